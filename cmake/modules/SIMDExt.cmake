@@ -10,6 +10,7 @@
 # HAVE_INTEL_PCLMUL
 # HAVE_INTEL_SSE4_1
 # HAVE_INTEL_SSE4_2
+# HAVE_INTEL_AVX2
 #
 # SIMD_COMPILE_FLAGS
 #
@@ -105,6 +106,9 @@ elseif(CMAKE_SYSTEM_PROCESSOR MATCHES "i386|i686|amd64|x86_64|AMD64")
       if(HAVE_INTEL_SSE4_2)
         set(SIMD_COMPILE_FLAGS "${SIMD_COMPILE_FLAGS} -msse4.2")
       endif()
+      # not added to SIMD_COMPILE_FLAGS: avx2 code is only built into
+      # files that check ceph_arch_intel_avx2 before using it
+      CHECK_C_COMPILER_FLAG(-mavx2 HAVE_INTEL_AVX2)
     endif(CMAKE_SYSTEM_PROCESSOR MATCHES "amd64|x86_64|AMD64")
   endif(CMAKE_SYSTEM_PROCESSOR MATCHES "i686|amd64|x86_64|AMD64")
 elseif(CMAKE_SYSTEM_PROCESSOR MATCHES "(powerpc|ppc)64|(powerpc|ppc)64le")
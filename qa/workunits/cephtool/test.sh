@@ -2051,6 +2051,15 @@ function test_mon_osd_pool_set()
       ceph osd pool get $TEST_POOL_GETSET $size | expect_false grep '.'
   done
 
+  for tag in qos_res qos_wgt qos_lim; do
+      ceph osd pool get $TEST_POOL_GETSET $tag | expect_false grep '.'
+      expect_false ceph osd pool set $TEST_POOL_GETSET $tag -1
+      ceph osd pool set $TEST_POOL_GETSET $tag 250
+      ceph osd pool get $TEST_POOL_GETSET $tag | grep '250'
+      ceph osd pool set $TEST_POOL_GETSET $tag 0
+      ceph osd pool get $TEST_POOL_GETSET $tag | expect_false grep '.'
+  done
+
   ceph osd pool set $TEST_POOL_GETSET nodelete 1
   expect_false ceph osd pool delete $TEST_POOL_GETSET $TEST_POOL_GETSET --yes-i-really-really-mean-it
   ceph osd pool set $TEST_POOL_GETSET nodelete 0
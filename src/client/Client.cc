@@ -219,7 +219,7 @@ vinodeno_t Client::_map_faked_ino(ino_t ino)
 
 vinodeno_t Client::map_faked_ino(ino_t ino)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   return _map_faked_ino(ino);
 }
 
@@ -228,7 +228,7 @@ vinodeno_t Client::map_faked_ino(ino_t ino)
 Client::Client(Messenger *m, MonClient *mc, Objecter *objecter_)
   : Dispatcher(m->cct),
     m_command_hook(this),
-    timer(m->cct, client_lock),
+    timer(m->cct, client_lock.mutex()),
     callback_handle(NULL),
     switch_interrupt_cb(NULL),
     remount_cb(NULL),
@@ -252,7 +252,8 @@ Client::Client(Messenger *m, MonClient *mc, Objecter *objecter_)
     mounted(false), unmounting(false), blacklisted(false),
     local_osd(-ENXIO), local_osd_epoch(0),
     unsafe_sync_write(0),
-    client_lock("Client::client_lock")
+    // with cct, mutex_perf_counter exposes the time spent waiting for it
+    client_lock("Client::client_lock", m->cct)
 {
   _reset_faked_inos();
   //
@@ -280,8 +281,8 @@ Client::Client(Messenger *m, MonClient *mc, Objecter *objecter_)
 
   // osd interfaces
   writeback_handler.reset(new ObjecterWriteback(objecter, &objecter_finisher,
-					    &client_lock));
-  objectcacher.reset(new ObjectCacher(cct, "libcephfs", *writeback_handler, client_lock,
+					    &client_lock.mutex()));
+  objectcacher.reset(new ObjectCacher(cct, "libcephfs", *writeback_handler, client_lock.mutex(),
 				  client_flush_set_callback,    // all commit callback
 				  (void*)this,
 				  cct->_conf->client_oc_size,
@@ -350,7 +351,7 @@ void Client::tear_down_cache()
 
 inodeno_t Client::get_root_ino()
 {
-  Mutex::Locker l(client_lock);
+  ClientLock::Locker l(client_lock);
   if (use_faked_inos())
     return root->faked_ino;
   else
@@ -359,7 +360,7 @@ inodeno_t Client::get_root_ino()
 
 Inode *Client::get_root()
 {
-  Mutex::Locker l(client_lock);
+  ClientLock::Locker l(client_lock);
   root->ll_get();
   return root;
 }
@@ -1623,8 +1624,101 @@ int Client::make_request(MetaRequest *request,
 			 mds_rank_t use_mds,
 			 bufferlist *pdirbl)
 {
-  int r = 0;
+  _make_request_start(request, perms, use_mds);
+
+  while (1) {
+    // set up wait cond
+    Cond caller_cond;
+    int r = _make_request_send(request, &caller_cond, true);
+    if (r < 0)
+      break;
+    if (r == 0)
+      continue;
+
+    // wait for signal
+    ldout(cct, 20) << "awaiting reply|forward|kick on " << &caller_cond << dendl;
+    while (!request->reply &&         // reply
+	   request->resend_mds < 0 && // forward
+	   !request->kick)
+      caller_cond.Wait(client_lock.mutex());
+    request->caller_cond = NULL;
+
+    // did we get a reply?
+    if (request->reply) 
+      break;
+  }
+
+  return _make_request_finish(request, perms, ptarget, pcreated, pdirbl);
+}
+
+void Client::make_requests(const vector<MetaRequest*>& requests,
+			   const UserPerm& perms, vector<int> *results)
+{
+  results->assign(requests.size(), 0);
+  set<size_t> unsent, inflight;
+  for (size_t i = 0; i < requests.size(); ++i) {
+    _make_request_start(requests[i], perms, -1);
+    unsent.insert(i);
+  }
+
+  Cond caller_cond;
+  while (!unsent.empty() || !inflight.empty()) {
+    for (auto p = unsent.begin(); p != unsent.end(); ) {
+      // Only wait for an mdsmap or session while nothing is in flight:
+      // a reply sits in the dispatcher until we collect it, and would
+      // hold up the very message we are waiting for.
+      int r = _make_request_send(requests[*p], &caller_cond,
+				 inflight.empty());
+      if (r == 0) {
+	++p;
+	continue;
+      }
+      if (r > 0)
+	inflight.insert(*p);
+      else
+	(*results)[*p] = _make_request_finish(requests[*p], perms,
+					      NULL, NULL, NULL);
+      unsent.erase(p++);
+    }
+    if (inflight.empty())
+      continue;
 
+    ldout(cct, 20) << "awaiting reply|forward|kick on " << inflight.size()
+		   << " requests on " << &caller_cond << dendl;
+    while (1) {
+      bool progress = false;
+      for (auto i : inflight) {
+	MetaRequest *request = requests[i];
+	if (request->reply || request->resend_mds >= 0 || request->kick) {
+	  progress = true;
+	  break;
+	}
+      }
+      if (progress)
+	break;
+      caller_cond.Wait(client_lock.mutex());
+    }
+
+    for (auto p = inflight.begin(); p != inflight.end(); ) {
+      MetaRequest *request = requests[*p];
+      if (request->reply) {
+	request->caller_cond = NULL;
+	(*results)[*p] = _make_request_finish(request, perms, NULL, NULL, NULL);
+	inflight.erase(p++);
+      } else if (request->resend_mds >= 0 || request->kick) {
+	request->caller_cond = NULL;
+	unsent.insert(*p);
+	inflight.erase(p++);
+      } else {
+	++p;
+      }
+    }
+  }
+}
+
+void Client::_make_request_start(MetaRequest *request, const UserPerm& perms,
+				 mds_rank_t use_mds)
+{
   // assign a unique tid
   ceph_tid_t tid = ++last_tid;
   request->set_tid(tid);
@@ -1649,79 +1743,83 @@ int Client::make_request(MetaRequest *request,
   // hack target mds?
   if (use_mds >= 0)
     request->resend_mds = use_mds;
+}
 
-  while (1) {
-    if (request->aborted())
-      break;
+int Client::_make_request_send(MetaRequest *request, Cond *caller_cond,
+			       bool can_block)
+{
+  if (request->aborted())
+    return -1;
 
-    if (blacklisted) {
-      request->abort(-EBLACKLISTED);
-      break;
-    }
+  if (blacklisted) {
+    request->abort(-EBLACKLISTED);
+    return -1;
+  }
 
-    // set up wait cond
-    Cond caller_cond;
-    request->caller_cond = &caller_cond;
-
-    // choose mds
-    Inode *hash_diri = NULL;
-    mds_rank_t mds = choose_target_mds(request, &hash_diri);
-    int mds_state = (mds == MDS_RANK_NONE) ? MDSMap::STATE_NULL : mdsmap->get_state(mds);
-    if (mds_state != MDSMap::STATE_ACTIVE && mds_state != MDSMap::STATE_STOPPING) {
-      if (mds_state == MDSMap::STATE_NULL && mds >= mdsmap->get_max_mds()) {
-	if (hash_diri) {
-	  ldout(cct, 10) << " target mds." << mds << " has stopped, remove it from fragmap" << dendl;
-	  _fragmap_remove_stopped_mds(hash_diri, mds);
-	} else {
-	  ldout(cct, 10) << " target mds." << mds << " has stopped, trying a random mds" << dendl;
-	  request->resend_mds = _get_random_up_mds();
-	}
+  request->caller_cond = caller_cond;
+
+  // choose mds
+  mds_rank_t resend_mds = request->resend_mds;
+  Inode *hash_diri = NULL;
+  mds_rank_t mds = choose_target_mds(request, &hash_diri);
+  int mds_state = (mds == MDS_RANK_NONE) ? MDSMap::STATE_NULL : mdsmap->get_state(mds);
+  if (mds_state != MDSMap::STATE_ACTIVE && mds_state != MDSMap::STATE_STOPPING) {
+    if (mds_state == MDSMap::STATE_NULL && mds >= mdsmap->get_max_mds()) {
+      if (hash_diri) {
+	ldout(cct, 10) << " target mds." << mds << " has stopped, remove it from fragmap" << dendl;
+	_fragmap_remove_stopped_mds(hash_diri, mds);
       } else {
-	ldout(cct, 10) << " target mds." << mds << " not active, waiting for new mdsmap" << dendl;
-	wait_on_list(waiting_for_mdsmap);
+	ldout(cct, 10) << " target mds." << mds << " has stopped, trying a random mds" << dendl;
+	request->resend_mds = _get_random_up_mds();
       }
-      continue;
+    } else if (can_block) {
+      ldout(cct, 10) << " target mds." << mds << " not active, waiting for new mdsmap" << dendl;
+      wait_on_list(waiting_for_mdsmap);
+    } else {
+      request->resend_mds = resend_mds;
     }
+    return 0;
+  }
 
-    // open a session?
-    MetaSession *session = NULL;
-    if (!have_open_session(mds)) {
-      session = _get_or_open_mds_session(mds);
+  // open a session?
+  MetaSession *session = NULL;
+  if (!have_open_session(mds)) {
+    session = _get_or_open_mds_session(mds);
 
-      // wait
-      if (session->state == MetaSession::STATE_OPENING) {
-	ldout(cct, 10) << "waiting for session to mds." << mds << " to open" << dendl;
-	wait_on_context_list(session->waiting_for_open);
-        // Abort requests on REJECT from MDS
-        if (rejected_by_mds.count(mds)) {
-          request->abort(-EPERM);
-          break;
-        }
-	continue;
+    // wait
+    if (session->state == MetaSession::STATE_OPENING) {
+      if (!can_block) {
+	request->resend_mds = resend_mds;
+	return 0;
       }
-
-      if (!have_open_session(mds))
-	continue;
-    } else {
-      session = mds_sessions[mds];
+      ldout(cct, 10) << "waiting for session to mds." << mds << " to open" << dendl;
+      wait_on_context_list(session->waiting_for_open);
+      // Abort requests on REJECT from MDS
+      if (rejected_by_mds.count(mds)) {
+	request->abort(-EPERM);
+	return -1;
+      }
+      return 0;
     }
 
-    // send request.
-    send_request(request, session);
+    if (!have_open_session(mds))
+      return 0;
+  } else {
+    session = mds_sessions[mds];
+  }
 
-    // wait for signal
-    ldout(cct, 20) << "awaiting reply|forward|kick on " << &caller_cond << dendl;
-    request->kick = false;
-    while (!request->reply &&         // reply
-	   request->resend_mds < 0 && // forward
-	   !request->kick)
-      caller_cond.Wait(client_lock);
-    request->caller_cond = NULL;
+  // send request.
+  send_request(request, session);
+  request->kick = false;
+  return 1;
+}
 
-    // did we get a reply?
-    if (request->reply) 
-      break;
-  }
+int Client::_make_request_finish(MetaRequest *request, const UserPerm& perms,
+				 InodeRef *ptarget, bool *pcreated,
+				 bufferlist *pdirbl)
+{
+  int r = 0;
+  ceph_tid_t tid = request->get_tid();
 
   if (!request->reply) {
     assert(request->aborted());
@@ -1976,7 +2074,7 @@ void Client::populate_metadata(const std::string &mount_root)
  */
 void Client::update_metadata(std::string const &k, std::string const &v)
 {
-  Mutex::Locker l(client_lock);
+  ClientLock::Locker l(client_lock);
   assert(initialized);
 
   if (metadata.count(k)) {
@@ -2347,7 +2445,7 @@ void Client::handle_client_reply(MClientReply *reply)
     // wake for kick back
     while (request->dispatch_cond) {
       ldout(cct, 20) << "handle_client_reply awaiting kickback on tid " << tid << " " << &cond << dendl;
-      cond.Wait(client_lock);
+      cond.Wait(client_lock.mutex());
     }
   }
 
@@ -2491,7 +2589,7 @@ void Client::handle_osd_map(MOSDMap *m)
 
 bool Client::ms_dispatch(Message *m)
 {
-  Mutex::Locker l(client_lock);
+  ClientLock::Locker l(client_lock);
   if (!initialized) {
     ldout(cct, 10) << "inactive, discarding " << *m << dendl;
     m->put();
@@ -2923,6 +3021,7 @@ void Client::put_inode(Inode *in, int n)
     remove_all_caps(in);
 
     ldout(cct, 10) << "put_inode deleting " << *in << dendl;
+    ll_stat_snaps.erase(in);
     bool unclean = objectcacher->release_set(&in->oset);
     assert(!unclean);
     inode_map.erase(in->vino());
@@ -3058,6 +3157,7 @@ public:
   C_Client_FlushComplete(Client *c, Inode *in) : client(c), inode(in) { }
   void finish(int r) override {
     assert(client->client_lock.is_locked_by_me());
+    client->client_lock.note_changed();
     if (r != 0) {
       client_t const whoami = client->whoami;  // For the benefit of ldout prefix
       ldout(client->cct, 1) << "I/O error from flush on inode " << inode
@@ -3666,7 +3766,7 @@ void Client::wait_on_list(list<Cond*>& ls)
 {
   Cond cond;
   ls.push_back(&cond);
-  cond.Wait(client_lock);
+  cond.Wait(client_lock.mutex());
   ls.remove(&cond);
 }
 
@@ -3683,7 +3783,7 @@ void Client::wait_on_context_list(list<Context*>& ls)
   int r;
   ls.push_back(new C_Cond(&cond, &done, &r));
   while (!done)
-    cond.Wait(client_lock);
+    cond.Wait(client_lock.mutex());
 }
 
 void Client::signal_context_list(list<Context*>& ls)
@@ -3829,6 +3929,7 @@ void Client::flush_set_callback(ObjectCacher::ObjectSet *oset)
   assert(client_lock.is_locked());   // will be called via dispatch() -> objecter -> ...
   Inode *in = static_cast<Inode *>(oset->parent);
   assert(in);
+  client_lock.note_changed();
   _flushed(in);
 }
 
@@ -4271,7 +4372,7 @@ void Client::wait_sync_caps(ceph_tid_t want)
     if (oldest_tid <= want) {
       ldout(cct, 10) << " waiting on mds." << p->first << " tid " << oldest_tid
 		     << " (want " << want << ")" << dendl;
-      sync_cond.Wait(client_lock);
+      sync_cond.Wait(client_lock.mutex());
       goto retry;
     }
   }
@@ -5564,7 +5665,7 @@ int Client::mds_command(
     string *outs,
     Context *onfinish)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (!initialized)
     return -ENOTCONN;
@@ -5674,7 +5775,7 @@ void Client::handle_command_reply(MCommandReply *m)
 int Client::mount(const std::string &mount_root, const UserPerm& perms,
 		  bool require_mds)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (mounted) {
     ldout(cct, 5) << "already mounted" << dendl;
@@ -5800,7 +5901,7 @@ void Client::_close_sessions()
 
     // wait for sessions to close
     ldout(cct, 2) << "waiting for " << mds_sessions.size() << " mds sessions to close" << dendl;
-    mount_cond.Wait(client_lock);
+    mount_cond.Wait(client_lock.mutex());
   }
 }
 
@@ -5830,7 +5931,7 @@ void Client::flush_mdlog(MetaSession *session)
 
 void Client::unmount()
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return;
@@ -5841,7 +5942,7 @@ void Client::unmount()
   flush_mdlog_sync(); // flush the mdlog for pending requests, if any
   while (!mds_requests.empty()) {
     ldout(cct, 10) << "waiting on " << mds_requests.size() << " requests" << dendl;
-    mount_cond.Wait(client_lock);
+    mount_cond.Wait(client_lock.mutex());
   }
 
   if (tick_event)
@@ -5853,6 +5954,7 @@ void Client::unmount()
   // clean up any unclosed files
   while (!fd_map.empty()) {
     Fh *fh = fd_map.begin()->second;
+    fd_stat_snaps.erase(fd_map.begin()->first);
     fd_map.erase(fd_map.begin());
     ldout(cct, 0) << " destroyed lost open file " << fh << " on " << *fh->inode << dendl;
     _release_fh(fh);
@@ -5893,7 +5995,7 @@ void Client::unmount()
 
   while (unsafe_sync_write > 0) {
     ldout(cct, 0) << unsafe_sync_write << " unsafe_sync_writes, waiting"  << dendl;
-    mount_cond.Wait(client_lock);
+    mount_cond.Wait(client_lock.mutex());
   }
 
   if (cct->_conf->client_oc) {
@@ -5930,7 +6032,7 @@ void Client::unmount()
 	    << ", waiting (for caps to release?)"
             << dendl;
     utime_t until = ceph_clock_now() + utime_t(5, 0);
-    int r = mount_cond.WaitUntil(client_lock, until);
+    int r = mount_cond.WaitUntil(client_lock.mutex(), until);
     if (r == ETIMEDOUT) {
       dump_cache(NULL);
     }
@@ -5972,6 +6074,8 @@ void Client::flush_cap_releases()
 
 void Client::tick()
 {
+  // SafeTimer takes client_lock.mutex() directly; see ClientLock
+  client_lock.note_changed();
   if (cct->_conf->client_debug_inject_tick_delay > 0) {
     sleep(cct->_conf->client_debug_inject_tick_delay);
     assert(0 == cct->_conf->set_val("client_debug_inject_tick_delay", "0"));
@@ -6296,7 +6400,7 @@ int Client::path_walk(const filepath& origpath, InodeRef *end,
 
 int Client::link(const char *relexisting, const char *relpath, const UserPerm& perm)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "link" << std::endl;
   tout(cct) << relexisting << std::endl;
   tout(cct) << relpath << std::endl;
@@ -6339,7 +6443,7 @@ int Client::link(const char *relexisting, const char *relpath, const UserPerm& p
 
 int Client::unlink(const char *relpath, const UserPerm& perm)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "unlink" << std::endl;
   tout(cct) << relpath << std::endl;
 
@@ -6366,7 +6470,7 @@ int Client::unlink(const char *relpath, const UserPerm& perm)
 
 int Client::rename(const char *relfrom, const char *relto, const UserPerm& perm)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "rename" << std::endl;
   tout(cct) << relfrom << std::endl;
   tout(cct) << relto << std::endl;
@@ -6409,7 +6513,7 @@ out:
 
 int Client::mkdir(const char *relpath, mode_t mode, const UserPerm& perm)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "mkdir" << std::endl;
   tout(cct) << relpath << std::endl;
   tout(cct) << mode << std::endl;
@@ -6438,7 +6542,7 @@ int Client::mkdir(const char *relpath, mode_t mode, const UserPerm& perm)
 
 int Client::mkdirs(const char *relpath, mode_t mode, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   ldout(cct, 10) << "Client::mkdirs " << relpath << dendl;
   tout(cct) << "mkdirs" << std::endl;
   tout(cct) << relpath << std::endl;
@@ -6495,7 +6599,7 @@ int Client::mkdirs(const char *relpath, mode_t mode, const UserPerm& perms)
 
 int Client::rmdir(const char *relpath, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "rmdir" << std::endl;
   tout(cct) << relpath << std::endl;
 
@@ -6522,7 +6626,7 @@ int Client::rmdir(const char *relpath, const UserPerm& perms)
 
 int Client::mknod(const char *relpath, mode_t mode, const UserPerm& perms, dev_t rdev) 
 { 
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "mknod" << std::endl;
   tout(cct) << relpath << std::endl;
   tout(cct) << mode << std::endl;
@@ -6553,7 +6657,7 @@ int Client::mknod(const char *relpath, mode_t mode, const UserPerm& perms, dev_t
   
 int Client::symlink(const char *target, const char *relpath, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "symlink" << std::endl;
   tout(cct) << target << std::endl;
   tout(cct) << relpath << std::endl;
@@ -6581,7 +6685,7 @@ int Client::symlink(const char *target, const char *relpath, const UserPerm& per
 
 int Client::readlink(const char *relpath, char *buf, loff_t size, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "readlink" << std::endl;
   tout(cct) << relpath << std::endl;
 
@@ -6887,7 +6991,7 @@ int Client::_setattr(InodeRef &in, struct stat *attr, int mask,
 int Client::setattr(const char *relpath, struct stat *attr, int mask,
 		    const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "setattr" << std::endl;
   tout(cct) << relpath << std::endl;
   tout(cct) << mask  << std::endl;
@@ -6906,7 +7010,7 @@ int Client::setattr(const char *relpath, struct stat *attr, int mask,
 int Client::setattrx(const char *relpath, struct ceph_statx *stx, int mask,
 		     const UserPerm& perms, int flags)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "setattrx" << std::endl;
   tout(cct) << relpath << std::endl;
   tout(cct) << mask  << std::endl;
@@ -6924,7 +7028,7 @@ int Client::setattrx(const char *relpath, struct ceph_statx *stx, int mask,
 
 int Client::fsetattr(int fd, struct stat *attr, int mask, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "fsetattr" << std::endl;
   tout(cct) << fd << std::endl;
   tout(cct) << mask  << std::endl;
@@ -6944,7 +7048,7 @@ int Client::fsetattr(int fd, struct stat *attr, int mask, const UserPerm& perms)
 
 int Client::fsetattrx(int fd, struct ceph_statx *stx, int mask, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "fsetattr" << std::endl;
   tout(cct) << fd << std::endl;
   tout(cct) << mask  << std::endl;
@@ -6966,7 +7070,7 @@ int Client::stat(const char *relpath, struct stat *stbuf, const UserPerm& perms,
 		 frag_info_t *dirstat, int mask)
 {
   ldout(cct, 3) << "stat enter (relpath " << relpath << " mask " << mask << ")" << dendl;
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "stat" << std::endl;
   tout(cct) << relpath << std::endl;
 
@@ -7015,7 +7119,7 @@ int Client::statx(const char *relpath, struct ceph_statx *stx,
 		  unsigned int want, unsigned int flags)
 {
   ldout(cct, 3) << "statx enter (relpath " << relpath << " want " << want << ")" << dendl;
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "statx" << std::endl;
   tout(cct) << relpath << std::endl;
 
@@ -7046,7 +7150,7 @@ int Client::lstat(const char *relpath, struct stat *stbuf,
 		  const UserPerm& perms, frag_info_t *dirstat, int mask)
 {
   ldout(cct, 3) << "lstat enter (relpath " << relpath << " mask " << mask << ")" << dendl;
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "lstat" << std::endl;
   tout(cct) << relpath << std::endl;
 
@@ -7184,6 +7288,88 @@ void Client::fill_statx(Inode *in, unsigned int mask, struct ceph_statx *stx)
 
 }
 
+/*
+ * Called under client_lock by a cache hit that changed nothing, which
+ * is then expected to set_unchanged() so that the snapshot stays good
+ * at the generation client_lock goes back to.
+ */
+void Client::save_stat_snapshot(Inode *in, StatSnapshot *snap)
+{
+  assert(client_lock.is_locked_by_me());
+  snap->gen = client_lock.get_gen() - 1;
+  snap->snap_caps = in->snap_caps;
+  snap->issued = 0;
+  snap->cap_ttl = utime_t();
+  bool first = true;
+  for (auto &p : in->caps) {
+    Cap *cap = p.second;
+    if (!in->cap_is_valid(cap))
+      continue;
+    snap->issued |= cap->issued;
+    if (first || cap->session->cap_ttl < snap->cap_ttl)
+      snap->cap_ttl = cap->session->cap_ttl;
+    first = false;
+  }
+  fill_statx(in, 0, &snap->stx);
+}
+
+/*
+ * Answer a statx from a snapshot without client_lock, mirroring what
+ * fill_statx() would report for mask.  Returns false if the snapshot
+ * is stale or does not have the caps mask asks for.
+ */
+bool Client::stat_from_snapshot(const StatSnapshot& snap, unsigned mask,
+				struct ceph_statx *stx)
+{
+  if (snap.gen != client_lock.get_gen())
+    return false;
+  if ((mask & snap.snap_caps) != mask &&
+      ((mask & (snap.snap_caps | snap.issued)) != mask ||
+       ceph_clock_now() >= snap.cap_ttl))
+    return false;
+
+  if (!mask)
+    mask = ~0;
+
+  const struct ceph_statx& full = snap.stx;
+  memset(stx, 0, sizeof(struct ceph_statx));
+  stx->stx_dev = full.stx_dev;
+  stx->stx_blksize = full.stx_blksize;
+  stx->stx_mode = S_IFMT & full.stx_mode;
+  stx->stx_ino = full.stx_ino;
+  stx->stx_rdev = full.stx_rdev;
+  stx->stx_mask |= (CEPH_STATX_INO|CEPH_STATX_RDEV);
+
+  if (mask & CEPH_CAP_AUTH_SHARED) {
+    stx->stx_uid = full.stx_uid;
+    stx->stx_gid = full.stx_gid;
+    stx->stx_mode = full.stx_mode;
+    stx->stx_btime = full.stx_btime;
+    stx->stx_mask |= (CEPH_STATX_MODE|CEPH_STATX_UID|CEPH_STATX_GID|CEPH_STATX_BTIME);
+  }
+
+  if (mask & CEPH_CAP_LINK_SHARED) {
+    stx->stx_nlink = full.stx_nlink;
+    stx->stx_mask |= CEPH_STATX_NLINK;
+  }
+
+  if (mask & CEPH_CAP_FILE_SHARED) {
+    stx->stx_atime = full.stx_atime;
+    stx->stx_mtime = full.stx_mtime;
+    stx->stx_size = full.stx_size;
+    stx->stx_blocks = full.stx_blocks;
+    stx->stx_mask |= (CEPH_STATX_ATIME|CEPH_STATX_MTIME|
+		      CEPH_STATX_SIZE|CEPH_STATX_BLOCKS);
+  }
+
+  if ((mask & CEPH_STAT_CAP_INODE_ALL) == CEPH_STAT_CAP_INODE_ALL) {
+    stx->stx_version = full.stx_version;
+    stx->stx_ctime = full.stx_ctime;
+    stx->stx_mask |= (CEPH_STATX_CTIME|CEPH_STATX_VERSION);
+  }
+  return true;
+}
+
 void Client::touch_dn(Dentry *dn)
 {
   lru.lru_touch(dn);
@@ -7191,7 +7377,7 @@ void Client::touch_dn(Dentry *dn)
 
 int Client::chmod(const char *relpath, mode_t mode, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "chmod" << std::endl;
   tout(cct) << relpath << std::endl;
   tout(cct) << mode << std::endl;
@@ -7211,7 +7397,7 @@ int Client::chmod(const char *relpath, mode_t mode, const UserPerm& perms)
 
 int Client::fchmod(int fd, mode_t mode, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "fchmod" << std::endl;
   tout(cct) << fd << std::endl;
   tout(cct) << mode << std::endl;
@@ -7233,7 +7419,7 @@ int Client::fchmod(int fd, mode_t mode, const UserPerm& perms)
 
 int Client::lchmod(const char *relpath, mode_t mode, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "lchmod" << std::endl;
   tout(cct) << relpath << std::endl;
   tout(cct) << mode << std::endl;
@@ -7255,7 +7441,7 @@ int Client::lchmod(const char *relpath, mode_t mode, const UserPerm& perms)
 int Client::chown(const char *relpath, uid_t new_uid, gid_t new_gid,
 		  const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "chown" << std::endl;
   tout(cct) << relpath << std::endl;
   tout(cct) << new_uid << std::endl;
@@ -7277,7 +7463,7 @@ int Client::chown(const char *relpath, uid_t new_uid, gid_t new_gid,
 
 int Client::fchown(int fd, uid_t new_uid, gid_t new_gid, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "fchown" << std::endl;
   tout(cct) << fd << std::endl;
   tout(cct) << new_uid << std::endl;
@@ -7305,7 +7491,7 @@ int Client::fchown(int fd, uid_t new_uid, gid_t new_gid, const UserPerm& perms)
 int Client::lchown(const char *relpath, uid_t new_uid, gid_t new_gid,
 		   const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "lchown" << std::endl;
   tout(cct) << relpath << std::endl;
   tout(cct) << new_uid << std::endl;
@@ -7332,7 +7518,7 @@ int Client::lchown(const char *relpath, uid_t new_uid, gid_t new_gid,
 int Client::utime(const char *relpath, struct utimbuf *buf,
 		  const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "utime" << std::endl;
   tout(cct) << relpath << std::endl;
   tout(cct) << buf->modtime << std::endl;
@@ -7357,7 +7543,7 @@ int Client::utime(const char *relpath, struct utimbuf *buf,
 int Client::lutime(const char *relpath, struct utimbuf *buf,
 		   const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "lutime" << std::endl;
   tout(cct) << relpath << std::endl;
   tout(cct) << buf->modtime << std::endl;
@@ -7382,7 +7568,7 @@ int Client::lutime(const char *relpath, struct utimbuf *buf,
 
 int Client::flock(int fd, int operation, uint64_t owner)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "flock" << std::endl;
   tout(cct) << fd << std::endl;
   tout(cct) << operation << std::endl;
@@ -7400,7 +7586,7 @@ int Client::flock(int fd, int operation, uint64_t owner)
 
 int Client::opendir(const char *relpath, dir_result_t **dirpp, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "opendir" << std::endl;
   tout(cct) << relpath << std::endl;
 
@@ -7437,7 +7623,7 @@ int Client::_opendir(Inode *in, dir_result_t **dirpp, const UserPerm& perms)
 
 int Client::closedir(dir_result_t *dir) 
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "closedir" << std::endl;
   tout(cct) << (unsigned long)dir << std::endl;
 
@@ -7460,7 +7646,7 @@ void Client::_closedir(dir_result_t *dirp)
 
 void Client::rewinddir(dir_result_t *dirp)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   ldout(cct, 3) << "rewinddir(" << dirp << ")" << dendl;
 
   if (unmounting)
@@ -7480,7 +7666,7 @@ loff_t Client::telldir(dir_result_t *dirp)
 
 void Client::seekdir(dir_result_t *dirp, loff_t offset)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   ldout(cct, 3) << "seekdir(" << dirp << ", " << offset << ")" << dendl;
 
@@ -7585,7 +7771,7 @@ void Client::_readdir_drop_dirp_buffer(dir_result_t *dirp)
   dirp->buffer.clear();
 }
 
-int Client::_readdir_get_frag(dir_result_t *dirp)
+MetaRequest *Client::_readdir_make_request(dir_result_t *dirp)
 {
   assert(dirp);
   assert(dirp->inode);
@@ -7619,6 +7805,12 @@ int Client::_readdir_get_frag(dir_result_t *dirp)
     req->head.args.readdir.offset_hash = dirp->offset_high();
   }
   req->dirp = dirp;
+  return req;
+}
+
+int Client::_readdir_get_frag(dir_result_t *dirp)
+{
+  MetaRequest *req = _readdir_make_request(dirp);
   
   bufferlist dirbl;
   int res = make_request(req, dirp->perms, NULL, NULL, -1, &dirbl);
@@ -7734,7 +7926,7 @@ int Client::readdir_r_cb(dir_result_t *d, add_dirent_cb_t cb, void *p,
 {
   int caps = statx_to_mask(flags, want);
 
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -8006,6 +8198,155 @@ int Client::readdirplus_r(dir_result_t *d, struct dirent *de,
   return 0;
 }
 
+/*
+ * readdirplus_bulk
+ *
+ * Read every frag of the directory at once, then hand the entries to
+ * cb.  The attributes come from the readdir replies themselves, so
+ * there is no getattr per entry.
+ */
+int Client::_readdir_bulk(dir_result_t *dirp, add_dirent_cb_t cb, void *p,
+			  int caps, bool getref, bool *stale)
+{
+  assert(client_lock.is_locked());
+  InodeRef diri = dirp->inode;
+  *stale = false;
+
+  list<frag_t> frags;
+  diri->dirfragtree.get_leaves(frags);
+  ldout(cct, 10) << "_readdir_bulk " << *diri << " frags " << frags << dendl;
+
+  vector<frag_t> fgs(frags.begin(), frags.end());
+  vector<unique_ptr<dir_result_t> > parts;
+  vector<vector<dir_result_t::dentry> > found(fgs.size());
+  vector<size_t> active;
+  for (size_t i = 0; i < fgs.size(); ++i) {
+    parts.emplace_back(new dir_result_t(diri.get(), dirp->perms));
+    parts.back()->offset = dir_result_t::make_fpos(fgs[i], 2, false);
+    active.push_back(i);
+  }
+
+  while (!active.empty()) {
+    vector<MetaRequest*> requests;
+    for (auto i : active)
+      requests.push_back(_readdir_make_request(parts[i].get()));
+    vector<int> results;
+    make_requests(requests, dirp->perms, &results);
+
+    vector<size_t> more;
+    for (size_t k = 0; k < active.size(); ++k) {
+      size_t i = active[k];
+      if (results[k] < 0 && results[k] != -EAGAIN)
+	return results[k];
+      if (results[k] == -EAGAIN || parts[i]->buffer_frag != fgs[i]) {
+	ldout(cct, 10) << "_readdir_bulk frag " << fgs[i]
+		       << " is stale, r = " << results[k] << dendl;
+	*stale = true;
+	return 0;
+      }
+      vector<dir_result_t::dentry>& buffer = parts[i]->buffer;
+      found[i].insert(found[i].end(), buffer.begin(), buffer.end());
+      _readdir_drop_dirp_buffer(parts[i].get());
+      if (parts[i]->next_offset > 2)
+	more.push_back(i);
+    }
+    active.swap(more);
+  }
+  dirp->set_end();
+
+  struct dirent de;
+  struct ceph_statx stx;
+  memset(&de, 0, sizeof(de));
+  memset(&stx, 0, sizeof(stx));
+  for (auto& entries : found) {
+    for (auto& entry : entries) {
+      uint64_t next_off = entry.offset + 1;
+      fill_statx(entry.inode, caps, &stx);
+      fill_dirent(&de, entry.name.c_str(), stx.stx_mode, stx.stx_ino, next_off);
+
+      Inode *inode = NULL;
+      if (getref) {
+	inode = entry.inode.get();
+	_ll_get(inode);
+      }
+
+      client_lock.Unlock();
+      int r = cb(p, &de, &stx, next_off, inode);
+      client_lock.Lock();
+      if (r != 0)
+	return r;
+    }
+  }
+  return 0;
+}
+
+/*
+ * The fallback goes through readdir_r_cb, which gives a negative return
+ * from the callback its own meaning (-EAGAIN from the cached path means
+ * "cache went stale", and the entries would be handed out again).  Pass
+ * the caller's callback through this shim so that any non-zero return
+ * stops the walk and is returned as is, like it does on the bulk path.
+ */
+struct readdir_bulk_fallback_result {
+  int (*cb)(void *p, struct dirent *de, struct ceph_statx *stx, off_t off,
+	    Inode *in);
+  void *p;
+  int r;
+};
+
+static int _readdir_bulk_fallback_cb(void *p, struct dirent *de,
+				     struct ceph_statx *stx, off_t off,
+				     Inode *in)
+{
+  readdir_bulk_fallback_result *fr =
+    static_cast<readdir_bulk_fallback_result*>(p);
+  fr->r = fr->cb(fr->p, de, stx, off, in);
+  return fr->r ? 1 : 0;
+}
+
+int Client::readdirplus_bulk(dir_result_t *d, add_dirent_cb_t cb, void *p,
+			     unsigned want, unsigned flags, bool getref)
+{
+  int caps = statx_to_mask(flags, want);
+  dir_result_t *dirp = static_cast<dir_result_t*>(d);
+
+  {
+    ClientLock::Locker lock(client_lock);
+
+    if (unmounting)
+      return -ENOTCONN;
+
+    ldout(cct, 10) << "readdirplus_bulk " << *dirp->inode << dendl;
+
+    for (int attempt = 0; attempt < 3; ++attempt) {
+      bool stale;
+      int r = _readdir_bulk(dirp, cb, p, caps, getref, &stale);
+      if (!stale)
+	return r;
+    }
+
+    // the frag tree keeps moving under us; walk it one frag at a time
+    ldout(cct, 10) << "readdirplus_bulk falling back to readdir" << dendl;
+    _readdir_drop_dirp_buffer(dirp);
+    dirp->offset = dir_result_t::make_fpos(0, 2, false);
+    dirp->next_offset = 2;
+    dirp->last_name.clear();
+    _readdir_rechoose_frag(dirp);
+  }
+
+  readdir_bulk_fallback_result fr = { cb, p, 0 };
+  int r = readdir_r_cb(dirp, _readdir_bulk_fallback_cb, &fr, want, flags,
+		       getref);
+  if (r < 0)
+    return r;
+  if (fr.r) {
+    // the bulk path leaves dirp at the end even when cb stops it early
+    ClientLock::Locker lock(client_lock);
+    dirp->set_end();
+  }
+  return fr.r;
+}
+
 
 /* getdents */
 struct getdents_result {
@@ -8082,7 +8423,7 @@ int Client::getdir(const char *relpath, list<string>& contents,
 {
   ldout(cct, 3) << "getdir(" << relpath << ")" << dendl;
   {
-    Mutex::Locker lock(client_lock);
+    ClientLock::Locker lock(client_lock);
     tout(cct) << "getdir" << std::endl;
     tout(cct) << relpath << std::endl;
   }
@@ -8111,7 +8452,7 @@ int Client::open(const char *relpath, int flags, const UserPerm& perms,
 		 int object_size, const char *data_pool)
 {
   ldout(cct, 3) << "open enter(" << relpath << ", " << ceph_flags_sys2wire(flags) << "," << mode << ")" << dendl;
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "open" << std::endl;
   tout(cct) << relpath << std::endl;
   tout(cct) << ceph_flags_sys2wire(flags) << std::endl;
@@ -8200,7 +8541,7 @@ int Client::open(const char *relpath, int flags, const UserPerm& perms, mode_t m
 int Client::lookup_hash(inodeno_t ino, inodeno_t dirino, const char *name,
 			const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   ldout(cct, 3) << "lookup_hash enter(" << ino << ", #" << dirino << "/" << name << ")" << dendl;
 
   if (unmounting)
@@ -8233,7 +8574,7 @@ int Client::lookup_hash(inodeno_t ino, inodeno_t dirino, const char *name,
  */
 int Client::lookup_ino(inodeno_t ino, const UserPerm& perms, Inode **inode)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   ldout(cct, 3) << "lookup_ino enter(" << ino << ")" << dendl;
 
   if (unmounting)
@@ -8264,7 +8605,7 @@ int Client::lookup_ino(inodeno_t ino, const UserPerm& perms, Inode **inode)
  */
 int Client::lookup_parent(Inode *ino, const UserPerm& perms, Inode **parent)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   ldout(cct, 3) << "lookup_parent enter(" << ino->ino << ")" << dendl;
 
   if (unmounting)
@@ -8312,7 +8653,7 @@ int Client::lookup_name(Inode *ino, Inode *parent, const UserPerm& perms)
 {
   assert(parent->is_dir());
 
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   ldout(cct, 3) << "lookup_name enter(" << ino->ino << ")" << dendl;
 
   if (unmounting)
@@ -8494,7 +8835,7 @@ int Client::_renew_caps(Inode *in)
 int Client::close(int fd)
 {
   ldout(cct, 3) << "close enter(" << fd << ")" << dendl;
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "close" << std::endl;
   tout(cct) << fd << std::endl;
 
@@ -8506,6 +8847,7 @@ int Client::close(int fd)
     return -EBADF;
   int err = _release_fh(fh);
   fd_map.erase(fd);
+  fd_stat_snaps.erase(fd);
   put_fd(fd);
   ldout(cct, 3) << "close exit(" << fd << ")" << dendl;
   return err;
@@ -8517,7 +8859,7 @@ int Client::close(int fd)
 
 loff_t Client::lseek(int fd, loff_t offset, int whence)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "lseek" << std::endl;
   tout(cct) << fd << std::endl;
   tout(cct) << offset << std::endl;
@@ -8582,7 +8924,7 @@ void Client::lock_fh_pos(Fh *f)
     f->pos_waiters.push_back(&cond);
     ldout(cct, 10) << "lock_fh_pos BLOCKING on " << f << dendl;
     while (f->pos_locked || f->pos_waiters.front() != &cond)
-      cond.Wait(client_lock);
+      cond.Wait(client_lock.mutex());
     ldout(cct, 10) << "lock_fh_pos UNBLOCKING on " << f << dendl;
     assert(f->pos_waiters.front() == &cond);
     f->pos_waiters.pop_front();
@@ -8648,7 +8990,7 @@ int Client::uninline_data(Inode *in, Context *onfinish)
 
 int Client::read(int fd, char *buf, loff_t size, loff_t offset)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "read" << std::endl;
   tout(cct) << fd << std::endl;
   tout(cct) << size << std::endl;
@@ -8838,6 +9180,7 @@ Client::C_Readahead::~C_Readahead() {
 
 void Client::C_Readahead::finish(int r) {
   lgeneric_subdout(client->cct, client, 20) << "client." << client->get_nodeid() << " " << "C_Readahead on " << f->inode << dendl;
+  client->client_lock.note_changed();
   client->put_cap_ref(f->inode.get(), CEPH_CAP_FILE_RD | CEPH_CAP_FILE_CACHE);
 }
 
@@ -8994,7 +9337,7 @@ void Client::_sync_write_commit(Inode *in)
 
 int Client::write(int fd, const char *buf, loff_t size, loff_t offset) 
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "write" << std::endl;
   tout(cct) << fd << std::endl;
   tout(cct) << size << std::endl;
@@ -9024,7 +9367,7 @@ int Client::pwritev(int fd, const struct iovec *iov, int iovcnt, int64_t offset)
 
 int Client::_preadv_pwritev(int fd, const struct iovec *iov, unsigned iovcnt, int64_t offset, bool write)
 {
-    Mutex::Locker lock(client_lock);
+    ClientLock::Locker lock(client_lock);
     tout(cct) << fd << std::endl;
     tout(cct) << offset << std::endl;
 
@@ -9333,7 +9676,7 @@ int Client::truncate(const char *relpath, loff_t length, const UserPerm& perms)
 
 int Client::ftruncate(int fd, loff_t length, const UserPerm& perms) 
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "ftruncate" << std::endl;
   tout(cct) << fd << std::endl;
   tout(cct) << length << std::endl;
@@ -9355,7 +9698,7 @@ int Client::ftruncate(int fd, loff_t length, const UserPerm& perms)
 
 int Client::fsync(int fd, bool syncdataonly) 
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "fsync" << std::endl;
   tout(cct) << fd << std::endl;
   tout(cct) << syncdataonly << std::endl;
@@ -9462,7 +9805,7 @@ int Client::_fsync(Fh *f, bool syncdataonly)
 
 int Client::fstat(int fd, struct stat *stbuf, const UserPerm& perms, int mask)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "fstat mask " << hex << mask << dec << std::endl;
   tout(cct) << fd << std::endl;
 
@@ -9483,7 +9826,17 @@ int Client::fstat(int fd, struct stat *stbuf, const UserPerm& perms, int mask)
 int Client::fstatx(int fd, struct ceph_statx *stx, const UserPerm& perms,
 		   unsigned int want, unsigned int flags)
 {
-  Mutex::Locker lock(client_lock);
+  unsigned mask = statx_to_mask(flags, want);
+
+  StatSnapshot snap;
+  if (cct->_conf->client_trace.empty() &&
+      fd_stat_snaps.get(fd, &snap) &&
+      stat_from_snapshot(snap, mask, stx)) {
+    ldout(cct, 3) << "fstatx(" << fd << ", " << stx << ") = 0 (snapshot)" << dendl;
+    return 0;
+  }
+
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "fstatx flags " << hex << flags << " want " << want << dec << std::endl;
   tout(cct) << fd << std::endl;
 
@@ -9494,8 +9847,6 @@ int Client::fstatx(int fd, struct ceph_statx *stx, const UserPerm& perms,
   if (!f)
     return -EBADF;
 
-  unsigned mask = statx_to_mask(flags, want);
-
   int r = 0;
   if (mask && !f->inode->caps_issued_mask(mask)) {
     r = _getattr(f->inode, mask, perms);
@@ -9503,6 +9854,10 @@ int Client::fstatx(int fd, struct ceph_statx *stx, const UserPerm& perms,
       ldout(cct, 3) << "fstatx exit on error!" << dendl;
       return r;
     }
+  } else if (cct->_conf->client_trace.empty()) {
+    save_stat_snapshot(f->inode.get(), &snap);
+    fd_stat_snaps.put(fd, snap);
+    client_lock.set_unchanged();
   }
 
   fill_statx(f->inode, mask, stx);
@@ -9515,7 +9870,7 @@ int Client::fstatx(int fd, struct ceph_statx *stx, const UserPerm& perms,
 int Client::chdir(const char *relpath, std::string &new_cwd,
 		  const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "chdir" << std::endl;
   tout(cct) << relpath << std::endl;
 
@@ -9577,7 +9932,7 @@ void Client::_getcwd(string& dir, const UserPerm& perms)
 
 void Client::getcwd(string& dir, const UserPerm& perms)
 {
-  Mutex::Locker l(client_lock);
+  ClientLock::Locker l(client_lock);
   if (!unmounting)
     _getcwd(dir, perms);
 }
@@ -9585,7 +9940,7 @@ void Client::getcwd(string& dir, const UserPerm& perms)
 int Client::statfs(const char *path, struct statvfs *stbuf,
 		   const UserPerm& perms)
 {
-  Mutex::Locker l(client_lock);
+  ClientLock::Locker l(client_lock);
   tout(cct) << "statfs" << std::endl;
 
   if (unmounting)
@@ -9991,7 +10346,7 @@ void Client::ll_register_callbacks(struct client_callback_args *args)
 {
   if (!args)
     return;
-  Mutex::Locker l(client_lock);
+  ClientLock::Locker l(client_lock);
   ldout(cct, 10) << "ll_register_callbacks cb " << args->handle
 		 << " invalidate_ino_cb " << args->ino_cb
 		 << " invalidate_dentry_cb " << args->dentry_cb
@@ -10085,7 +10440,7 @@ int Client::_sync_fs()
 
 int Client::sync_fs()
 {
-  Mutex::Locker l(client_lock);
+  ClientLock::Locker l(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -10095,14 +10450,14 @@ int Client::sync_fs()
 
 int64_t Client::drop_caches()
 {
-  Mutex::Locker l(client_lock);
+  ClientLock::Locker l(client_lock);
   return objectcacher->release_all();
 }
 
 
 int Client::lazyio_propogate(int fd, loff_t offset, size_t count)
 {
-  Mutex::Locker l(client_lock);
+  ClientLock::Locker l(client_lock);
   ldout(cct, 3) << "op: client->lazyio_propogate(" << fd
           << ", " << offset << ", " << count << ")" << dendl;
   
@@ -10118,7 +10473,7 @@ int Client::lazyio_propogate(int fd, loff_t offset, size_t count)
 
 int Client::lazyio_synchronize(int fd, loff_t offset, size_t count)
 {
-  Mutex::Locker l(client_lock);
+  ClientLock::Locker l(client_lock);
   ldout(cct, 3) << "op: client->lazyio_synchronize(" << fd
           << ", " << offset << ", " << count << ")" << dendl;
   
@@ -10139,7 +10494,7 @@ int Client::lazyio_synchronize(int fd, loff_t offset, size_t count)
 
 int Client::mksnap(const char *relpath, const char *name, const UserPerm& perm)
 {
-  Mutex::Locker l(client_lock);
+  ClientLock::Locker l(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -10160,7 +10515,7 @@ int Client::mksnap(const char *relpath, const char *name, const UserPerm& perm)
 
 int Client::rmsnap(const char *relpath, const char *name, const UserPerm& perms)
 {
-  Mutex::Locker l(client_lock);
+  ClientLock::Locker l(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -10184,7 +10539,7 @@ int Client::rmsnap(const char *relpath, const char *name, const UserPerm& perms)
 
 int Client::get_caps_issued(int fd) {
 
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -10198,7 +10553,7 @@ int Client::get_caps_issued(int fd) {
 
 int Client::get_caps_issued(const char *path, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -10249,7 +10604,7 @@ Inode *Client::open_snapdir(Inode *diri)
 int Client::ll_lookup(Inode *parent, const char *name, struct stat *attr,
 		      Inode **out, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   vinodeno_t vparent = _get_vino(parent);
   ldout(cct, 3) << "ll_lookup " << vparent << " " << name << dendl;
   tout(cct) << "ll_lookup" << std::endl;
@@ -10290,7 +10645,7 @@ int Client::ll_lookupx(Inode *parent, const char *name, Inode **out,
 		       struct ceph_statx *stx, unsigned want, unsigned flags,
 		       const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   vinodeno_t vparent = _get_vino(parent);
   ldout(cct, 3) << "ll_lookupx " << vparent << " " << name << dendl;
   tout(cct) << "ll_lookupx" << std::endl;
@@ -10330,7 +10685,7 @@ int Client::ll_lookupx(Inode *parent, const char *name, Inode **out,
 int Client::ll_walk(const char* name, Inode **out, struct ceph_statx *stx,
 		    unsigned int want, unsigned int flags, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -10406,7 +10761,7 @@ void Client::_ll_drop_pins()
 
 bool Client::ll_forget(Inode *in, int count)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   inodeno_t ino = _get_inodeno(in);
 
   ldout(cct, 3) << "ll_forget " << ino << " " << count << dendl;
@@ -10442,13 +10797,13 @@ bool Client::ll_put(Inode *in)
 
 snapid_t Client::ll_get_snapid(Inode *in)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   return in->snapid;
 }
 
 Inode *Client::ll_get_inode(ino_t ino)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return NULL;
@@ -10464,7 +10819,7 @@ Inode *Client::ll_get_inode(ino_t ino)
 
 Inode *Client::ll_get_inode(vinodeno_t vino)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return NULL;
@@ -10493,7 +10848,7 @@ int Client::_ll_getattr(Inode *in, int caps, const UserPerm& perms)
 
 int Client::ll_getattr(Inode *in, struct stat *attr, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -10509,16 +10864,30 @@ int Client::ll_getattr(Inode *in, struct stat *attr, const UserPerm& perms)
 int Client::ll_getattrx(Inode *in, struct ceph_statx *stx, unsigned int want,
 			unsigned int flags, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  unsigned mask = statx_to_mask(flags, want);
+
+  StatSnapshot snap;
+  if (cct->_conf->client_trace.empty() &&
+      ll_stat_snaps.get(in, &snap) &&
+      stat_from_snapshot(snap, mask, stx)) {
+    ldout(cct, 3) << "ll_getattrx " << snap.stx.stx_ino << " = 0 (snapshot)" << dendl;
+    return 0;
+  }
+
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
 
   int res = 0;
-  unsigned mask = statx_to_mask(flags, want);
 
-  if (mask && !in->caps_issued_mask(mask))
+  if (mask && !in->caps_issued_mask(mask)) {
     res = _ll_getattr(in, mask, perms);
+  } else if (cct->_conf->client_trace.empty()) {
+    save_stat_snapshot(in, &snap);
+    ll_stat_snaps.put(in, snap);
+    client_lock.set_unchanged();
+  }
 
   if (res == 0)
     fill_statx(in, mask, stx);
@@ -10558,7 +10927,7 @@ int Client::_ll_setattrx(Inode *in, struct ceph_statx *stx, int mask,
 int Client::ll_setattrx(Inode *in, struct ceph_statx *stx, int mask,
 			const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -10580,7 +10949,7 @@ int Client::ll_setattr(Inode *in, struct stat *attr, int mask,
   struct ceph_statx stx;
   stat_to_statx(attr, &stx);
 
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -10603,7 +10972,7 @@ int Client::ll_setattr(Inode *in, struct stat *attr, int mask,
 int Client::getxattr(const char *path, const char *name, void *value, size_t size,
 		     const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -10618,7 +10987,7 @@ int Client::getxattr(const char *path, const char *name, void *value, size_t siz
 int Client::lgetxattr(const char *path, const char *name, void *value, size_t size,
 		      const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -10633,7 +11002,7 @@ int Client::lgetxattr(const char *path, const char *name, void *value, size_t si
 int Client::fgetxattr(int fd, const char *name, void *value, size_t size,
 		      const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -10647,7 +11016,7 @@ int Client::fgetxattr(int fd, const char *name, void *value, size_t size,
 int Client::listxattr(const char *path, char *list, size_t size,
 		      const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -10662,7 +11031,7 @@ int Client::listxattr(const char *path, char *list, size_t size,
 int Client::llistxattr(const char *path, char *list, size_t size,
 		       const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -10676,7 +11045,7 @@ int Client::llistxattr(const char *path, char *list, size_t size,
 
 int Client::flistxattr(int fd, char *list, size_t size, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -10690,7 +11059,7 @@ int Client::flistxattr(int fd, char *list, size_t size, const UserPerm& perms)
 int Client::removexattr(const char *path, const char *name,
 			const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -10705,7 +11074,7 @@ int Client::removexattr(const char *path, const char *name,
 int Client::lremovexattr(const char *path, const char *name,
 			 const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -10719,7 +11088,7 @@ int Client::lremovexattr(const char *path, const char *name,
 
 int Client::fremovexattr(int fd, const char *name, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -10735,7 +11104,7 @@ int Client::setxattr(const char *path, const char *name, const void *value,
 {
   _setxattr_maybe_wait_for_osdmap(name, value, size);
 
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -10752,7 +11121,7 @@ int Client::lsetxattr(const char *path, const char *name, const void *value,
 {
   _setxattr_maybe_wait_for_osdmap(name, value, size);
 
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -10769,7 +11138,7 @@ int Client::fsetxattr(int fd, const char *name, const void *value, size_t size,
 {
   _setxattr_maybe_wait_for_osdmap(name, value, size);
 
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -10853,7 +11222,7 @@ int Client::_getxattr(InodeRef &in, const char *name, void *value, size_t size,
 int Client::ll_getxattr(Inode *in, const char *name, void *value,
 			size_t size, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -10922,7 +11291,7 @@ int Client::_listxattr(Inode *in, char *name, size_t size,
 int Client::ll_listxattr(Inode *in, char *names, size_t size,
 			 const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -11108,7 +11477,7 @@ int Client::ll_setxattr(Inode *in, const char *name, const void *value,
 {
   _setxattr_maybe_wait_for_osdmap(name, value, size);
 
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -11172,7 +11541,7 @@ int Client::_removexattr(InodeRef &in, const char *name, const UserPerm& perms)
 
 int Client::ll_removexattr(Inode *in, const char *name, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -11413,7 +11782,7 @@ size_t Client::_vxattrs_calcu_name_size(const VXattr *vxattr)
 
 int Client::ll_readlink(Inode *in, char *buf, size_t buflen, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -11493,7 +11862,7 @@ int Client::ll_mknod(Inode *parent, const char *name, mode_t mode,
 		     dev_t rdev, struct stat *attr, Inode **out,
 		     const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -11532,7 +11901,7 @@ int Client::ll_mknodx(Inode *parent, const char *name, mode_t mode,
 		      const UserPerm& perms)
 {
   unsigned caps = statx_to_mask(flags, want);
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -11718,7 +12087,7 @@ int Client::_mkdir(Inode *dir, const char *name, mode_t mode, const UserPerm& pe
 int Client::ll_mkdir(Inode *parent, const char *name, mode_t mode,
 		     struct stat *attr, Inode **out, const UserPerm& perm)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -11754,7 +12123,7 @@ int Client::ll_mkdirx(Inode *parent, const char *name, mode_t mode, Inode **out,
 		      struct ceph_statx *stx, unsigned want, unsigned flags,
 		      const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -11838,7 +12207,7 @@ int Client::_symlink(Inode *dir, const char *name, const char *target,
 int Client::ll_symlink(Inode *parent, const char *name, const char *value,
 		       struct stat *attr, Inode **out, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -11875,7 +12244,7 @@ int Client::ll_symlinkx(Inode *parent, const char *name, const char *value,
 			Inode **out, struct ceph_statx *stx, unsigned want,
 			unsigned flags, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -11956,7 +12325,7 @@ int Client::_unlink(Inode *dir, const char *name, const UserPerm& perm)
 
 int Client::ll_unlink(Inode *in, const char *name, const UserPerm& perm)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -12026,7 +12395,7 @@ int Client::_rmdir(Inode *dir, const char *name, const UserPerm& perms)
 
 int Client::ll_rmdir(Inode *in, const char *name, const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -12144,7 +12513,7 @@ int Client::_rename(Inode *fromdir, const char *fromname, Inode *todir, const ch
 int Client::ll_rename(Inode *parent, const char *name, Inode *newparent,
 		      const char *newname, const UserPerm& perm)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -12219,7 +12588,7 @@ int Client::_link(Inode *in, Inode *dir, const char *newname, const UserPerm& pe
 int Client::ll_link(Inode *in, Inode *newparent, const char *newname,
 		    const UserPerm& perm)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -12255,13 +12624,13 @@ int Client::ll_link(Inode *in, Inode *newparent, const char *newname,
 
 int Client::ll_num_osds(void)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   return objecter->with_osdmap(std::mem_fn(&OSDMap::get_num_osds));
 }
 
 int Client::ll_osdaddr(int osd, uint32_t *addr)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   entity_addr_t g;
   bool exists = objecter->with_osdmap([&](const OSDMap& o) {
@@ -12279,19 +12648,19 @@ int Client::ll_osdaddr(int osd, uint32_t *addr)
 
 uint32_t Client::ll_stripe_unit(Inode *in)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   return in->layout.stripe_unit;
 }
 
 uint64_t Client::ll_snap_seq(Inode *in)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   return in->snaprealm->seq;
 }
 
 int Client::ll_file_layout(Inode *in, file_layout_t *layout)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   *layout = in->layout;
   return 0;
 }
@@ -12311,7 +12680,7 @@ int Client::ll_file_layout(Fh *fh, file_layout_t *layout)
 int Client::ll_get_stripe_osd(Inode *in, uint64_t blockno,
 			      file_layout_t* layout)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   inodeno_t ino = ll_get_inodeno(in);
   uint32_t object_size = layout->object_size;
@@ -12340,7 +12709,7 @@ int Client::ll_get_stripe_osd(Inode *in, uint64_t blockno,
 
 uint64_t Client::ll_get_internal_offset(Inode *in, uint64_t blockno)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   file_layout_t *layout=&(in->layout);
   uint32_t object_size = layout->object_size;
   uint32_t su = layout->stripe_unit;
@@ -12352,7 +12721,7 @@ uint64_t Client::ll_get_internal_offset(Inode *in, uint64_t blockno)
 int Client::ll_opendir(Inode *in, int flags, dir_result_t** dirpp,
 		       const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -12379,7 +12748,7 @@ int Client::ll_opendir(Inode *in, int flags, dir_result_t** dirpp,
 
 int Client::ll_releasedir(dir_result_t *dirp)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   ldout(cct, 3) << "ll_releasedir " << dirp << dendl;
   tout(cct) << "ll_releasedir" << std::endl;
   tout(cct) << (unsigned long)dirp << std::endl;
@@ -12393,7 +12762,7 @@ int Client::ll_releasedir(dir_result_t *dirp)
 
 int Client::ll_fsyncdir(dir_result_t *dirp)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   ldout(cct, 3) << "ll_fsyncdir " << dirp << dendl;
   tout(cct) << "ll_fsyncdir" << std::endl;
   tout(cct) << (unsigned long)dirp << std::endl;
@@ -12408,7 +12777,7 @@ int Client::ll_open(Inode *in, int flags, Fh **fhp, const UserPerm& perms)
 {
   assert(!(flags & O_CREAT));
 
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -12526,7 +12895,7 @@ int Client::ll_create(Inode *parent, const char *name, mode_t mode,
 		      int flags, struct stat *attr, Inode **outp, Fh **fhp,
 		      const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   InodeRef in;
 
   if (unmounting)
@@ -12556,7 +12925,7 @@ int Client::ll_createx(Inode *parent, const char *name, mode_t mode,
 			const UserPerm& perms)
 {
   unsigned caps = statx_to_mask(lflags, want);
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   InodeRef in;
 
   if (unmounting)
@@ -12582,7 +12951,7 @@ int Client::ll_createx(Inode *parent, const char *name, mode_t mode,
 
 loff_t Client::ll_lseek(Fh *fh, loff_t offset, int whence)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "ll_lseek" << std::endl;
   tout(cct) << offset << std::endl;
   tout(cct) << whence << std::endl;
@@ -12595,7 +12964,7 @@ loff_t Client::ll_lseek(Fh *fh, loff_t offset, int whence)
 
 int Client::ll_read(Fh *fh, loff_t off, loff_t len, bufferlist *bl)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   ldout(cct, 3) << "ll_read " << fh << " " << fh->inode->ino << " " << " " << off << "~" << len << dendl;
   tout(cct) << "ll_read" << std::endl;
   tout(cct) << (unsigned long)fh << std::endl;
@@ -12614,7 +12983,7 @@ int Client::ll_read_block(Inode *in, uint64_t blockid,
 			  uint64_t length,
 			  file_layout_t* layout)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -12725,7 +13094,7 @@ int Client::ll_commit_blocks(Inode *in,
 			     uint64_t offset,
 			     uint64_t length)
 {
-    Mutex::Locker lock(client_lock);
+    ClientLock::Locker lock(client_lock);
     /*
     BarrierContext *bctx;
     vinodeno_t vino = ll_get_vino(in);
@@ -12749,7 +13118,7 @@ int Client::ll_commit_blocks(Inode *in,
 
 int Client::ll_write(Fh *fh, loff_t off, loff_t len, const char *data)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   ldout(cct, 3) << "ll_write " << fh << " " << fh->inode->ino << " " << off <<
     "~" << len << dendl;
   tout(cct) << "ll_write" << std::endl;
@@ -12768,7 +13137,7 @@ int Client::ll_write(Fh *fh, loff_t off, loff_t len, const char *data)
 
 int Client::ll_flush(Fh *fh)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   ldout(cct, 3) << "ll_flush " << fh << " " << fh->inode->ino << " " << dendl;
   tout(cct) << "ll_flush" << std::endl;
   tout(cct) << (unsigned long)fh << std::endl;
@@ -12781,7 +13150,7 @@ int Client::ll_flush(Fh *fh)
 
 int Client::ll_fsync(Fh *fh, bool syncdataonly)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   ldout(cct, 3) << "ll_fsync " << fh << " " << fh->inode->ino << " " << dendl;
   tout(cct) << "ll_fsync" << std::endl;
   tout(cct) << (unsigned long)fh << std::endl;
@@ -12945,7 +13314,7 @@ int Client::_fallocate(Fh *fh, int mode, int64_t offset, int64_t length)
 
 int Client::ll_fallocate(Fh *fh, int mode, loff_t offset, loff_t length)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   ldout(cct, 3) << "ll_fallocate " << fh << " " << fh->inode->ino << " " << dendl;
   tout(cct) << "ll_fallocate " << mode << " " << offset << " " << length << std::endl;
   tout(cct) << (unsigned long)fh << std::endl;
@@ -12958,7 +13327,7 @@ int Client::ll_fallocate(Fh *fh, int mode, loff_t offset, loff_t length)
 
 int Client::fallocate(int fd, int mode, loff_t offset, loff_t length)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   tout(cct) << "fallocate " << " " << fd << mode << " " << offset << " " << length << std::endl;
 
   if (unmounting)
@@ -12976,7 +13345,7 @@ int Client::fallocate(int fd, int mode, loff_t offset, loff_t length)
 
 int Client::ll_release(Fh *fh)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
   ldout(cct, 3) << "ll_release (fh)" << fh << " " << fh->inode->ino << " " <<
     dendl;
   tout(cct) << "ll_release (fh)" << std::endl;
@@ -12992,7 +13361,7 @@ int Client::ll_release(Fh *fh)
 
 int Client::ll_getlk(Fh *fh, struct flock *fl, uint64_t owner)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   ldout(cct, 3) << "ll_getlk (fh)" << fh << " " << fh->inode->ino << dendl;
   tout(cct) << "ll_getk (fh)" << (unsigned long)fh << std::endl;
@@ -13005,7 +13374,7 @@ int Client::ll_getlk(Fh *fh, struct flock *fl, uint64_t owner)
 
 int Client::ll_setlk(Fh *fh, struct flock *fl, uint64_t owner, int sleep)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   ldout(cct, 3) << "ll_setlk  (fh) " << fh << " " << fh->inode->ino << dendl;
   tout(cct) << "ll_setk (fh)" << (unsigned long)fh << std::endl;
@@ -13018,7 +13387,7 @@ int Client::ll_setlk(Fh *fh, struct flock *fl, uint64_t owner, int sleep)
 
 int Client::ll_flock(Fh *fh, int cmd, uint64_t owner)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   ldout(cct, 3) << "ll_flock  (fh) " << fh << " " << fh->inode->ino << dendl;
   tout(cct) << "ll_flock (fh)" << (unsigned long)fh << std::endl;
@@ -13038,7 +13407,7 @@ public:
     req->get();
   }
   void finish(int r) override {
-    Mutex::Locker l(client->client_lock);
+    ClientLock::Locker l(client->client_lock);
     assert(req->head.op == CEPH_MDS_OP_SETFILELOCK);
     client->_interrupt_filelock(req);
     client->put_request(req);
@@ -13061,7 +13430,7 @@ void Client::ll_interrupt(void *d)
 int Client::describe_layout(const char *relpath, file_layout_t *lp,
 			    const UserPerm& perms)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -13080,7 +13449,7 @@ int Client::describe_layout(const char *relpath, file_layout_t *lp,
 
 int Client::fdescribe_layout(int fd, file_layout_t *lp)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -13098,7 +13467,7 @@ int Client::fdescribe_layout(int fd, file_layout_t *lp)
 
 int64_t Client::get_default_pool_id()
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -13111,7 +13480,7 @@ int64_t Client::get_default_pool_id()
 
 int64_t Client::get_pool_id(const char *pool_name)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -13122,7 +13491,7 @@ int64_t Client::get_pool_id(const char *pool_name)
 
 string Client::get_pool_name(int64_t pool)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return string();
@@ -13134,7 +13503,7 @@ string Client::get_pool_name(int64_t pool)
 
 int Client::get_pool_replication(int64_t pool)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -13146,7 +13515,7 @@ int Client::get_pool_replication(int64_t pool)
 
 int Client::get_file_extent_osds(int fd, loff_t off, loff_t *len, vector<int>& osds)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -13192,7 +13561,7 @@ int Client::get_file_extent_osds(int fd, loff_t off, loff_t *len, vector<int>& o
 
 int Client::get_osd_crush_location(int id, vector<pair<string, string> >& path)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -13207,7 +13576,7 @@ int Client::get_osd_crush_location(int id, vector<pair<string, string> >& path)
 int Client::get_file_stripe_address(int fd, loff_t offset,
 				    vector<entity_addr_t>& address)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -13240,7 +13609,7 @@ int Client::get_file_stripe_address(int fd, loff_t offset,
 
 int Client::get_osd_addr(int osd, entity_addr_t& addr)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -13257,7 +13626,7 @@ int Client::get_osd_addr(int osd, entity_addr_t& addr)
 int Client::enumerate_layout(int fd, vector<ObjectExtent>& result,
 			     loff_t length, loff_t offset)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -13278,7 +13647,7 @@ int Client::enumerate_layout(int fd, vector<ObjectExtent>& result,
 /* find an osd with the same ip.  -ENXIO if none. */
 int Client::get_local_osd()
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
@@ -13313,7 +13682,7 @@ bool Client::ms_handle_reset(Connection *con)
 void Client::ms_handle_remote_reset(Connection *con)
 {
   ldout(cct, 0) << "ms_handle_remote_reset on " << con->get_peer_addr() << dendl;
-  Mutex::Locker l(client_lock);
+  ClientLock::Locker l(client_lock);
   switch (con->get_peer_type()) {
   case CEPH_ENTITY_TYPE_MDS:
     {
@@ -13717,7 +14086,7 @@ out:
 
 void Client::set_filer_flags(int flags)
 {
-  Mutex::Locker l(client_lock);
+  ClientLock::Locker l(client_lock);
   assert(flags == 0 ||
 	 flags == CEPH_OSD_FLAG_LOCALIZE_READS);
   objecter->add_global_op_flags(flags);
@@ -13725,7 +14094,7 @@ void Client::set_filer_flags(int flags)
 
 void Client::clear_filer_flags(int flags)
 {
-  Mutex::Locker l(client_lock);
+  ClientLock::Locker l(client_lock);
   assert(flags == CEPH_OSD_FLAG_LOCALIZE_READS);
   objecter->clear_global_op_flag(flags);
 }
@@ -13757,7 +14126,7 @@ const char** Client::get_tracked_conf_keys() const
 void Client::handle_conf_change(const struct md_config_t *conf,
 				const std::set <std::string> &changed)
 {
-  Mutex::Locker lock(client_lock);
+  ClientLock::Locker lock(client_lock);
 
   if (changed.count("client_cache_mid")) {
     lru.lru_set_midpoint(cct->_conf->client_cache_mid);
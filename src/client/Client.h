@@ -24,6 +24,8 @@
 #include <set>
 #include <map>
 #include <fstream>
+#include <mutex>
+#include <atomic>
 using std::set;
 using std::map;
 using std::fstream;
@@ -248,6 +250,66 @@ struct dir_result_t {
   }
 };
 
+/*
+ * client_lock, plus a generation that moves on whenever a holder
+ * releases it, unless the holder promised with set_unchanged() that it
+ * changed nothing.  State copied out under the lock stays current for
+ * as long as the generation is where it was, so a few read-only paths
+ * can reuse such copies without taking the lock.
+ *
+ * Cond waits, SafeTimer and ObjectCacher take the underlying Mutex
+ * directly (see mutex()); Client code they call into that changes
+ * anything must call note_changed() itself.
+ */
+class ClientLock {
+  Mutex m;
+  std::atomic<uint64_t> gen = { 0 };
+  bool unchanged = false;
+
+public:
+  ClientLock(const std::string &n, CephContext *cct)
+    : m(n, false, true, false, cct) {}
+
+  void Lock() {
+    m.Lock();
+    note_changed();
+    unchanged = false;
+  }
+  void Unlock() {
+    if (unchanged)
+      gen.store(gen.load(std::memory_order_relaxed) - 1,
+		std::memory_order_release);
+    else
+      note_changed();
+    unchanged = false;
+    m.Unlock();
+  }
+  bool is_locked() const { return m.is_locked(); }
+  bool is_locked_by_me() const { return m.is_locked_by_me(); }
+  Mutex& mutex() { return m; }
+
+  uint64_t get_gen() const {
+    return gen.load(std::memory_order_acquire);
+  }
+  void note_changed() {
+    assert(m.is_locked());
+    gen.store(gen.load(std::memory_order_relaxed) + 1,
+	      std::memory_order_release);
+  }
+  /// the current holder changed nothing; give the generation back on Unlock
+  void set_unchanged() {
+    assert(m.is_locked_by_me());
+    unchanged = true;
+  }
+
+  class Locker {
+    ClientLock &l;
+  public:
+    explicit Locker(ClientLock &l) : l(l) { l.Lock(); }
+    ~Locker() { l.Unlock(); }
+  };
+};
+
 class Client : public Dispatcher, public md_config_obs_t {
  public:
   using Dispatcher::cct;
@@ -362,6 +424,19 @@ protected:
   int make_request(MetaRequest *req, const UserPerm& perms,
 		   InodeRef *ptarget = 0, bool *pcreated = 0,
 		   mds_rank_t use_mds=-1, bufferlist *pdirbl=0);
+  /**
+   * Send several requests and wait for all of them, with as many in
+   * flight at once as the mds sessions allow.
+   */
+  void make_requests(const vector<MetaRequest*>& requests,
+		     const UserPerm& perms, vector<int> *results);
+  void _make_request_start(MetaRequest *request, const UserPerm& perms,
+			   mds_rank_t use_mds);
+  int _make_request_send(MetaRequest *request, Cond *caller_cond,
+			 bool can_block);
+  int _make_request_finish(MetaRequest *request, const UserPerm& perms,
+			   InodeRef *ptarget, bool *pcreated,
+			   bufferlist *pdirbl);
   void put_request(MetaRequest *request);
   void unregister_request(MetaRequest *request);
 
@@ -478,7 +553,62 @@ protected:
 
   // global client lock
   //  - protects Client and buffer cache both!
-  Mutex                  client_lock;
+  ClientLock             client_lock;
+
+  /*
+   * Attributes of an inode as fill_statx() saw them, saved by fstatx()
+   * and ll_getattrx() cache hits.  They are good for as long as
+   * client_lock.get_gen() stays at the value they were saved at and the
+   * caps they rely on have not timed out, which lets repeated cache hits
+   * be answered without taking client_lock at all.
+   */
+  struct StatSnapshot {
+    uint64_t gen = 0;       // client_lock generation they are valid at
+    int snap_caps = 0;      // caps that never time out
+    int issued = 0;         // caps held as of then...
+    utime_t cap_ttl;        // ...and until when
+    struct ceph_statx stx;  // fill_statx(in, 0, &stx)
+  };
+
+  template<typename K>
+  class StatSnapshotMap {
+    static const unsigned SHARDS = 32;
+    struct Shard {
+      std::mutex lock;
+      ceph::unordered_map<K, StatSnapshot> snaps;
+    } shards[SHARDS];
+
+    Shard& shard_of(const K& k) {
+      return shards[(std::hash<K>()(k) * 0x9E3779B97F4A7C15ull) >> 59];
+    }
+
+  public:
+    void put(const K& k, const StatSnapshot& snap) {
+      Shard& s = shard_of(k);
+      std::lock_guard<std::mutex> l(s.lock);
+      s.snaps[k] = snap;
+    }
+    bool get(const K& k, StatSnapshot *snap) {
+      Shard& s = shard_of(k);
+      std::lock_guard<std::mutex> l(s.lock);
+      auto p = s.snaps.find(k);
+      if (p == s.snaps.end())
+	return false;
+      *snap = p->second;
+      return true;
+    }
+    void erase(const K& k) {
+      Shard& s = shard_of(k);
+      std::lock_guard<std::mutex> l(s.lock);
+      s.snaps.erase(k);
+    }
+  };
+  StatSnapshotMap<int> fd_stat_snaps;
+  StatSnapshotMap<Inode*> ll_stat_snaps;
+
+  void save_stat_snapshot(Inode *in, StatSnapshot *snap);
+  bool stat_from_snapshot(const StatSnapshot& snap, unsigned mask,
+			  struct ceph_statx *stx);
 
   // helpers
   void wake_inode_waiters(MetaSession *s);
@@ -741,7 +871,10 @@ private:
   bool _readdir_have_frag(dir_result_t *dirp);
   void _readdir_next_frag(dir_result_t *dirp);
   void _readdir_rechoose_frag(dir_result_t *dirp);
+  MetaRequest *_readdir_make_request(dir_result_t *dirp);
   int _readdir_get_frag(dir_result_t *dirp);
+  int _readdir_bulk(dir_result_t *dirp, add_dirent_cb_t cb, void *p, int caps, bool getref,
+		    bool *stale);
   int _readdir_cache_cb(dir_result_t *dirp, add_dirent_cb_t cb, void *p, int caps, bool getref);
   void _closedir(dir_result_t *dirp);
 
@@ -977,6 +1110,15 @@ public:
   int readdir_r(dir_result_t *dirp, struct dirent *de);
   int readdirplus_r(dir_result_t *dirp, struct dirent *de, struct ceph_statx *stx, unsigned want, unsigned flags, Inode **out);
 
+  /**
+   * Read the whole directory, fetching all of its frags concurrently,
+   * and invoke cb for each entry (without . and ..) as readdir_r_cb
+   * does.  Leaves dirp at the end of the directory.
+   */
+  int readdirplus_bulk(dir_result_t *dirp, add_dirent_cb_t cb, void *p,
+		       unsigned want=0, unsigned flags=AT_NO_ATTR_SYNC,
+		       bool getref=false);
+
   int getdir(const char *relpath, list<string>& names,
 	     const UserPerm& perms);  // get the whole dir at once.
 
@@ -1123,12 +1265,12 @@ public:
 
   // low-level interface v2
   inodeno_t ll_get_inodeno(Inode *in) {
-    Mutex::Locker lock(client_lock);
+    ClientLock::Locker lock(client_lock);
     return _get_inodeno(in);
   }
   snapid_t ll_get_snapid(Inode *in);
   vinodeno_t ll_get_vino(Inode *in) {
-    Mutex::Locker lock(client_lock);
+    ClientLock::Locker lock(client_lock);
     return _get_vino(in);
   }
   // get inode from faked ino
@@ -151,6 +151,10 @@ void parse_syn_options(vector<const char*>& args)
         syn_iargs.push_back( atoi(args[++i]) );
         syn_iargs.push_back( atoi(args[++i]) );
         syn_iargs.push_back( atoi(args[++i]) );
+      } else if (strcmp(args[i],"mdtest") == 0) {
+        syn_modes.push_back( SYNCLIENT_MODE_MDTEST );
+        syn_iargs.push_back( atoi(args[++i]) );
+        syn_iargs.push_back( atoi(args[++i]) );
       } else if (strcmp(args[i],"makefiles2") == 0) {
         syn_modes.push_back( SYNCLIENT_MODE_MAKEFILES2 );
         syn_iargs.push_back( atoi(args[++i]) );
@@ -568,6 +572,17 @@ int SyntheticClient::run()
 	did_run_me();
       }
       break;
+    case SYNCLIENT_MODE_MDTEST:
+      {
+        int num = iargs.front();  iargs.pop_front();
+        int priv = iargs.front();  iargs.pop_front();
+        if (run_me()) {
+          dout(2) << "mdtest " << num << " " << priv << dendl;
+          mdtest(num, priv);
+        }
+	did_run_me();
+      }
+      break;
     case SYNCLIENT_MODE_MAKEFILES2:
       {
         int num = iargs.front();  iargs.pop_front();
@@ -1887,6 +1902,63 @@ int SyntheticClient::make_files(int num, int count, int priv, bool more)
   return 0;
 }
 
+/*
+ * mdtest-style metadata benchmark: create, stat, readdir and unlink num
+ * files, in a directory of our own (priv) or one shared by all clients,
+ * and report each phase's rate.  Run with --num-client N to see how
+ * the MDS scales with the number of concurrent clients.
+ */
+int SyntheticClient::mdtest(int num, int priv)
+{
+  int whoami = client->get_nodeid().v;
+  UserPerm perms = client->pick_my_perms();
+  char d[255];
+  char f[255];
+
+  snprintf(d, sizeof(d), "mdtest.%d", priv ? whoami : 0);
+  client->mkdir(d, 0755, perms);
+
+  const char *phases[] = { "create", "stat", "readdir", "unlink" };
+  for (int phase = 0; phase < 4; phase++) {
+    int ops = 0;
+    int entries = 0;
+    utime_t start = ceph_clock_now();
+    if (phase == 2) {
+      // one getdir is one op, however many entries it returns
+      list<string> names;
+      client->getdir(d, names, perms);
+      ops = 1;
+      entries = names.size();
+    } else {
+      struct stat st;
+      for (int n = 0; n < num; n++) {
+	snprintf(f, sizeof(f), "%s/file.client%d.%d", d, whoami, n);
+	switch (phase) {
+	case 0: client->mknod(f, 0644, perms); break;
+	case 1: client->lstat(f, &st, perms); break;
+	case 3: client->unlink(f, perms); break;
+	}
+	ops++;
+	if (time_to_stop())
+	  return 0;
+      }
+    }
+    utime_t end = ceph_clock_now();
+    end -= start;
+    dout(0) << "mdtest " << phases[phase] << " " << ops << " in " << end
+	    << " = " << ((double)end ? (double)ops / (double)end : 0)
+	    << " ops/sec" << dendl;
+    if (phase == 2)
+      dout(0) << "mdtest " << phases[phase] << " " << entries << " entries = "
+	      << ((double)end ? (double)entries / (double)end : 0)
+	      << " entries/sec" << dendl;
+  }
+
+  if (priv)
+    client->rmdir(d, perms);
+  return 0;
+}
+
 int SyntheticClient::link_test()
 {
   char d[255];
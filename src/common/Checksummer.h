@@ -4,6 +4,7 @@
 #ifndef CEPH_OS_BLUESTORE_CHECKSUMMER
 #define CEPH_OS_BLUESTORE_CHECKSUMMER
 
+#include "include/crc32c.h"
 #include "xxHash/xxhash.h"
 
 class Checksummer {
@@ -67,6 +68,36 @@ public:
     }
   }
 
+  /// most blocks checksummed per calc_batch() call on the verify path
+  enum { BATCH_BLOCKS = 16 };
+
+  /*
+   * Each algorithm also has a calc_batch() that checksums `blocks`
+   * back-to-back blocks of contiguous memory in one call, so that
+   * implementations can interleave independent blocks.
+   */
+  template<typename value_t>
+  static void crc32c_batch(
+    uint32_t init_value,
+    size_t len,
+    size_t blocks,
+    const char *data,
+    value_t *out,
+    uint32_t mask
+    ) {
+    uint32_t crcs[BATCH_BLOCKS];
+    while (blocks > 0) {
+      size_t n = std::min<size_t>(blocks, BATCH_BLOCKS);
+      ceph_crc32c_multi(init_value, (const unsigned char*)data, len, n, crcs);
+      for (size_t i = 0; i < n; ++i) {
+	out[i] = crcs[i] & mask;
+      }
+      data += n * len;
+      out += n;
+      blocks -= n;
+    }
+  }
+
   struct crc32c {
     typedef uint32_t init_value_t;
     typedef __le32 value_t;
@@ -86,6 +117,16 @@ public:
       ) {
       return p.crc32c(len, init_value);
     }
+    static void calc_batch(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      size_t blocks,
+      const char *data,
+      value_t *out
+      ) {
+      crc32c_batch(init_value, len, blocks, data, out, 0xffffffff);
+    }
   };
 
   struct crc32c_16 {
@@ -107,6 +148,16 @@ public:
       ) {
       return p.crc32c(len, init_value) & 0xffff;
     }
+    static void calc_batch(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      size_t blocks,
+      const char *data,
+      value_t *out
+      ) {
+      crc32c_batch(init_value, len, blocks, data, out, 0xffff);
+    }
   };
 
   struct crc32c_8 {
@@ -128,6 +179,16 @@ public:
       ) {
       return p.crc32c(len, init_value) & 0xff;
     }
+    static void calc_batch(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      size_t blocks,
+      const char *data,
+      value_t *out
+      ) {
+      crc32c_batch(init_value, len, blocks, data, out, 0xff);
+    }
   };
 
   struct xxhash32 {
@@ -157,6 +218,18 @@ public:
       }
       return XXH32_digest(state);
     }
+    static void calc_batch(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      size_t blocks,
+      const char *data,
+      value_t *out
+      ) {
+      for (size_t i = 0; i < blocks; ++i, data += len) {
+	out[i] = XXH32(data, len, init_value);
+      }
+    }
   };
 
   struct xxhash64 {
@@ -186,6 +259,18 @@ public:
       }
       return XXH64_digest(state);
     }
+    static void calc_batch(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      size_t blocks,
+      const char *data,
+      value_t *out
+      ) {
+      for (size_t i = 0; i < blocks; ++i, data += len) {
+	out[i] = XXH64(data, len, init_value);
+      }
+    }
   };
 
   template<class Alg>
@@ -221,9 +306,23 @@ public:
     typename Alg::value_t *pv =
       reinterpret_cast<typename Alg::value_t*>(csum_data->c_str());
     pv += offset / csum_block_size;
-    while (blocks--) {
-      *pv = Alg::calc(state, init_value, csum_block_size, p);
-      ++pv;
+    while (blocks > 0) {
+      // batch whatever whole blocks the current segment holds
+      size_t n = 0;
+      bufferptr cur;
+      if (p.get_remaining()) {
+	cur = p.get_current_ptr();
+	n = std::min(blocks, cur.length() / csum_block_size);
+      }
+      if (n) {
+	Alg::calc_batch(state, init_value, csum_block_size, n, cur.c_str(), pv);
+	p.advance(n * csum_block_size);
+      } else {
+	*pv = Alg::calc(state, init_value, csum_block_size, p);
+	n = 1;
+      }
+      pv += n;
+      blocks -= n;
     }
     Alg::fini(&state);
     return 0;
@@ -249,18 +348,37 @@ public:
       reinterpret_cast<const typename Alg::value_t*>(csum_data.c_str());
     pv += offset / csum_block_size;
     size_t pos = offset;
+    typename Alg::value_t v[BATCH_BLOCKS];
     while (length > 0) {
-      typename Alg::value_t v = Alg::calc(state, -1, csum_block_size, p);
-      if (*pv != v) {
-	if (bad_csum) {
-	  *bad_csum = v;
+      // batch up to BATCH_BLOCKS whole blocks of the current segment and
+      // stop at the first one that doesn't match
+      size_t n = 0;
+      bufferptr cur;
+      if (p.get_remaining()) {
+	cur = p.get_current_ptr();
+	n = std::min<size_t>({length / csum_block_size,
+			      cur.length() / csum_block_size,
+			      BATCH_BLOCKS});
+      }
+      if (n) {
+	Alg::calc_batch(state, -1, csum_block_size, n, cur.c_str(), v);
+	p.advance(n * csum_block_size);
+      } else {
+	v[0] = Alg::calc(state, -1, csum_block_size, p);
+	n = 1;
+      }
+      for (size_t i = 0; i < n; ++i) {
+	if (pv[i] != v[i]) {
+	  if (bad_csum) {
+	    *bad_csum = v[i];
+	  }
+	  Alg::fini(&state);
+	  return pos + i * csum_block_size;
 	}
-	Alg::fini(&state);
-	return pos;
       }
-      ++pv;
-      pos += csum_block_size;
-      length -= csum_block_size;
+      pv += n;
+      pos += n * csum_block_size;
+      length -= n * csum_block_size;
     }
     Alg::fini(&state);
     return -1;  // no errors
@@ -8,6 +8,7 @@
 #include "arch/ppc.h"
 #include "common/sctp_crc32.h"
 #include "common/crc32c_intel_fast.h"
+#include "common/crc32c_intel_multi.h"
 #include "common/crc32c_aarch64.h"
 #include "common/crc32c_ppc.h"
 
@@ -51,6 +52,31 @@ ceph_crc32c_func_t ceph_choose_crc32(void)
 ceph_crc32c_func_t ceph_crc32c_func = ceph_choose_crc32();
 
 
+static void ceph_crc32c_multi_generic(uint32_t crc, unsigned char const *data,
+				      unsigned chunk_len, unsigned chunks,
+				      uint32_t *out)
+{
+  for (unsigned i = 0; i < chunks; ++i) {
+    out[i] = ceph_crc32c_func(crc, data, chunk_len);
+    data += chunk_len;
+  }
+}
+
+ceph_crc32c_multi_func_t ceph_choose_crc32c_multi(void)
+{
+  ceph_arch_probe();
+
+#if defined(__x86_64__) && defined(HAVE_INTEL_SSE4_2)
+  if (ceph_arch_intel_sse42) {
+    return ceph_crc32c_intel_multi;
+  }
+#endif
+  return ceph_crc32c_multi_generic;
+}
+
+ceph_crc32c_multi_func_t ceph_crc32c_multi_func = ceph_choose_crc32c_multi();
+
+
 /*
  * Look: http://crcutil.googlecode.com/files/crc-doc.1.0.pdf
  * Here is implementation that goes 1 logical step further,
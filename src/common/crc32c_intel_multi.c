@@ -0,0 +1,47 @@
+#include <string.h>
+#include <nmmintrin.h>
+
+#include "include/crc32c.h"
+#include "common/crc32c_intel_multi.h"
+
+static inline uint64_t load64(unsigned char const *p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+void ceph_crc32c_intel_multi(uint32_t crc, unsigned char const *buffer,
+			     unsigned chunk_len, unsigned chunks,
+			     uint32_t *out)
+{
+	unsigned words = chunk_len / 8;
+	unsigned i, w;
+
+	for (i = 0; i + 3 <= chunks; i += 3) {
+		unsigned char const *p0 = buffer;
+		unsigned char const *p1 = buffer + chunk_len;
+		unsigned char const *p2 = buffer + 2 * chunk_len;
+		uint64_t c0 = crc, c1 = crc, c2 = crc;
+
+		for (w = 0; w < words; w++) {
+			c0 = _mm_crc32_u64(c0, load64(p0 + 8 * w));
+			c1 = _mm_crc32_u64(c1, load64(p1 + 8 * w));
+			c2 = _mm_crc32_u64(c2, load64(p2 + 8 * w));
+		}
+		for (w *= 8; w < chunk_len; w++) {
+			c0 = _mm_crc32_u8((uint32_t)c0, p0[w]);
+			c1 = _mm_crc32_u8((uint32_t)c1, p1[w]);
+			c2 = _mm_crc32_u8((uint32_t)c2, p2[w]);
+		}
+		out[i] = (uint32_t)c0;
+		out[i + 1] = (uint32_t)c1;
+		out[i + 2] = (uint32_t)c2;
+		buffer += 3 * chunk_len;
+	}
+	/* not enough left to interleave; the single-buffer code does better */
+	for (; i < chunks; i++) {
+		out[i] = ceph_crc32c_func(crc, buffer, chunk_len);
+		buffer += chunk_len;
+	}
+}
@@ -0,0 +1,24 @@
+#ifndef CEPH_COMMON_CRC32C_INTEL_MULTI_H
+#define CEPH_COMMON_CRC32C_INTEL_MULTI_H
+
+#include "include/int_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * crc32c of each of `chunks` back-to-back `chunk_len` byte chunks of
+ * buffer, each seeded with crc, into out[].  Three chunks are run
+ * through the SSE 4.2 crc32 instruction at once so that their
+ * independent dependency chains hide the instruction latency.
+ */
+extern void ceph_crc32c_intel_multi(uint32_t crc, unsigned char const *buffer,
+				    unsigned chunk_len, unsigned chunks,
+				    uint32_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -157,6 +157,9 @@ OPTION(ms_async_set_affinity, OPT_BOOL)
 // If ms_async_affinity_cores is empty, all threads will be bind to current running
 // core
 OPTION(ms_async_affinity_cores, OPT_STR)
+OPTION(ms_async_send_zerocopy, OPT_BOOL)   // use MSG_ZEROCOPY for large sends (posix stack)
+OPTION(ms_async_send_zerocopy_min_bytes, OPT_U64)
+OPTION(ms_async_busy_poll_us, OPT_U64)   // spin this long after doing work before sleeping, 0 to disable
 OPTION(ms_async_rdma_device_name, OPT_STR)
 OPTION(ms_async_rdma_enable_hugepage, OPT_BOOL)
 OPTION(ms_async_rdma_buffer_size, OPT_INT)
@@ -460,6 +463,8 @@ OPTION(mds_log_events_per_segment, OPT_INT)
 OPTION(mds_log_segment_size, OPT_INT)  // segment size for mds log, default to default file_layout_t
 OPTION(mds_log_max_segments, OPT_U32)
 OPTION(mds_log_max_expiring, OPT_INT)
+OPTION(mds_log_group_commit_max_events, OPT_U64)
+OPTION(mds_log_group_commit_latency, OPT_FLOAT)
 OPTION(mds_bal_export_pin, OPT_BOOL)  // allow clients to pin directory trees to ranks
 OPTION(mds_bal_sample_interval, OPT_DOUBLE)  // every 3 seconds
 OPTION(mds_bal_replicate_threshold, OPT_FLOAT)
@@ -675,6 +680,7 @@ OPTION(osd_op_num_threads_per_shard_ssd, OPT_INT)
 OPTION(osd_op_num_shards, OPT_INT)
 OPTION(osd_op_num_shards_hdd, OPT_INT)
 OPTION(osd_op_num_shards_ssd, OPT_INT)
+OPTION(osd_op_queue_steal_threshold, OPT_U32) // idle shards take work from shards this backlogged; 0 disables
 
 // PrioritzedQueue (prio), Weighted Priority Queue (wpq ; default),
 // mclock_opclass, mclock_client, or debug_random. "mclock_opclass"
@@ -710,6 +716,11 @@ OPTION(osd_ignore_stale_divergent_priors, OPT_BOOL) // do not assert on divergen
 // If set to true even after reading enough shards to
 // decode the object, any error will be reported.
 OPTION(osd_read_ec_check_for_errors, OPT_BOOL) // return error if any ec shard has an error
+OPTION(osd_ec_parity_delta_writes, OPT_BOOL) // patch parity for small ec overwrites
+OPTION(osd_ec_compute_threads, OPT_U32) // threads coding stripes of large ec ops
+OPTION(osd_ec_compute_min_stripes, OPT_U32) // min stripes per ec compute batch
+OPTION(osd_ec_read_cache_size, OPT_U64) // bytes of reconstructed ec reads to cache
+OPTION(osd_ec_read_cache_max_read, OPT_U64) // largest stripe aligned read to cache
 
 // Only use clone_overlap for recovery if there are fewer than
 // osd_recover_clone_overlap_limit entries in the overlap set
@@ -724,6 +735,10 @@ OPTION(osd_recovery_thread_suicide_timeout, OPT_INT)
 OPTION(osd_recovery_sleep, OPT_FLOAT)         // seconds to sleep between recovery ops
 OPTION(osd_recovery_sleep_hdd, OPT_FLOAT)
 OPTION(osd_recovery_sleep_ssd, OPT_FLOAT)
+OPTION(osd_recovery_adaptive, OPT_BOOL)
+OPTION(osd_recovery_adaptive_client_latency, OPT_FLOAT)
+OPTION(osd_recovery_adaptive_commit_latency, OPT_FLOAT)
+OPTION(osd_recovery_adaptive_max_sleep, OPT_FLOAT)
 OPTION(osd_snap_trim_sleep, OPT_DOUBLE)
 OPTION(osd_scrub_invalid_stats, OPT_BOOL)
 OPTION(osd_remove_thread_timeout, OPT_INT)
@@ -782,6 +797,12 @@ OPTION(osd_scrub_backoff_ratio, OPT_DOUBLE)   // the probability to back off the
 OPTION(osd_scrub_chunk_min, OPT_INT)
 OPTION(osd_scrub_chunk_max, OPT_INT)
 OPTION(osd_scrub_sleep, OPT_FLOAT)   // sleep between [deep]scrub ops
+OPTION(osd_scrub_time_slice, OPT_FLOAT) // scan time before requeueing a scrub
+OPTION(osd_scrub_max_bytes_per_sec, OPT_U64) // per osd deep scrub read budget
+OPTION(osd_scrub_max_ops_per_sec, OPT_U64) // per osd scrub read budget
+OPTION(osd_scrub_preempt_queue_depth, OPT_U64) // client ops in progress that preempt scrub
+OPTION(osd_scrub_preempt_sleep, OPT_FLOAT) // wait after preempting a scrub
+OPTION(osd_scrub_max_preemptions, OPT_U32) // preemptions per scrub chunk
 OPTION(osd_scrub_auto_repair, OPT_BOOL)   // whether auto-repair inconsistencies upon deep-scrubbing
 OPTION(osd_scrub_auto_repair_num_errors, OPT_U32)   // only auto-repair when number of errors is below this threshold
 OPTION(osd_deep_scrub_interval, OPT_FLOAT) // once a week
@@ -962,6 +983,8 @@ OPTION(bdev_aio, OPT_BOOL)
 OPTION(bdev_aio_poll_ms, OPT_INT)  // milliseconds
 OPTION(bdev_aio_max_queue_depth, OPT_INT)
 OPTION(bdev_aio_reap_max, OPT_INT)
+OPTION(bdev_ioring, OPT_BOOL)  // use io_uring instead of libaio if available
+OPTION(bdev_ioring_sqthread_poll, OPT_BOOL)
 OPTION(bdev_block_size, OPT_INT)
 OPTION(bdev_debug_aio, OPT_BOOL)
 OPTION(bdev_debug_aio_suicide_timeout, OPT_FLOAT)
@@ -984,7 +1007,7 @@ OPTION(bluefs_min_flush_size, OPT_U64)  // ignore flush until its this big
 OPTION(bluefs_compact_log_sync, OPT_BOOL)  // sync or async log compaction?
 OPTION(bluefs_buffered_io, OPT_BOOL)
 OPTION(bluefs_sync_write, OPT_BOOL)
-OPTION(bluefs_allocator, OPT_STR)     // stupid | bitmap
+OPTION(bluefs_allocator, OPT_STR)     // stupid | bitmap | fastbitmap
 OPTION(bluefs_preextend_wal_files, OPT_BOOL)  // this *requires* that rocksdb has recycling enabled
 
 OPTION(bluestore_bluefs, OPT_BOOL)
@@ -1065,7 +1088,7 @@ OPTION(bluestore_extent_map_shard_target_size_slop, OPT_DOUBLE)
 OPTION(bluestore_extent_map_inline_shard_prealloc_size, OPT_U32)
 OPTION(bluestore_cache_trim_interval, OPT_DOUBLE)
 OPTION(bluestore_cache_trim_max_skip_pinned, OPT_U32) // skip this many onodes pinned in cache before we give up
-OPTION(bluestore_cache_type, OPT_STR)   // lru, 2q
+OPTION(bluestore_cache_type, OPT_STR)   // lru, 2q, clock
 OPTION(bluestore_2q_cache_kin_ratio, OPT_DOUBLE)    // kin page slot size / max page slot size
 OPTION(bluestore_2q_cache_kout_ratio, OPT_DOUBLE)   // number of kout page slot / total number of page slot
 OPTION(bluestore_cache_size, OPT_U64)
@@ -1075,10 +1098,12 @@ OPTION(bluestore_cache_meta_ratio, OPT_DOUBLE)
 OPTION(bluestore_cache_kv_ratio, OPT_DOUBLE)
 OPTION(bluestore_cache_kv_max, OPT_U64) // limit the maximum amount of cache for the kv store
 OPTION(bluestore_kvbackend, OPT_STR)
-OPTION(bluestore_allocator, OPT_STR)     // stupid | bitmap
+OPTION(bluestore_allocator, OPT_STR)     // stupid | bitmap | fastbitmap
 OPTION(bluestore_freelist_blocks_per_key, OPT_INT)
 OPTION(bluestore_bitmapallocator_blocks_per_zone, OPT_INT) // must be power of 2 aligned, e.g., 512, 1024, 2048...
 OPTION(bluestore_bitmapallocator_span_size, OPT_INT) // must be power of 2 aligned, e.g., 512, 1024, 2048...
+OPTION(bluestore_fastbitmap_cache_shards, OPT_U64)
+OPTION(bluestore_fastbitmap_cache_chunk, OPT_U64)
 OPTION(bluestore_max_deferred_txc, OPT_U64)
 OPTION(bluestore_rocksdb_options, OPT_STR)
 OPTION(bluestore_fsck_on_mount, OPT_BOOL)
@@ -1088,6 +1113,10 @@ OPTION(bluestore_fsck_on_umount_deep, OPT_BOOL)
 OPTION(bluestore_fsck_on_mkfs, OPT_BOOL)
 OPTION(bluestore_fsck_on_mkfs_deep, OPT_BOOL)
 OPTION(bluestore_sync_submit_transaction, OPT_BOOL) // submit kv txn in queueing thread (not kv_sync_thread)
+OPTION(bluestore_kv_sync_pipeline_depth, OPT_U64) // kv commit batches in flight (1 = serial)
+OPTION(bluestore_kv_sync_max_batch, OPT_U64)
+OPTION(bluestore_kv_sync_max_batch_delay, OPT_FLOAT)
+OPTION(bluestore_kv_sync_target_latency, OPT_FLOAT)
 OPTION(bluestore_throttle_bytes, OPT_U64)
 OPTION(bluestore_throttle_deferred_bytes, OPT_U64)
 OPTION(bluestore_throttle_cost_per_io_hdd, OPT_U64)
@@ -288,6 +288,12 @@ namespace ceph {
       }
     }
 
+    // re-fetch the ClientInfo of every known client, e.g. after the
+    // info function's source of tags has changed
+    void update_client_infos() {
+      queue.update_client_infos();
+    }
+
     void enqueue_strict(K cl, unsigned priority, T item) override final {
       high_queue[priority].enqueue(cl, 0, item);
     }
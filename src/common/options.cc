@@ -760,6 +760,21 @@ std::vector<Option> get_global_options() {
     .set_default("")
     .set_description(""),
 
+    Option("ms_async_send_zerocopy", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Send large messages with MSG_ZEROCOPY (posix stack, Linux >= 4.14)")
+    .add_see_also("ms_async_send_zerocopy_min_bytes"),
+
+    Option("ms_async_send_zerocopy_min_bytes", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(64_K)
+    .set_description("Smallest pending send that uses MSG_ZEROCOPY")
+    .set_long_description("Below this size the page pinning and completion notification cost more than copying the data into the socket buffer."),
+
+    Option("ms_async_busy_poll_us", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Microseconds a worker keeps polling for events after doing work before it blocks")
+    .set_long_description("Trades CPU for wakeup latency: while polling, the worker does not sleep in the event driver and other threads don't need to wake it through the notify pipe.  Also sets SO_BUSY_POLL on sockets (raising it above net.core.busy_read needs CAP_NET_ADMIN).  0 disables."),
+
     Option("ms_async_rdma_device_name", Option::TYPE_STR, Option::LEVEL_ADVANCED)
     .set_default("")
     .set_description(""),
@@ -1937,6 +1952,12 @@ std::vector<Option> get_global_options() {
     .set_default(8)
     .set_description(""),
 
+    Option("osd_op_queue_steal_threshold", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Let idle op shard threads take work from shards with at least this many queued items (0 disables)")
+    .set_long_description("PGs hash to a fixed op queue shard, so a hot PG can saturate one shard while the others sit idle.  With this set, an idle thread processes items from the most backlogged shard, using that shard's per-PG ordering, so ops for a PG are still run in order.")
+    .add_see_also("osd_op_num_shards"),
+
     Option("osd_skip_data_digest", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(true)
     .set_description(""),
@@ -2263,6 +2284,33 @@ std::vector<Option> get_global_options() {
     .set_default(false)
     .set_description(""),
 
+    Option("osd_ec_parity_delta_writes", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Apply small overwrites on EC pools with parity deltas")
+    .set_long_description("When an overwrite changes only a few data chunks of a stripe, read and rewrite just those chunks and the coding chunks, patching the coding chunks with the erasure code's parity delta, instead of reading and re-encoding the whole stripe. Only used when every shard of the object is available and the plugin supports it (jerasure, isa)."),
+
+    Option("osd_ec_compute_threads", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Number of threads an OSD uses to encode and decode the stripes of large EC reads and writes in parallel")
+    .set_long_description("The op thread codes one batch of stripes itself and waits for these threads to code the others, so at most osd_ec_compute_threads + 1 stripes are coded at the same time for a single request. 0 codes every stripe on the op thread."),
+
+    Option("osd_ec_compute_min_stripes", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(16)
+    .set_min(1)
+    .set_description("Minimum number of stripes in each batch handed to an EC compute thread")
+    .set_long_description("Requests smaller than twice this number of stripes are coded on the op thread."),
+
+    Option("osd_ec_read_cache_size", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Memory target in bytes for the cache of reconstructed EC read extents on each OSD")
+    .set_long_description("Small client reads from EC pools are remembered by the primary so repeated reads of hot objects need not gather shards again.  The cache is shared by all the EC PGs of the OSD and evicts their least recently read objects; lowering the target at runtime evicts straight away.  Cached buffers are accounted in the osd_ec_read_cache mempool.  0 disables the cache.")
+    .add_see_also("osd_ec_read_cache_max_read"),
+
+    Option("osd_ec_read_cache_max_read", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(64_K)
+    .set_description("Largest EC client read, after rounding out to whole stripes, that is looked up in or added to the read cache")
+    .add_see_also("osd_ec_read_cache_size"),
+
     Option("osd_recover_clone_overlap_limit", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(10)
     .set_description(""),
@@ -2307,6 +2355,29 @@ std::vector<Option> get_global_options() {
     .set_default(0.025)
     .set_description("Time in seconds to sleep before next recovery or backfill op when data is on HDD and journal is on SSD"),
 
+    Option("osd_recovery_adaptive", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Adjust recovery concurrency and pacing to client and device latency")
+    .set_long_description("Every tick, halve the number of active recovery ops (or, at one op, lengthen the sleep between ops) while the client op latency or the object store commit latency is above its target, and step back towards osd_recovery_max_active while both are below it.")
+    .add_see_also("osd_recovery_adaptive_client_latency")
+    .add_see_also("osd_recovery_adaptive_commit_latency")
+    .add_see_also("osd_recovery_adaptive_max_sleep"),
+
+    Option("osd_recovery_adaptive_client_latency", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0.05)
+    .set_description("Client op latency in seconds above which adaptive recovery backs off (0 to ignore)")
+    .add_see_also("osd_recovery_adaptive"),
+
+    Option("osd_recovery_adaptive_commit_latency", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0.1)
+    .set_description("Object store commit latency in seconds above which adaptive recovery backs off (0 to ignore)")
+    .add_see_also("osd_recovery_adaptive"),
+
+    Option("osd_recovery_adaptive_max_sleep", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0.5)
+    .set_description("Longest sleep in seconds adaptive recovery adds between recovery ops")
+    .add_see_also("osd_recovery_adaptive"),
+
     Option("osd_snap_trim_sleep", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
     .set_default(0)
     .set_description(""),
@@ -2499,6 +2570,32 @@ std::vector<Option> get_global_options() {
     .set_default(0)
     .set_description(""),
 
+    Option("osd_scrub_time_slice", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Seconds a scrub spends scanning objects before letting queued ops run")
+    .set_long_description("When building the scrub map of a chunk takes longer than this, the scrub requeues itself behind the ops already in the op queue and resumes with the next object. 0 builds each chunk in one go."),
+
+    Option("osd_scrub_max_bytes_per_sec", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Maximum rate at which an OSD reads object data for deep scrubs, in bytes per second (0 is unlimited)"),
+
+    Option("osd_scrub_max_ops_per_sec", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Maximum rate of scrub reads on an OSD, in reads per second (0 is unlimited)")
+    .set_long_description("Every object scrubbed counts as one read, plus one per osd_deep_scrub_stride of data for deep scrubs."),
+
+    Option("osd_scrub_preempt_queue_depth", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Number of client ops in progress on an OSD above which scrubs step aside (0 never preempts)"),
+
+    Option("osd_scrub_preempt_sleep", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(.1)
+    .set_description("Seconds a preempted scrub waits before resuming"),
+
+    Option("osd_scrub_max_preemptions", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(5)
+    .set_description("Maximum number of times the scrub of a single chunk is preempted by client load"),
+
     Option("osd_scrub_auto_repair", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
     .set_description(""),
@@ -3082,6 +3179,16 @@ std::vector<Option> get_global_options() {
     .set_default(16)
     .set_description(""),
 
+    Option("bdev_ioring", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Use io_uring instead of libaio for KernelDevice")
+    .set_long_description("Falls back to libaio if ceph was built without liburing or the running kernel does not support io_uring."),
+
+    Option("bdev_ioring_sqthread_poll", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Have a kernel thread poll the io_uring submission queue")
+    .set_long_description("Avoids a syscall per submitted batch at the cost of a kernel thread spinning on each device; usually requires root."),
+
     Option("bdev_block_size", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(4_K)
     .set_description(""),
@@ -3144,7 +3251,9 @@ std::vector<Option> get_global_options() {
 
     Option("bluefs_allocator", Option::TYPE_STR, Option::LEVEL_DEV)
     .set_default("stupid")
-    .set_description(""),
+    .set_enum_allowed({"bitmap", "stupid", "fastbitmap"})
+    .set_description("Allocator policy for BlueFS")
+    .set_long_description("fastbitmap is the bitmap allocator with per-thread extent caches in front of it; see bluestore_fastbitmap_cache_shards and bluestore_fastbitmap_cache_chunk."),
 
     Option("bluefs_preextend_wal_files", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
@@ -3404,7 +3513,7 @@ std::vector<Option> get_global_options() {
 
     Option("bluestore_cache_type", Option::TYPE_STR, Option::LEVEL_DEV)
     .set_default("2q")
-    .set_enum_allowed({"2q", "lru"})
+    .set_enum_allowed({"2q", "lru", "clock"})
     .set_description("Cache replacement algorithm"),
 
     Option("bluestore_2q_cache_kin_ratio", Option::TYPE_FLOAT, Option::LEVEL_DEV)
@@ -3447,8 +3556,9 @@ std::vector<Option> get_global_options() {
 
     Option("bluestore_allocator", Option::TYPE_STR, Option::LEVEL_ADVANCED)
     .set_default("stupid")
-    .set_enum_allowed({"bitmap", "stupid"})
-    .set_description("Allocator policy"),
+    .set_enum_allowed({"bitmap", "stupid", "fastbitmap"})
+    .set_description("Allocator policy")
+    .set_long_description("fastbitmap is the bitmap allocator with per-thread extent caches in front of it; see bluestore_fastbitmap_cache_shards and bluestore_fastbitmap_cache_chunk."),
 
     Option("bluestore_freelist_blocks_per_key", Option::TYPE_INT, Option::LEVEL_DEV)
     .set_default(128)
@@ -3462,6 +3572,16 @@ std::vector<Option> get_global_options() {
     .set_default(1024)
     .set_description(""),
 
+    Option("bluestore_fastbitmap_cache_shards", Option::TYPE_UINT, Option::LEVEL_DEV)
+    .set_default(8)
+    .set_description("Number of per-thread extent caches in the fastbitmap allocator")
+    .set_long_description("Small allocations are served from one of these caches so that concurrent allocating threads do not all serialize on the bitmap lock.  0 disables the caches."),
+
+    Option("bluestore_fastbitmap_cache_chunk", Option::TYPE_UINT, Option::LEVEL_DEV)
+    .set_default(1_M)
+    .set_description("Bytes a fastbitmap allocator cache pulls from the bitmap when it runs dry")
+    .set_long_description("Allocations larger than a quarter of this bypass the caches."),
+
     Option("bluestore_max_deferred_txc", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(32)
     .set_description("Max transactions with deferred writes that can accumulate before we force flush deferred writes"),
@@ -3502,6 +3622,28 @@ std::vector<Option> get_global_options() {
     .set_default(false)
     .set_description("Try to submit metadata transaction to rocksdb in queuing thread context"),
 
+    Option("bluestore_kv_sync_pipeline_depth", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(1)
+    .set_min(1)
+    .set_description("Number of kv commit batches that may be in flight at once")
+    .set_long_description("With a value of 1 the kv_sync_thread prepares, submits and syncs one batch at a time.  Larger values let a separate commit thread wait for the synchronous rocksdb commit of one batch while the kv_sync_thread already prepares and submits the next."),
+
+    Option("bluestore_kv_sync_max_batch", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(256)
+    .set_min(1)
+    .set_description("Upper bound for the adaptive kv commit batch size target")
+    .add_see_also("bluestore_kv_sync_pipeline_depth"),
+
+    Option("bluestore_kv_sync_max_batch_delay", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(.0005)
+    .set_description("Longest time (seconds) to hold back a kv commit batch to let it grow while another batch is in flight")
+    .add_see_also("bluestore_kv_sync_pipeline_depth"),
+
+    Option("bluestore_kv_sync_target_latency", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(.002)
+    .set_description("kv commit latency (seconds) above which the batch size target grows")
+    .add_see_also("bluestore_kv_sync_pipeline_depth"),
+
     Option("bluestore_throttle_bytes", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(64_M)
     .set_safe()
@@ -5555,6 +5697,16 @@ std::vector<Option> get_mds_options() {
     .set_default(20)
     .set_description(""),
 
+    Option("mds_log_group_commit_max_events", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(1024)
+    .set_description("Maximum number of journal events written and flushed as one batch"),
+
+    Option("mds_log_group_commit_latency", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Time in seconds a journal flush may wait for more events to share it")
+    .set_long_description("When an event needs the journal flushed, the submit thread waits up to this long for further events to join the same write; 0 flushes whatever is queued right away.")
+    .add_see_also("mds_log_group_commit_max_events"),
+
     Option("mds_bal_export_pin", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(true)
     .set_description(""),
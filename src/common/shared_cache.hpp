@@ -17,6 +17,10 @@
 
 #include <map>
 #include <list>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <thread>
 #include "common/Mutex.h"
 #include "common/Cond.h"
 #include "include/unordered_map.h"
@@ -368,4 +372,118 @@ public:
   friend class SharedLRUTest;
 };
 
+/**
+ * SharedWindow
+ *
+ * Strong references to the values of the most recent integer keys, one
+ * slot per key % size (a slot only moves forward), looked up without
+ * any mutex.
+ *
+ * A slot points to a heap allocated holder.  Readers copy the
+ * reference out of it inside a read-side section counted against the
+ * current generation.  add() swaps the holder, flips the generation
+ * and waits for the readers of the previous one to drain before it
+ * frees the old holder: epoch-based reclamation in the manner of RCU.
+ * set_size() replaces the whole slot table the same way.  Calls to
+ * add(), clear() and set_size() must be serialized by the caller.
+ */
+template <class V>
+class SharedWindow {
+  typedef ceph::shared_ptr<V> VPtr;
+  struct holder_t {
+    uint64_t key;
+    VPtr val;
+  };
+  struct table_t {
+    unsigned size;
+    std::unique_ptr<std::atomic<holder_t*>[]> slots;
+    explicit table_t(unsigned s)
+      : size(s), slots(new std::atomic<holder_t*>[s ? s : 1]) {
+      for (unsigned i = 0; i < size; ++i)
+	slots[i].store(nullptr);
+    }
+    ~table_t() {
+      for (unsigned i = 0; i < size; ++i)
+	delete slots[i].load();
+    }
+  };
+  std::atomic<table_t*> table;
+  std::atomic<unsigned> gen;
+  std::atomic<unsigned> readers[2];
+
+  void synchronize() {
+    unsigned old = gen.load();
+    gen.store(old ^ 1);
+    while (readers[old].load())
+      std::this_thread::yield();
+  }
+
+public:
+  explicit SharedWindow(unsigned size) : table(new table_t(size)), gen(0) {
+    readers[0].store(0);
+    readers[1].store(0);
+  }
+  ~SharedWindow() {
+    delete table.load();
+  }
+
+  VPtr lookup(uint64_t key) {
+    unsigned g;
+    while (true) {
+      g = gen.load();
+      ++readers[g];
+      if (gen.load() == g)
+	break;
+      // add() may already have seen our generation drained; retry
+      --readers[g];
+    }
+    VPtr ret;
+    table_t *t = table.load();
+    if (t->size) {
+      holder_t *h = t->slots[key % t->size].load();
+      if (h && h->key == key)
+	ret = h->val;
+    }
+    --readers[g];
+    return ret;
+  }
+
+  /// publish val for key unless its slot already holds a newer key
+  void add(uint64_t key, const VPtr &val) {
+    table_t *t = table.load();
+    if (!t->size)
+      return;
+    std::atomic<holder_t*> &slot = t->slots[key % t->size];
+    holder_t *cur = slot.load();
+    if (cur && cur->key >= key)
+      return;
+    holder_t *old = slot.exchange(new holder_t{key, val});
+    if (old) {
+      synchronize();
+      delete old;
+    }
+  }
+
+  void clear() {
+    table_t *t = table.load();
+    std::vector<holder_t*> old(t->size);
+    for (unsigned i = 0; i < t->size; ++i)
+      old[i] = t->slots[i].exchange(nullptr);
+    synchronize();
+    for (auto h : old)
+      delete h;
+  }
+
+  /// resize to size slots (0 disables the window); starts out empty
+  void set_size(unsigned size) {
+    table_t *old = table.exchange(new table_t(size));
+    synchronize();
+    delete old;
+  }
+
+  unsigned get_size() const {
+    return table.load()->size;
+  }
+};
+
 #endif
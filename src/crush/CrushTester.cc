@@ -20,6 +20,7 @@
 #include <boost/algorithm/string/join.hpp>
 #include "common/SubProcess.h"
 #include "common/fork_function.h"
+#include "common/ceph_time.h"
 
 void CrushTester::set_device_weight(int dev, float f)
 {
@@ -589,6 +590,9 @@ int CrushTester::test()
       for (unsigned i = 0; i < num_devices; i++)
         num_objects_expected[i] = (proportional_weights[i]*expected_objects);
 
+      // time spent in do_rule, for --show-throughput
+      ceph::timespan mapping_time = ceph::timespan::zero();
+
       for (int current_batch = 0; current_batch < num_batches; current_batch++) {
         if (current_batch == (num_batches - 1)) {
           batch_max = max_x;
@@ -615,7 +619,9 @@ int CrushTester::test()
             if (pool_id != -1) {
               real_x = crush_hash32_2(CRUSH_HASH_RJENKINS1, x, (uint32_t)pool_id);
             }
+            auto start = ceph::mono_clock::now();
             crush.do_rule(r, real_x, out, nr, weight, 0);
+            mapping_time += ceph::mono_clock::now() - start;
           } else {
             if (output_mappings)
 	      err << "RNG"; // prepend RNG to placement output to denote simulation
@@ -652,6 +658,14 @@ int CrushTester::test()
         batch_max = batch_min + objects_per_batch - 1;
       }
 
+      if (output_throughput && use_crush) {
+        double secs = std::chrono::duration<double>(mapping_time).count();
+        err << "rule " << r << " (" << crush.get_rule_name(r) << ") num_rep " << nr
+            << " mapped " << num_objects << " x in " << secs << "s: "
+            << (secs > 0 ? num_objects / secs : 0) << " mappings/s"
+            << std::endl;
+      }
+
       for (unsigned i = 0; i < per.size(); i++)
         if (output_utilization && !output_statistics)
           err << "  device " << i
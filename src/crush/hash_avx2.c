@@ -0,0 +1,51 @@
+#include <immintrin.h>
+
+#include "hash.h"
+#include "hash_avx2.h"
+
+/*
+ * crush_hashmix() from hash.c, one lane per item.  All the arithmetic
+ * is 32-bit add/sub/xor/shift, so every lane produces exactly what the
+ * scalar version would.
+ */
+#define crush_hashmix_x8(a, b, c) do {					\
+		a = _mm256_sub_epi32(a, b);  a = _mm256_sub_epi32(a, c); \
+		a = _mm256_xor_si256(a, _mm256_srli_epi32(c, 13));	\
+		b = _mm256_sub_epi32(b, c);  b = _mm256_sub_epi32(b, a); \
+		b = _mm256_xor_si256(b, _mm256_slli_epi32(a, 8));	\
+		c = _mm256_sub_epi32(c, a);  c = _mm256_sub_epi32(c, b); \
+		c = _mm256_xor_si256(c, _mm256_srli_epi32(b, 13));	\
+		a = _mm256_sub_epi32(a, b);  a = _mm256_sub_epi32(a, c); \
+		a = _mm256_xor_si256(a, _mm256_srli_epi32(c, 12));	\
+		b = _mm256_sub_epi32(b, c);  b = _mm256_sub_epi32(b, a); \
+		b = _mm256_xor_si256(b, _mm256_slli_epi32(a, 16));	\
+		c = _mm256_sub_epi32(c, a);  c = _mm256_sub_epi32(c, b); \
+		c = _mm256_xor_si256(c, _mm256_srli_epi32(b, 5));	\
+		a = _mm256_sub_epi32(a, b);  a = _mm256_sub_epi32(a, c); \
+		a = _mm256_xor_si256(a, _mm256_srli_epi32(c, 3));	\
+		b = _mm256_sub_epi32(b, c);  b = _mm256_sub_epi32(b, a); \
+		b = _mm256_xor_si256(b, _mm256_slli_epi32(a, 10));	\
+		c = _mm256_sub_epi32(c, a);  c = _mm256_sub_epi32(c, b); \
+		c = _mm256_xor_si256(c, _mm256_srli_epi32(b, 15));	\
+	} while (0)
+
+#define crush_hash_seed 1315423911
+
+void crush_hash32_rjenkins1_3_x8(__u32 a_, const __s32 *b_, __u32 c_,
+				 __u32 *out)
+{
+	__m256i a = _mm256_set1_epi32(a_);
+	__m256i b = _mm256_loadu_si256((const __m256i *)b_);
+	__m256i c = _mm256_set1_epi32(c_);
+	__m256i hash = _mm256_xor_si256(
+		_mm256_set1_epi32(crush_hash_seed ^ a_ ^ c_), b);
+	__m256i x = _mm256_set1_epi32(231232);
+	__m256i y = _mm256_set1_epi32(1232);
+
+	crush_hashmix_x8(a, b, hash);
+	crush_hashmix_x8(c, x, hash);
+	crush_hashmix_x8(y, a, hash);
+	crush_hashmix_x8(b, x, hash);
+	crush_hashmix_x8(y, c, hash);
+	_mm256_storeu_si256((__m256i *)out, hash);
+}
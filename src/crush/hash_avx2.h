@@ -0,0 +1,22 @@
+#ifndef CEPH_CRUSH_HASH_AVX2_H
+#define CEPH_CRUSH_HASH_AVX2_H
+
+#include "include/int_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * out[i] = crush_hash32_3(CRUSH_HASH_RJENKINS1, a, b[i], c) for
+ * i in [0, 8), computed in the eight 32-bit lanes of an AVX2 register.
+ * Only call this after checking ceph_arch_intel_avx2.
+ */
+extern void crush_hash32_rjenkins1_3_x8(__u32 a, const __s32 *b, __u32 c,
+					__u32 *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
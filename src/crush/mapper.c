@@ -25,6 +25,15 @@
 #include "crush_ln_table.h"
 #include "mapper.h"
 
+#if !defined(__KERNEL__) && defined(__x86_64__)
+# include "acconfig.h"
+# ifdef HAVE_INTEL_AVX2
+#  define CRUSH_STRAW2_AVX2
+#  include "arch/intel.h"
+#  include "hash_avx2.h"
+# endif
+#endif
+
 #define dprintk(args...) /* printf(args) */
 
 /*
@@ -319,40 +328,81 @@ static inline __s32 *get_choose_arg_ids(const struct crush_bucket_straw2 *bucket
   return arg->ids;
 }
 
+/*
+ * the straw2 draw for an item with hash value u and 16.16 fixed-point
+ * weight (> 0)
+ */
+static inline __s64 straw2_draw(__u32 u, __u32 weight)
+{
+	__s64 ln;
+
+	u &= 0xffff;
+
+	/*
+	 * for some reason slightly less than 0x10000 produces
+	 * a slightly more accurate distribution... probably a
+	 * rounding effect.
+	 *
+	 * the natural log lookup table maps [0,0xffff]
+	 * (corresponding to real numbers [1/0x10000, 1] to
+	 * [0, 0xffffffffffff] (corresponding to real numbers
+	 * [-11.090355,0]).
+	 */
+	ln = crush_ln(u) - 0x1000000000000ll;
+
+	/*
+	 * divide by 16.16 fixed-point weight.  note
+	 * that the ln value is negative, so a larger
+	 * weight means a larger (less negative) value
+	 * for draw.
+	 */
+	return div64_s64(ln, weight);
+}
+
 static int bucket_straw2_choose(const struct crush_bucket_straw2 *bucket,
 				int x, int r, const struct crush_choose_arg *arg,
                                 int position)
 {
-	unsigned int i, high = 0;
+	unsigned int i = 0, high = 0;
 	unsigned int u;
-	__s64 ln, draw, high_draw = 0;
+	__s64 draw, high_draw = 0;
         __u32 *weights = get_choose_arg_weights(bucket, arg, position);
         __s32 *ids = get_choose_arg_ids(bucket, arg);
-	for (i = 0; i < bucket->h.size; i++) {
+
+#ifdef CRUSH_STRAW2_AVX2
+	/*
+	 * hash eight items at a time.  the hash dominates the cost of a
+	 * draw; crush_ln() and the 64-bit divide stay scalar (there is
+	 * no vector integer divide), and items are still compared in
+	 * order, so the result is the same as the loop below.
+	 */
+	if (ceph_arch_intel_avx2 &&
+	    bucket->h.hash == CRUSH_HASH_RJENKINS1) {
+		__u32 hash[8];
+		unsigned int j;
+
+		for (; i + 8 <= bucket->h.size; i += 8) {
+			crush_hash32_rjenkins1_3_x8(x, ids + i, r, hash);
+			for (j = 0; j < 8; j++) {
+				if (weights[i + j])
+					draw = straw2_draw(hash[j],
+							   weights[i + j]);
+				else
+					draw = S64_MIN;
+				if (i + j == 0 || draw > high_draw) {
+					high = i + j;
+					high_draw = draw;
+				}
+			}
+		}
+	}
+#endif
+
+	for (; i < bucket->h.size; i++) {
                 dprintk("weight 0x%x item %d\n", weights[i], ids[i]);
 		if (weights[i]) {
 			u = crush_hash32_3(bucket->h.hash, x, ids[i], r);
-			u &= 0xffff;
-
-			/*
-			 * for some reason slightly less than 0x10000 produces
-			 * a slightly more accurate distribution... probably a
-			 * rounding effect.
-			 *
-			 * the natural log lookup table maps [0,0xffff]
-			 * (corresponding to real numbers [1/0x10000, 1] to
-			 * [0, 0xffffffffffff] (corresponding to real numbers
-			 * [-11.090355,0]).
-			 */
-			ln = crush_ln(u) - 0x1000000000000ll;
-
-			/*
-			 * divide by 16.16 fixed-point weight.  note
-			 * that the ln value is negative, so a larger
-			 * weight means a larger (less negative) value
-			 * for draw.
-			 */
-			draw = div64_s64(ln, weights[i]);
+			draw = straw2_draw(u, weights[i]);
 		} else {
 			draw = S64_MIN;
 		}
@@ -179,6 +179,40 @@ int ErasureCode::encode_chunks(const set<int> &want_to_encode,
 {
   assert("ErasureCode::encode_chunks not implemented" == 0);
 }
+
+int ErasureCode::encode_delta(int data_chunk,
+			      const bufferlist &delta,
+			      map<int, bufferlist> *parity_delta)
+{
+  // For a linear code the coding chunks of a stripe that is all
+  // zeros except for the delta are the parity deltas.  Plugins that
+  // know their coding matrix override this with something cheaper.
+  if (!supports_parity_delta())
+    return -EOPNOTSUPP;
+  unsigned int k = get_data_chunk_count();
+  unsigned int m = get_chunk_count() - k;
+  if (data_chunk < 0 || (unsigned)data_chunk >= k)
+    return -EINVAL;
+  unsigned blocksize = delta.length();
+  map<int, bufferlist> encoded;
+  for (unsigned int i = 0; i < k + m; i++) {
+    bufferptr buf(buffer::create_aligned(blocksize, SIMD_ALIGN));
+    if (i == (unsigned)data_chunk)
+      delta.copy(0, blocksize, buf.c_str());
+    else if (i < k)
+      buf.zero();
+    encoded[chunk_index(i)].push_back(std::move(buf));
+  }
+  set<int> want;
+  for (unsigned int i = k; i < k + m; i++)
+    want.insert(chunk_index(i));
+  int r = encode_chunks(want, &encoded);
+  if (r < 0)
+    return r;
+  for (unsigned int i = k; i < k + m; i++)
+    (*parity_delta)[i].claim(encoded[chunk_index(i)]);
+  return 0;
+}
  
 int ErasureCode::decode(const set<int> &want_to_read,
                         const map<int, bufferlist> &chunks,
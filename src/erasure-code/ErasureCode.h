@@ -74,6 +74,14 @@ namespace ceph {
     int encode_chunks(const std::set<int> &want_to_encode,
                               std::map<int, bufferlist> *encoded) override;
 
+    bool supports_parity_delta() const override {
+      return false;
+    }
+
+    int encode_delta(int data_chunk,
+		     const bufferlist &delta,
+		     std::map<int, bufferlist> *parity_delta) override;
+
     int decode(const std::set<int> &want_to_read,
                        const std::map<int, bufferlist> &chunks,
                        std::map<int, bufferlist> *decoded) override;
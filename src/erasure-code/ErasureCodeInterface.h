@@ -358,6 +358,42 @@ namespace ceph {
     virtual int encode_chunks(const std::set<int> &want_to_encode,
                               std::map<int, bufferlist> *encoded) = 0;
 
+    /**
+     * Return true if the code is linear, i.e. each coding chunk is
+     * a sum (XOR) of contributions that each depend on a single data
+     * chunk, so that **encode_delta** can be used to update the
+     * coding chunks after a data chunk changed without reading the
+     * other data chunks.
+     *
+     * @return **true** if **encode_delta** is supported
+     */
+    virtual bool supports_parity_delta() const = 0;
+
+    /**
+     * Compute the change of every coding chunk caused by XORing
+     * **delta** into data chunk **data_chunk** (i.e. **delta** is
+     * old_data ^ new_data). The new content of coding chunk i is
+     * old_coding[i] ^ (*parity_delta)[i].
+     *
+     * **data_chunk** and the keys of **parity_delta** are chunk
+     * indexes before remapping by **get_chunk_mapping**: data chunks
+     * are in [0, get_data_chunk_count()) and coding chunks follow.
+     *
+     * **delta** can be any length that is a multiple of the
+     * alignment required by the plugin. Every buffer stored in
+     * **parity_delta** has the same length as **delta**.
+     *
+     * Returns 0 on success.
+     *
+     * @param [in] data_chunk index of the modified data chunk
+     * @param [in] delta old_data ^ new_data for that chunk
+     * @param [out] parity_delta map coding chunk indexes to deltas
+     * @return **0** on success or a negative errno on error.
+     */
+    virtual int encode_delta(int data_chunk,
+			     const bufferlist &delta,
+			     std::map<int, bufferlist> *parity_delta) = 0;
+
     /**
      * Decode the **chunks** and store at least **want_to_read**
      * chunks in **decoded**.
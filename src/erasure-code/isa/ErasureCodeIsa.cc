@@ -131,6 +131,38 @@ ErasureCodeIsaDefault::isa_encode(char **data,
 
 // -----------------------------------------------------------------------------
 
+int
+ErasureCodeIsaDefault::encode_delta(int data_chunk,
+                                    const bufferlist &delta,
+                                    map<int, bufferlist> *parity_delta)
+{
+  if (data_chunk < 0 || data_chunk >= k)
+    return -EINVAL;
+  unsigned blocksize = delta.length();
+  if (m == 1) {
+    // single parity stripe: the parity delta is the data delta
+    bufferlist &out = (*parity_delta)[k];
+    out = delta;
+    out.rebuild_aligned(EC_ISA_ADDRESS_ALIGNMENT);
+    return 0;
+  }
+  bufferlist in = delta;
+  in.rebuild_aligned(EC_ISA_ADDRESS_ALIGNMENT);
+  unsigned char *coding[m];
+  for (int i = 0; i < m; i++) {
+    bufferptr out(buffer::create_aligned(blocksize, EC_ISA_ADDRESS_ALIGNMENT));
+    // ec_encode_data_update accumulates into the coding buffers
+    out.zero();
+    coding[i] = (unsigned char*) out.c_str();
+    (*parity_delta)[k + i].push_back(std::move(out));
+  }
+  ec_encode_data_update(blocksize, k, m, data_chunk, encode_tbls,
+                        (unsigned char*) in.c_str(), coding);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+
 bool
 ErasureCodeIsaDefault::erasure_contains(int *erasures, int i)
 {
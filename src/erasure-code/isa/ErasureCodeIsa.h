@@ -141,6 +141,15 @@ public:
                          char **coding,
                          int blocksize) override;
 
+  bool supports_parity_delta() const override
+  {
+    return true;
+  }
+
+  int encode_delta(int data_chunk,
+                   const bufferlist &delta,
+                   std::map<int, bufferlist> *parity_delta) override;
+
   unsigned get_alignment() const override;
 
   void prepare() override;
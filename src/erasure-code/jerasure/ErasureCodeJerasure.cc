@@ -146,6 +146,47 @@ bool ErasureCodeJerasure::is_prime(int value)
   return false;
 }
 
+int ErasureCodeJerasure::matrix_encode_delta(const int *matrix,
+					     int data_chunk,
+					     const bufferlist &delta,
+					     map<int, bufferlist> *parity_delta)
+{
+  if (data_chunk < 0 || data_chunk >= k)
+    return -EINVAL;
+  if (w != 8 && w != 16 && w != 32)
+    return ErasureCode::encode_delta(data_chunk, delta, parity_delta);
+  // galois_wXX_region_multiply wants a word aligned source
+  bufferlist in = delta;
+  in.rebuild_aligned(SIMD_ALIGN);
+  unsigned blocksize = in.length();
+  for (int i = 0; i < m; i++) {
+    int coeff = matrix[i * k + data_chunk];
+    bufferptr out(buffer::create_aligned(blocksize, SIMD_ALIGN));
+    if (coeff == 0) {
+      out.zero();
+    } else if (coeff == 1) {
+      in.copy(0, blocksize, out.c_str());
+    } else {
+      switch (w) {
+      case 8:
+	galois_w08_region_multiply(in.c_str(), coeff, blocksize,
+				   out.c_str(), 0);
+	break;
+      case 16:
+	galois_w16_region_multiply(in.c_str(), coeff, blocksize,
+				   out.c_str(), 0);
+	break;
+      case 32:
+	galois_w32_region_multiply(in.c_str(), coeff, blocksize,
+				   out.c_str(), 0);
+	break;
+      }
+    }
+    (*parity_delta)[k + i].push_back(std::move(out));
+  }
+  return 0;
+}
+
 // 
 // ErasureCodeJerasureReedSolomonVandermonde
 //
@@ -63,6 +63,11 @@ public:
 			    const std::map<int, bufferlist> &chunks,
 			    std::map<int, bufferlist> *decoded) override;
 
+  // every jerasure technique is linear over GF(2^w)
+  bool supports_parity_delta() const override {
+    return true;
+  }
+
   int init(ErasureCodeProfile &profile, std::ostream *ss) override;
 
   virtual void jerasure_encode(char **data,
@@ -77,6 +82,10 @@ public:
   static bool is_prime(int value);
 protected:
   virtual int parse(ErasureCodeProfile &profile, std::ostream *ss);
+  int matrix_encode_delta(const int *matrix,
+			  int data_chunk,
+			  const bufferlist &delta,
+			  std::map<int, bufferlist> *parity_delta);
 };
 
 class ErasureCodeJerasureReedSolomonVandermonde : public ErasureCodeJerasure {
@@ -103,6 +112,11 @@ public:
                                char **data,
                                char **coding,
                                int blocksize) override;
+  int encode_delta(int data_chunk,
+		   const bufferlist &delta,
+		   std::map<int, bufferlist> *parity_delta) override {
+    return matrix_encode_delta(matrix, data_chunk, delta, parity_delta);
+  }
   unsigned get_alignment() const override;
   void prepare() override;
 private:
@@ -132,6 +146,11 @@ public:
                                char **data,
                                char **coding,
                                int blocksize) override;
+  int encode_delta(int data_chunk,
+		   const bufferlist &delta,
+		   std::map<int, bufferlist> *parity_delta) override {
+    return matrix_encode_delta(matrix, data_chunk, delta, parity_delta);
+  }
   unsigned get_alignment() const override;
   void prepare() override;
 private:
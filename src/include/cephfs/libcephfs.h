@@ -503,6 +503,31 @@ int ceph_readdir_r(struct ceph_mount_info *cmount, struct ceph_dir_result *dirp,
 int ceph_readdirplus_r(struct ceph_mount_info *cmount, struct ceph_dir_result *dirp, struct dirent *de,
 		       struct ceph_statx *stx, unsigned want, unsigned flags, struct Inode **out);
 
+typedef int (*ceph_readdirplus_cb_t)(void *arg, struct dirent *de, struct ceph_statx *stx);
+
+/**
+ * Read a whole directory along with the file statistics of every entry.
+ *
+ * All fragments of the directory are fetched from the MDS concurrently and the
+ * attributes come from the same replies, so there is no round trip per entry.
+ * The "." and ".." entries are not returned.  If the directory keeps being
+ * refragmented while it is read, the entries are read one fragment at a time
+ * instead; cb sees each entry once either way.
+ *
+ * @param cmount the ceph mount handle to use for performing the readdir.
+ * @param dirp the directory stream pointer from an opendir.  It is left at the
+ *        end of the directory, also when cb stops the readdir early.
+ * @param cb called once for each entry; any non-zero return, negative or
+ *        positive, stops the readdir and is returned unchanged.
+ * @param arg opaque pointer passed to cb
+ * @param want mask showing desired inode attrs for returned entries
+ * @param flags bitmask of flags to use when filling out attributes
+ * @returns 0 once every entry has been passed to cb, the non-zero value cb
+ *          returned, or a negative error code on failure.
+ */
+int ceph_readdirplus_bulk(struct ceph_mount_info *cmount, struct ceph_dir_result *dirp,
+			  ceph_readdirplus_cb_t cb, void *arg, unsigned want, unsigned flags);
+
 /**
  * Gets multiple directory entries.
  *
@@ -90,6 +90,9 @@
 /* Defined if you have libaio */
 #cmakedefine HAVE_LIBAIO
 
+/* Defined if you have liburing */
+#cmakedefine HAVE_LIBURING
+
 /* Defined if OpenLDAP enabled */
 #cmakedefine HAVE_OPENLDAP
 
@@ -232,6 +235,12 @@
 /* Support SSE2 (Streaming SIMD Extensions 2) instructions */
 #cmakedefine HAVE_SSE2
 
+/* Compiler can build SSE 4.2 (crc32 instruction) code */
+#cmakedefine HAVE_INTEL_SSE4_2
+
+/* Compiler can build AVX2 code */
+#cmakedefine HAVE_INTEL_AVX2
+
 /* Define to 1 if you have the `pipe2' function. */
 #cmakedefine HAVE_PIPE2 1
 
@@ -50,6 +50,36 @@ static inline uint32_t ceph_crc32c(uint32_t crc, unsigned char const *data, unsi
   return ceph_crc32c_func(crc, data, length);
 }
 
+typedef void (*ceph_crc32c_multi_func_t)(uint32_t crc, unsigned char const *data,
+					 unsigned chunk_len, unsigned chunks,
+					 uint32_t *out);
+
+/*
+ * chosen implementation of the batched variant below
+ */
+extern ceph_crc32c_multi_func_t ceph_crc32c_multi_func;
+
+extern ceph_crc32c_multi_func_t ceph_choose_crc32c_multi(void);
+
+/**
+ * calculate crc32c of several equally sized chunks
+ *
+ * Computes out[i] = ceph_crc32c(crc, data + i * chunk_len, chunk_len)
+ * for each chunk, interleaving the chunks where the architecture can.
+ *
+ * @param crc initial value for every chunk
+ * @param data pointer to chunks * chunk_len bytes (must not be NULL)
+ * @param chunk_len length of each chunk
+ * @param chunks number of chunks
+ * @param out array of chunks results
+ */
+static inline void ceph_crc32c_multi(uint32_t crc, unsigned char const *data,
+				     unsigned chunk_len, unsigned chunks,
+				     uint32_t *out)
+{
+  ceph_crc32c_multi_func(crc, data, chunk_len, chunks, out);
+}
+
 #ifdef __cplusplus
 }
 #endif
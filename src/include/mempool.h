@@ -155,6 +155,7 @@ namespace mempool {
   f(buffer_anon)		      \
   f(buffer_meta)		      \
   f(osd)			      \
+  f(osd_ec_read_cache)		      \
   f(osd_mapbl)			      \
   f(osd_pglog)			      \
   f(osdmap)			      \
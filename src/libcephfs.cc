@@ -528,6 +528,33 @@ extern "C" int ceph_readdirplus_r(struct ceph_mount_info *cmount, struct ceph_di
   return cmount->get_client()->readdirplus_r(reinterpret_cast<dir_result_t*>(dirp), de, stx, want, flags, out);
 }
 
+struct readdirplus_bulk_arg {
+  ceph_readdirplus_cb_t cb;
+  void *arg;
+};
+
+static int readdirplus_bulk_cb(void *p, struct dirent *de,
+			       struct ceph_statx *stx, off_t off, Inode *in)
+{
+  readdirplus_bulk_arg *a = static_cast<readdirplus_bulk_arg *>(p);
+  return a->cb(a->arg, de, stx);
+}
+
+extern "C" int ceph_readdirplus_bulk(struct ceph_mount_info *cmount,
+				     struct ceph_dir_result *dirp,
+				     ceph_readdirplus_cb_t cb, void *arg,
+				     unsigned want, unsigned flags)
+{
+  if (!cmount->is_mounted())
+    return -ENOTCONN;
+  if (flags & ~CEPH_REQ_FLAG_MASK)
+    return -EINVAL;
+  readdirplus_bulk_arg a = { cb, arg };
+  return cmount->get_client()->readdirplus_bulk(
+    reinterpret_cast<dir_result_t*>(dirp), readdirplus_bulk_cb, &a,
+    want, flags);
+}
+
 extern "C" int ceph_getdents(struct ceph_mount_info *cmount, struct ceph_dir_result *dirp,
 			     char *buf, int buflen)
 {
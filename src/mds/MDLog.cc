@@ -75,6 +75,12 @@ void MDLog::create_logger()
   plb.add_time_avg(l_mdl_jlat, "jlat", "Journaler flush latency");
 
   plb.add_u64_counter(l_mdl_replayed, "replayed", "Events replayed");
+  plb.add_u64_avg(l_mdl_batch_events, "batch_events",
+		  "Events per journal submit batch");
+  plb.add_u64_avg(l_mdl_batch_bytes, "batch_bytes",
+		  "Bytes per journal submit batch");
+  plb.add_time_avg(l_mdl_batch_wait, "batch_wait",
+		   "Time a submit batch waited for more events");
 
   // logger
   logger = plb.create_perf_counters();
@@ -344,6 +350,59 @@ public:
   }
 };
 
+/*
+ * Append one pending event (or flush marker/waiter) to the journal.
+ * Called from the submit thread without submit_mutex held.
+ */
+void MDLog::_write_event(const PendingEvent &data, int64_t features)
+{
+  if (data.le) {
+    LogEvent *le = data.le;
+    LogSegment *ls = le->_segment;
+    // encode it, with event type
+    bufferlist bl;
+    le->encode_with_header(bl, features);
+
+    uint64_t write_pos = journaler->get_write_pos();
+
+    le->set_start_off(write_pos);
+    if (le->get_type() == EVENT_SUBTREEMAP)
+      ls->offset = write_pos;
+
+    dout(5) << "_submit_thread " << write_pos << "~" << bl.length()
+	    << " : " << *le << dendl;
+
+    // journal it.
+    const uint64_t new_write_pos = journaler->append_entry(bl);  // bl is destroyed.
+    ls->end = new_write_pos;
+
+    MDSLogContextBase *fin;
+    if (data.fin) {
+      fin = dynamic_cast<MDSLogContextBase*>(data.fin);
+      assert(fin);
+      fin->set_write_pos(new_write_pos);
+    } else {
+      fin = new C_MDL_Flushed(this, new_write_pos);
+    }
+
+    journaler->wait_for_flush(fin);
+
+    if (logger)
+      logger->set(l_mdl_wrpos, ls->end);
+
+    delete le;
+  } else {
+    if (data.fin) {
+      MDSInternalContextBase* fin =
+	      dynamic_cast<MDSInternalContextBase*>(data.fin);
+      assert(fin);
+      C_MDL_Flushed *fin2 = new C_MDL_Flushed(this, fin);
+      fin2->set_write_pos(journaler->get_write_pos());
+      journaler->wait_for_flush(fin2);
+    }
+  }
+}
+
 void MDLog::_submit_thread()
 {
   dout(10) << "_submit_thread start" << dendl;
@@ -367,68 +426,66 @@ void MDLog::_submit_thread()
       continue;
     }
 
-    int64_t features = mdsmap_up_features;
-    PendingEvent data = it->second.front();
-    it->second.pop_front();
+    // group commit: take everything queued, up to
+    // mds_log_group_commit_max_events, and if somebody wants a flush
+    // give later events up to mds_log_group_commit_latency to join it.
+    // the (possibly emptied) lists stay in pending_events until the
+    // batch is journaled so trim() still sees their segments as busy.
+    uint64_t max_events = MAX(g_conf->mds_log_group_commit_max_events, 1);
+    double latency = g_conf->mds_log_group_commit_latency;
+    list<PendingEvent> batch;
+    uint64_t batch_events = 0;
+    bool want_flush = false;
+    utime_t batch_start = ceph_clock_now();
+    utime_t deadline = batch_start;
+    deadline += latency;
+    while (true) {
+      for (auto p = pending_events.begin();
+	   p != pending_events.end() && batch_events < max_events;
+	   ++p) {
+	while (!p->second.empty() && batch_events < max_events) {
+	  want_flush |= p->second.front().flush;
+	  batch.splice(batch.end(), p->second, p->second.begin());
+	  ++batch_events;
+	}
+      }
+      if (!want_flush || latency <= 0 || batch_events >= max_events ||
+	  mds->is_daemon_stopping() || ceph_clock_now() >= deadline)
+	break;
+      submit_cond.WaitUntil(submit_mutex, deadline);
+    }
 
+    int64_t features = mdsmap_up_features;
     submit_mutex.Unlock();
 
-    if (data.le) {
-      LogEvent *le = data.le;
-      LogSegment *ls = le->_segment;
-      // encode it, with event type
-      bufferlist bl;
-      le->encode_with_header(bl, features);
-
-      uint64_t write_pos = journaler->get_write_pos();
-
-      le->set_start_off(write_pos);
-      if (le->get_type() == EVENT_SUBTREEMAP)
-	ls->offset = write_pos;
-
-      dout(5) << "_submit_thread " << write_pos << "~" << bl.length()
-	      << " : " << *le << dendl;
-
-      // journal it.
-      const uint64_t new_write_pos = journaler->append_entry(bl);  // bl is destroyed.
-      ls->end = new_write_pos;
-
-      MDSLogContextBase *fin;
-      if (data.fin) {
-	fin = dynamic_cast<MDSLogContextBase*>(data.fin);
-	assert(fin);
-	fin->set_write_pos(new_write_pos);
-      } else {
-	fin = new C_MDL_Flushed(this, new_write_pos);
-      }
-
-      journaler->wait_for_flush(fin);
+    if (logger) {
+      logger->inc(l_mdl_batch_events, batch_events);
+      logger->tinc(l_mdl_batch_wait, ceph_clock_now() - batch_start);
+    }
 
-      if (data.flush)
-	journaler->flush();
+    uint64_t batch_start_pos = journaler->get_write_pos();
+    uint64_t batch_unflushed = 0;
+    for (auto& data : batch) {
+      _write_event(data, features);
+      if (data.le)
+	batch_unflushed++;
+    }
 
-      if (logger)
-	logger->set(l_mdl_wrpos, ls->end);
+    // one flush for the whole batch, covering every event in it
+    if (want_flush)
+      journaler->flush();
 
-      delete le;
-    } else {
-      if (data.fin) {
-	MDSInternalContextBase* fin =
-		dynamic_cast<MDSInternalContextBase*>(data.fin);
-	assert(fin);
-	C_MDL_Flushed *fin2 = new C_MDL_Flushed(this, fin);
-	fin2->set_write_pos(journaler->get_write_pos());
-	journaler->wait_for_flush(fin2);
-      }
-      if (data.flush)
-	journaler->flush();
-    }
+    if (logger)
+      logger->inc(l_mdl_batch_bytes,
+		  journaler->get_write_pos() - batch_start_pos);
 
     submit_mutex.Lock();
-    if (data.flush)
+    while (!pending_events.empty() && pending_events.begin()->second.empty())
+      pending_events.erase(pending_events.begin());
+    if (want_flush)
       unflushed = 0;
-    else if (data.le)
-      unflushed++;
+    else
+      unflushed += batch_unflushed;
   }
 
   submit_mutex.Unlock();
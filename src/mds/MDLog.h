@@ -35,6 +35,9 @@ enum {
   l_mdl_rdpos,
   l_mdl_jlat,
   l_mdl_replayed,
+  l_mdl_batch_events,
+  l_mdl_batch_bytes,
+  l_mdl_batch_wait,
   l_mdl_last,
 };
 
@@ -136,6 +139,7 @@ protected:
 
   int64_t mdsmap_up_features;
   map<uint64_t,list<PendingEvent> > pending_events; // log segment -> event list
+  void _write_event(const PendingEvent &data, int64_t features);
   Mutex submit_mutex;
   Cond submit_cond;
 
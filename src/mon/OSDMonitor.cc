@@ -487,8 +487,17 @@ void OSDMonitor::start_mapping()
   }
   if (!osdmap.get_pools().empty()) {
     auto fin = new C_UpdateCreatingPGs(this, osdmap.get_epoch());
-    mapping_job = mapping.start_update(osdmap, mapper,
-				       g_conf->mon_osd_mapping_pgs_per_chunk);
+    bufferlist inc_bl;
+    if (mapping.get_epoch() + 1 == osdmap.get_epoch() &&
+	get_version(osdmap.get_epoch(), inc_bl) == 0) {
+      // only remap the pgs the last incremental can have moved
+      OSDMap::Incremental inc(inc_bl);
+      mapping_job = mapping.start_update(osdmap, inc, mapper,
+					 g_conf->mon_osd_mapping_pgs_per_chunk);
+    } else {
+      mapping_job = mapping.start_update(osdmap, mapper,
+					 g_conf->mon_osd_mapping_pgs_per_chunk);
+    }
     dout(10) << __func__ << " started mapping job " << mapping_job.get()
 	     << " at " << fin->start << dendl;
     mapping_job->set_finish_event(fin);
@@ -956,7 +965,7 @@ void OSDMonitor::encode_pending(MonitorDBStore::TransactionRef t)
 	auto p = pool.first;
 	if (tmp.get_pg_pool(p)->has_flag(pg_pool_t::FLAG_NEARFULL) &&
 	    nearfull_pool_ids.empty()) {
-	  dout(10) << __func__ << " clearing pool '" << tmp.pool_name[p]
+	  dout(10) << __func__ << " clearing pool '" << tmp.get_pool_name(p)
 		   << "'s nearfull flag" << dendl;
 	  if (pending_inc.new_pools.count(p) == 0) {
 	    // load original pool info first!
@@ -966,7 +975,7 @@ void OSDMonitor::encode_pending(MonitorDBStore::TransactionRef t)
 	}
 	if (tmp.get_pg_pool(p)->has_flag(pg_pool_t::FLAG_BACKFILLFULL) &&
 	    backfillfull_pool_ids.empty()) {
-	  dout(10) << __func__ << " clearing pool '" << tmp.pool_name[p]
+	  dout(10) << __func__ << " clearing pool '" << tmp.get_pool_name(p)
 		   << "'s backfillfull flag" << dendl;
 	  if (pending_inc.new_pools.count(p) == 0) {
 	    pending_inc.new_pools[p] = pool.second;
@@ -979,7 +988,7 @@ void OSDMonitor::encode_pending(MonitorDBStore::TransactionRef t)
 	    // set by EQUOTA, skipping
 	    continue;
 	  }
-	  dout(10) << __func__ << " clearing pool '" << tmp.pool_name[p]
+	  dout(10) << __func__ << " clearing pool '" << tmp.get_pool_name(p)
 		   << "'s full flag" << dendl;
 	  if (pending_inc.new_pools.count(p) == 0) {
 	    pending_inc.new_pools[p] = pool.second;
@@ -996,7 +1005,7 @@ void OSDMonitor::encode_pending(MonitorDBStore::TransactionRef t)
 	  continue;
 	}
 	if (pending_inc.new_pools.count(p) == 0) {
-	  pending_inc.new_pools[p] = tmp.pools[p];
+	  pending_inc.new_pools[p] = *tmp.get_pg_pool(p);
 	}
 	pending_inc.new_pools[p].flags |= pg_pool_t::FLAG_FULL;
 	pending_inc.new_pools[p].flags &= ~pg_pool_t::FLAG_BACKFILLFULL;
@@ -1015,7 +1024,7 @@ void OSDMonitor::encode_pending(MonitorDBStore::TransactionRef t)
 	  // or is running out of quota (and hence considered as full)
 	  continue;
 	}
-	dout(10) << __func__ << " clearing pool '" << tmp.pool_name[p]
+	dout(10) << __func__ << " clearing pool '" << tmp.get_pool_name(p)
 		 << "'s full flag" << dendl;
 	if (pending_inc.new_pools.count(p) == 0) {
 	  pending_inc.new_pools[p] = pool.second;
@@ -1039,10 +1048,10 @@ void OSDMonitor::encode_pending(MonitorDBStore::TransactionRef t)
 	  // don't bother if pool is already marked as backfillfull
 	  continue;
 	}
-	dout(10) << __func__ << " marking pool '" << tmp.pool_name[p]
+	dout(10) << __func__ << " marking pool '" << tmp.get_pool_name(p)
 		 << "'s as backfillfull" << dendl;
 	if (pending_inc.new_pools.count(p) == 0) {
-	  pending_inc.new_pools[p] = tmp.pools[p];
+	  pending_inc.new_pools[p] = *tmp.get_pg_pool(p);
 	}
 	pending_inc.new_pools[p].flags |= pg_pool_t::FLAG_BACKFILLFULL;
 	pending_inc.new_pools[p].flags &= ~pg_pool_t::FLAG_NEARFULL;
@@ -1059,7 +1068,7 @@ void OSDMonitor::encode_pending(MonitorDBStore::TransactionRef t)
 	  // and don't touch if currently is not backfillfull
 	  continue;
 	}
-	dout(10) << __func__ << " clearing pool '" << tmp.pool_name[p]
+	dout(10) << __func__ << " clearing pool '" << tmp.get_pool_name(p)
 		 << "'s backfillfull flag" << dendl;
 	if (pending_inc.new_pools.count(p) == 0) {
 	  pending_inc.new_pools[p] = pool.second;
@@ -1082,10 +1091,10 @@ void OSDMonitor::encode_pending(MonitorDBStore::TransactionRef t)
 	  // don't bother if pool is already marked as nearfull
 	  continue;
 	}
-	dout(10) << __func__ << " marking pool '" << tmp.pool_name[p]
+	dout(10) << __func__ << " marking pool '" << tmp.get_pool_name(p)
 		 << "'s as nearfull" << dendl;
 	if (pending_inc.new_pools.count(p) == 0) {
-	  pending_inc.new_pools[p] = tmp.pools[p];
+	  pending_inc.new_pools[p] = *tmp.get_pg_pool(p);
 	}
 	pending_inc.new_pools[p].flags |= pg_pool_t::FLAG_NEARFULL;
       }
@@ -1104,7 +1113,7 @@ void OSDMonitor::encode_pending(MonitorDBStore::TransactionRef t)
 	  // and don't touch if currently is not nearfull
 	  continue;
 	}
-	dout(10) << __func__ << " clearing pool '" << tmp.pool_name[p]
+	dout(10) << __func__ << " clearing pool '" << tmp.get_pool_name(p)
 		 << "'s nearfull flag" << dendl;
 	if (pending_inc.new_pools.count(p) == 0) {
 	  pending_inc.new_pools[p] = pool.second;
@@ -2814,7 +2823,7 @@ bool OSDMonitor::prepare_remove_snaps(MonOpRequestRef op)
       continue;
     }
 
-    pg_pool_t& pi = osdmap.pools[p->first];
+    const pg_pool_t& pi = *osdmap.get_pg_pool(p->first);
     for (vector<snapid_t>::iterator q = p->second.begin();
 	 q != p->second.end();
 	 ++q) {
@@ -3485,7 +3494,8 @@ namespace {
     RECOVERY_PRIORITY, RECOVERY_OP_PRIORITY, SCRUB_PRIORITY,
     COMPRESSION_MODE, COMPRESSION_ALGORITHM, COMPRESSION_REQUIRED_RATIO,
     COMPRESSION_MAX_BLOB_SIZE, COMPRESSION_MIN_BLOB_SIZE,
-    CSUM_TYPE, CSUM_MAX_BLOCK, CSUM_MIN_BLOCK };
+    CSUM_TYPE, CSUM_MAX_BLOCK, CSUM_MIN_BLOCK,
+    QOS_RES, QOS_WGT, QOS_LIM };
 
   std::set<osd_pool_get_choices>
     subtract_second_from_first(const std::set<osd_pool_get_choices>& first,
@@ -3939,17 +3949,17 @@ bool OSDMonitor::preprocess_command(MonOpRequestRef op)
     cmd_getval(cct, cmdmap, "auid", auid, int64_t(0));
     if (f)
       f->open_array_section("pools");
-    for (map<int64_t, pg_pool_t>::iterator p = osdmap.pools.begin();
-	 p != osdmap.pools.end();
+    for (auto p = osdmap.pools->begin();
+	 p != osdmap.pools->end();
 	 ++p) {
       if (!auid || p->second.auid == (uint64_t)auid) {
 	if (f) {
 	  f->open_object_section("pool");
 	  f->dump_int("poolnum", p->first);
-	  f->dump_string("poolname", osdmap.pool_name[p->first]);
+	  f->dump_string("poolname", osdmap.get_pool_name(p->first));
 	  f->close_section();
 	} else {
-	  ds << p->first << ' ' << osdmap.pool_name[p->first] << ',';
+	  ds << p->first << ' ' << osdmap.get_pool_name(p->first) << ',';
 	}
       }
     }
@@ -4095,6 +4105,9 @@ bool OSDMonitor::preprocess_command(MonOpRequestRef op)
       {"csum_type", CSUM_TYPE},
       {"csum_max_block", CSUM_MAX_BLOCK},
       {"csum_min_block", CSUM_MIN_BLOCK},
+      {"qos_res", QOS_RES},
+      {"qos_wgt", QOS_WGT},
+      {"qos_lim", QOS_LIM},
     };
 
     typedef std::set<osd_pool_get_choices> choices_set_t;
@@ -4301,6 +4314,9 @@ bool OSDMonitor::preprocess_command(MonOpRequestRef op)
 	  case CSUM_TYPE:
 	  case CSUM_MAX_BLOCK:
 	  case CSUM_MIN_BLOCK:
+	  case QOS_RES:
+	  case QOS_WGT:
+	  case QOS_LIM:
             pool_opts_t::key_t key = pool_opts_t::get_opt_desc(i->first).key;
             if (p->opts.is_set(key)) {
               f->open_object_section("pool");
@@ -4459,6 +4475,9 @@ bool OSDMonitor::preprocess_command(MonOpRequestRef op)
 	  case CSUM_TYPE:
 	  case CSUM_MAX_BLOCK:
 	  case CSUM_MIN_BLOCK:
+	  case QOS_RES:
+	  case QOS_WGT:
+	  case QOS_LIM:
 	    for (i = ALL_CHOICES.begin(); i != ALL_CHOICES.end(); ++i) {
 	      if (i->second == *it)
 		break;
@@ -4778,10 +4797,10 @@ bool OSDMonitor::preprocess_command(MonOpRequestRef op)
     if (pool_name.empty()) {
       // all
       f->open_object_section("pools");
-      for (const auto &pool : osdmap.pools) {
+      for (const auto &pool : *osdmap.pools) {
         std::string name("<unknown>");
-        const auto &pni = osdmap.pool_name.find(pool.first);
-        if (pni != osdmap.pool_name.end())
+        const auto &pni = osdmap.pool_name->find(pool.first);
+        if (pni != osdmap.pool_name->end())
           name = pni->second;
         f->open_object_section(name.c_str());
         for (auto &app_pair : pool.second.application_metadata) {
@@ -5208,7 +5227,7 @@ bool OSDMonitor::erasure_code_profile_in_use(
        p != pools.end();
        ++p) {
     if (p->second.erasure_code_profile == profile) {
-      *ss << osdmap.pool_name[p->first] << " ";
+      *ss << osdmap.get_pool_name(p->first) << " ";
       found = true;
     }
   }
@@ -6091,6 +6110,17 @@ int OSDMonitor::prepare_command_pool_set(map<string,cmd_vartype> &cmdmap,
         ss << "error parsing int value '" << val << "': " << interr;
         return -EINVAL;
       }
+    } else if (var == "qos_res" ||
+               var == "qos_wgt" ||
+               var == "qos_lim") {
+      if (floaterr.length()) {
+        ss << "error parsing float value '" << val << "': " << floaterr;
+        return -EINVAL;
+      }
+      if (f < 0) {
+        ss << var << " must be >= 0: '" << val << "'";
+        return -EINVAL;
+      }
     }
 
     pool_opts_t::opt_desc_t desc = pool_opts_t::get_opt_desc(var);
@@ -8083,7 +8113,7 @@ bool OSDMonitor::prepare_command_impl(MonOpRequestRef op,
     if (erasure_code_profile_in_use(pending_inc.new_pools, name, &ss))
       goto wait;
 
-    if (erasure_code_profile_in_use(osdmap.pools, name, &ss)) {
+    if (erasure_code_profile_in_use(*osdmap.pools, name, &ss)) {
       err = -EBUSY;
       goto reply;
     }
@@ -11148,7 +11178,7 @@ int OSDMonitor::_prepare_remove_pool(
     }
   }
   // remove any pg_upmap mappings for this pool
-  for (auto& p : osdmap.pg_upmap) {
+  for (auto& p : *osdmap.pg_upmap) {
     if (p.first.pool() == (uint64_t)pool) {
       dout(10) << __func__ << " " << pool
                << " removing obsolete pg_upmap "
@@ -11157,7 +11187,7 @@ int OSDMonitor::_prepare_remove_pool(
     }
   }
   // remove any pg_upmap_items mappings for this pool
-  for (auto& p : osdmap.pg_upmap_items) {
+  for (auto& p : *osdmap.pg_upmap_items) {
     if (p.first.pool() == (uint64_t)pool) {
       dout(10) << __func__ << " " << pool
                << " removing obsolete pg_upmap_items " << p.first
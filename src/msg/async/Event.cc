@@ -15,6 +15,7 @@
  */
 
 #include "common/errno.h"
+#include "common/perf_counters.h"
 #include "Event.h"
 
 #ifdef HAVE_DPDK
@@ -136,6 +137,7 @@ int EventCenter::init(int n, unsigned i, const std::string &t)
 
   file_events.resize(n);
   nevent = n;
+  set_busy_poll(cct->_conf->ms_async_busy_poll_us);
 
   if (!driver->need_wakeup())
     return 0;
@@ -365,7 +367,14 @@ int EventCenter::process_events(int timeout_microseconds,  ceph::timespan *worki
   auto now = clock_type::now();
 
   auto it = time_events.begin();
-  bool blocking = pollers.empty() && !external_num_events.load();
+  bool spin = false;
+  if (busy_poll_dur != ceph::timespan::zero()) {
+    // clear busy_polling before looking at external_num_events, so an
+    // external thread either sees us spinning or its event is counted
+    spin = ceph::mono_clock::now() < busy_poll_until;
+    busy_polling.store(spin);
+  }
+  bool blocking = !spin && pollers.empty() && !external_num_events.load();
   // If exists external events or poller, don't block
   if (!blocking) {
     if (it != time_events.end() && now >= it->first)
@@ -429,7 +438,13 @@ int EventCenter::process_events(int timeout_microseconds,  ceph::timespan *worki
     deque<EventCallbackRef> cur_process;
     cur_process.swap(external_events);
     external_num_events.store(0);
+    auto stamp = external_first_stamp;
     external_lock.unlock();
+    if (logger)
+      logger->hinc(l_external_lat_hist,
+                   std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     ceph::mono_clock::now() - stamp).count(),
+                   cur_process.size());
     while (!cur_process.empty()) {
       EventCallbackRef e = cur_process.front();
       ldout(cct, 30) << __func__ << " do " << e << dendl;
@@ -444,8 +459,13 @@ int EventCenter::process_events(int timeout_microseconds,  ceph::timespan *worki
       numevents += pollers[i]->poll();
   }
 
-  if (working_dur)
-    *working_dur = ceph::mono_clock::now() - working_start;
+  if (working_dur || (numevents && busy_poll_dur != ceph::timespan::zero())) {
+    auto working_end = ceph::mono_clock::now();
+    if (working_dur)
+      *working_dur = working_end - working_start;
+    if (numevents)
+      busy_poll_until = working_end + busy_poll_dur;
+  }
   return numevents;
 }
 
@@ -454,9 +474,12 @@ void EventCenter::dispatch_event_external(EventCallbackRef e)
   external_lock.lock();
   external_events.push_back(e);
   bool wake = !external_num_events.load();
+  if (wake && logger)
+    external_first_stamp = ceph::mono_clock::now();
   uint64_t num = ++external_num_events;
   external_lock.unlock();
-  if (!in_thread() && wake)
+  // a spinning center will find the event without being woken
+  if (!in_thread() && wake && !busy_polling.load())
     wakeup();
 
   ldout(cct, 30) << __func__ << " " << e << " pending " << num << dendl;
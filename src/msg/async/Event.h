@@ -50,6 +50,7 @@
 #define EVENT_WRITABLE 2
 
 class EventCenter;
+class PerfCounters;
 
 class EventCallback {
 
@@ -175,6 +176,18 @@ class EventCenter {
   unsigned idx;
   AssociatedCenters *global_centers = nullptr;
 
+  // adaptive busy polling: after doing some work, keep polling the
+  // driver without blocking for busy_poll_us before going back to sleep
+  ceph::timespan busy_poll_dur = ceph::timespan::zero();
+  ceph::mono_clock::time_point busy_poll_until;
+  // set while spinning, so external threads can skip the notify pipe
+  std::atomic_bool busy_polling = {false};
+
+  // histogram of how long external events wait to be picked up
+  PerfCounters *logger = nullptr;
+  int l_external_lat_hist = -1;
+  ceph::mono_clock::time_point external_first_stamp;
+
   int process_time_events();
   FileEvent *_get_file_event(int fd) {
     assert(fd < nevent);
@@ -197,6 +210,14 @@ class EventCenter {
   unsigned get_id() const { return idx; }
 
   EventDriver *get_driver() { return driver; }
+  void set_busy_poll(uint64_t us) {
+    busy_poll_dur = std::chrono::microseconds(us);
+  }
+  /// report external event wakeup latency to the given 2d histogram
+  void set_perf_counters(PerfCounters *l, int external_lat_hist) {
+    logger = l;
+    l_external_lat_hist = external_lat_hist;
+  }
 
   // Used by internal thread
   int create_file_event(int fd, int mask, EventCallbackRef ctxt);
@@ -19,8 +19,12 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
 
 #include <algorithm>
+#include <deque>
 
 #include "PosixStack.h"
 
@@ -36,15 +40,154 @@
 #undef dout_prefix
 #define dout_prefix *_dout << "PosixStack "
 
+// MSG_ZEROCOPY needs linux >= 4.14 headers (and kernel, checked at runtime)
+#if defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define CEPH_HAVE_MSG_ZEROCOPY
+#endif
+
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+/// MSG_ZEROCOPY sends on one socket: the data stays here while the kernel
+/// may still read it, until it reports through the socket's error queue
+/// that sendmsg calls [first, last] are done with
+class PosixZeroCopySends {
+  struct pending_t {
+    uint32_t first, last;
+    uint32_t completed = 0;
+    bufferlist bl;
+    pending_t(uint32_t f, uint32_t l, bufferlist&& b)
+      : first(f), last(l), bl(std::move(b)) {}
+  };
+  std::deque<pending_t> pending;
+  /// the kernel numbers successful MSG_ZEROCOPY sendmsg calls from 0
+  uint32_t next_seq = 0;
+  PerfCounters *logger;
+
+  void complete(uint32_t lo, uint32_t hi) {
+    // sequence numbers wrap; compare offsets from each entry's first call
+    for (auto& p : pending) {
+      int32_t n = p.last - p.first + 1;
+      int32_t s = lo - p.first;
+      int32_t e = hi - p.first;
+      if (s < 0)
+        s = 0;
+      if (e >= n)
+        e = n - 1;
+      if (e >= s)
+        p.completed += e - s + 1;
+    }
+    while (!pending.empty() &&
+           pending.front().completed ==
+             pending.front().last - pending.front().first + 1) {
+      pending.pop_front();
+    }
+  }
+
+ public:
+  explicit PosixZeroCopySends(PerfCounters *l) : logger(l) {}
+
+  bool empty() const {
+    return pending.empty();
+  }
+  size_t size() const {
+    return pending.size();
+  }
+  void add(uint32_t calls, bufferlist&& bl) {
+    pending.emplace_back(next_seq, next_seq + calls - 1, std::move(bl));
+    next_seq += calls;
+  }
+  /// hand the data back to the kernel's care for good; only for when
+  /// we can no longer wait for it (the worker is going away)
+  void leak() {
+    for (auto& p : pending)
+      new bufferlist(std::move(p.bl));
+    pending.clear();
+  }
+
+  // drain completion notifications from fd's error queue
+  void reap(int fd) {
+    while (true) {
+      char control[CMSG_SPACE(sizeof(struct sock_extended_err)) +
+                   CMSG_SPACE(sizeof(struct sockaddr_in6))];
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      if (::recvmsg(fd, &msg, MSG_ERRQUEUE) < 0)
+        break;
+      for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm;
+           cm = CMSG_NXTHDR(&msg, cm)) {
+        if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+            !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+          continue;
+        struct sock_extended_err *serr =
+          reinterpret_cast<struct sock_extended_err*>(CMSG_DATA(cm));
+        if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+          continue;
+        if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+          logger->inc(l_msgr_send_zerocopy_copied, serr->ee_data - serr->ee_info + 1);
+        complete(serr->ee_info, serr->ee_data);
+      }
+    }
+  }
+};
+
+// the worker's event loop reaps closed sockets' zero-copy completions
+class C_zerocopy_reap : public EventCallback {
+  PosixWorker *worker;
+
+ public:
+  explicit C_zerocopy_reap(PosixWorker *w) : worker(w) {}
+  void do_request(uint64_t fd) override {
+    worker->reap_closed(fd);
+  }
+};
+
+class C_zerocopy_timeout : public EventCallback {
+  PosixWorker *worker;
+
+ public:
+  explicit C_zerocopy_timeout(PosixWorker *w) : worker(w) {}
+  void do_request(uint64_t id) override {
+    worker->abort_stuck_closed();
+  }
+};
+#else
+class PosixZeroCopySends {};
+#endif
+
 class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   NetHandler &handler;
   int _fd;
   entity_addr_t sa;
   bool connected;
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+  PosixWorker *worker;
+  PerfCounters *logger;
+  /// sends at least this big use MSG_ZEROCOPY; 0 if disabled on this socket
+  uint64_t zerocopy_min_bytes = 0;
+  std::unique_ptr<PosixZeroCopySends> zerocopy_sends;
+#endif
 
  public:
-  explicit PosixConnectedSocketImpl(NetHandler &h, const entity_addr_t &sa, int f, bool connected)
-      : handler(h), _fd(f), sa(sa), connected(connected) {}
+  explicit PosixConnectedSocketImpl(NetHandler &h, const entity_addr_t &sa, int f, bool connected,
+                                    Worker *w)
+      : handler(h), _fd(f), sa(sa), connected(connected) {
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+    worker = static_cast<PosixWorker*>(w);
+    logger = w->get_perf_counter();
+    if (w->cct->_conf->ms_async_send_zerocopy) {
+      int on = 1;
+      if (::setsockopt(_fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == 0) {
+        zerocopy_min_bytes = std::max<uint64_t>(
+          1, w->cct->_conf->ms_async_send_zerocopy_min_bytes);
+        zerocopy_sends.reset(new PosixZeroCopySends(logger));
+      } else {
+        ldout(w->cct, 10) << __func__ << " SO_ZEROCOPY not supported: "
+                          << cpp_strerror(errno) << dendl;
+      }
+    }
+#endif
+  }
 
   int is_connected() override {
     if (connected)
@@ -66,6 +209,11 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   }
 
   ssize_t read(char *buf, size_t len) override {
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+    // completions raise EPOLLERR, which lands here
+    if (zerocopy_sends && !zerocopy_sends->empty())
+      zerocopy_sends->reap(_fd);
+#endif
     ssize_t r = ::read(_fd, buf, len);
     if (r < 0)
       r = -errno;
@@ -74,21 +222,36 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
 
   // return the sent length
   // < 0 means error occured
-  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more)
+  // *zerocopy requests MSG_ZEROCOPY; it is cleared if the kernel can't
+  // take any more zero-copy sends right now, and every successful
+  // zero-copy call is counted in *zerocopy_calls
+  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more,
+                            bool *zerocopy, uint32_t *zerocopy_calls)
   {
     size_t sent = 0;
     while (1) {
       MSGR_SIGPIPE_STOPPER;
       ssize_t r;
-      r = ::sendmsg(fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+      int flags = MSG_NOSIGNAL | (more ? MSG_MORE : 0);
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+      if (*zerocopy)
+        flags |= MSG_ZEROCOPY;
+#endif
+      r = ::sendmsg(fd, &msg, flags);
       if (r < 0) {
         if (errno == EINTR) {
           continue;
         } else if (errno == EAGAIN) {
           break;
+        } else if (errno == ENOBUFS && *zerocopy) {
+          // too many notifications outstanding (optmem); copy instead
+          *zerocopy = false;
+          continue;
         }
         return -errno;
       }
+      if (*zerocopy)
+        ++*zerocopy_calls;
 
       sent += r;
       if (len == sent) break;
@@ -110,6 +273,14 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   }
 
   ssize_t send(bufferlist &bl, bool more) override {
+    bool zerocopy = false;
+    uint32_t zerocopy_calls = 0;
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+    if (zerocopy_sends && !zerocopy_sends->empty())
+      zerocopy_sends->reap(_fd);
+    zerocopy = zerocopy_min_bytes && bl.length() >= zerocopy_min_bytes;
+    bool wanted_zerocopy = zerocopy;
+#endif
     size_t sent_bytes = 0;
     std::list<bufferptr>::const_iterator pb = bl.buffers().begin();
     uint64_t left_pbrs = bl.buffers().size();
@@ -131,7 +302,8 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
         size--;
       }
 
-      ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more);
+      ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more,
+                             &zerocopy, &zerocopy_calls);
       if (r < 0)
         return r;
 
@@ -148,9 +320,22 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
         bl.splice(sent_bytes, bl.length()-sent_bytes, &swapped);
         bl.swap(swapped);
       } else {
-        bl.clear();
+        bl.swap(swapped);
       }
+      // swapped now holds what went out
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+      if (zerocopy_calls) {
+        // the kernel still points at these pages
+        zerocopy_sends->add(zerocopy_calls, std::move(swapped));
+        logger->inc(l_msgr_send_zerocopy);
+        logger->inc(l_msgr_send_zerocopy_bytes, sent_bytes);
+      }
+#endif
     }
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+    if (wanted_zerocopy && !zerocopy)
+      logger->inc(l_msgr_send_zerocopy_fallback);
+#endif
 
     return static_cast<ssize_t>(sent_bytes);
   }
@@ -158,6 +343,17 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
     ::shutdown(_fd, SHUT_RDWR);
   }
   void close() override {
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+    if (zerocopy_sends && !zerocopy_sends->empty()) {
+      zerocopy_sends->reap(_fd);
+      if (!zerocopy_sends->empty()) {
+        // only this fd's error queue tells us when the kernel is done
+        // with the pages, so the worker keeps it open until then
+        worker->close_after_zerocopy(_fd, std::move(zerocopy_sends));
+        return;
+      }
+    }
+#endif
     ::close(_fd);
   }
   int fd() const override {
@@ -209,7 +405,7 @@ int PosixServerSocketImpl::accept(ConnectedSocket *sock, const SocketOptions &op
   out->set_sockaddr((sockaddr*)&ss);
   handler.set_priority(sd, opt.priority, out->get_family());
 
-  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(handler, *out, sd, true));
+  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(handler, *out, sd, true, w));
   *sock = ConnectedSocket(std::move(csi));
   return 0;
 }
@@ -218,6 +414,101 @@ void PosixWorker::initialize()
 {
 }
 
+PosixWorker::PosixWorker(CephContext *c, unsigned i)
+  : Worker(c, i), net(c)
+{
+}
+
+PosixWorker::~PosixWorker()
+{
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+  for (auto& p : zerocopy_closing) {
+    p.second.sends->reap(p.first);
+    if (!p.second.sends->empty()) {
+      // the event loop is gone; don't hand back memory the kernel may
+      // still read
+      lderr(cct) << __func__ << " fd " << p.first << " leaking "
+                 << p.second.sends->size()
+                 << " zero-copy sends the kernel has not released" << dendl;
+      p.second.sends->leak();
+    }
+    ::close(p.first);
+  }
+  delete zerocopy_reaper;
+  delete zerocopy_timeout;
+#endif
+}
+
+#ifdef CEPH_HAVE_MSG_ZEROCOPY
+void PosixWorker::close_after_zerocopy(int fd,
+                                       std::unique_ptr<PosixZeroCopySends> sends)
+{
+  if (!center.in_thread()) {
+    PosixZeroCopySends *s = sends.release();
+    center.submit_to(center.get_id(), [this, fd, s]() {
+        close_after_zerocopy(fd, std::unique_ptr<PosixZeroCopySends>(s));
+      }, true);
+    return;
+  }
+
+  ldout(cct, 10) << __func__ << " fd " << fd << " waits for " << sends->size()
+                 << " zero-copy sends" << dendl;
+  // what close() would do, minus the reset if there is unread data
+  ::shutdown(fd, SHUT_RDWR);
+  if (!zerocopy_reaper) {
+    zerocopy_reaper = new C_zerocopy_reap(this);
+    zerocopy_timeout = new C_zerocopy_timeout(this);
+  }
+  closing_t& c = zerocopy_closing[fd];
+  c.sends = std::move(sends);
+  c.deadline = ceph::mono_clock::now() +
+    std::chrono::seconds(cct->_conf->ms_tcp_read_timeout);
+  // completions raise EPOLLERR, which is reported whatever the mask
+  center.create_file_event(fd, EVENT_READABLE, zerocopy_reaper);
+  if (!zerocopy_timer_id)
+    zerocopy_timer_id = center.create_time_event(
+      cct->_conf->ms_tcp_read_timeout * 1000000ull, zerocopy_timeout);
+}
+
+void PosixWorker::reap_closed(int fd)
+{
+  auto it = zerocopy_closing.find(fd);
+  if (it == zerocopy_closing.end())
+    return;
+  it->second.sends->reap(fd);
+  if (!it->second.sends->empty())
+    return;
+  ldout(cct, 10) << __func__ << " fd " << fd << " zero-copy sends released"
+                 << dendl;
+  center.delete_file_event(fd, EVENT_READABLE);
+  ::close(fd);
+  zerocopy_closing.erase(it);
+}
+
+void PosixWorker::abort_stuck_closed()
+{
+  zerocopy_timer_id = 0;
+  auto now = ceph::mono_clock::now();
+  for (auto& p : zerocopy_closing) {
+    if (p.second.deadline > now || p.second.aborted)
+      continue;
+    // the peer stopped taking data.  resetting the connection frees what
+    // the kernel still holds, and the completions follow.
+    ldout(cct, 1) << __func__ << " fd " << p.first << " still has "
+                  << p.second.sends->size()
+                  << " zero-copy sends, resetting the connection" << dendl;
+    struct sockaddr unspec;
+    memset(&unspec, 0, sizeof(unspec));
+    unspec.sa_family = AF_UNSPEC;
+    ::connect(p.first, &unspec, sizeof(unspec));
+    p.second.aborted = true;
+  }
+  if (!zerocopy_closing.empty())
+    zerocopy_timer_id = center.create_time_event(
+      cct->_conf->ms_tcp_read_timeout * 1000000ull, zerocopy_timeout);
+}
+#endif
+
 int PosixWorker::listen(entity_addr_t &sa, const SocketOptions &opt,
                         ServerSocket *sock)
 {
@@ -277,7 +568,7 @@ int PosixWorker::connect(const entity_addr_t &addr, const SocketOptions &opts, C
 
   net.set_priority(sd, opts.priority, addr.get_family());
   *socket = ConnectedSocket(
-      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock)));
+      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock, this)));
   return 0;
 }
 
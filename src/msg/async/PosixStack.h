@@ -17,6 +17,8 @@
 #ifndef CEPH_MSG_ASYNC_POSIXSTACK_H
 #define CEPH_MSG_ASYNC_POSIXSTACK_H
 
+#include <map>
+#include <memory>
 #include <thread>
 
 #include "msg/msg_types.h"
@@ -24,15 +26,34 @@
 
 #include "Stack.h"
 
+class PosixZeroCopySends;
+
 class PosixWorker : public Worker {
   NetHandler net;
+
+  /// closed sockets the kernel still has MSG_ZEROCOPY data queued on; the
+  /// fd stays open until its error queue reports the data released
+  struct closing_t {
+    std::unique_ptr<PosixZeroCopySends> sends;
+    ceph::mono_time deadline;
+    bool aborted = false;
+  };
+  std::map<int, closing_t> zerocopy_closing;
+  EventCallbackRef zerocopy_reaper = nullptr;
+  EventCallbackRef zerocopy_timeout = nullptr;
+  uint64_t zerocopy_timer_id = 0;
+
   void initialize() override;
  public:
-  PosixWorker(CephContext *c, unsigned i)
-      : Worker(c, i), net(c) {}
+  PosixWorker(CephContext *c, unsigned i);
+  ~PosixWorker() override;
   int listen(entity_addr_t &sa, const SocketOptions &opt,
                      ServerSocket *socks) override;
   int connect(const entity_addr_t &addr, const SocketOptions &opts, ConnectedSocket *socket) override;
+
+  void close_after_zerocopy(int fd, std::unique_ptr<PosixZeroCopySends> sends);
+  void reap_closed(int fd);
+  void abort_stuck_closed();
 };
 
 class PosixNetworkStack : public NetworkStack {
@@ -198,6 +198,13 @@ enum {
   l_msgr_running_recv_time,
   l_msgr_running_fast_dispatch_time,
 
+  l_msgr_send_zerocopy,
+  l_msgr_send_zerocopy_bytes,
+  l_msgr_send_zerocopy_copied,
+  l_msgr_send_zerocopy_fallback,
+
+  l_msgr_external_event_lat_hist,
+
   l_msgr_last,
 };
 
@@ -238,8 +245,33 @@ class Worker {
     plb.add_time(l_msgr_running_recv_time, "msgr_running_recv_time", "The total time of message receiving");
     plb.add_time(l_msgr_running_fast_dispatch_time, "msgr_running_fast_dispatch_time", "The total time of fast dispatch");
 
+    plb.add_u64_counter(l_msgr_send_zerocopy, "msgr_send_zerocopy", "Sends that used MSG_ZEROCOPY");
+    plb.add_u64_counter(l_msgr_send_zerocopy_bytes, "msgr_send_zerocopy_bytes", "Bytes sent with MSG_ZEROCOPY");
+    plb.add_u64_counter(l_msgr_send_zerocopy_copied, "msgr_send_zerocopy_copied", "MSG_ZEROCOPY sendmsg calls the kernel copied anyway");
+    plb.add_u64_counter(l_msgr_send_zerocopy_fallback, "msgr_send_zerocopy_fallback", "Zero-copy sends that fell back to copying (ENOBUFS)");
+
+    PerfHistogramCommon::axis_config_d lat_x_axis_config{
+      "Latency (usec)",
+      PerfHistogramCommon::SCALE_LOG2,
+      0,
+      1000,                        ///< 1usec quantization
+      24,
+    };
+    PerfHistogramCommon::axis_config_d batch_y_axis_config{
+      "Events",
+      PerfHistogramCommon::SCALE_LOG2,
+      0,
+      1,
+      12,
+    };
+    plb.add_u64_counter_histogram(
+      l_msgr_external_event_lat_hist, "msgr_external_event_latency_histogram",
+      lat_x_axis_config, batch_y_axis_config,
+      "Histogram of time from queueing an external event to the worker running it + events run together");
+
     perf_logger = plb.create_perf_counters();
     cct->get_perfcounters_collection()->add(perf_logger);
+    center.set_perf_counters(perf_logger, l_msgr_external_event_lat_hist);
   }
   virtual ~Worker() {
     if (perf_logger) {
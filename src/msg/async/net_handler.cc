@@ -118,6 +118,19 @@ int NetHandler::set_socket_options(int sd, bool nodelay, int size)
     }
   }
 
+#ifdef SO_BUSY_POLL
+  if (cct->_conf->ms_async_busy_poll_us) {
+    // let the kernel poll the device queue on blocking reads/epoll; raising
+    // it above net.core.busy_read needs CAP_NET_ADMIN
+    int us = cct->_conf->ms_async_busy_poll_us;
+    r = ::setsockopt(sd, SOL_SOCKET, SO_BUSY_POLL, (void*)&us, sizeof(us));
+    if (r < 0) {
+      r = errno;
+      ldout(cct, 1) << "couldn't set SO_BUSY_POLL to " << us << ": " << cpp_strerror(r) << dendl;
+    }
+  }
+#endif
+
   // block ESIGPIPE
 #ifdef CEPH_USE_SO_NOSIGPIPE
   int val = 1;
@@ -52,6 +52,15 @@ public:
 
   virtual uint64_t get_free() = 0;
 
+  /*
+   * Score how scattered the free space is, from 0.0 (one contiguous
+   * extent) to 1.0 (every alloc_unit-sized free block is on its own).
+   * Allocators that don't track it report 0.
+   */
+  virtual double get_fragmentation(uint64_t alloc_unit) {
+    return 0.0;
+  }
+
   virtual void shutdown() = 0;
   static Allocator *create(CephContext* cct, string type, int64_t size,
 			   int64_t block_size);
@@ -776,6 +776,8 @@ BlueStore::Cache *BlueStore::Cache::create(CephContext* cct, string type,
     c = new LRUCache(cct);
   else if (type == "2q")
     c = new TwoQCache(cct);
+  else if (type == "clock")
+    c = new ClockCache(cct);
   else
     assert(0 == "unrecognized cache type");
 
@@ -1272,6 +1274,107 @@ void BlueStore::TwoQCache::_audit(const char *when)
 #endif
 
 
+// ClockCache
+#undef dout_prefix
+#define dout_prefix *_dout << "bluestore.ClockCache(" << this << ") "
+
+void BlueStore::ClockCache::_trim(uint64_t onode_max, uint64_t buffer_max)
+{
+  dout(20) << __func__ << " onodes " << onode_ring.size() << " / " << onode_max
+	   << " buffers " << buffer_size << " / " << buffer_max
+	   << dendl;
+
+  _audit("trim start");
+
+  // buffers.  each referenced buffer we pass gets its bit cleared and
+  // is moved behind the hand, so two full sweeps always suffice.
+  size_t max_steps = 2 * buffer_ring.size();
+  while (buffer_size > buffer_max && max_steps-- > 0) {
+    auto i = buffer_ring.begin();
+    if (i == buffer_ring.end()) {
+      // stop if buffer_ring is now empty
+      break;
+    }
+
+    Buffer *b = &*i;
+    assert(b->is_clean());
+    if (b->cache_private == BUFFER_REFERENCED) {
+      b->cache_private = BUFFER_UNREFERENCED;
+      buffer_ring.erase(i);
+      buffer_ring.push_back(*b);
+      continue;
+    }
+    dout(20) << __func__ << " rm " << *b << dendl;
+    b->space->_rm_buffer(this, b);
+  }
+
+  // onodes
+  int num = onode_ring.size() - onode_max;
+  if (num <= 0)
+    return; // don't even try
+
+  int skipped = 0;
+  int max_skipped = g_conf->bluestore_cache_trim_max_skip_pinned;
+  max_steps = 2 * onode_ring.size();
+  while (num > 0 && max_steps-- > 0) {
+    auto p = onode_ring.begin();
+    assert(p != onode_ring.end());
+    Onode *o = &*p;
+    int refs = o->nref.load();
+    if (refs > 1) {
+      dout(20) << __func__ << "  " << o->oid << " has " << refs
+	       << " refs, skipping" << dendl;
+      if (++skipped >= max_skipped) {
+        dout(20) << __func__ << " maximum skip pinned reached; stopping with "
+                 << num << " left to trim" << dendl;
+        break;
+      }
+      onode_ring.erase(p);
+      onode_ring.push_back(*o);
+      num--;
+      continue;
+    }
+    if (o->cache_ref.exchange(false, std::memory_order_relaxed)) {
+      // second chance
+      onode_ring.erase(p);
+      onode_ring.push_back(*o);
+      continue;
+    }
+    // lookups do not take our lock, so one may have pinned o since we
+    // looked at nref; recheck under the map lock
+    o->get();  // paranoia
+    if (!o->c->onode_map.remove_if_unreferenced(o, 1)) {
+      dout(20) << __func__ << "  " << o->oid << " raced with lookup" << dendl;
+      onode_ring.erase(p);
+      onode_ring.push_back(*o);
+      o->put();
+      continue;
+    }
+    dout(30) << __func__ << "  rm " << o->oid << dendl;
+    onode_ring.erase(p);
+    o->put();
+    --num;
+  }
+}
+
+#ifdef DEBUG_CACHE
+void BlueStore::ClockCache::_audit(const char *when)
+{
+  dout(10) << __func__ << " " << when << " start" << dendl;
+  uint64_t s = 0;
+  for (auto i = buffer_ring.begin(); i != buffer_ring.end(); ++i) {
+    s += i->length;
+  }
+  if (s != buffer_size) {
+    derr << __func__ << " buffer_size " << buffer_size << " actual " << s
+	 << dendl;
+    assert(s == buffer_size);
+  }
+  dout(20) << __func__ << " " << when << " buffer_size " << buffer_size
+	   << " ok" << dendl;
+}
+#endif
+
 // BufferSpace
 
 #undef dout_prefix
@@ -1517,6 +1620,7 @@ void BlueStore::BufferSpace::split(Cache* cache, size_t pos, BlueStore::BufferSp
 BlueStore::OnodeRef BlueStore::OnodeSpace::add(const ghobject_t& oid, OnodeRef o)
 {
   std::lock_guard<std::recursive_mutex> l(cache->lock);
+  RWLock::WLocker ml(map_lock);
   auto p = onode_map.find(oid);
   if (p != onode_map.end()) {
     ldout(cache->cct, 30) << __func__ << " " << oid << " " << o
@@ -1535,22 +1639,31 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
   ldout(cache->cct, 30) << __func__ << dendl;
   OnodeRef o;
   bool hit = false;
+  bool lockless_touch = cache->touch_onode_lockless();
 
   {
-    std::lock_guard<std::recursive_mutex> l(cache->lock);
+    // a cache that can be touched locklessly evicts via
+    // remove_if_unreferenced(), so a hit only needs the map lock
+    std::unique_lock<std::recursive_mutex> l(cache->lock, std::defer_lock);
+    if (!lockless_touch)
+      l.lock();
+    RWLock::RLocker ml(map_lock);
     ceph::unordered_map<ghobject_t,OnodeRef>::iterator p = onode_map.find(oid);
     if (p == onode_map.end()) {
       ldout(cache->cct, 30) << __func__ << " " << oid << " miss" << dendl;
     } else {
       ldout(cache->cct, 30) << __func__ << " " << oid << " hit " << p->second
 			    << dendl;
-      cache->_touch_onode(p->second);
+      if (!lockless_touch)
+	cache->_touch_onode(p->second);
       hit = true;
       o = p->second;
     }
   }
 
   if (hit) {
+    if (lockless_touch)
+      cache->_touch_onode(o);
     cache->logger->inc(l_bluestore_onode_hits);
   } else {
     cache->logger->inc(l_bluestore_onode_misses);
@@ -1558,9 +1671,19 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
   return o;
 }
 
+bool BlueStore::OnodeSpace::remove_if_unreferenced(Onode *o, int refs)
+{
+  RWLock::WLocker l(map_lock);
+  if (o->nref.load() > refs + 1)
+    return false;
+  onode_map.erase(o->oid);
+  return true;
+}
+
 void BlueStore::OnodeSpace::clear()
 {
   std::lock_guard<std::recursive_mutex> l(cache->lock);
+  RWLock::WLocker ml(map_lock);
   ldout(cache->cct, 10) << __func__ << dendl;
   for (auto &p : onode_map) {
     cache->_rm_onode(p.second);
@@ -1570,7 +1693,7 @@ void BlueStore::OnodeSpace::clear()
 
 bool BlueStore::OnodeSpace::empty()
 {
-  std::lock_guard<std::recursive_mutex> l(cache->lock);
+  RWLock::RLocker l(map_lock);
   return onode_map.empty();
 }
 
@@ -1581,6 +1704,7 @@ void BlueStore::OnodeSpace::rename(
   const mempool::bluestore_cache_other::string& new_okey)
 {
   std::lock_guard<std::recursive_mutex> l(cache->lock);
+  RWLock::WLocker ml(map_lock);
   ldout(cache->cct, 30) << __func__ << " " << old_oid << " -> " << new_oid
 			<< dendl;
   ceph::unordered_map<ghobject_t,OnodeRef>::iterator po, pn;
@@ -1612,6 +1736,7 @@ void BlueStore::OnodeSpace::rename(
 bool BlueStore::OnodeSpace::map_any(std::function<bool(OnodeRef)> f)
 {
   std::lock_guard<std::recursive_mutex> l(cache->lock);
+  RWLock::RLocker ml(map_lock);
   ldout(cache->cct, 20) << __func__ << dendl;
   for (auto& i : onode_map) {
     if (f(i.second)) {
@@ -3285,6 +3410,8 @@ void BlueStore::Collection::split_cache(
   std::lock(cache->lock, dest->cache->lock);
   std::lock_guard<std::recursive_mutex> l(cache->lock, std::adopt_lock);
   std::lock_guard<std::recursive_mutex> l2(dest->cache->lock, std::adopt_lock);
+  RWLock::WLocker ml(onode_map.map_lock);
+  RWLock::WLocker ml2(dest->onode_map.map_lock);
 
   int destbits = dest->cnode.bits;
   spg_t destpg;
@@ -3510,6 +3637,7 @@ BlueStore::BlueStore(CephContext *cct, const string& path)
 		       cct->_conf->bluestore_throttle_deferred_bytes),
     deferred_finisher(cct, "defered_finisher", "dfin"),
     kv_sync_thread(this),
+    kv_commit_thread(this),
     kv_finalize_thread(this),
     mempool_thread(this)
 {
@@ -3529,6 +3657,7 @@ BlueStore::BlueStore(CephContext *cct,
 		       cct->_conf->bluestore_throttle_deferred_bytes),
     deferred_finisher(cct, "defered_finisher", "dfin"),
     kv_sync_thread(this),
+    kv_commit_thread(this),
     kv_finalize_thread(this),
     min_alloc_size(_min_alloc_size),
     min_alloc_size_order(ctz(_min_alloc_size)),
@@ -3820,6 +3949,12 @@ void BlueStore::_init_logger()
   b.add_time_avg(l_bluestore_kv_lat, "kv_lat",
 		 "Average kv_thread sync latency",
 		 "k_l", PerfCountersBuilder::PRIO_INTERESTING);
+  b.add_u64_avg(l_bluestore_kv_batch_size, "kv_batch_size",
+		"Average number of transactions per kv commit batch");
+  b.add_u64(l_bluestore_kv_batch_target, "kv_batch_target",
+	    "Current adaptive kv commit batch size target");
+  b.add_u64_avg(l_bluestore_kv_pipeline_occupancy, "kv_pipeline_occupancy",
+		"Average kv commit batches already in flight when a new batch is started");
   b.add_time_avg(l_bluestore_state_prepare_lat, "state_prepare_lat",
     "Average prepare state latency");
   b.add_time_avg(l_bluestore_state_aio_wait_lat, "state_aio_wait_lat",
@@ -4315,6 +4450,7 @@ int BlueStore::_open_alloc()
   fm->enumerate_reset();
   dout(1) << __func__ << " loaded " << pretty_si_t(bytes)
 	  << " in " << num << " extents"
+	  << ", fragmentation " << alloc->get_fragmentation(min_alloc_size)
 	  << dendl;
 
   // also mark bluefs space as allocated
@@ -8354,6 +8490,14 @@ void BlueStore::_kv_start()
   for (auto f : finishers) {
     f->start();
   }
+  kv_pipeline_depth = cct->_conf->bluestore_kv_sync_pipeline_depth;
+  kv_batch_target = 1;
+  logger->set(l_bluestore_kv_batch_target, kv_batch_target);
+  if (kv_pipeline_depth > 1) {
+    dout(10) << __func__ << " kv pipeline depth " << kv_pipeline_depth
+	     << dendl;
+    kv_commit_thread.create("bstore_kv_commit");
+  }
   kv_sync_thread.create("bstore_kv_sync");
   kv_finalize_thread.create("bstore_kv_final");
 }
@@ -8378,6 +8522,18 @@ void BlueStore::_kv_stop()
     kv_finalize_cond.notify_all();
   }
   kv_sync_thread.join();
+  if (kv_pipeline_depth > 1) {
+    // the sync thread drained the pipeline before exiting
+    {
+      std::lock_guard<std::mutex> l(kv_commit_lock);
+      assert(kv_commit_queue.empty());
+      kv_commit_stop = true;
+      kv_commit_cond.notify_all();
+    }
+    kv_commit_thread.join();
+    std::lock_guard<std::mutex> l(kv_commit_lock);
+    kv_commit_stop = false;
+  }
   kv_finalize_thread.join();
   {
     std::lock_guard<std::mutex> l(kv_lock);
@@ -8404,8 +8560,8 @@ void BlueStore::_kv_sync_thread()
   assert(!kv_sync_started);
   kv_sync_started = true;
   kv_cond.notify_all();
+  utime_t batch_wait_start;
   while (true) {
-    assert(kv_committing.empty());
     if (kv_queue.empty() &&
 	((deferred_done_queue.empty() && deferred_stable_queue.empty()) ||
 	 !deferred_aggressive)) {
@@ -8414,221 +8570,344 @@ void BlueStore::_kv_sync_thread()
       dout(20) << __func__ << " sleep" << dendl;
       kv_cond.wait(l);
       dout(20) << __func__ << " wake" << dendl;
+    } else if (kv_sync_in_flight >= kv_pipeline_depth) {
+      dout(20) << __func__ << " pipeline full (" << kv_sync_in_flight
+	       << " batches in flight), waiting" << dendl;
+      kv_cond.wait(l);
     } else {
-      deque<TransContext*> kv_submitting;
-      deque<DeferredBatch*> deferred_done, deferred_stable;
-      uint64_t aios = 0, costs = 0;
+      // group commit: while an earlier batch is still syncing we can
+      // afford to let this one grow a bit before we start it.
+      if (kv_sync_in_flight > 0 && !kv_stop && !deferred_aggressive &&
+	  kv_queue.size() < kv_batch_target) {
+	utime_t now = ceph_clock_now();
+	if (batch_wait_start == utime_t())
+	  batch_wait_start = now;
+	double waited = now - batch_wait_start;
+	double max_delay = cct->_conf->bluestore_kv_sync_max_batch_delay;
+	if (waited < max_delay) {
+	  dout(20) << __func__ << " batch " << kv_queue.size() << " < target "
+		   << kv_batch_target << ", waiting" << dendl;
+	  kv_cond.wait_for(
+	    l, std::chrono::microseconds((int64_t)((max_delay - waited) * 1000000)));
+	  continue;
+	}
+      }
+      batch_wait_start = utime_t();
+
+      // rebalancing bluefs looks at bluefs and allocator usage, which
+      // an in-flight batch changes when it commits; let those land
+      // first.  this costs one pipeline bubble per balance interval.
+      bool balance_bluefs = bluefs &&
+	ceph_clock_now() - bluefs_last_balance >
+	cct->_conf->bluestore_bluefs_balance_interval;
+      if (balance_bluefs && kv_sync_in_flight > 0) {
+	dout(20) << __func__ << " waiting for " << kv_sync_in_flight
+		 << " in flight batches before bluefs balance" << dendl;
+	kv_cond.wait(l);
+	continue;
+      }
 
+      KVSyncBatch *b = new KVSyncBatch;
       dout(20) << __func__ << " committing " << kv_queue.size()
 	       << " submitting " << kv_queue_unsubmitted.size()
 	       << " deferred done " << deferred_done_queue.size()
 	       << " stable " << deferred_stable_queue.size()
+	       << " in flight " << kv_sync_in_flight
 	       << dendl;
-      kv_committing.swap(kv_queue);
-      kv_submitting.swap(kv_queue_unsubmitted);
-      deferred_done.swap(deferred_done_queue);
-      deferred_stable.swap(deferred_stable_queue);
-      aios = kv_ios;
-      costs = kv_throttle_costs;
+      logger->inc(l_bluestore_kv_batch_size, kv_queue.size());
+      logger->inc(l_bluestore_kv_pipeline_occupancy, kv_sync_in_flight);
+      b->committing.swap(kv_queue);
+      b->deferred_done.swap(deferred_done_queue);
+      b->deferred_stable.swap(deferred_stable_queue);
+      b->submitting.swap(kv_queue_unsubmitted);
+      b->aios = kv_ios;
+      b->costs = kv_throttle_costs;
+      b->balance_bluefs = balance_bluefs;
       kv_ios = 0;
       kv_throttle_costs = 0;
-      utime_t start = ceph_clock_now();
+      ++kv_sync_in_flight;
       l.unlock();
 
-      dout(30) << __func__ << " committing " << kv_committing << dendl;
-      dout(30) << __func__ << " submitting " << kv_submitting << dendl;
-      dout(30) << __func__ << " deferred_done " << deferred_done << dendl;
-      dout(30) << __func__ << " deferred_stable " << deferred_stable << dendl;
-
-      bool force_flush = false;
-      // if bluefs is sharing the same device as data (only), then we
-      // can rely on the bluefs commit to flush the device and make
-      // deferred aios stable.  that means that if we do have done deferred
-      // txcs AND we are not on a single device, we need to force a flush.
-      if (bluefs_single_shared_device && bluefs) {
-	if (aios) {
-	  force_flush = true;
-	} else if (kv_committing.empty() && kv_submitting.empty() &&
-		   deferred_stable.empty()) {
-	  force_flush = true;  // there's nothing else to commit!
-	} else if (deferred_aggressive) {
-	  force_flush = true;
-	}
-      } else
-	force_flush = true;
-
-      if (force_flush) {
-	dout(20) << __func__ << " num_aios=" << aios
-		 << " force_flush=" << (int)force_flush
-		 << ", flushing, deferred done->stable" << dendl;
-	// flush/barrier on block device
-	bdev->flush();
-
-	// if we flush then deferred done are now deferred stable
-	deferred_stable.insert(deferred_stable.end(), deferred_done.begin(),
-			       deferred_done.end());
-	deferred_done.clear();
-      }
-      utime_t after_flush = ceph_clock_now();
-
-      // we will use one final transaction to force a sync
-      KeyValueDB::Transaction synct = db->get_transaction();
-
-      // increase {nid,blobid}_max?  note that this covers both the
-      // case where we are approaching the max and the case we passed
-      // it.  in either case, we increase the max in the earlier txn
-      // we submit.
-      uint64_t new_nid_max = 0, new_blobid_max = 0;
-      if (nid_last + cct->_conf->bluestore_nid_prealloc/2 > nid_max) {
-	KeyValueDB::Transaction t =
-	  kv_submitting.empty() ? synct : kv_submitting.front()->t;
-	new_nid_max = nid_last + cct->_conf->bluestore_nid_prealloc;
-	bufferlist bl;
-	::encode(new_nid_max, bl);
-	t->set(PREFIX_SUPER, "nid_max", bl);
-	dout(10) << __func__ << " new_nid_max " << new_nid_max << dendl;
-      }
-      if (blobid_last + cct->_conf->bluestore_blobid_prealloc/2 > blobid_max) {
-	KeyValueDB::Transaction t =
-	  kv_submitting.empty() ? synct : kv_submitting.front()->t;
-	new_blobid_max = blobid_last + cct->_conf->bluestore_blobid_prealloc;
-	bufferlist bl;
-	::encode(new_blobid_max, bl);
-	t->set(PREFIX_SUPER, "blobid_max", bl);
-	dout(10) << __func__ << " new_blobid_max " << new_blobid_max << dendl;
+      _kv_sync_prepare(b);
+      if (kv_pipeline_depth > 1) {
+	std::lock_guard<std::mutex> m(kv_commit_lock);
+	kv_commit_queue.push_back(b);
+	kv_commit_cond.notify_one();
+      } else {
+	_kv_sync_commit(b);
+	delete b;
       }
+      l.lock();
+    }
+  }
+  while (kv_sync_in_flight > 0) {
+    dout(20) << __func__ << " draining " << kv_sync_in_flight
+	     << " in flight batches" << dendl;
+    kv_cond.wait(l);
+  }
+  dout(10) << __func__ << " finish" << dendl;
+  kv_sync_started = false;
+}
 
-      for (auto txc : kv_committing) {
-	if (txc->state == TransContext::STATE_KV_QUEUED) {
-	  txc->log_state_latency(logger, l_bluestore_state_kv_queued_lat);
-	  int r = cct->_conf->bluestore_debug_omit_kv_commit ? 0 : db->submit_transaction(txc->t);
-	  assert(r == 0);
-	  _txc_applied_kv(txc);
-	  --txc->osr->kv_committing_serially;
-	  txc->state = TransContext::STATE_KV_SUBMITTED;
-	  if (txc->osr->kv_submitted_waiters) {
-	    std::lock_guard<std::mutex> l(txc->osr->qlock);
-	    if (txc->osr->_is_all_kv_submitted()) {
-	      txc->osr->qcond.notify_all();
-	    }
-	  }
+void BlueStore::_kv_sync_prepare(KVSyncBatch *b)
+{
+  // called without kv_lock; everything it needs from the queues was
+  // moved into the batch by _kv_sync_thread
+  deque<TransContext*>& kv_submitting = b->submitting;
+  uint64_t aios = b->aios;
+  uint64_t costs = b->costs;
+  b->start = ceph_clock_now();
+
+  deque<TransContext*>& kv_committing = b->committing;
+  deque<DeferredBatch*>& deferred_done = b->deferred_done;
+  deque<DeferredBatch*>& deferred_stable = b->deferred_stable;
+
+  dout(30) << __func__ << " committing " << kv_committing << dendl;
+  dout(30) << __func__ << " submitting " << kv_submitting << dendl;
+  dout(30) << __func__ << " deferred_done " << deferred_done << dendl;
+  dout(30) << __func__ << " deferred_stable " << deferred_stable << dendl;
+
+  bool force_flush = false;
+  // if bluefs is sharing the same device as data (only), then we
+  // can rely on the bluefs commit to flush the device and make
+  // deferred aios stable.  that means that if we do have done deferred
+  // txcs AND we are not on a single device, we need to force a flush.
+  if (bluefs_single_shared_device && bluefs) {
+    if (aios) {
+      force_flush = true;
+    } else if (kv_committing.empty() && kv_submitting.empty() &&
+	       deferred_stable.empty()) {
+      force_flush = true;  // there's nothing else to commit!
+    } else if (deferred_aggressive) {
+      force_flush = true;
+    }
+  } else
+    force_flush = true;
+
+  if (force_flush) {
+    dout(20) << __func__ << " num_aios=" << aios
+	     << " force_flush=" << (int)force_flush
+	     << ", flushing, deferred done->stable" << dendl;
+    // flush/barrier on block device
+    bdev->flush();
+
+    // if we flush then deferred done are now deferred stable
+    deferred_stable.insert(deferred_stable.end(), deferred_done.begin(),
+			   deferred_done.end());
+    deferred_done.clear();
+  }
+  b->after_flush = ceph_clock_now();
+  utime_t after_flush = b->after_flush;
+
+  // we will use one final transaction to force a sync
+  b->synct = db->get_transaction();
+  KeyValueDB::Transaction& synct = b->synct;
+
+  // increase {nid,blobid}_max?  note that this covers both the
+  // case where we are approaching the max and the case we passed
+  // it.  in either case, we increase the max in the earlier txn
+  // we submit.
+  if (nid_last + cct->_conf->bluestore_nid_prealloc/2 > nid_max) {
+    KeyValueDB::Transaction t =
+      kv_submitting.empty() ? synct : kv_submitting.front()->t;
+    b->new_nid_max = nid_last + cct->_conf->bluestore_nid_prealloc;
+    bufferlist bl;
+    ::encode(b->new_nid_max, bl);
+    t->set(PREFIX_SUPER, "nid_max", bl);
+    dout(10) << __func__ << " new_nid_max " << b->new_nid_max << dendl;
+  }
+  if (blobid_last + cct->_conf->bluestore_blobid_prealloc/2 > blobid_max) {
+    KeyValueDB::Transaction t =
+      kv_submitting.empty() ? synct : kv_submitting.front()->t;
+    b->new_blobid_max = blobid_last + cct->_conf->bluestore_blobid_prealloc;
+    bufferlist bl;
+    ::encode(b->new_blobid_max, bl);
+    t->set(PREFIX_SUPER, "blobid_max", bl);
+    dout(10) << __func__ << " new_blobid_max " << b->new_blobid_max << dendl;
+  }
 
-	} else {
-	  assert(txc->state == TransContext::STATE_KV_SUBMITTED);
-	  txc->log_state_latency(logger, l_bluestore_state_kv_queued_lat);
-	}
-	if (txc->had_ios) {
-	  --txc->osr->txc_with_unstable_io;
+  for (auto txc : kv_committing) {
+    if (txc->state == TransContext::STATE_KV_QUEUED) {
+      txc->log_state_latency(logger, l_bluestore_state_kv_queued_lat);
+      int r = cct->_conf->bluestore_debug_omit_kv_commit ? 0 : db->submit_transaction(txc->t);
+      assert(r == 0);
+      _txc_applied_kv(txc);
+      --txc->osr->kv_committing_serially;
+      txc->state = TransContext::STATE_KV_SUBMITTED;
+      if (txc->osr->kv_submitted_waiters) {
+	std::lock_guard<std::mutex> l(txc->osr->qlock);
+	if (txc->osr->_is_all_kv_submitted()) {
+	  txc->osr->qcond.notify_all();
 	}
       }
 
-      // release throttle *before* we commit.  this allows new ops
-      // to be prepared and enter pipeline while we are waiting on
-      // the kv commit sync/flush.  then hopefully on the next
-      // iteration there will already be ops awake.  otherwise, we
-      // end up going to sleep, and then wake up when the very first
-      // transaction is ready for commit.
-      throttle_bytes.put(costs);
-
-      PExtentVector bluefs_gift_extents;
-      if (bluefs &&
-	  after_flush - bluefs_last_balance >
-	  cct->_conf->bluestore_bluefs_balance_interval) {
-	bluefs_last_balance = after_flush;
-	int r = _balance_bluefs_freespace(&bluefs_gift_extents);
-	assert(r >= 0);
-	if (r > 0) {
-	  for (auto& p : bluefs_gift_extents) {
-	    bluefs_extents.insert(p.offset, p.length);
-	  }
-	  bufferlist bl;
-	  ::encode(bluefs_extents, bl);
-	  dout(10) << __func__ << " bluefs_extents now 0x" << std::hex
-		   << bluefs_extents << std::dec << dendl;
-	  synct->set(PREFIX_SUPER, "bluefs_extents", bl);
-	}
-      }
+    } else {
+      assert(txc->state == TransContext::STATE_KV_SUBMITTED);
+      txc->log_state_latency(logger, l_bluestore_state_kv_queued_lat);
+    }
+    if (txc->had_ios) {
+      --txc->osr->txc_with_unstable_io;
+    }
+  }
 
-      // cleanup sync deferred keys
-      for (auto b : deferred_stable) {
-	for (auto& txc : b->txcs) {
-	  bluestore_deferred_transaction_t& wt = *txc.deferred_txn;
-	  assert(wt.released.empty()); // only kraken did this
-	  string key;
-	  get_deferred_key(wt.seq, &key);
-	  synct->rm_single_key(PREFIX_DEFERRED, key);
-	}
+  // release throttle *before* we commit.  this allows new ops
+  // to be prepared and enter pipeline while we are waiting on
+  // the kv commit sync/flush.  then hopefully on the next
+  // iteration there will already be ops awake.  otherwise, we
+  // end up going to sleep, and then wake up when the very first
+  // transaction is ready for commit.
+  throttle_bytes.put(costs);
+
+  PExtentVector& bluefs_gift_extents = b->bluefs_gift_extents;
+  if (b->balance_bluefs) {
+    bluefs_last_balance = after_flush;
+    int r = _balance_bluefs_freespace(&bluefs_gift_extents);
+    assert(r >= 0);
+    if (r > 0) {
+      for (auto& p : bluefs_gift_extents) {
+	bluefs_extents.insert(p.offset, p.length);
       }
+      bufferlist bl;
+      ::encode(bluefs_extents, bl);
+      dout(10) << __func__ << " bluefs_extents now 0x" << std::hex
+	       << bluefs_extents << std::dec << dendl;
+      synct->set(PREFIX_SUPER, "bluefs_extents", bl);
+    }
+  }
 
-      // submit synct synchronously (block and wait for it to commit)
-      int r = cct->_conf->bluestore_debug_omit_kv_commit ? 0 : db->submit_transaction_sync(synct);
-      assert(r == 0);
+  // cleanup sync deferred keys
+  for (auto deferred : deferred_stable) {
+    for (auto& txc : deferred->txcs) {
+      bluestore_deferred_transaction_t& wt = *txc.deferred_txn;
+      assert(wt.released.empty()); // only kraken did this
+      string key;
+      get_deferred_key(wt.seq, &key);
+      synct->rm_single_key(PREFIX_DEFERRED, key);
+    }
+  }
 
-      {
-	std::unique_lock<std::mutex> m(kv_finalize_lock);
-	if (kv_committing_to_finalize.empty()) {
-	  kv_committing_to_finalize.swap(kv_committing);
-	} else {
-	  kv_committing_to_finalize.insert(
-	      kv_committing_to_finalize.end(),
-	      kv_committing.begin(),
-	      kv_committing.end());
-	  kv_committing.clear();
-	}
-	if (deferred_stable_to_finalize.empty()) {
-	  deferred_stable_to_finalize.swap(deferred_stable);
-	} else {
-	  deferred_stable_to_finalize.insert(
-	      deferred_stable_to_finalize.end(),
-	      deferred_stable.begin(),
-	      deferred_stable.end());
-	  deferred_stable.clear();
-	}
-	kv_finalize_cond.notify_one();
-      }
+  // whatever we are reclaiming from bluefs gets released once this
+  // batch (which records the new bluefs_extents) is durable
+  b->bluefs_extents_reclaiming.swap(bluefs_extents_reclaiming);
+}
 
-      if (new_nid_max) {
-	nid_max = new_nid_max;
-	dout(10) << __func__ << " nid_max now " << nid_max << dendl;
-      }
-      if (new_blobid_max) {
-	blobid_max = new_blobid_max;
-	dout(10) << __func__ << " blobid_max now " << blobid_max << dendl;
-      }
+void BlueStore::_kv_sync_commit(KVSyncBatch *b)
+{
+  deque<TransContext*>& kv_committing = b->committing;
+  deque<DeferredBatch*>& deferred_stable = b->deferred_stable;
+  utime_t start = b->start;
+  utime_t after_flush = b->after_flush;
 
-      {
-	utime_t finish = ceph_clock_now();
-	utime_t dur_flush = after_flush - start;
-	utime_t dur_kv = finish - after_flush;
-	utime_t dur = finish - start;
-	dout(20) << __func__ << " committed " << kv_committing.size()
-	  << " cleaned " << deferred_stable.size()
-	  << " in " << dur
-	  << " (" << dur_flush << " flush + " << dur_kv << " kv commit)"
-	  << dendl;
-	logger->tinc(l_bluestore_kv_flush_lat, dur_flush);
-	logger->tinc(l_bluestore_kv_commit_lat, dur_kv);
-	logger->tinc(l_bluestore_kv_lat, dur);
-      }
+  // submit synct synchronously (block and wait for it to commit)
+  int r = cct->_conf->bluestore_debug_omit_kv_commit ? 0 : db->submit_transaction_sync(b->synct);
+  assert(r == 0);
 
-      if (bluefs) {
-	if (!bluefs_gift_extents.empty()) {
-	  _commit_bluefs_freespace(bluefs_gift_extents);
-	}
-	dout(20) << __func__ << " releasing old bluefs 0x" << std::hex
-		 << bluefs_extents_reclaiming << std::dec << dendl;
-	alloc->release(bluefs_extents_reclaiming);
-	bluefs_extents_reclaiming.clear();
-      }
+  {
+    std::unique_lock<std::mutex> m(kv_finalize_lock);
+    if (kv_committing_to_finalize.empty()) {
+      kv_committing_to_finalize.swap(kv_committing);
+    } else {
+      kv_committing_to_finalize.insert(
+	  kv_committing_to_finalize.end(),
+	  kv_committing.begin(),
+	  kv_committing.end());
+      kv_committing.clear();
+    }
+    if (deferred_stable_to_finalize.empty()) {
+      deferred_stable_to_finalize.swap(deferred_stable);
+    } else {
+      deferred_stable_to_finalize.insert(
+	  deferred_stable_to_finalize.end(),
+	  deferred_stable.begin(),
+	  deferred_stable.end());
+      deferred_stable.clear();
+    }
+    kv_finalize_cond.notify_one();
+  }
+
+  if (b->new_nid_max) {
+    nid_max = b->new_nid_max;
+    dout(10) << __func__ << " nid_max now " << nid_max << dendl;
+  }
+  if (b->new_blobid_max) {
+    blobid_max = b->new_blobid_max;
+    dout(10) << __func__ << " blobid_max now " << blobid_max << dendl;
+  }
 
+  {
+    utime_t finish = ceph_clock_now();
+    utime_t dur_flush = after_flush - start;
+    utime_t dur_kv = finish - after_flush;
+    utime_t dur = finish - start;
+    dout(20) << __func__ << " committed " << kv_committing.size()
+      << " cleaned " << deferred_stable.size()
+      << " in " << dur
+      << " (" << dur_flush << " flush + " << dur_kv << " kv commit)"
+      << dendl;
+    logger->tinc(l_bluestore_kv_flush_lat, dur_flush);
+    logger->tinc(l_bluestore_kv_commit_lat, dur_kv);
+    logger->tinc(l_bluestore_kv_lat, dur);
+  }
+
+  if (bluefs) {
+    if (!b->bluefs_gift_extents.empty()) {
+      _commit_bluefs_freespace(b->bluefs_gift_extents);
+    }
+    dout(20) << __func__ << " releasing old bluefs 0x" << std::hex
+	     << b->bluefs_extents_reclaiming << std::dec << dendl;
+    alloc->release(b->bluefs_extents_reclaiming);
+    b->bluefs_extents_reclaiming.clear();
+  }
+
+  std::lock_guard<std::mutex> l(kv_lock);
+  // previously deferred "done" are now "stable" by virtue of this
+  // commit cycle.
+  deferred_stable_queue.insert(deferred_stable_queue.end(),
+			       b->deferred_done.begin(),
+			       b->deferred_done.end());
+  b->deferred_done.clear();
+
+  if (kv_pipeline_depth > 1) {
+    // adapt the group commit size: a slow commit means the device is
+    // busy and we should amortize each sync over more transactions; a
+    // fast one means we can shrink batches and cut queueing delay.
+    double lat = ceph_clock_now() - start;
+    double target = cct->_conf->bluestore_kv_sync_target_latency;
+    uint64_t max_batch = cct->_conf->bluestore_kv_sync_max_batch;
+    if (lat > target) {
+      kv_batch_target = MIN(kv_batch_target * 2, max_batch);
+    } else if (lat < target / 2 && kv_batch_target > 1) {
+      --kv_batch_target;
+    }
+    logger->set(l_bluestore_kv_batch_target, kv_batch_target);
+  }
+  assert(kv_sync_in_flight > 0);
+  --kv_sync_in_flight;
+  kv_cond.notify_all();
+}
+
+void BlueStore::_kv_commit_thread()
+{
+  dout(10) << __func__ << " start" << dendl;
+  std::unique_lock<std::mutex> l(kv_commit_lock);
+  while (true) {
+    if (kv_commit_queue.empty()) {
+      if (kv_commit_stop)
+	break;
+      dout(20) << __func__ << " sleep" << dendl;
+      kv_commit_cond.wait(l);
+      dout(20) << __func__ << " wake" << dendl;
+    } else {
+      // batches are synced strictly in the order they were prepared
+      KVSyncBatch *b = kv_commit_queue.front();
+      kv_commit_queue.pop_front();
+      l.unlock();
+      _kv_sync_commit(b);
+      delete b;
       l.lock();
-      // previously deferred "done" are now "stable" by virtue of this
-      // commit cycle.
-      deferred_stable_queue.swap(deferred_done);
     }
   }
   dout(10) << __func__ << " finish" << dendl;
-  kv_sync_started = false;
 }
 
 void BlueStore::_kv_finalize_thread()
@@ -60,6 +60,9 @@ enum {
   l_bluestore_kv_flush_lat,
   l_bluestore_kv_commit_lat,
   l_bluestore_kv_lat,
+  l_bluestore_kv_batch_size,
+  l_bluestore_kv_batch_target,
+  l_bluestore_kv_pipeline_occupancy,
   l_bluestore_state_prepare_lat,
   l_bluestore_state_aio_wait_lat,
   l_bluestore_state_io_done_lat,
@@ -1007,6 +1010,7 @@ public:
     mempool::bluestore_cache_other::string key;
 
     boost::intrusive::list_member_hook<> lru_item;
+    std::atomic<bool> cache_ref = {false};  ///< CLOCK reference bit
 
     bluestore_onode_t onode;  ///< metadata stored as value in kv store
     bool exists;              ///< true if object logically exists
@@ -1059,6 +1063,13 @@ public:
     virtual void _rm_onode(OnodeRef& o) = 0;
     virtual void _touch_onode(OnodeRef& o) = 0;
 
+    /// true if _touch_onode() is safe to call without holding lock, in
+    /// which case OnodeSpace::lookup() does not take lock at all and
+    /// _trim() must evict via OnodeSpace::remove_if_unreferenced()
+    virtual bool touch_onode_lockless() const {
+      return false;
+    }
+
     virtual void _add_buffer(Buffer *b, int level, Buffer *near) = 0;
     virtual void _rm_buffer(Buffer *b) = 0;
     virtual void _move_buffer(Cache *src, Buffer *b) = 0;
@@ -1290,6 +1301,116 @@ public:
       *bytes += buffer_bytes;
     }
 
+#ifdef DEBUG_CACHE
+    void _audit(const char *s) override;
+#endif
+  };
+
+  /// CLOCK (second chance) cache for onodes and buffers
+  ///
+  /// Hits only set a reference bit; nothing is reordered until _trim()
+  /// sweeps the ring, so the hit path never writes the shared list
+  /// heads and onode touches do not need the cache lock at all.
+  struct ClockCache : public Cache {
+  private:
+    typedef boost::intrusive::list<
+      Onode,
+      boost::intrusive::member_hook<
+        Onode,
+	boost::intrusive::list_member_hook<>,
+	&Onode::lru_item> > onode_ring_t;
+    typedef boost::intrusive::list<
+      Buffer,
+      boost::intrusive::member_hook<
+	Buffer,
+	boost::intrusive::list_member_hook<>,
+	&Buffer::lru_item> > buffer_ring_t;
+
+    // the clock hand always points at the front of each ring; new
+    // entries are inserted just behind it (at the back).
+    onode_ring_t onode_ring;
+
+    buffer_ring_t buffer_ring;
+    uint64_t buffer_size = 0;
+
+    enum {
+      BUFFER_UNREFERENCED = 0,
+      BUFFER_REFERENCED = 1,
+    };
+
+  public:
+    ClockCache(CephContext* cct) : Cache(cct) {}
+    uint64_t _get_num_onodes() override {
+      return onode_ring.size();
+    }
+    void _add_onode(OnodeRef& o, int level) override {
+      o->cache_ref.store(false, std::memory_order_relaxed);
+      if (level > 0)
+	onode_ring.push_back(*o);
+      else
+	onode_ring.push_front(*o);
+    }
+    void _rm_onode(OnodeRef& o) override {
+      auto q = onode_ring.iterator_to(*o);
+      onode_ring.erase(q);
+    }
+    void _touch_onode(OnodeRef& o) override {
+      o->cache_ref.store(true, std::memory_order_relaxed);
+    }
+    bool touch_onode_lockless() const override {
+      return true;
+    }
+
+    uint64_t _get_buffer_bytes() override {
+      return buffer_size;
+    }
+    void _add_buffer(Buffer *b, int level, Buffer *near) override {
+      // a non-zero cache_private here means the data replaces a buffer
+      // that was recently referenced; let it keep its second chance.
+      b->cache_private = b->cache_private ?
+	BUFFER_REFERENCED : BUFFER_UNREFERENCED;
+      if (near) {
+	auto q = buffer_ring.iterator_to(*near);
+	buffer_ring.insert(q, *b);
+      } else if (level > 0) {
+	buffer_ring.push_back(*b);
+      } else {
+	buffer_ring.push_front(*b);
+      }
+      buffer_size += b->length;
+    }
+    void _rm_buffer(Buffer *b) override {
+      assert(buffer_size >= b->length);
+      buffer_size -= b->length;
+      auto q = buffer_ring.iterator_to(*b);
+      buffer_ring.erase(q);
+    }
+    void _move_buffer(Cache *src, Buffer *b) override {
+      src->_rm_buffer(b);
+      _add_buffer(b, 0, nullptr);
+    }
+    void _adjust_buffer_size(Buffer *b, int64_t delta) override {
+      assert((int64_t)buffer_size + delta >= 0);
+      buffer_size += delta;
+    }
+    void _touch_buffer(Buffer *b) override {
+      b->cache_private = BUFFER_REFERENCED;
+    }
+
+    void _trim(uint64_t onode_max, uint64_t buffer_max) override;
+
+    void add_stats(uint64_t *onodes, uint64_t *extents,
+		   uint64_t *blobs,
+		   uint64_t *buffers,
+		   uint64_t *bytes) override {
+      std::lock_guard<std::recursive_mutex> l(lock);
+      *onodes += onode_ring.size();
+      *extents += num_extents;
+      *blobs += num_blobs;
+      *buffers += buffer_ring.size();
+      *bytes += buffer_size;
+    }
+
 #ifdef DEBUG_CACHE
     void _audit(const char *s) override;
 #endif
@@ -1299,13 +1420,18 @@ public:
   private:
     Cache *cache;
 
+    /// protects onode_map; taken after cache->lock when both are needed
+    RWLock map_lock;
+
     /// forward lookups
     mempool::bluestore_cache_other::unordered_map<ghobject_t,OnodeRef> onode_map;
 
     friend class Collection; // for split_cache()
 
   public:
-    OnodeSpace(Cache *c) : cache(c) {}
+    OnodeSpace(Cache *c)
+      : cache(c),
+	map_lock("BlueStore::OnodeSpace::map_lock", false, false) {}
     ~OnodeSpace() {
       clear();
     }
@@ -1313,8 +1439,11 @@ public:
     OnodeRef add(const ghobject_t& oid, OnodeRef o);
     OnodeRef lookup(const ghobject_t& o);
     void remove(const ghobject_t& oid) {
+      RWLock::WLocker l(map_lock);
       onode_map.erase(oid);
     }
+    /// remove o unless a lookup took a ref beyond the map's and @p refs
+    bool remove_if_unreferenced(Onode *o, int refs);
     void rename(OnodeRef& o, const ghobject_t& old_oid,
 		const ghobject_t& new_oid,
 		const mempool::bluestore_cache_other::string& new_okey);
@@ -1785,6 +1914,27 @@ public:
       return NULL;
     }
   };
+  struct KVCommitThread : public Thread {
+    BlueStore *store;
+    explicit KVCommitThread(BlueStore *s) : store(s) {}
+    void *entry() override {
+      store->_kv_commit_thread();
+      return NULL;
+    }
+  };
+
+  /// one kv_sync_thread commit cycle (see _kv_sync_prepare/_kv_sync_commit)
+  struct KVSyncBatch {
+    deque<TransContext*> committing, submitting;
+    deque<DeferredBatch*> deferred_done, deferred_stable;
+    uint64_t aios = 0, costs = 0;
+    bool balance_bluefs = false;  ///< no other batch is in flight
+    KeyValueDB::Transaction synct;
+    uint64_t new_nid_max = 0, new_blobid_max = 0;
+    PExtentVector bluefs_gift_extents;
+    interval_set<uint64_t> bluefs_extents_reclaiming;
+    utime_t start, after_flush;
+  };
 
   struct DBHistogram {
     struct value_dist {
@@ -1866,9 +2016,17 @@ private:
   bool kv_finalize_stop = false;
   deque<TransContext*> kv_queue;             ///< ready, already submitted
   deque<TransContext*> kv_queue_unsubmitted; ///< ready, need submit by kv thread
-  deque<TransContext*> kv_committing;        ///< currently syncing
   deque<DeferredBatch*> deferred_done_queue;   ///< deferred ios done
   deque<DeferredBatch*> deferred_stable_queue; ///< deferred ios done + stable
+  uint64_t kv_pipeline_depth = 1;   ///< max batches in flight; 1 = serial
+  uint64_t kv_sync_in_flight = 0;   ///< batches handed out, not yet synced
+  uint64_t kv_batch_target = 1;     ///< adaptive group commit batch size
+
+  KVCommitThread kv_commit_thread;
+  std::mutex kv_commit_lock;
+  std::condition_variable kv_commit_cond;
+  bool kv_commit_stop = false;
+  deque<KVSyncBatch*> kv_commit_queue;  ///< prepared, waiting for sync
 
   KVFinalizeThread kv_finalize_thread;
   std::mutex kv_finalize_lock;
@@ -2038,6 +2196,9 @@ private:
   void _kv_start();
   void _kv_stop();
   void _kv_sync_thread();
+  void _kv_sync_prepare(KVSyncBatch *b);
+  void _kv_sync_commit(KVSyncBatch *b);
+  void _kv_commit_thread();
   void _kv_finalize_thread();
 
   bluestore_deferred_op_t *_get_deferred_op(TransContext *txc, OnodeRef o);
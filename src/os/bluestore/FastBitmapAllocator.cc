@@ -0,0 +1,451 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <algorithm>
+
+#include "FastBitmapAllocator.h"
+#include "bluestore_types.h"
+#include "common/debug.h"
+#include "include/intarith.h"
+
+#define dout_context cct
+#define dout_subsys ceph_subsys_bluestore
+#undef dout_prefix
+#define dout_prefix *_dout << "fastbitmapalloc "
+
+FastBitmapAllocator::FastBitmapAllocator(CephContext* cct,
+					 int64_t device_size,
+					 int64_t block_size)
+  : cct(cct),
+    unit(block_size),
+    unit_order(ctz((uint64_t)block_size)),
+    num_units(device_size / block_size),
+    shards(cct->_conf->bluestore_fastbitmap_cache_shards)
+{
+  assert(block_size > 0 && ISP2(block_size));
+  cache_chunk = std::max<uint64_t>(
+    1, cct->_conf->bluestore_fastbitmap_cache_chunk >> unit_order);
+  cache_max_want = std::max<uint64_t>(1, cache_chunk / 4);
+
+  uint64_t n = num_units;
+  do {
+    uint64_t words = (n + 63) / 64;
+    levels.emplace_back(words, 0);
+    n = words;
+  } while (n > 1);
+
+  ldout(cct, 10) << __func__ << " size 0x" << std::hex << device_size
+		 << " unit 0x" << unit << std::dec
+		 << " units " << num_units
+		 << " levels " << levels.size()
+		 << " shards " << shards.size() << dendl;
+}
+
+FastBitmapAllocator::~FastBitmapAllocator()
+{
+}
+
+/// first free unit >= pos, or num_units
+uint64_t FastBitmapAllocator::_find_next_free(uint64_t pos) const
+{
+  if (pos >= num_units)
+    return num_units;
+  // climb until some word has a set bit at or after our position...
+  size_t l = 0;
+  uint64_t idx = pos;
+  while (true) {
+    if (l == levels.size())
+      return num_units;
+    const auto& v = levels[l];
+    uint64_t w = idx >> 6;
+    if (w >= v.size())
+      return num_units;
+    uint64_t bits = v[w] & (~0ull << (idx & 63));
+    if (bits) {
+      idx = (w << 6) + ctz(bits);
+      break;
+    }
+    idx = w + 1;
+    ++l;
+  }
+  // ...then descend taking the first non-empty word at each level
+  while (l > 0) {
+    --l;
+    uint64_t bits = levels[l][idx];
+    assert(bits);
+    idx = (idx << 6) + ctz(bits);
+  }
+  return std::min(idx, num_units);
+}
+
+/// first allocated unit in [pos, end), or end
+uint64_t FastBitmapAllocator::_find_next_used(uint64_t pos,
+					      uint64_t end) const
+{
+  const auto& l0 = levels[0];
+  while (pos < end) {
+    uint64_t w = pos >> 6;
+    uint64_t bits = ~l0[w] & (~0ull << (pos & 63));
+    if (bits)
+      return std::min(end, (w << 6) + ctz(bits));
+    pos = (w + 1) << 6;
+  }
+  return end;
+}
+
+void FastBitmapAllocator::_update_summary(uint64_t first_word,
+					  uint64_t last_word)
+{
+  for (size_t l = 1; l < levels.size(); ++l) {
+    const auto& lower = levels[l - 1];
+    auto& upper = levels[l];
+    for (uint64_t w = first_word; w <= last_word; ++w) {
+      uint64_t bit = 1ull << (w & 63);
+      if (lower[w])
+	upper[w >> 6] |= bit;
+      else
+	upper[w >> 6] &= ~bit;
+    }
+    first_word >>= 6;
+    last_word >>= 6;
+  }
+}
+
+/// mark [start, start+count) free; return the number of units that changed
+uint64_t FastBitmapAllocator::_mark_free(uint64_t start, uint64_t count)
+{
+  if (!count)
+    return 0;
+  auto& l0 = levels[0];
+  uint64_t end = start + count;
+  uint64_t changed = 0;
+  for (uint64_t pos = start; pos < end; ) {
+    uint64_t w = pos >> 6;
+    uint64_t b = pos & 63;
+    uint64_t n = std::min<uint64_t>(64 - b, end - pos);
+    uint64_t mask = (n == 64 ? ~0ull : ((1ull << n) - 1)) << b;
+    changed += __builtin_popcountll(~l0[w] & mask);
+    l0[w] |= mask;
+    pos += n;
+  }
+  _update_summary(start >> 6, (end - 1) >> 6);
+  return changed;
+}
+
+/// mark [start, start+count) used; return the number of units that changed
+uint64_t FastBitmapAllocator::_mark_used(uint64_t start, uint64_t count)
+{
+  if (!count)
+    return 0;
+  auto& l0 = levels[0];
+  uint64_t end = start + count;
+  uint64_t changed = 0;
+  for (uint64_t pos = start; pos < end; ) {
+    uint64_t w = pos >> 6;
+    uint64_t b = pos & 63;
+    uint64_t n = std::min<uint64_t>(64 - b, end - pos);
+    uint64_t mask = (n == 64 ? ~0ull : ((1ull << n) - 1)) << b;
+    changed += __builtin_popcountll(l0[w] & mask);
+    l0[w] &= ~mask;
+    pos += n;
+  }
+  _update_summary(start >> 6, (end - 1) >> 6);
+  return changed;
+}
+
+/*
+ * Next-fit search starting at pos, wrapping around once.  Every extent
+ * starts on an au boundary, is a multiple of au long and no longer than
+ * max_units.  Found extents are marked used and passed to emit(start,
+ * count).  Caller holds lock.
+ */
+template <typename F>
+uint64_t FastBitmapAllocator::_allocate_units(
+  uint64_t want, uint64_t au, uint64_t max_units, uint64_t pos, F&& emit)
+{
+  uint64_t got = 0;
+  uint64_t start = pos < num_units ? pos : 0;
+  uint64_t pass_end = num_units;
+  bool wrapped = false;
+  pos = start;
+  while (got < want) {
+    pos = _find_next_free(pos);
+    if (pos >= pass_end) {
+      if (wrapped || start == 0)
+	break;
+      // second pass only needs to find extents that begin before start
+      wrapped = true;
+      pass_end = start;
+      pos = 0;
+      continue;
+    }
+    uint64_t a = ROUND_UP_TO(pos, au);
+    if (a >= num_units) {
+      pos = num_units;
+      continue;
+    }
+    uint64_t limit = std::min(ROUND_UP_TO(want - got, au), max_units);
+    uint64_t e = _find_next_used(a, std::min(num_units, a + limit));
+    uint64_t len = (e - a) / au * au;
+    if (len == 0) {
+      pos = std::max(e, a + 1);
+      continue;
+    }
+    _mark_used(a, len);
+    emit(a, len);
+    got += len;
+    pos = a + len;
+  }
+  cursor = pos;
+  return got;
+}
+
+FastBitmapAllocator::Shard& FastBitmapAllocator::_get_shard()
+{
+  // spread threads round-robin; hashing std::thread::id tends to give
+  // page-aligned values that all land in the same shard
+  static std::atomic<unsigned> next_thread_shard = {0};
+  static thread_local unsigned thread_shard = next_thread_shard++;
+  return shards[thread_shard % shards.size()];
+}
+
+/// serve want units from the shard cache, refilling it if needed;
+/// caller holds s.lock
+uint64_t FastBitmapAllocator::_allocate_from_shard(
+  Shard& s, uint64_t want, uint64_t max_units, ExtentList *block_list)
+{
+  if (s.units < want) {
+    mempool::bluestore_alloc::vector<unit_extent_t> fresh;
+    uint64_t got;
+    {
+      std::lock_guard<std::mutex> l(lock);
+      got = _allocate_units(
+	cache_chunk, 1, 0xffffffffull >> unit_order, cursor,
+	[&](uint64_t start, uint64_t count) {
+	  fresh.emplace_back(start, count);
+	});
+    }
+    ldout(cct, 20) << __func__ << " refilled " << got << " units in "
+		   << fresh.size() << " extents" << dendl;
+    // keep what we already had on top so it is used first
+    std::reverse(fresh.begin(), fresh.end());
+    fresh.insert(fresh.end(), s.extents.begin(), s.extents.end());
+    s.extents.swap(fresh);
+    s.units += got;
+  }
+
+  uint64_t got = 0;
+  while (got < want && !s.extents.empty()) {
+    auto& e = s.extents.back();
+    uint64_t n = std::min({e.second, want - got, max_units});
+    block_list->add_extents(e.first, n);
+    e.first += n;
+    e.second -= n;
+    if (!e.second)
+      s.extents.pop_back();
+    got += n;
+  }
+  s.units -= got;
+  return got;
+}
+
+/// return a shard's cached extents to the bitmap; caller holds s.lock
+void FastBitmapAllocator::_flush_shard(Shard& s)
+{
+  if (s.extents.empty())
+    return;
+  std::lock_guard<std::mutex> l(lock);
+  for (auto& e : s.extents)
+    _mark_free(e.first, e.second);
+  s.extents.clear();
+  s.units = 0;
+}
+
+void FastBitmapAllocator::_flush_shards()
+{
+  for (auto& s : shards) {
+    std::lock_guard<std::mutex> l(s.lock);
+    _flush_shard(s);
+  }
+}
+
+int FastBitmapAllocator::reserve(uint64_t need)
+{
+  int64_t reserved = num_reserved.load();
+  do {
+    if ((int64_t)need > num_free.load() - reserved) {
+      ldout(cct, 10) << __func__ << " need 0x" << std::hex << need
+		     << " num_free 0x" << num_free.load()
+		     << " num_reserved 0x" << reserved << std::dec
+		     << " -ENOSPC" << dendl;
+      return -ENOSPC;
+    }
+  } while (!num_reserved.compare_exchange_weak(reserved, reserved + need));
+  ldout(cct, 10) << __func__ << " need 0x" << std::hex << need
+		 << " num_reserved 0x" << reserved + need << std::dec << dendl;
+  return 0;
+}
+
+void FastBitmapAllocator::unreserve(uint64_t unused)
+{
+  ldout(cct, 10) << __func__ << " unused 0x" << std::hex << unused
+		 << std::dec << dendl;
+  int64_t left = num_reserved -= unused;
+  assert(left >= 0);
+}
+
+int64_t FastBitmapAllocator::allocate(
+  uint64_t want_size, uint64_t alloc_unit, uint64_t max_alloc_size,
+  int64_t hint, AllocExtentVector *extents)
+{
+  ldout(cct, 10) << __func__ << " want_size 0x" << std::hex << want_size
+		 << " alloc_unit 0x" << alloc_unit
+		 << " max_alloc_size 0x" << max_alloc_size
+		 << " hint 0x" << hint << std::dec << dendl;
+  assert(alloc_unit && alloc_unit % unit == 0);
+
+  // AllocExtent::length is 32 bits
+  uint64_t max_bytes = 0xffffffffull;
+  if (max_alloc_size && max_alloc_size < max_bytes)
+    max_bytes = max_alloc_size;
+  max_bytes = std::max(alloc_unit, max_bytes / alloc_unit * alloc_unit);
+
+  uint64_t want = ROUND_UP_TO(want_size, unit) >> unit_order;
+  uint64_t au = alloc_unit >> unit_order;
+  uint64_t max_units = max_bytes >> unit_order;
+  ExtentList block_list(extents, unit, max_bytes);
+  auto emit = [&](uint64_t start, uint64_t count) {
+    block_list.add_extents(start, count);
+  };
+
+  uint64_t got = 0;
+  if (au == 1 && hint == 0 && want <= cache_max_want && !shards.empty()) {
+    Shard& s = _get_shard();
+    std::lock_guard<std::mutex> l(s.lock);
+    got = _allocate_from_shard(s, want, max_units, &block_list);
+  }
+  if (got < want) {
+    std::lock_guard<std::mutex> l(lock);
+    uint64_t pos = cursor;
+    if (hint > 0 && (uint64_t)hint < (num_units << unit_order))
+      pos = (uint64_t)hint >> unit_order;
+    got += _allocate_units(want - got, au, max_units, pos, emit);
+  }
+  if (got < want && !shards.empty()) {
+    // the shard caches may be sitting on what the bitmap is missing
+    _flush_shards();
+    std::lock_guard<std::mutex> l(lock);
+    got += _allocate_units(want - got, au, max_units, cursor, emit);
+  }
+  if (got == 0) {
+    ldout(cct, 10) << __func__ << " -ENOSPC" << dendl;
+    return -ENOSPC;
+  }
+
+  int64_t bytes = got << unit_order;
+  num_free -= bytes;
+  num_reserved -= bytes;
+  ldout(cct, 10) << __func__ << " got 0x" << std::hex << bytes << std::dec
+		 << " in " << extents->size() << " extents" << dendl;
+  return bytes;
+}
+
+void FastBitmapAllocator::release(
+  const interval_set<uint64_t>& release_set)
+{
+  std::lock_guard<std::mutex> l(lock);
+  for (auto p = release_set.begin(); p != release_set.end(); ++p) {
+    ldout(cct, 10) << __func__ << " 0x" << std::hex << p.get_start() << "~"
+		   << p.get_len() << std::dec << dendl;
+    assert(p.get_start() % unit == 0 && p.get_len() % unit == 0);
+    uint64_t n = _mark_free(p.get_start() >> unit_order,
+			    p.get_len() >> unit_order);
+    num_free += n << unit_order;
+  }
+}
+
+uint64_t FastBitmapAllocator::get_free()
+{
+  return num_free.load();
+}
+
+/// count maximal free runs and free units; caller holds lock
+void FastBitmapAllocator::_count_free_runs(uint64_t *runs,
+					   uint64_t *units) const
+{
+  uint64_t prev = 0;  // top bit of the previous word
+  for (auto w : levels[0]) {
+    *units += __builtin_popcountll(w);
+    // a run starts at every set bit whose lower neighbour is clear
+    *runs += __builtin_popcountll(w & ~((w << 1) | prev));
+    prev = w >> 63;
+  }
+}
+
+double FastBitmapAllocator::get_fragmentation(uint64_t alloc_unit)
+{
+  // cached extents are free space too; put them back so they are counted
+  _flush_shards();
+  std::lock_guard<std::mutex> l(lock);
+  uint64_t runs = 0, units = 0;
+  _count_free_runs(&runs, &units);
+  uint64_t blocks = (units << unit_order) / std::max(alloc_unit, unit);
+  if (runs <= 1 || blocks <= 1)
+    return 0.0;
+  return std::min(1.0, (double)(runs - 1) / (double)(blocks - 1));
+}
+
+void FastBitmapAllocator::dump()
+{
+  for (size_t i = 0; i < shards.size(); ++i) {
+    Shard& s = shards[i];
+    std::lock_guard<std::mutex> l(s.lock);
+    ldout(cct, 0) << __func__ << " shard " << i << ": "
+		  << s.extents.size() << " cached extents, 0x" << std::hex
+		  << (s.units << unit_order) << std::dec << " bytes" << dendl;
+  }
+  std::lock_guard<std::mutex> l(lock);
+  uint64_t runs = 0, units = 0;
+  _count_free_runs(&runs, &units);
+  ldout(cct, 0) << __func__ << " bitmap: " << runs << " extents, 0x"
+		<< std::hex << (units << unit_order) << std::dec << " bytes"
+		<< dendl;
+  uint64_t pos = _find_next_free(0);
+  while (pos < num_units) {
+    uint64_t end = _find_next_used(pos, num_units);
+    ldout(cct, 0) << __func__ << "  0x" << std::hex << (pos << unit_order)
+		  << "~" << ((end - pos) << unit_order) << std::dec << dendl;
+    pos = _find_next_free(end);
+  }
+}
+
+void FastBitmapAllocator::init_add_free(uint64_t offset, uint64_t length)
+{
+  ldout(cct, 10) << __func__ << " 0x" << std::hex << offset << "~" << length
+		 << std::dec << dendl;
+  _flush_shards();
+  std::lock_guard<std::mutex> l(lock);
+  uint64_t start = ROUND_UP_TO(offset, unit) >> unit_order;
+  uint64_t end = std::min(num_units, P2ALIGN(offset + length, unit) >> unit_order);
+  if (start < end)
+    num_free += _mark_free(start, end - start) << unit_order;
+}
+
+void FastBitmapAllocator::init_rm_free(uint64_t offset, uint64_t length)
+{
+  ldout(cct, 10) << __func__ << " 0x" << std::hex << offset << "~" << length
+		 << std::dec << dendl;
+  _flush_shards();
+  std::lock_guard<std::mutex> l(lock);
+  uint64_t start = offset >> unit_order;
+  uint64_t end = std::min(num_units,
+			  ROUND_UP_TO(offset + length, unit) >> unit_order);
+  if (start < end)
+    num_free -= _mark_used(start, end - start) << unit_order;
+}
+
+void FastBitmapAllocator::shutdown()
+{
+  ldout(cct, 1) << __func__ << dendl;
+  _flush_shards();
+}
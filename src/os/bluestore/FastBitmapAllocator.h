@@ -0,0 +1,101 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_OS_BLUESTORE_FASTBITMAPALLOCATOR_H
+#define CEPH_OS_BLUESTORE_FASTBITMAPALLOCATOR_H
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "Allocator.h"
+#include "os/bluestore/bluestore_types.h"
+#include "include/mempool.h"
+
+/*
+ * Flat bitmap allocator with a summary hierarchy on top.
+ *
+ * Level 0 has one bit per allocation unit (set == free).  Each bit at
+ * level N > 0 says whether the corresponding 64-bit word at level N-1
+ * has any free unit, so finding the next free unit skips empty regions
+ * 64x faster per level.
+ *
+ * Small allocations are served from per-shard caches of extents that
+ * were pulled out of the bitmap in chunks, so concurrent allocators
+ * (different kv/aio threads) mostly contend on their own shard lock
+ * rather than on the global one.  Cached extents still count as free;
+ * they are handed back to the bitmap whenever the free map is modified
+ * directly (init_add_free/init_rm_free) or the bitmap alone cannot
+ * satisfy a request.
+ */
+class FastBitmapAllocator : public Allocator {
+  typedef std::pair<uint64_t,uint64_t> unit_extent_t;  ///< start, count (units)
+
+  struct Shard {
+    std::mutex lock;
+    /// cached free extents; consumed from the back
+    mempool::bluestore_alloc::vector<unit_extent_t> extents;
+    uint64_t units = 0;      ///< total units in extents
+  };
+
+  CephContext* cct;
+  uint64_t unit;             ///< bytes per level 0 bit
+  unsigned unit_order;
+  uint64_t num_units;        ///< usable units on the device
+  uint64_t cache_chunk;      ///< units a shard pulls from the bitmap at once
+  uint64_t cache_max_want;   ///< larger requests bypass the shard caches
+
+  std::mutex lock;           ///< protects levels and cursor
+  std::vector<mempool::bluestore_alloc::vector<uint64_t>> levels;
+  uint64_t cursor = 0;       ///< next-fit position (units)
+
+  std::atomic<int64_t> num_free = {0};     ///< bytes free (incl. shard caches)
+  std::atomic<int64_t> num_reserved = {0}; ///< reserved bytes
+
+  std::vector<Shard> shards;
+
+  uint64_t _find_next_free(uint64_t pos) const;
+  uint64_t _find_next_used(uint64_t pos, uint64_t end) const;
+  void _update_summary(uint64_t first_word, uint64_t last_word);
+  uint64_t _mark_free(uint64_t start, uint64_t count);
+  uint64_t _mark_used(uint64_t start, uint64_t count);
+
+  template <typename F>
+  uint64_t _allocate_units(uint64_t want, uint64_t au, uint64_t max_units,
+			   uint64_t pos, F&& emit);
+
+  Shard& _get_shard();
+  uint64_t _allocate_from_shard(Shard& s, uint64_t want, uint64_t max_units,
+				ExtentList *block_list);
+  void _flush_shard(Shard& s);
+  void _flush_shards();
+
+  void _count_free_runs(uint64_t *runs, uint64_t *units) const;
+
+public:
+  FastBitmapAllocator(CephContext* cct, int64_t device_size,
+		      int64_t block_size);
+  ~FastBitmapAllocator() override;
+
+  int reserve(uint64_t need) override;
+  void unreserve(uint64_t unused) override;
+
+  int64_t allocate(
+    uint64_t want_size, uint64_t alloc_unit, uint64_t max_alloc_size,
+    int64_t hint, AllocExtentVector *extents) override;
+
+  void release(
+    const interval_set<uint64_t>& release_set) override;
+
+  uint64_t get_free() override;
+  double get_fragmentation(uint64_t alloc_unit) override;
+
+  void dump() override;
+
+  void init_add_free(uint64_t offset, uint64_t length) override;
+  void init_rm_free(uint64_t offset, uint64_t length) override;
+
+  void shutdown() override;
+};
+
+#endif
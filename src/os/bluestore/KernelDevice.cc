@@ -39,11 +39,25 @@ KernelDevice::KernelDevice(CephContext* cct, aio_callback_t cb, void *cbpriv)
     fd_buffered(-1),
     fs(NULL), aio(false), dio(false),
     debug_lock("KernelDevice::debug_lock"),
-    aio_queue(cct->_conf->bdev_aio_max_queue_depth),
     aio_stop(false),
     aio_thread(this),
     injecting_crash(0)
 {
+  unsigned iodepth = cct->_conf->bdev_aio_max_queue_depth;
+  if (cct->_conf->bdev_ioring) {
+    if (ioring_queue_t::supported()) {
+      use_ioring = true;
+      io_queue.reset(new ioring_queue_t(iodepth,
+					cct->_conf->bdev_ioring_sqthread_poll));
+    } else {
+      derr << __func__ << " bdev_ioring is set but io_uring is not available"
+	   << " (built without liburing or kernel too old);"
+	   << " falling back to libaio" << dendl;
+    }
+  }
+  if (!io_queue) {
+    io_queue.reset(new aio_queue_t(iodepth));
+  }
 }
 
 int KernelDevice::_lock()
@@ -204,6 +218,7 @@ int KernelDevice::collect_metadata(const string& prefix, map<string,string> *pm)
   (*pm)[prefix + "size"] = stringify(get_size());
   (*pm)[prefix + "block_size"] = stringify(get_block_size());
   (*pm)[prefix + "driver"] = "KernelDevice";
+  (*pm)[prefix + "io_backend"] = use_ioring ? "io_uring" : "libaio";
   if (rotational) {
     (*pm)[prefix + "type"] = "hdd";
   } else {
@@ -303,10 +318,15 @@ int KernelDevice::flush()
 int KernelDevice::_aio_start()
 {
   if (aio) {
-    dout(10) << __func__ << dendl;
-    int r = aio_queue.init();
+    dout(10) << __func__ << " using "
+	     << (use_ioring ? "io_uring" : "libaio") << dendl;
+    std::vector<int> fds = { fd_direct, fd_buffered };
+    int r = io_queue->init(fds);
     if (r < 0) {
-      if (r == -EAGAIN) {
+      if (use_ioring) {
+	derr << __func__ << " io_uring setup failed: " << cpp_strerror(r)
+	     << dendl;
+      } else if (r == -EAGAIN) {
 	derr << __func__ << " io_setup(2) failed with EAGAIN; "
 	     << "try increasing /proc/sys/fs/aio-max-nr" << dendl;
       } else {
@@ -326,7 +346,7 @@ void KernelDevice::_aio_stop()
     aio_stop = true;
     aio_thread.join();
     aio_stop = false;
-    aio_queue.shutdown();
+    io_queue->shutdown();
   }
 }
 
@@ -338,7 +358,7 @@ void KernelDevice::_aio_thread()
     dout(40) << __func__ << " polling" << dendl;
     int max = cct->_conf->bdev_aio_reap_max;
     aio_t *aio[max];
-    int r = aio_queue.get_next_completed(cct->_conf->bdev_aio_poll_ms,
+    int r = io_queue->get_next_completed(cct->_conf->bdev_aio_poll_ms,
 					 aio, max);
     if (r < 0) {
       derr << __func__ << " got " << cpp_strerror(r) << dendl;
@@ -521,7 +541,7 @@ void KernelDevice::aio_submit(IOContext *ioc)
 
   void *priv = static_cast<void*>(ioc);
   int r, retries = 0;
-  r = aio_queue.submit_batch(ioc->running_aios.begin(), e, 
+  r = io_queue->submit_batch(ioc->running_aios.begin(), e,
 			     pending, priv, &retries);
   
   if (retries)
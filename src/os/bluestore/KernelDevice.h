@@ -21,6 +21,7 @@
 #include "include/interval_set.h"
 
 #include "aio.h"
+#include "io_uring.h"
 #include "BlockDevice.h"
 
 class KernelDevice : public BlockDevice {
@@ -35,7 +36,8 @@ class KernelDevice : public BlockDevice {
   std::atomic<bool> io_since_flush = {false};
   std::mutex flush_mutex;
 
-  aio_queue_t aio_queue;
+  std::unique_ptr<io_queue_t> io_queue;
+  bool use_ioring = false;  ///< io_queue is an io_uring rather than libaio
   bool aio_stop;
 
   struct AioCompletionThread : public Thread {
@@ -263,6 +263,19 @@ uint64_t StupidAllocator::get_free()
   return num_free;
 }
 
+double StupidAllocator::get_fragmentation(uint64_t alloc_unit)
+{
+  std::lock_guard<std::mutex> l(lock);
+  uint64_t intervals = 0;
+  for (unsigned bin = 0; bin < free.size(); ++bin) {
+    intervals += free[bin].num_intervals();
+  }
+  uint64_t blocks = num_free / alloc_unit;
+  if (intervals <= 1 || blocks <= 1)
+    return 0.0;
+  return std::min(1.0, (double)(intervals - 1) / (double)(blocks - 1));
+}
+
 void StupidAllocator::dump()
 {
   std::lock_guard<std::mutex> l(lock);
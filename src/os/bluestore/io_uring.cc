@@ -0,0 +1,244 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "io_uring.h"
+
+#if defined(HAVE_LIBAIO) && defined(HAVE_LIBURING)
+
+#include <sys/epoll.h>
+#include <liburing.h>
+
+#include <map>
+#include <mutex>
+
+struct ioring_data {
+  struct io_uring io_uring;
+  std::mutex sq_mutex;   ///< the submission ring is single producer
+  std::mutex cq_mutex;   ///< ... and so is the completion ring consumer
+  int epoll_fd = -1;
+  std::map<int, int> fixed_fds_map;  ///< real fd -> registered index
+};
+
+static int ioring_get_cqe(ioring_data *d, unsigned int max, aio_t **paio)
+{
+  struct io_uring *ring = &d->io_uring;
+  struct io_uring_cqe *cqe;
+
+  unsigned nr = 0;
+  unsigned head;
+  io_uring_for_each_cqe(ring, head, cqe) {
+    aio_t *io = (aio_t *)(uintptr_t) io_uring_cqe_get_data(cqe);
+    io->rval = cqe->res;
+    paio[nr++] = io;
+    if (nr == max)
+      break;
+  }
+  io_uring_cq_advance(ring, nr);
+  return nr;
+}
+
+static int find_fixed_fd(ioring_data *d, int real_fd)
+{
+  auto it = d->fixed_fds_map.find(real_fd);
+  if (it == d->fixed_fds_map.end())
+    return -1;
+  return it->second;
+}
+
+static void init_sqe(ioring_data *d, struct io_uring_sqe *sqe, aio_t *io)
+{
+  int fixed_fd = find_fixed_fd(d, io->fd);
+  assert(fixed_fd != -1);
+
+  if (io->iocb.aio_lio_opcode == IO_CMD_PWRITEV) {
+    io_uring_prep_writev(sqe, fixed_fd, &io->iov[0],
+			 io->iov.size(), io->offset);
+  } else if (io->iocb.aio_lio_opcode == IO_CMD_PREAD) {
+    // aio_t::pread() mirrors its buffer into iov for our benefit
+    io_uring_prep_readv(sqe, fixed_fd, &io->iov[0],
+			io->iov.size(), io->offset);
+  } else {
+    assert(0 == "unknown aio opcode");
+  }
+  io_uring_sqe_set_data(sqe, io);
+  io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+}
+
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool sq_thread_)
+  : d(new ioring_data),
+    iodepth(iodepth_),
+    sq_thread(sq_thread_)
+{
+}
+
+ioring_queue_t::~ioring_queue_t()
+{
+  assert(d->epoll_fd == -1);
+}
+
+bool ioring_queue_t::supported()
+{
+  struct io_uring ring;
+  int r = io_uring_queue_init(16, &ring, 0);
+  if (r < 0)
+    return false;
+  io_uring_queue_exit(&ring);
+  return true;
+}
+
+int ioring_queue_t::init(std::vector<int> &fds)
+{
+  unsigned flags = 0;
+  if (sq_thread)
+    flags |= IORING_SETUP_SQPOLL;
+
+  int r = io_uring_queue_init(iodepth, &d->io_uring, flags);
+  if (r < 0)
+    return r;
+
+  r = io_uring_register_files(&d->io_uring, &fds[0], fds.size());
+  if (r < 0)
+    goto out_ring;
+  for (unsigned i = 0; i < fds.size(); ++i)
+    d->fixed_fds_map[fds[i]] = i;
+
+  d->epoll_fd = epoll_create1(0);
+  if (d->epoll_fd < 0) {
+    r = -errno;
+    goto out_files;
+  }
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = nullptr;
+  r = epoll_ctl(d->epoll_fd, EPOLL_CTL_ADD, d->io_uring.ring_fd, &ev);
+  if (r < 0) {
+    r = -errno;
+    goto out_epoll;
+  }
+  return 0;
+
+ out_epoll:
+  ::close(d->epoll_fd);
+  d->epoll_fd = -1;
+ out_files:
+  d->fixed_fds_map.clear();
+  io_uring_unregister_files(&d->io_uring);
+ out_ring:
+  io_uring_queue_exit(&d->io_uring);
+  return r;
+}
+
+void ioring_queue_t::shutdown()
+{
+  d->fixed_fds_map.clear();
+  ::close(d->epoll_fd);
+  d->epoll_fd = -1;
+  io_uring_queue_exit(&d->io_uring);
+}
+
+int ioring_queue_t::submit_batch(aio_iter beg, aio_iter end,
+				 uint16_t aios_size, void *priv,
+				 int *retries)
+{
+  // same backoff as aio_queue_t: ~16 seconds worst case
+  int attempts = 16;
+  int delay = 125;
+
+  std::lock_guard<std::mutex> l(d->sq_mutex);
+  struct io_uring *ring = &d->io_uring;
+
+  int queued = 0;
+  aio_iter cur = beg;
+  while (cur != end) {
+    struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+    if (!sqe) {
+      // the submission ring is full; hand what we have to the kernel
+      // and, if it did not take anything, wait for completions.
+      int r = io_uring_submit(ring);
+      if (r < 0)
+	return r;
+      if (r == 0) {
+	if (attempts-- <= 0)
+	  return -EAGAIN;
+	usleep(delay);
+	delay *= 2;
+	(*retries)++;
+      }
+      continue;
+    }
+    cur->priv = priv;
+    init_sqe(d.get(), sqe, &*cur);
+    ++queued;
+    ++cur;
+  }
+  assert(aios_size >= queued);
+
+  int r = io_uring_submit(ring);
+  if (r < 0)
+    return r;
+  return queued;
+}
+
+int ioring_queue_t::get_next_completed(int timeout_ms, aio_t **paio, int max)
+{
+  std::lock_guard<std::mutex> l(d->cq_mutex);
+
+  int events = ioring_get_cqe(d.get(), max, paio);
+  if (events)
+    return events;
+
+  struct epoll_event ev;
+  int r = epoll_wait(d->epoll_fd, &ev, 1, timeout_ms);
+  if (r < 0) {
+    if (errno == EINTR)
+      return 0;
+    return -errno;
+  }
+  if (r == 0)
+    return 0;
+  return ioring_get_cqe(d.get(), max, paio);
+}
+
+#elif defined(HAVE_LIBAIO)
+
+struct ioring_data {};
+
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool sq_thread_)
+{
+  (void)iodepth_;
+  (void)sq_thread_;
+  assert(0 == "ioring_queue_t without liburing");
+}
+
+ioring_queue_t::~ioring_queue_t()
+{
+}
+
+bool ioring_queue_t::supported()
+{
+  return false;
+}
+
+int ioring_queue_t::init(std::vector<int> &fds)
+{
+  return -EOPNOTSUPP;
+}
+
+void ioring_queue_t::shutdown()
+{
+}
+
+int ioring_queue_t::submit_batch(aio_iter beg, aio_iter end,
+				 uint16_t aios_size, void *priv,
+				 int *retries)
+{
+  return -EOPNOTSUPP;
+}
+
+int ioring_queue_t::get_next_completed(int timeout_ms, aio_t **paio, int max)
+{
+  return -EOPNOTSUPP;
+}
+
+#endif
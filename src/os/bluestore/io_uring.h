@@ -0,0 +1,43 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include "acconfig.h"
+
+#include "aio.h"
+
+#ifdef HAVE_LIBAIO
+
+struct ioring_data;
+
+/**
+ * io_uring backed implementation of io_queue_t
+ *
+ * The whole batch handed to submit_batch() is placed on the submission
+ * ring and pushed to the kernel with a single io_uring_enter(2); the
+ * device fds are registered up front so the kernel does not need to
+ * take a reference on the file for every io.  Optionally a kernel
+ * thread polls the submission ring so that no syscall is needed at all
+ * on the submit path.
+ */
+struct ioring_queue_t final : public io_queue_t {
+  std::unique_ptr<ioring_data> d;
+  unsigned iodepth = 0;
+  bool sq_thread = false;
+
+  ioring_queue_t(unsigned iodepth_, bool sq_thread_);
+  ~ioring_queue_t() final;
+
+  /// true if we were built with liburing and the running kernel has it
+  static bool supported();
+
+  int init(std::vector<int> &fds) final;
+  void shutdown() final;
+
+  int submit_batch(aio_iter begin, aio_iter end, uint16_t aios_size,
+		   void *priv, int *retries) final;
+  int get_next_completed(int timeout_ms, aio_t **paio, int max) final;
+};
+
+#endif
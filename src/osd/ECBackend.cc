@@ -154,7 +154,19 @@ ostream &operator<<(ostream &lhs, const ECBackend::Op &rhs)
       << " pending_apply=" << rhs.pending_apply
       << " pending_commit=" << rhs.pending_commit
       << " plan.to_read=" << rhs.plan.to_read
-      << " plan.will_write=" << rhs.plan.will_write
+      << " plan.will_write=" << rhs.plan.will_write;
+  if (!rhs.plan.delta_writes.empty()) {
+    lhs << " plan.delta_writes=[";
+    for (auto i = rhs.plan.delta_writes.begin();
+	 i != rhs.plan.delta_writes.end();
+	 ++i) {
+      if (i != rhs.plan.delta_writes.begin())
+	lhs << ",";
+      lhs << i->first;
+    }
+    lhs << "]";
+  }
+  lhs << " pending_reads=" << rhs.pending_reads
       << ")";
   return lhs;
 }
@@ -197,6 +209,7 @@ ECBackend::ECBackend(
   ErasureCodeInterfaceRef ec_impl,
   uint64_t stripe_width)
   : PGBackend(cct, pg, store, coll, ch),
+    read_cache(pg->get_ec_read_cache()),
     ec_impl(ec_impl),
     sinfo(ec_impl->get_data_chunk_count(), stripe_width) {
   assert((ec_impl->get_data_chunk_count() *
@@ -408,7 +421,8 @@ void ECBackend::handle_recovery_read_complete(
     from[i->first.shard].claim(i->second);
   }
   dout(10) << __func__ << ": " << from << dendl;
-  int r = ECUtil::decode(sinfo, ec_impl, from, target);
+  int r = ECUtil::decode(sinfo, ec_impl, from, target,
+			 get_parent()->get_ec_stripe_coder());
   assert(r == 0);
   if (attrs) {
     op.xattrs.swap(*attrs);
@@ -1184,6 +1198,19 @@ void ECBackend::handle_sub_read_reply(
 
   assert(rop.in_progress.count(from));
   rop.in_progress.erase(from);
+  if (rop.exact) {
+    // the caller wants these shards and nothing else
+    if (rop.in_progress.empty()) {
+      for (auto &&i: rop.complete) {
+	if (!i.second.errors.empty())
+	  i.second.r = -EIO;
+      }
+      dout(20) << __func__ << " Complete: " << rop << dendl;
+      rop.trace.event("ec read complete");
+      complete_read_op(rop, m);
+    }
+    return;
+  }
   unsigned is_complete = 0;
   // For redundant reads check for completion as each shard comes in,
   // or in a non-recovery read check for completion once all the shards read.
@@ -1398,6 +1425,7 @@ void ECBackend::on_change()
   }
   tid_to_read_map.clear();
   in_progress_client_reads.clear();
+  read_cache->clear(get_parent()->whoami_spg_t());
   shard_to_read_map.clear();
   clear_recovery_state();
 }
@@ -1606,7 +1634,8 @@ void ECBackend::start_read_op(
   map<hobject_t, read_request_t> &to_read,
   OpRequestRef _op,
   bool do_redundant_reads,
-  bool for_recovery)
+  bool for_recovery,
+  bool exact)
 {
   ceph_tid_t tid = get_parent()->get_tid();
   assert(!tid_to_read_map.count(tid));
@@ -1619,6 +1648,7 @@ void ECBackend::start_read_op(
       for_recovery,
       _op,
       std::move(to_read))).first->second;
+  op.exact = exact;
   dout(10) << __func__ << ": starting " << op << dendl;
   if (_op) {
     op.trace = _op->pg_trace;
@@ -1767,10 +1797,13 @@ void ECBackend::start_rmw(Op *op, PGTransactionUPtr &&t)
       }
       return ref;
     },
-    get_parent()->get_dpp());
+    get_parent()->get_dpp(),
+    get_parity_delta_max_chunks());
 
   dout(10) << __func__ << ": " << *op << dendl;
 
+  for (auto &&e: op->log_entries)
+    read_cache->invalidate(e.soid);
   waiting_state.push_back(*op);
   check_ops();
 }
@@ -1799,6 +1832,21 @@ bool ECBackend::try_state_to_reads()
     op->using_cache = pipeline_state.caching_enabled();
   }
 
+  for (auto i = op->plan.delta_writes.begin();
+       i != op->plan.delta_writes.end();
+       ) {
+    if (op->using_cache && can_delta_write(i->first)) {
+      dout(20) << __func__ << ": " << i->first
+	       << " writing chunks " << i->second.chunks
+	       << " with parity deltas" << dendl;
+      op->plan.to_read[i->first] = i->second.chunks;
+      op->plan.will_write[i->first] = i->second.chunks;
+      ++i;
+    } else {
+      op->plan.delta_writes.erase(i++);
+    }
+  }
+
   waiting_state.pop_front();
   waiting_reads.push_back(*op);
 
@@ -1837,19 +1885,213 @@ bool ECBackend::try_state_to_reads()
 
   if (!op->remote_read.empty()) {
     assert(get_parent()->get_pool().allows_ecoverwrites());
-    objects_read_async_no_cache(
-      op->remote_read,
-      [this, op](map<hobject_t,pair<int, extent_map> > &&results) {
-	for (auto &&i: results) {
-	  op->remote_read_result.emplace(i.first, i.second.second);
-	}
-	check_ops();
-      });
+    map<hobject_t,extent_set> to_read;
+    for (const auto &hpair: op->remote_read) {
+      if (op->plan.delta_writes.count(hpair.first))
+	continue;
+      // delta writes pin single chunks, but shards are read in
+      // whole stripes
+      for (auto extent: hpair.second) {
+	auto bounds = sinfo.offset_len_to_stripe_bounds(extent);
+	to_read[hpair.first].union_insert(bounds.first, bounds.second);
+      }
+    }
+    if (!to_read.empty()) {
+      ++op->pending_reads;
+      objects_read_async_no_cache(
+	to_read,
+	[this, op](map<hobject_t,pair<int, extent_map> > &&results) {
+	  for (auto &&i: results) {
+	    auto &result = op->remote_read_result[i.first];
+	    const extent_set &wanted = op->remote_read[i.first];
+	    for (auto extent: wanted) {
+	      result.insert(
+		i.second.second.intersect(extent.first, extent.second));
+	    }
+	  }
+	  --op->pending_reads;
+	  check_ops();
+	});
+    }
+    if (!op->plan.delta_writes.empty())
+      start_delta_reads(op);
   }
 
   return true;
 }
 
+unsigned ECBackend::get_parity_delta_max_chunks() const
+{
+  if (!cct->_conf->osd_ec_parity_delta_writes ||
+      !get_parent()->get_pool().allows_ecoverwrites() ||
+      !ec_impl->supports_parity_delta() ||
+      !ec_impl->get_chunk_mapping().empty())
+    return 0;
+  // The criterion is total shard I/O, reads plus writes.  A delta
+  // write of t chunks reads and writes the t data chunks and the m
+  // coding chunks, 2(t + m) shard ops; a full-stripe read-modify-write
+  // reads k and writes k + m, 2k + m.  The delta wins for
+  // t <= (2k - m - 1) / 2.  It may read more shards than the RMW would
+  // (t + m > k, e.g. k=8 m=3 t=6 reads 9 against 8) but it writes
+  // fewer, and writes are the expensive half.
+  int k = ec_impl->get_data_chunk_count();
+  int m = ec_impl->get_coding_chunk_count();
+  int max_chunks = (2 * k - m - 1) / 2;
+  return max_chunks > 0 ? max_chunks : 0;
+}
+
+bool ECBackend::can_delta_write(const hobject_t &hoid) const
+{
+  // an earlier write may not have reached the shards yet, and the
+  // cache only holds logical data, not the coding chunks
+  for (auto &&op: waiting_reads) {
+    if (op.plan.will_write.count(hoid))
+      return false;
+  }
+  for (auto &&op: waiting_commit) {
+    if (op.plan.will_write.count(hoid))
+      return false;
+  }
+  // every shard must be readable; later rmw reads then never need to
+  // decode through the coding chunks we are rewriting
+  set<int> have;
+  for (auto &&shard: get_parent()->get_acting_shards()) {
+    if (!get_parent()->get_shard_missing(shard).is_missing(hoid))
+      have.insert(shard.shard);
+  }
+  return have.size() == ec_impl->get_chunk_count();
+}
+
+struct FinishDeltaRead :
+  public GenContext<pair<RecoveryMessages*, ECBackend::read_result_t& > &> {
+  ECBackend *ec;
+  ECBackend::Op *op;
+  hobject_t hoid;
+  FinishDeltaRead(ECBackend *ec, ECBackend::Op *op, const hobject_t &hoid)
+    : ec(ec), op(op), hoid(hoid) {}
+  void finish(pair<RecoveryMessages *, ECBackend::read_result_t &> &in) override {
+    ec->handle_delta_read(op, hoid, in.second);
+  }
+};
+
+void ECBackend::start_delta_reads(Op *op)
+{
+  map<hobject_t, read_request_t> for_read_op;
+  for (auto &&hpair: op->plan.delta_writes) {
+    const ECTransaction::DeltaWrite &delta = hpair.second;
+    // nothing else in flight writes the object, so nothing is pinned
+    assert(!op->pending_read.count(hpair.first));
+
+    set<int> want = delta.data_shards;
+    for (unsigned i = ec_impl->get_data_chunk_count();
+	 i < ec_impl->get_chunk_count();
+	 ++i) {
+      want.insert(i);
+    }
+    set<pg_shard_t> need;
+    for (auto &&shard: get_parent()->get_acting_shards()) {
+      if (want.count(shard.shard))
+	need.insert(shard);
+    }
+    assert(need.size() == want.size());
+
+    list<boost::tuple<uint64_t, uint64_t, uint32_t> > to_read;
+    for (auto extent: delta.stripes) {
+      to_read.push_back(boost::make_tuple(extent.first, extent.second, 0));
+    }
+    for_read_op.insert(
+      make_pair(
+	hpair.first,
+	read_request_t(
+	  to_read,
+	  need,
+	  false,
+	  new FinishDeltaRead(this, op, hpair.first))));
+    ++op->pending_reads;
+  }
+  start_read_op(
+    CEPH_MSG_PRIO_DEFAULT,
+    for_read_op,
+    OpRequestRef(),
+    false, false, true);
+}
+
+void ECBackend::handle_delta_read(
+  Op *op,
+  const hobject_t &hoid,
+  read_result_t &res)
+{
+  auto &delta = op->plan.delta_writes.at(hoid);
+  int r = res.r;
+  for (auto &&extent: res.returned) {
+    if (r < 0)
+      break;
+    auto chunk = sinfo.aligned_offset_len_to_chunk(
+      make_pair(extent.get<0>(), extent.get<1>()));
+    for (auto &&shard: extent.get<2>()) {
+      if (shard.second.length() != chunk.second) {
+	r = -EIO;
+	break;
+      }
+      delta.old_shards[shard.first.shard].insert(
+	chunk.first, chunk.second, shard.second);
+    }
+  }
+  if (r == 0 &&
+      delta.old_shards.size() !=
+      delta.data_shards.size() + ec_impl->get_coding_chunk_count())
+    r = -EIO;
+  if (r == 0) {
+    --op->pending_reads;
+    check_ops();
+    return;
+  }
+
+  // Reconstruct the stripes the usual way and re-encode them to get
+  // the shard contents.  This also repairs whatever made the raw read
+  // fail, since the coding chunks are written in full.
+  dout(5) << __func__ << ": " << hoid << " raw shard read failed (" << r
+	  << "), reconstructing " << delta.stripes << dendl;
+  delta.old_shards.clear();
+  map<hobject_t,extent_set> to_read;
+  to_read[hoid] = delta.stripes;
+  objects_read_async_no_cache(
+    to_read,
+    [this, op, hoid](map<hobject_t,pair<int, extent_map> > &&results) {
+      auto &delta = op->plan.delta_writes.at(hoid);
+      set<int> want;
+      for (unsigned i = 0; i < ec_impl->get_chunk_count(); ++i) {
+	want.insert(i);
+      }
+      for (auto &&i: results) {
+	if (i.second.first < 0) {
+	  derr << __func__ << ": unable to read " << i.first
+	       << " for a parity delta write: "
+	       << cpp_strerror(i.second.first) << dendl;
+	  ceph_abort();
+	}
+	for (auto &&extent: i.second.second) {
+	  bufferlist bl = extent.get_val();
+	  map<int, bufferlist> encoded;
+	  int r = ECUtil::encode(sinfo, ec_impl, bl, want, &encoded,
+				 get_parent()->get_ec_stripe_coder());
+	  assert(r == 0);
+	  uint64_t off = sinfo.aligned_logical_offset_to_chunk_offset(
+	    extent.get_off());
+	  for (auto &&chunk: encoded) {
+	    if (chunk.first < (int)ec_impl->get_data_chunk_count() &&
+		!delta.data_shards.count(chunk.first))
+	      continue;
+	    delta.old_shards[chunk.first].insert(
+	      off, chunk.second.length(), chunk.second);
+	  }
+	}
+      }
+      --op->pending_reads;
+      check_ops();
+    });
+}
+
 bool ECBackend::try_reads_to_commit()
 {
   if (waiting_reads.empty())
@@ -1903,7 +2145,8 @@ bool ECBackend::try_reads_to_commit()
       &trans,
       &(op->temp_added),
       &(op->temp_cleared),
-      get_parent()->get_dpp());
+      get_parent()->get_dpp(),
+      get_parent()->get_ec_stripe_coder());
   }
 
   dout(20) << __func__ << ": " << cache << dendl;
@@ -1927,6 +2170,13 @@ bool ECBackend::try_reads_to_commit()
   dout(20) << __func__ << ": written_set: " << written_set << dendl;
   assert(written_set == op->plan.will_write);
 
+  for (auto &&hpair: op->plan.to_read) {
+    if (op->plan.delta_writes.count(hpair.first))
+      get_parent()->get_logger()->inc(l_osd_ec_delta_write);
+    else
+      get_parent()->get_logger()->inc(l_osd_ec_rmw_write);
+  }
+
   if (op->using_cache) {
     for (auto &&hpair: written) {
       dout(20) << __func__ << ": " << hpair << dendl;
@@ -2046,6 +2296,10 @@ bool ECBackend::try_finish_rmw()
   if (op->using_cache) {
     cache.release_write_pin(op->pin);
   }
+  // a read that started while this write was in flight may have
+  // fetched the old contents
+  for (auto &&e: op->log_entries)
+    read_cache->invalidate(e.soid);
   tid_to_op_map.erase(op->tid);
 
   if (waiting_reads.empty() &&
@@ -2102,7 +2356,21 @@ void ECBackend::objects_read_async(
     flags |= i->first.get<2>();
   }
 
-  if (!es.empty()) {
+  bool use_cache = cct->_conf->osd_ec_read_cache_size && !es.empty() &&
+    es.size() <= cct->_conf->osd_ec_read_cache_max_read;
+  extent_map cached;
+  if (use_cache) {
+    if (read_cache->lookup(hoid, es, &cached)) {
+      dout(20) << __func__ << ": " << hoid << " " << es
+	       << " served from read cache" << dendl;
+      get_parent()->get_logger()->inc(l_osd_ec_read_cache_hit);
+    } else {
+      get_parent()->get_logger()->inc(l_osd_ec_read_cache_miss);
+      read_cache->start_read(get_parent()->whoami_spg_t(), hoid);
+    }
+  }
+
+  if (!es.empty() && cached.empty()) {
     auto &offsets = reads[hoid];
     for (auto j = es.begin();
 	 j != es.end();
@@ -2121,17 +2389,27 @@ void ECBackend::objects_read_async(
     list<pair<boost::tuple<uint64_t, uint64_t, uint32_t>,
 	      pair<bufferlist*, Context*> > > to_read;
     unique_ptr<Context> on_complete;
+    bool cache_pending;
     cb(const cb&) = delete;
-    cb(cb &&) = default;
+    cb(cb &&o)
+      : ec(o.ec),
+	hoid(std::move(o.hoid)),
+	to_read(std::move(o.to_read)),
+	on_complete(std::move(o.on_complete)),
+	cache_pending(o.cache_pending) {
+      o.cache_pending = false;
+    }
     cb(ECBackend *ec,
        const hobject_t &hoid,
        const list<pair<boost::tuple<uint64_t, uint64_t, uint32_t>,
                   pair<bufferlist*, Context*> > > &to_read,
-       Context *on_complete)
+       Context *on_complete,
+       bool cache_pending)
       : ec(ec),
 	hoid(hoid),
 	to_read(to_read),
-	on_complete(on_complete) {}
+	on_complete(on_complete),
+	cache_pending(cache_pending) {}
     void operator()(map<hobject_t,pair<int, extent_map> > &&results) {
       auto dpp = ec->get_parent()->get_dpp();
       ldpp_dout(dpp, 20) << "objects_read_async_cb: got: " << results
@@ -2140,6 +2418,11 @@ void ECBackend::objects_read_async(
 			 << dendl;
 
       auto &got = results[hoid];
+      if (cache_pending) {
+	ec->read_cache->finish_read(
+	  hoid, got.first < 0 ? nullptr : &got.second);
+	cache_pending = false;
+      }
 
       int r = 0;
       for (auto &&read: to_read) {
@@ -2175,12 +2458,30 @@ void ECBackend::objects_read_async(
       }
     }
     ~cb() {
+      if (cache_pending)
+	ec->read_cache->finish_read(hoid, nullptr);
       for (auto &&i: to_read) {
 	delete i.second.second;
       }
       to_read.clear();
     }
   };
+  if (!cached.empty()) {
+    // complete behind any client reads still in flight, as a miss would
+    in_progress_client_reads.emplace_back(
+      0,
+      make_gen_lambda_context<
+	map<hobject_t,pair<int, extent_map> > &&, cb>(
+	  cb(this,
+	     hoid,
+	     to_read,
+	     on_complete,
+	     false)));
+    in_progress_client_reads.back().results.emplace(
+      hoid, make_pair(0, std::move(cached)));
+    kick_reads();
+    return;
+  }
   objects_read_and_reconstruct(
     reads,
     fast_read,
@@ -2189,7 +2490,8 @@ void ECBackend::objects_read_async(
 	cb(this,
 	   hoid,
 	   to_read,
-	   on_complete)));
+	   on_complete,
+	   use_cache)));
 }
 
 struct CallClientContexts :
@@ -2230,7 +2532,8 @@ struct CallClientContexts :
 	ec->sinfo,
 	ec->ec_impl,
 	to_decode,
-	&bl);
+	&bl,
+	ec->get_parent()->get_ec_stripe_coder());
       if (r < 0) {
         res.r = r;
         goto out;
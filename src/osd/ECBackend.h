@@ -176,6 +176,8 @@ public:
       func.release()->complete(std::move(results));
     }
   };
+  /// the OSD's cache of reconstructed client reads
+  ECReadCache *read_cache;
   list<ClientAsyncReadStatus> in_progress_client_reads;
   void objects_read_async(
     const hobject_t &hoid,
@@ -383,6 +385,9 @@ public:
     // True if reading for recovery which could possibly reading only a subset
     // of the available shards.
     bool for_recovery;
+    // True if the raw contents of exactly the shards in need are wanted
+    // (parity delta writes): never read other shards, fail on any error.
+    bool exact = false;
 
     ZTracer::Trace trace;
 
@@ -432,7 +437,7 @@ public:
     int priority,
     map<hobject_t, read_request_t> &to_read,
     OpRequestRef op,
-    bool do_redundant_reads, bool for_recovery);
+    bool do_redundant_reads, bool for_recovery, bool exact = false);
 
   void do_read_op(ReadOp &rop);
   int send_all_remaining_reads(
@@ -488,8 +493,9 @@ public:
     map<hobject_t,extent_set> pending_read; // subset already being read
     map<hobject_t,extent_set> remote_read;  // subset we must read
     map<hobject_t,extent_map> remote_read_result;
+    unsigned pending_reads = 0;  // outstanding remote/delta reads
     bool read_in_progress() const {
-      return !remote_read.empty() && remote_read_result.empty();
+      return pending_reads > 0;
     }
 
     /// In progress write state
@@ -517,6 +523,23 @@ public:
   };
   using op_list = boost::intrusive::list<Op>;
   friend ostream &operator<<(ostream &lhs, const Op &rhs);
+  friend struct FinishDeltaRead;
+
+  /**
+   * Parity delta writes
+   *
+   * get_write_plan marks small overwrites as candidates; they are kept
+   * only if nothing earlier in the pipeline writes the object (so the
+   * raw shards are current) and every shard is readable.  Their
+   * to_read/will_write are switched to the touched data chunks so the
+   * cache pins exactly what they rewrite, and the raw data and coding
+   * chunks of the touched stripes are read instead of the logical
+   * stripes.
+   */
+  unsigned get_parity_delta_max_chunks() const;
+  bool can_delta_write(const hobject_t &hoid) const;
+  void start_delta_reads(Op *op);
+  void handle_delta_read(Op *op, const hobject_t &hoid, read_result_t &res);
 
   ExtentCache cache;
   map<ceph_tid_t, Op> tid_to_op_map; /// Owns Op structure
@@ -35,7 +35,8 @@ void encode_and_write(
   ECUtil::HashInfoRef hinfo,
   extent_map &written,
   map<shard_id_t, ObjectStore::Transaction> *transactions,
-  DoutPrefixProvider *dpp) {
+  DoutPrefixProvider *dpp,
+  ECUtil::StripeCoder *coder) {
   const uint64_t before_size = hinfo->get_total_logical_size(sinfo);
   assert(sinfo.logical_offset_is_stripe_aligned(offset));
   assert(sinfo.logical_offset_is_stripe_aligned(bl.length()));
@@ -43,7 +44,7 @@ void encode_and_write(
 
   map<int, bufferlist> buffers;
   int r = ECUtil::encode(
-    sinfo, ecimpl, bl, want, &buffers);
+    sinfo, ecimpl, bl, want, &buffers, coder);
   assert(r == 0);
 
   written.insert(offset, bl.length(), bl);
@@ -82,6 +83,218 @@ void encode_and_write(
   }
 }
 
+bool ECTransaction::get_delta_write(
+  const ECUtil::stripe_info_t &sinfo,
+  unsigned max_chunks_per_stripe,
+  const extent_set &raw_write_set,
+  DeltaWrite *delta)
+{
+  const uint64_t chunk_size = sinfo.get_chunk_size();
+  const uint64_t stripe_width = sinfo.get_stripe_width();
+  for (auto extent: raw_write_set) {
+    uint64_t start = extent.first - (extent.first % chunk_size);
+    uint64_t end = extent.first + extent.second;
+    end += (chunk_size - (end % chunk_size)) % chunk_size;
+    delta->chunks.union_insert(start, end - start);
+  }
+  uint64_t stripe = UINT64_MAX;
+  unsigned in_stripe = 0;
+  const extent_set &chunks = delta->chunks;
+  for (auto extent: chunks) {
+    for (uint64_t off = extent.first;
+	 off < extent.first + extent.second;
+	 off += chunk_size) {
+      uint64_t s = sinfo.logical_to_prev_stripe_offset(off);
+      if (s != stripe) {
+	stripe = s;
+	in_stripe = 0;
+	delta->stripes.union_insert(s, stripe_width);
+      }
+      if (++in_stripe > max_chunks_per_stripe)
+	return false;
+      delta->data_shards.insert((off - s) / chunk_size);
+    }
+  }
+  return true;
+}
+
+static void xor_buffer(char *dst, const char *src, unsigned len)
+{
+  unsigned i = 0;
+  for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+    uint64_t a, b;
+    memcpy(&a, dst + i, sizeof(a));
+    memcpy(&b, src + i, sizeof(b));
+    a ^= b;
+    memcpy(dst + i, &a, sizeof(a));
+  }
+  for (; i < len; ++i)
+    dst[i] ^= src[i];
+}
+
+/// copy of one chunk of an extent_map read from a shard
+static bufferptr get_shard_chunk(
+  const extent_map &shard,
+  uint64_t off,
+  uint64_t len)
+{
+  bufferptr out(buffer::create_aligned(len, ECUtil::CHUNK_ALIGNMENT));
+  auto extents = shard.intersect(off, len);
+  assert(extents.begin() != extents.end());
+  assert(extents.begin().get_off() == off);
+  assert(extents.begin().get_len() == len);
+  extents.begin().get_val().copy(0, len, out.c_str());
+  return out;
+}
+
+/**
+ * Write the data chunks in delta.chunks in place and patch the coding
+ * chunks of their stripes: parity ^= encode_delta(old ^ new).  Every
+ * shard still saves the touched stripes for rollback so that the log
+ * entry describes the same extents everywhere.
+ */
+static void delta_write(
+  pg_t pgid,
+  const hobject_t &oid,
+  const ECUtil::stripe_info_t &sinfo,
+  ErasureCodeInterfaceRef &ecimpl,
+  const PGTransaction::ObjectOperation &op,
+  const ECTransaction::DeltaWrite &delta,
+  pg_log_entry_t *entry,
+  extent_map &written,
+  map<shard_id_t, ObjectStore::Transaction> *transactions,
+  DoutPrefixProvider *dpp)
+{
+  const uint64_t chunk_size = sinfo.get_chunk_size();
+  const int k = ecimpl->get_data_chunk_count();
+  const int n = ecimpl->get_chunk_count();
+
+  extent_map updates;
+  uint32_t fadvise_flags = 0;
+  for (auto &&extent: op.buffer_updates) {
+    using BufferUpdate = PGTransaction::ObjectOperation::BufferUpdate;
+    bufferlist bl;
+    match(
+      extent.get_val(),
+      [&](const BufferUpdate::Write &op) {
+	bl = op.buffer;
+	fadvise_flags |= op.fadvise_flags;
+      },
+      [&](const BufferUpdate::Zero &) {
+	bl.append_zero(extent.get_len());
+      },
+      [&](const BufferUpdate::CloneRange &) {
+	assert(
+	  0 ==
+	  "CloneRange is not allowed, do_op should have returned ENOTSUPP");
+      });
+    updates.insert(extent.get_off(), extent.get_len(), bl);
+  }
+
+  vector<pair<uint64_t, uint64_t> > rollback_extents;
+  for (auto stripes: delta.stripes) {
+    rollback_extents.emplace_back(
+      sinfo.aligned_offset_len_to_chunk(stripes));
+  }
+  ldpp_dout(dpp, 20) << __func__ << ": " << oid
+		     << " chunks " << delta.chunks
+		     << " saving extents " << rollback_extents
+		     << dendl;
+  for (auto &&st : *transactions) {
+    st.second.touch(
+      coll_t(spg_t(pgid, st.first)),
+      ghobject_t(oid, entry->version.version, st.first));
+    for (auto &&r: rollback_extents) {
+      st.second.clone_range(
+	coll_t(spg_t(pgid, st.first)),
+	ghobject_t(oid, ghobject_t::NO_GEN, st.first),
+	ghobject_t(oid, entry->version.version, st.first),
+	r.first,
+	r.second,
+	r.first);
+    }
+  }
+  entry->mod_desc.rollback_extents(
+    entry->version.version, rollback_extents);
+
+  map<int, extent_map> shard_writes;
+  auto chunk = delta.chunks.begin();
+  uint64_t chunk_off = chunk.get_start();
+  for (auto stripes: delta.stripes) {
+    for (uint64_t stripe = stripes.first;
+	 stripe < stripes.first + stripes.second;
+	 stripe += sinfo.get_stripe_width()) {
+      uint64_t shard_off = sinfo.aligned_logical_offset_to_chunk_offset(stripe);
+      map<int, bufferptr> parity;
+      for (int i = k; i < n; ++i) {
+	auto p = delta.old_shards.find(i);
+	assert(p != delta.old_shards.end());
+	parity[i] = get_shard_chunk(p->second, shard_off, chunk_size);
+      }
+
+      for (; chunk != delta.chunks.end() &&
+	     chunk_off < stripe + sinfo.get_stripe_width();) {
+	int j = (chunk_off - stripe) / chunk_size;
+	auto p = delta.old_shards.find(j);
+	assert(p != delta.old_shards.end());
+	bufferptr data = get_shard_chunk(p->second, shard_off, chunk_size);
+	bufferptr diff(buffer::create_aligned(chunk_size,
+					      ECUtil::CHUNK_ALIGNMENT));
+	memcpy(diff.c_str(), data.c_str(), chunk_size);
+	for (auto &&u: updates.intersect(chunk_off, chunk_size)) {
+	  u.get_val().copy(0, u.get_len(),
+			   data.c_str() + (u.get_off() - chunk_off));
+	}
+	xor_buffer(diff.c_str(), data.c_str(), chunk_size);
+
+	bufferlist diff_bl;
+	diff_bl.push_back(std::move(diff));
+	map<int, bufferlist> parity_delta;
+	int r = ecimpl->encode_delta(j, diff_bl, &parity_delta);
+	assert(r == 0);
+	for (auto &&pd: parity_delta) {
+	  assert(pd.second.length() == chunk_size);
+	  xor_buffer(parity[pd.first].c_str(), pd.second.c_str(), chunk_size);
+	}
+
+	bufferlist bl;
+	bl.push_back(std::move(data));
+	written.insert(chunk_off, chunk_size, bl);
+	shard_writes[j].insert(shard_off, chunk_size, bl);
+
+	chunk_off += chunk_size;
+	if (chunk_off == chunk.get_start() + chunk.get_len()) {
+	  ++chunk;
+	  if (chunk != delta.chunks.end())
+	    chunk_off = chunk.get_start();
+	}
+      }
+
+      for (auto &&p: parity) {
+	bufferlist bl;
+	bl.push_back(std::move(p.second));
+	shard_writes[p.first].insert(shard_off, chunk_size, bl);
+      }
+    }
+  }
+  assert(chunk == delta.chunks.end());
+
+  for (auto &&sw: shard_writes) {
+    auto st = transactions->find(shard_id_t(sw.first));
+    if (st == transactions->end())
+      continue;
+    for (auto &&extent: sw.second) {
+      st->second.write(
+	coll_t(spg_t(pgid, st->first)),
+	ghobject_t(oid, ghobject_t::NO_GEN, st->first),
+	extent.get_off(),
+	extent.get_len(),
+	extent.get_val(),
+	fadvise_flags);
+    }
+  }
+}
+
 bool ECTransaction::requires_overwrite(
   uint64_t prev_size,
   const PGTransaction::ObjectOperation &op) {
@@ -106,7 +319,8 @@ void ECTransaction::generate_transactions(
   map<shard_id_t, ObjectStore::Transaction> *transactions,
   set<hobject_t> *temp_added,
   set<hobject_t> *temp_removed,
-  DoutPrefixProvider *dpp)
+  DoutPrefixProvider *dpp,
+  ECUtil::StripeCoder *coder)
 {
   assert(written_map);
   assert(transactions);
@@ -389,6 +603,35 @@ void ECTransaction::generate_transactions(
 	}
       }
 
+      auto diter = plan.delta_writes.find(oid);
+      if (diter != plan.delta_writes.end()) {
+	assert(entry);
+	assert(op.is_none() && !op.truncate);
+	delta_write(
+	  pgid,
+	  oid,
+	  sinfo,
+	  ecimpl,
+	  op,
+	  diter->second,
+	  entry,
+	  written,
+	  transactions,
+	  dpp);
+	hinfo->set_total_chunk_size_clear_hash(
+	  hinfo->get_total_chunk_size());
+	bufferlist hbuf;
+	::encode(*hinfo, hbuf);
+	for (auto &&i : *transactions) {
+	  i.second.setattr(
+	    coll_t(spg_t(pgid, i.first)),
+	    ghobject_t(oid, ghobject_t::NO_GEN, i.first),
+	    ECUtil::get_hinfo_key(),
+	    hbuf);
+	}
+	return;
+      }
+
       extent_map to_write;
       auto pextiter = partial_extents.find(oid);
       if (pextiter != partial_extents.end()) {
@@ -586,7 +829,8 @@ void ECTransaction::generate_transactions(
 	  hinfo,
 	  written,
 	  transactions,
-	  dpp);
+	  dpp,
+	  coder);
       }
 
       auto to_append = to_write.intersect(
@@ -613,7 +857,8 @@ void ECTransaction::generate_transactions(
 	  hinfo,
 	  written,
 	  transactions,
-	  dpp);
+	  dpp,
+	  coder);
       }
 
       ldpp_dout(dpp, 20) << __func__ << ": " << oid
@@ -23,6 +23,24 @@
 #include "ExtentCache.h"
 
 namespace ECTransaction {
+  /**
+   * In-place overwrite of a few data chunks per stripe
+   *
+   * Rather than reading and re-encoding whole stripes, the touched
+   * data chunks and the coding chunks of each touched stripe are read
+   * raw and the coding chunks are patched with
+   * ErasureCodeInterface::encode_delta.  Only the touched data shards
+   * and the coding shards get new data.
+   */
+  struct DeltaWrite {
+    extent_set stripes; ///< touched stripes, logical offsets
+    extent_set chunks;  ///< touched data chunks, logical offsets
+    set<int> data_shards; ///< data shards touched in any stripe
+
+    /// current contents of shards over stripes, chunk offsets
+    map<int, extent_map> old_shards;
+  };
+
   struct WritePlan {
     PGTransactionUPtr t;
     bool invalidates_cache = false; // Yes, both are possible
@@ -30,8 +48,21 @@ namespace ECTransaction {
     map<hobject_t,extent_set> will_write; // superset of to_read
 
     map<hobject_t,ECUtil::HashInfoRef> hash_infos;
+
+    /* objects which may be written with parity deltas, the
+     * ECBackend decides whether they actually are and drops the
+     * others; to_read and will_write are switched to chunk
+     * granularity for the ones it keeps */
+    map<hobject_t,DeltaWrite> delta_writes;
   };
 
+  /// fill in delta, returns false if too many chunks of a stripe change
+  bool get_delta_write(
+    const ECUtil::stripe_info_t &sinfo,
+    unsigned max_chunks_per_stripe,
+    const extent_set &raw_write_set,
+    DeltaWrite *delta);
+
   bool requires_overwrite(
     uint64_t prev_size,
     const PGTransaction::ObjectOperation &op);
@@ -41,7 +72,8 @@ namespace ECTransaction {
     const ECUtil::stripe_info_t &sinfo,
     PGTransactionUPtr &&t,
     F &&get_hinfo,
-    DoutPrefixProvider *dpp) {
+    DoutPrefixProvider *dpp,
+    unsigned parity_delta_max_chunks = 0) {
     WritePlan plan;
     t->safe_create_traverse(
       [&](pair<const hobject_t, PGTransaction::ObjectOperation> &i) {
@@ -150,6 +182,24 @@ namespace ECTransaction {
 	  }
 	}
 
+	if (parity_delta_max_chunks &&
+	    plan.to_read.count(i.first) &&
+	    i.second.is_none() &&
+	    !i.second.truncate &&
+	    projected_size == orig_size) {
+	  DeltaWrite delta;
+	  if (get_delta_write(
+		sinfo,
+		parity_delta_max_chunks,
+		raw_write_set,
+		&delta)) {
+	    ldpp_dout(dpp, 20) << __func__ << ": " << i.first
+			       << " may use parity deltas for chunks "
+			       << delta.chunks << dendl;
+	    plan.delta_writes[i.first] = std::move(delta);
+	  }
+	}
+
 	if (i.second.truncate &&
 	    i.second.truncate->second > projected_size) {
 	  uint64_t truncating_to =
@@ -193,7 +243,8 @@ namespace ECTransaction {
     map<shard_id_t, ObjectStore::Transaction> *transactions,
     set<hobject_t> *temp_added,
     set<hobject_t> *temp_removed,
-    DoutPrefixProvider *dpp);
+    DoutPrefixProvider *dpp,
+    ECUtil::StripeCoder *coder = nullptr);
 };
 
 #endif
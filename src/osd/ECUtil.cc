@@ -1,15 +1,156 @@
 // -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
 
 #include <errno.h>
+#include "include/Context.h"
 #include "include/encoding.h"
+#include "common/Clock.h"
+#include "common/perf_counters.h"
+#include "common/WorkQueue.h"
 #include "ECUtil.h"
 using namespace std;
 
+enum {
+  l_ec_coder_first = 96500,
+  l_ec_coder_encode_lat,
+  l_ec_coder_decode_lat,
+  l_ec_coder_parallel_encode,
+  l_ec_coder_parallel_decode,
+  l_ec_coder_batches,
+  l_ec_coder_last,
+};
+
+ECUtil::StripeCoder::StripeCoder(
+  CephContext *cct, unsigned threads, uint64_t min_stripes)
+  : cct(cct), threads(threads), min_stripes(MAX(min_stripes, 1))
+{
+  if (threads) {
+    tp.reset(new ThreadPool(cct, "ECUtil::StripeCoder::tp", "tp_osd_ec",
+			    threads));
+    wq.reset(new ContextWQ("ECUtil::StripeCoder::wq", 0, tp.get()));
+  }
+
+  PerfCountersBuilder b(cct, "ec_stripe_coder",
+			l_ec_coder_first, l_ec_coder_last);
+  b.add_time_avg(l_ec_coder_encode_lat, "encode_latency",
+		 "Latency of encoding the stripes of a write");
+  b.add_time_avg(l_ec_coder_decode_lat, "decode_latency",
+		 "Latency of decoding the stripes of a read");
+  b.add_u64_counter(l_ec_coder_parallel_encode, "parallel_encode",
+		    "Encodes spread over the EC compute threads");
+  b.add_u64_counter(l_ec_coder_parallel_decode, "parallel_decode",
+		    "Decodes spread over the EC compute threads");
+  b.add_u64_counter(l_ec_coder_batches, "batches",
+		    "Batches of stripes coded by parallel encodes and decodes");
+  logger = b.create_perf_counters();
+  cct->get_perfcounters_collection()->add(logger);
+}
+
+ECUtil::StripeCoder::~StripeCoder()
+{
+  // the work queue unregisters itself from the pool
+  wq.reset();
+  tp.reset();
+  cct->get_perfcounters_collection()->remove(logger);
+  delete logger;
+}
+
+void ECUtil::StripeCoder::start()
+{
+  if (tp)
+    tp->start();
+}
+
+void ECUtil::StripeCoder::stop()
+{
+  if (tp) {
+    wq->drain();
+    tp->stop();
+  }
+}
+
+unsigned ECUtil::StripeCoder::get_batches(uint64_t stripes) const
+{
+  if (!threads)
+    return 1;
+  return MAX(1, MIN(threads + 1, stripes / min_stripes));
+}
+
+void ECUtil::StripeCoder::run(
+  unsigned batches,
+  const std::function<void(unsigned)> &fn)
+{
+  assert(batches > 0);
+  if (batches == 1) {
+    fn(0);
+    return;
+  }
+  assert(wq);
+  Mutex lock("ECUtil::StripeCoder::run");
+  Cond cond;
+  unsigned pending = batches - 1;
+  for (unsigned b = 0; b < batches - 1; ++b) {
+    wq->queue(new FunctionContext([&, b](int) {
+	  fn(b);
+	  Mutex::Locker l(lock);
+	  if (--pending == 0)
+	    cond.Signal();
+	}));
+  }
+  fn(batches - 1);
+  Mutex::Locker l(lock);
+  while (pending)
+    cond.Wait(lock);
+}
+
+void ECUtil::StripeCoder::note_encode(utime_t latency, unsigned batches)
+{
+  logger->tinc(l_ec_coder_encode_lat, latency);
+  if (batches > 1) {
+    logger->inc(l_ec_coder_parallel_encode);
+    logger->inc(l_ec_coder_batches, batches);
+  }
+}
+
+void ECUtil::StripeCoder::note_decode(utime_t latency, unsigned batches)
+{
+  logger->tinc(l_ec_coder_decode_lat, latency);
+  if (batches > 1) {
+    logger->inc(l_ec_coder_parallel_decode);
+    logger->inc(l_ec_coder_batches, batches);
+  }
+}
+
+/**
+ * Split the chunk aligned shards of to_decode into batches of whole
+ * chunks, batch b covering chunks [n * b / batches, n * (b + 1) / batches)
+ * of each shard.  This only shares buffers, nothing is copied.
+ */
+static void split_chunks(
+  const ECUtil::stripe_info_t &sinfo,
+  map<int, bufferlist> &to_decode,
+  unsigned batches,
+  vector<map<int, bufferlist> > *split)
+{
+  uint64_t chunks = to_decode.begin()->second.length() / sinfo.get_chunk_size();
+  split->resize(batches);
+  for (unsigned b = 0; b < batches; ++b) {
+    uint64_t off = chunks * b / batches * sinfo.get_chunk_size();
+    uint64_t end = chunks * (b + 1) / batches * sinfo.get_chunk_size();
+    for (auto &&i : to_decode) {
+      if (batches == 1)
+	(*split)[b][i.first] = i.second;
+      else
+	(*split)[b][i.first].substr_of(i.second, off, end - off);
+    }
+  }
+}
+
 int ECUtil::decode(
   const stripe_info_t &sinfo,
   ErasureCodeInterfaceRef &ec_impl,
   map<int, bufferlist> &to_decode,
-  bufferlist *out) {
+  bufferlist *out,
+  StripeCoder *coder) {
   assert(to_decode.size());
 
   uint64_t total_data_size = to_decode.begin()->second.length();
@@ -27,19 +168,39 @@ int ECUtil::decode(
   if (total_data_size == 0)
     return 0;
 
-  for (uint64_t i = 0; i < total_data_size; i += sinfo.get_chunk_size()) {
-    map<int, bufferlist> chunks;
-    for (map<int, bufferlist>::iterator j = to_decode.begin();
-	 j != to_decode.end();
-	 ++j) {
-      chunks[j->first].substr_of(j->second, i, sinfo.get_chunk_size());
+  utime_t start = ceph_clock_now();
+  unsigned batches = coder ?
+    coder->get_batches(total_data_size / sinfo.get_chunk_size()) : 1;
+  vector<map<int, bufferlist> > split;
+  split_chunks(sinfo, to_decode, batches, &split);
+  vector<bufferlist> decoded(batches);
+
+  auto decode_batch = [&](unsigned b) {
+    map<int, bufferlist> &batch = split[b];
+    uint64_t batch_size = batch.begin()->second.length();
+    for (uint64_t i = 0; i < batch_size; i += sinfo.get_chunk_size()) {
+      map<int, bufferlist> chunks;
+      for (map<int, bufferlist>::iterator j = batch.begin();
+	   j != batch.end();
+	   ++j) {
+	chunks[j->first].substr_of(j->second, i, sinfo.get_chunk_size());
+      }
+      bufferlist bl;
+      int r = ec_impl->decode_concat(chunks, &bl);
+      assert(bl.length() == sinfo.get_stripe_width());
+      assert(r == 0);
+      decoded[b].claim_append(bl);
     }
-    bufferlist bl;
-    int r = ec_impl->decode_concat(chunks, &bl);
-    assert(bl.length() == sinfo.get_stripe_width());
-    assert(r == 0);
+  };
+  if (coder)
+    coder->run(batches, decode_batch);
+  else
+    decode_batch(0);
+
+  for (auto &&bl : decoded)
     out->claim_append(bl);
-  }
+  if (coder)
+    coder->note_decode(ceph_clock_now() - start, batches);
   return 0;
 }
 
@@ -47,7 +208,8 @@ int ECUtil::decode(
   const stripe_info_t &sinfo,
   ErasureCodeInterfaceRef &ec_impl,
   map<int, bufferlist> &to_decode,
-  map<int, bufferlist*> &out) {
+  map<int, bufferlist*> &out,
+  StripeCoder *coder) {
   assert(to_decode.size());
 
   uint64_t total_data_size = to_decode.begin()->second.length();
@@ -71,22 +233,43 @@ int ECUtil::decode(
     need.insert(i->first);
   }
 
-  for (uint64_t i = 0; i < total_data_size; i += sinfo.get_chunk_size()) {
-    map<int, bufferlist> chunks;
-    for (map<int, bufferlist>::iterator j = to_decode.begin();
-	 j != to_decode.end();
-	 ++j) {
-      chunks[j->first].substr_of(j->second, i, sinfo.get_chunk_size());
+  utime_t start = ceph_clock_now();
+  unsigned batches = coder ?
+    coder->get_batches(total_data_size / sinfo.get_chunk_size()) : 1;
+  vector<map<int, bufferlist> > split;
+  split_chunks(sinfo, to_decode, batches, &split);
+  vector<map<int, bufferlist> > decoded(batches);
+
+  auto decode_batch = [&](unsigned b) {
+    map<int, bufferlist> &batch = split[b];
+    uint64_t batch_size = batch.begin()->second.length();
+    for (uint64_t i = 0; i < batch_size; i += sinfo.get_chunk_size()) {
+      map<int, bufferlist> chunks;
+      for (map<int, bufferlist>::iterator j = batch.begin();
+	   j != batch.end();
+	   ++j) {
+	chunks[j->first].substr_of(j->second, i, sinfo.get_chunk_size());
+      }
+      map<int, bufferlist> out_bls;
+      int r = ec_impl->decode(need, chunks, &out_bls);
+      assert(r == 0);
+      for (set<int>::iterator j = need.begin(); j != need.end(); ++j) {
+	assert(out_bls.count(*j));
+	assert(out_bls[*j].length() == sinfo.get_chunk_size());
+	decoded[b][*j].claim_append(out_bls[*j]);
+      }
     }
-    map<int, bufferlist> out_bls;
-    int r = ec_impl->decode(need, chunks, &out_bls);
-    assert(r == 0);
+  };
+  if (coder)
+    coder->run(batches, decode_batch);
+  else
+    decode_batch(0);
+
+  for (auto &&batch : decoded) {
     for (map<int, bufferlist*>::iterator j = out.begin();
 	 j != out.end();
 	 ++j) {
-      assert(out_bls.count(j->first));
-      assert(out_bls[j->first].length() == sinfo.get_chunk_size());
-      j->second->claim_append(out_bls[j->first]);
+      j->second->claim_append(batch[j->first]);
     }
   }
   for (map<int, bufferlist*>::iterator i = out.begin();
@@ -94,6 +277,8 @@ int ECUtil::decode(
        ++i) {
     assert(i->second->length() == total_data_size);
   }
+  if (coder)
+    coder->note_decode(ceph_clock_now() - start, batches);
   return 0;
 }
 
@@ -102,7 +287,8 @@ int ECUtil::encode(
   ErasureCodeInterfaceRef &ec_impl,
   bufferlist &in,
   const set<int> &want,
-  map<int, bufferlist> *out) {
+  map<int, bufferlist> *out,
+  StripeCoder *coder) {
 
   uint64_t logical_size = in.length();
 
@@ -113,18 +299,44 @@ int ECUtil::encode(
   if (logical_size == 0)
     return 0;
 
-  for (uint64_t i = 0; i < logical_size; i += sinfo.get_stripe_width()) {
-    map<int, bufferlist> encoded;
-    bufferlist buf;
-    buf.substr_of(in, i, sinfo.get_stripe_width());
-    int r = ec_impl->encode(want, buf, &encoded);
-    assert(r == 0);
-    for (map<int, bufferlist>::iterator i = encoded.begin();
-	 i != encoded.end();
-	 ++i) {
-      assert(i->second.length() == sinfo.get_chunk_size());
-      (*out)[i->first].claim_append(i->second);
+  utime_t start = ceph_clock_now();
+  uint64_t stripes = logical_size / sinfo.get_stripe_width();
+  unsigned batches = coder ? coder->get_batches(stripes) : 1;
+  vector<bufferlist> split(batches);
+  for (unsigned b = 0; b < batches; ++b) {
+    uint64_t off = stripes * b / batches * sinfo.get_stripe_width();
+    uint64_t end = stripes * (b + 1) / batches * sinfo.get_stripe_width();
+    if (batches == 1)
+      split[b] = in;
+    else
+      split[b].substr_of(in, off, end - off);
+  }
+  vector<map<int, bufferlist> > encoded_batches(batches);
+
+  auto encode_batch = [&](unsigned b) {
+    bufferlist &batch = split[b];
+    for (uint64_t i = 0; i < batch.length(); i += sinfo.get_stripe_width()) {
+      map<int, bufferlist> encoded;
+      bufferlist buf;
+      buf.substr_of(batch, i, sinfo.get_stripe_width());
+      int r = ec_impl->encode(want, buf, &encoded);
+      assert(r == 0);
+      for (map<int, bufferlist>::iterator i = encoded.begin();
+	   i != encoded.end();
+	   ++i) {
+	assert(i->second.length() == sinfo.get_chunk_size());
+	encoded_batches[b][i->first].claim_append(i->second);
+      }
     }
+  };
+  if (coder)
+    coder->run(batches, encode_batch);
+  else
+    encode_batch(0);
+
+  for (auto &&batch : encoded_batches) {
+    for (auto &&i : batch)
+      (*out)[i.first].claim_append(i.second);
   }
 
   for (map<int, bufferlist>::iterator i = out->begin();
@@ -135,6 +347,8 @@ int ECUtil::encode(
       sinfo.aligned_chunk_offset_to_logical_offset(i->second.length()) ==
       logical_size);
   }
+  if (coder)
+    coder->note_encode(ceph_clock_now() - start, batches);
   return 0;
 }
 
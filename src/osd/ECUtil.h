@@ -19,8 +19,17 @@
 #include "include/buffer_fwd.h"
 #include "include/assert.h"
 #include "include/encoding.h"
+#include "include/utime.h"
 #include "common/Formatter.h"
 
+#include <functional>
+#include <memory>
+
+class CephContext;
+class ContextWQ;
+class PerfCounters;
+class ThreadPool;
+
 namespace ECUtil {
 
 const uint64_t CHUNK_ALIGNMENT = 64;
@@ -83,24 +92,65 @@ public:
   }
 };
 
+/**
+ * StripeCoder
+ *
+ * Codes the stripes of a large encode or decode on a small pool of
+ * threads.  The stripes are split into contiguous batches, each batch is
+ * coded into its own shard bufferlists and those are claimed back in
+ * stripe order, so no data is copied.  The calling thread codes the last
+ * batch itself and then waits for the others, which bounds the number of
+ * stripes coded at once to the number of threads + 1 per caller.
+ *
+ * The erasure code plugin must allow concurrent encode and decode calls,
+ * which all the in-tree plugins do.
+ */
+class StripeCoder {
+  CephContext *cct;
+  const unsigned threads;
+  const uint64_t min_stripes;
+  std::unique_ptr<ThreadPool> tp;
+  std::unique_ptr<ContextWQ> wq;
+  PerfCounters *logger = nullptr;
+
+public:
+  StripeCoder(CephContext *cct, unsigned threads, uint64_t min_stripes);
+  ~StripeCoder();
+
+  void start();
+  void stop();
+
+  /// number of batches to split @p stripes stripes into, 1 to not fan out
+  unsigned get_batches(uint64_t stripes) const;
+
+  /// run fn(0) ... fn(batches - 1), fn(batches - 1) on the calling thread
+  void run(unsigned batches, const std::function<void(unsigned)> &fn);
+
+  void note_encode(utime_t latency, unsigned batches);
+  void note_decode(utime_t latency, unsigned batches);
+};
+
 int decode(
   const stripe_info_t &sinfo,
   ErasureCodeInterfaceRef &ec_impl,
   std::map<int, bufferlist> &to_decode,
-  bufferlist *out);
+  bufferlist *out,
+  StripeCoder *coder = nullptr);
 
 int decode(
   const stripe_info_t &sinfo,
   ErasureCodeInterfaceRef &ec_impl,
   std::map<int, bufferlist> &to_decode,
-  std::map<int, bufferlist*> &out);
+  std::map<int, bufferlist*> &out,
+  StripeCoder *coder = nullptr);
 
 int encode(
   const stripe_info_t &sinfo,
   ErasureCodeInterfaceRef &ec_impl,
   bufferlist &in,
   const std::set<int> &want,
-  std::map<int, bufferlist> *out);
+  std::map<int, bufferlist> *out,
+  StripeCoder *coder = nullptr);
 
 class HashInfo {
   uint64_t total_chunk_size = 0;
@@ -13,6 +13,7 @@
  */
 
 #include "ExtentCache.h"
+#include "include/mempool.h"
 
 void ExtentCache::extent::_link_pin_state(pin_state &pin_state)
 {
@@ -239,3 +240,129 @@ ostream &operator<<(ostream &lhs, const ExtentCache &cache)
 {
   return cache.print(lhs);
 }
+
+bool ECReadCache::lookup(
+  const hobject_t &hoid,
+  const extent_set &want,
+  extent_map *out)
+{
+  Mutex::Locker l(lock);
+  auto p = objects.find(hoid);
+  if (p == objects.end() || want.empty())
+    return false;
+  extent_map ret;
+  for (auto &&i: want) {
+    auto range = p->second.data.get_containing_range(i.first, i.second);
+    if (range.first == range.second ||
+	range.first.get_off() > i.first ||
+	range.first.get_off() + range.first.get_len() < i.first + i.second)
+      return false;
+    bufferlist bl;
+    bl.substr_of(
+      range.first.get_val(),
+      i.first - range.first.get_off(),
+      i.second);
+    ret.insert(i.first, i.second, std::move(bl));
+  }
+  lru.splice(lru.begin(), lru, p->second.lru_pos);
+  out->insert(std::move(ret));
+  return true;
+}
+
+void ECReadCache::start_read(spg_t pgid, const hobject_t &hoid)
+{
+  Mutex::Locker l(lock);
+  pending_read &r = pending[hoid];
+  r.pgid = pgid;
+  ++r.reads;
+}
+
+void ECReadCache::finish_read(
+  const hobject_t &hoid,
+  const extent_map *got)
+{
+  Mutex::Locker l(lock);
+  auto p = pending.find(hoid);
+  if (p == pending.end())
+    return;
+  spg_t pgid = p->second.pgid;
+  bool stale = p->second.stale;
+  if (--p->second.reads == 0)
+    pending.erase(p);
+  if (stale || !got || got->empty() || !target)
+    return;
+
+  auto r = objects.find(hoid);
+  if (r == objects.end()) {
+    r = objects.emplace(hoid, object_entry()).first;
+    lru.push_front(hoid);
+    r->second.lru_pos = lru.begin();
+  } else {
+    lru.splice(lru.begin(), lru, r->second.lru_pos);
+  }
+  object_entry &e = r->second;
+  e.pgid = pgid;
+  for (auto i = got->begin(); i != got->end(); ++i) {
+    // copy out of the (possibly much larger) message buffers so the
+    // pool is charged for exactly what we keep
+    bufferlist bl = i.get_val();
+    bl.rebuild();
+    bl.reassign_to_mempool(mempool::mempool_osd_ec_read_cache);
+    e.data.insert(i.get_off(), i.get_len(), std::move(bl));
+  }
+  bytes -= e.bytes;
+  e.bytes = 0;
+  for (auto i = e.data.begin(); i != e.data.end(); ++i)
+    e.bytes += i.get_len();
+  bytes += e.bytes;
+  _trim();
+}
+
+void ECReadCache::invalidate(const hobject_t &hoid)
+{
+  Mutex::Locker l(lock);
+  auto p = pending.find(hoid);
+  if (p != pending.end())
+    p->second.stale = true;
+  auto r = objects.find(hoid);
+  if (r != objects.end())
+    _evict(r);
+}
+
+void ECReadCache::clear(spg_t pgid)
+{
+  Mutex::Locker l(lock);
+  // the cache is bounded by its target, so a scan is cheap enough for
+  // an interval change
+  for (auto &&p: pending) {
+    if (p.second.pgid == pgid)
+      p.second.stale = true;
+  }
+  for (auto p = objects.begin(); p != objects.end(); ) {
+    if (p->second.pgid == pgid)
+      _evict(p++);
+    else
+      ++p;
+  }
+}
+
+void ECReadCache::set_target(uint64_t t)
+{
+  Mutex::Locker l(lock);
+  target = t;
+  _trim();
+}
+
+void ECReadCache::_trim()
+{
+  while (!lru.empty() && bytes > target)
+    _evict(objects.find(lru.back()));
+}
+
+void ECReadCache::_evict(map<hobject_t, object_entry>::iterator p)
+{
+  assert(p != objects.end());
+  bytes -= p->second.bytes;
+  lru.erase(p->second.lru_pos);
+  objects.erase(p);
+}
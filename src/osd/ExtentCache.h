@@ -26,6 +26,8 @@
 #include "common/interval_map.h"
 #include "include/buffer.h"
 #include "common/hobject.h"
+#include "common/Mutex.h"
+#include "osd/osd_types.h"
 
 /**
    ExtentCache
@@ -488,4 +490,83 @@ public:
 
 ostream &operator<<(ostream &lhs, const ExtentCache &cache);
 
+/**
+   ECReadCache
+
+   Unlike ExtentCache above, which only pins extents for writes in
+   flight, this remembers the reconstructed, stripe aligned extents
+   returned by completed client reads so that repeated partial reads
+   of hot objects can be served without gathering k shards again.
+
+   There is one cache per OSD, shared by the EC PGs it is primary for,
+   with a single LRU and a single target size (osd_ec_read_cache_size).
+   An insert evicts the least recently read objects of any PG until the
+   cache is back under the target, and set_target() trims straight
+   away, so lowering the target frees memory without waiting for
+   reads.  Cached buffers are charged to mempool osd_ec_read_cache.
+
+   Every write to an object must invalidate() it.  A read in flight
+   across an invalidate() may have fetched the old contents, so its
+   result is dropped rather than inserted.  A PG that changes interval
+   drops what it cached with clear().
+
+   Callers hold their PG lock; the cache has its own lock.
+ */
+class ECReadCache {
+  struct object_entry {
+    spg_t pgid;
+    extent_map data;
+    uint64_t bytes = 0;
+    list<hobject_t>::iterator lru_pos;
+  };
+  struct pending_read {
+    spg_t pgid;
+    unsigned reads = 0;
+    bool stale = false;  ///< a write raced with the reads
+  };
+
+  Mutex lock;
+  uint64_t target;
+  uint64_t bytes = 0;
+  map<hobject_t, object_entry> objects;
+  list<hobject_t> lru; ///< most recently read at the front
+  map<hobject_t, pending_read> pending;
+
+  void _trim();
+  void _evict(map<hobject_t, object_entry>::iterator p);
+
+public:
+  explicit ECReadCache(uint64_t target = 0)
+    : lock("ECReadCache::lock"), target(target) {}
+
+  /// fill out with want and return true iff all of want is cached
+  bool lookup(
+    const hobject_t &hoid,
+    const extent_set &want,
+    extent_map *out);
+
+  /// pgid sent a read of hoid that may be inserted on completion
+  void start_read(spg_t pgid, const hobject_t &hoid);
+
+  /// the read completed with got (nullptr on error or cancellation)
+  void finish_read(
+    const hobject_t &hoid,
+    const extent_map *got);
+
+  void invalidate(const hobject_t &hoid);
+  /// drop everything pgid cached, and the results of its reads in flight
+  void clear(spg_t pgid);
+  /// change the target size, evicting down to it
+  void set_target(uint64_t target);
+
+  uint64_t get_bytes() {
+    Mutex::Locker l(lock);
+    return bytes;
+  }
+  size_t get_num_objects() {
+    Mutex::Locker l(lock);
+    return objects.size();
+  }
+};
+
 #endif
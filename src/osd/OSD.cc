@@ -217,6 +217,9 @@ OSDService::OSDService(OSD *osd) :
   peering_wq(osd->peering_wq),
   recovery_gen_wq("recovery_gen_wq", cct->_conf->osd_recovery_thread_timeout,
 		  &osd->disk_tp),
+  ec_stripe_coder(cct, cct->_conf->osd_ec_compute_threads,
+		  cct->_conf->osd_ec_compute_min_stripes),
+  ec_read_cache(cct->_conf->osd_ec_read_cache_size),
   class_handler(osd->class_handler),
   pg_epoch_lock("OSDService::pg_epoch_lock"),
   publish_lock("OSDService::publish_lock"),
@@ -258,14 +261,16 @@ OSDService::OSDService(OSD *osd) :
   scrub_sleep_lock("OSDService::scrub_sleep_lock"),
   scrub_sleep_timer(
     osd->client_messenger->cct, scrub_sleep_lock, false /* relax locking */),
+  scrub_io_lock("OSDService::scrub_io_lock"),
   snap_reserver(cct, &reserver_finisher,
 		cct->_conf->osd_max_trimming_pgs),
   recovery_lock("OSDService::recovery_lock"),
   recovery_ops_active(0),
   recovery_ops_reserved(0),
   recovery_paused(false),
-  map_cache_lock("OSDService::map_cache_lock"),
+  map_cache_lock("OSDService::map_cache_lock", false, true, false, cct),
   map_cache(cct, cct->_conf->osd_map_cache_size),
+  map_window(cct->_conf->osd_map_cache_size),
   map_bl_cache(cct->_conf->osd_map_cache_size),
   map_bl_inc_cache(cct->_conf->osd_map_cache_size),
   in_progress_split_lock("OSDService::in_progress_split_lock"),
@@ -551,6 +556,10 @@ void OSDService::shutdown()
 
   osdmap = OSDMapRef();
   next_osdmap = OSDMapRef();
+  {
+    Mutex::Locker l(map_cache_lock);
+    map_window.clear();
+  }
 }
 
 void OSDService::init()
@@ -1319,6 +1328,33 @@ void OSDService::dec_scrubs_active()
   sched_scrub_lock.Unlock();
 }
 
+void OSDService::scrub_io_charge(uint64_t ops, uint64_t bytes)
+{
+  logger->inc(l_osd_scrub_read_ops, ops);
+  logger->inc(l_osd_scrub_read_bytes, bytes);
+
+  // every scrubbing PG draws from the same budget, so the reads of the
+  // OSD as a whole are spread out
+  Mutex::Locker l(scrub_io_lock);
+  scrub_io_budget.charge(ops, bytes,
+			 cct->_conf->osd_scrub_max_ops_per_sec,
+			 cct->_conf->osd_scrub_max_bytes_per_sec,
+			 ceph_clock_now());
+}
+
+utime_t OSDService::scrub_io_delay()
+{
+  Mutex::Locker l(scrub_io_lock);
+  return scrub_io_budget.delay(ceph_clock_now());
+}
+
+bool OSDService::scrub_should_preempt()
+{
+  return ScrubIOBudget::should_preempt(
+    logger->get(l_osd_op_wip),
+    cct->_conf->osd_scrub_preempt_queue_depth);
+}
+
 void OSDService::retrieve_epochs(epoch_t *_boot_epoch, epoch_t *_up_epoch,
                                  epoch_t *_bind_epoch) const
 {
@@ -1557,13 +1593,27 @@ OSDMapRef OSDService::_add_map(OSDMap *o)
   if (existed) {
     delete o;
   }
+  map_window.add(e, l);
   return l;
 }
 
 OSDMapRef OSDService::try_get_map(epoch_t epoch)
 {
+  OSDMapRef retval = map_window.lookup(epoch);
+  if (retval) {
+    dout(30) << "get_map " << epoch << " -cached (lockfree)" << dendl;
+    if (logger) {
+      logger->inc(l_osd_map_cache_hit);
+      logger->inc(l_osd_map_cache_lockfree_hit);
+    }
+    return retval;
+  }
+
   Mutex::Locker l(map_cache_lock);
-  OSDMapRef retval = map_cache.lookup(epoch);
+  if (logger) {
+    logger->inc(l_osd_map_cache_locked);
+  }
+  retval = map_cache.lookup(epoch);
   if (retval) {
     dout(30) << "get_map " << epoch << " -cached" << dendl;
     if (logger) {
@@ -2600,6 +2650,7 @@ int OSD::init()
   osd_op_tp.start();
   disk_tp.start();
   command_tp.start();
+  service.ec_stripe_coder.start();
 
   set_disk_tp_priority();
 
@@ -3108,6 +3159,12 @@ void OSD::create_logger()
   osd_plb.add_u64_avg(
     l_osd_map_cache_miss_low_avg, "osd_map_cache_miss_low_avg",
     "osdmap cache miss, avg distance below cache lower bound");
+  osd_plb.add_u64_counter(
+    l_osd_map_cache_lockfree_hit, "osd_map_cache_lockfree_hit",
+    "osdmap cache hits served without taking the map cache lock");
+  osd_plb.add_u64_counter(
+    l_osd_map_cache_locked, "osd_map_cache_locked",
+    "osdmap cache lookups that took the map cache lock");
   osd_plb.add_u64_counter(
     l_osd_map_bl_cache_hit, "osd_map_bl_cache_hit",
     "OSDMap buffer cache hits");
@@ -3176,6 +3233,51 @@ void OSD::create_logger()
   osd_plb.add_u64_counter(
     l_osd_pg_biginfo, "osd_pg_biginfo", "PG updated its biginfo attr");
 
+  osd_plb.add_u64_counter(
+    l_osd_ec_delta_write, "ec_delta_write",
+    "EC partial overwrites applied with parity deltas");
+  osd_plb.add_u64_counter(
+    l_osd_ec_rmw_write, "ec_rmw_write",
+    "EC partial overwrites applied by re-encoding full stripes");
+  osd_plb.add_u64_counter(
+    l_osd_ec_read_cache_hit, "ec_read_cache_hit",
+    "EC client reads served from the read cache");
+  osd_plb.add_u64_counter(
+    l_osd_ec_read_cache_miss, "ec_read_cache_miss",
+    "EC client reads eligible for the read cache but not cached");
+
+  osd_plb.add_u64_counter(
+    l_osd_scrub_read_bytes, "scrub_read_bytes",
+    "Object data read by deep scrubs");
+  osd_plb.add_u64_counter(
+    l_osd_scrub_read_ops, "scrub_read_ops",
+    "Reads issued by scrubs");
+  osd_plb.add_u64_counter(
+    l_osd_scrub_throttled, "scrub_throttled",
+    "Scrubs paused to stay within the scrub read budget");
+  osd_plb.add_u64_counter(
+    l_osd_scrub_preempted, "scrub_preempted",
+    "Scrubs preempted by client load");
+
+  osd_plb.add_u64(
+    l_osd_recovery_adaptive_max_active, "recovery_adaptive_max_active",
+    "Active recovery ops allowed by adaptive recovery");
+  osd_plb.add_time(
+    l_osd_recovery_adaptive_sleep, "recovery_adaptive_sleep",
+    "Sleep adaptive recovery adds between recovery ops");
+  osd_plb.add_time(
+    l_osd_recovery_adaptive_client_lat, "recovery_adaptive_client_lat",
+    "Client op latency seen by the last adaptive recovery tick");
+  osd_plb.add_time(
+    l_osd_recovery_adaptive_commit_lat, "recovery_adaptive_commit_lat",
+    "Store commit latency seen by the last adaptive recovery tick");
+  osd_plb.add_u64_counter(
+    l_osd_recovery_adaptive_backoff, "recovery_adaptive_backoff",
+    "Adaptive recovery throttled recovery down");
+  osd_plb.add_u64_counter(
+    l_osd_recovery_adaptive_raise, "recovery_adaptive_raise",
+    "Adaptive recovery let recovery speed up");
+
   logger = osd_plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 }
@@ -3334,6 +3436,9 @@ int OSD::shutdown()
   disk_tp.stop();
   dout(10) << "disk tp paused (new)" << dendl;
 
+  service.ec_stripe_coder.stop();
+  dout(10) << "ec stripe coder stopped" << dendl;
+
   dout(10) << "stopping agent" << dendl;
   service.agent_stop();
 
@@ -4872,6 +4977,7 @@ void OSD::tick_without_osd_lock()
       sched_scrub();
     }
     service.promote_throttle_recalibrate();
+    service.recovery_throttle_recalibrate();
     bool need_send_beacon = false;
     const auto now = ceph::coarse_mono_clock::now();
     {
@@ -7153,10 +7259,9 @@ void OSD::handle_osd_map(MOSDMap *m)
 
       OSDMap *o = new OSDMap;
       if (e > 1) {
-	bufferlist obl;
-        bool got = get_map_bl(e - 1, obl);
-        assert(got);
-	o->decode(obl);
+	// start from a copy of the previous epoch instead of decoding it
+	// again; whatever the incremental leaves alone stays shared
+	o->cow_copy_from(*get_map(e - 1));
       }
 
       OSDMap::Incremental inc;
@@ -7655,6 +7760,9 @@ void OSD::consume_map()
     ceph_abort();
   }
 
+  if (op_queue == io_queue::mclock_client)
+    ceph::mClockClientQueue::update_pool_tags(osdmap->get_pools());
+
   int num_pg_primary = 0, num_pg_replica = 0, num_pg_stray = 0;
   list<PGRef> to_remove;
 
@@ -8722,7 +8830,7 @@ bool OSDService::_recover_now(uint64_t *available_pushes)
     return false;
   }
 
-  uint64_t max = cct->_conf->osd_recovery_max_active;
+  uint64_t max = _get_recovery_max_active();
   if (max <= recovery_ops_active + recovery_ops_reserved) {
     dout(15) << __func__ << " active " << recovery_ops_active
 	     << " + reserved " << recovery_ops_reserved
@@ -8736,6 +8844,74 @@ bool OSDService::_recover_now(uint64_t *available_pushes)
   return true;
 }
 
+uint64_t OSDService::_get_recovery_max_active() const
+{
+  uint64_t max_active = recovery_throttle.get_max_active();
+  if (cct->_conf->osd_recovery_adaptive && max_active)
+    return MIN(max_active, cct->_conf->osd_recovery_max_active);
+  return cct->_conf->osd_recovery_max_active;
+}
+
+void OSDService::recovery_throttle_recalibrate()
+{
+  Mutex::Locker l(recovery_lock);
+
+  // client op latency over the last interval
+  pair<uint64_t, uint64_t> lat = logger->get_tavg_ms(l_osd_op_lat);
+  double client_lat = RecoveryThrottle::interval_latency(
+    recovery_adaptive_last_lat, lat);
+  recovery_adaptive_last_lat = lat;
+
+  if (!cct->_conf->osd_recovery_adaptive) {
+    recovery_throttle.reset();
+    recovery_adaptive_sleep = 0;
+    return;
+  }
+
+  double commit_lat = store->get_cur_stats().os_commit_latency / 1000.0;
+  RecoveryThrottle::targets_t targets;
+  targets.client_lat = cct->_conf->osd_recovery_adaptive_client_latency;
+  targets.commit_lat = cct->_conf->osd_recovery_adaptive_commit_latency;
+  targets.max_sleep = cct->_conf->osd_recovery_adaptive_max_sleep;
+
+  uint64_t prev_max_active = recovery_throttle.get_max_active();
+  double prev_sleep = recovery_throttle.get_sleep();
+  RecoveryThrottle::step_t step = recovery_throttle.update(
+    client_lat, commit_lat,
+    recovery_ops_active + recovery_ops_reserved, !awaiting_throttle.empty(),
+    cct->_conf->osd_recovery_max_active, targets);
+  uint64_t max_active = recovery_throttle.get_max_active();
+  double sleep = recovery_throttle.get_sleep();
+
+  if (step != RecoveryThrottle::STEP_NONE) {
+    dout(10) << __func__ << " client lat " << client_lat
+	     << " (target " << targets.client_lat << ") commit lat "
+	     << commit_lat << " (target " << targets.commit_lat
+	     << "): max_active " << prev_max_active << " -> " << max_active
+	     << ", sleep " << prev_sleep << " -> " << sleep << dendl;
+    logger->inc(step == RecoveryThrottle::STEP_BACKOFF ?
+		l_osd_recovery_adaptive_backoff :
+		l_osd_recovery_adaptive_raise);
+  } else {
+    dout(20) << __func__ << " client lat " << client_lat
+	     << " commit lat " << commit_lat << " max_active " << max_active
+	     << " sleep " << sleep << dendl;
+  }
+  recovery_adaptive_sleep = sleep;
+
+  utime_t t;
+  logger->set(l_osd_recovery_adaptive_max_active, max_active);
+  t.set_from_double(sleep);
+  logger->tset(l_osd_recovery_adaptive_sleep, t);
+  t.set_from_double(client_lat);
+  logger->tset(l_osd_recovery_adaptive_client_lat, t);
+  t.set_from_double(commit_lat);
+  logger->tset(l_osd_recovery_adaptive_commit_lat, t);
+
+  if (max_active > prev_max_active)
+    _maybe_queue_recovery();
+}
+
 
 void OSDService::adjust_pg_priorities(const vector<PGRef>& pgs, int newflags)
 {
@@ -8780,7 +8956,8 @@ void OSD::do_recovery(
    * recovery_requeue_callback event, which re-queues the recovery op using
    * queue_recovery_after_sleep.
    */
-  float recovery_sleep = get_osd_recovery_sleep();
+  float recovery_sleep = get_osd_recovery_sleep() +
+    service.get_recovery_adaptive_sleep();
   {
     Mutex::Locker l(service.recovery_sleep_lock);
     if (recovery_sleep > 0 && service.recovery_needs_sleep) {
@@ -8846,7 +9023,7 @@ void OSDService::start_recovery_op(PG *pg, const hobject_t& soid)
   Mutex::Locker l(recovery_lock);
   dout(10) << "start_recovery_op " << *pg << " " << soid
 	   << " (" << recovery_ops_active << "/"
-	   << cct->_conf->osd_recovery_max_active << " rops)"
+	   << _get_recovery_max_active() << " rops)"
 	   << dendl;
   recovery_ops_active++;
 
@@ -8862,7 +9039,7 @@ void OSDService::finish_recovery_op(PG *pg, const hobject_t& soid, bool dequeue)
   Mutex::Locker l(recovery_lock);
   dout(10) << "finish_recovery_op " << *pg << " " << soid
 	   << " dequeue=" << dequeue
-	   << " (" << recovery_ops_active << "/" << cct->_conf->osd_recovery_max_active << " rops)"
+	   << " (" << recovery_ops_active << "/" << _get_recovery_max_active() << " rops)"
 	   << dendl;
 
   // adjust count
@@ -9049,6 +9226,7 @@ const char** OSD::get_tracked_conf_keys() const
     "osd_op_history_slow_op_threshold",
     "osd_enable_op_tracker",
     "osd_map_cache_size",
+    "osd_ec_read_cache_size",
     "osd_map_max_advance",
     "osd_pg_epoch_persisted_max_stale",
     "osd_disk_thread_ioprio_class",
@@ -9114,6 +9292,11 @@ void OSD::handle_conf_change(const struct md_config_t *conf,
     service.map_cache.set_size(cct->_conf->osd_map_cache_size);
     service.map_bl_cache.set_size(cct->_conf->osd_map_cache_size);
     service.map_bl_inc_cache.set_size(cct->_conf->osd_map_cache_size);
+    Mutex::Locker l(service.map_cache_lock);
+    service.map_window.set_size(cct->_conf->osd_map_cache_size);
+  }
+  if (changed.count("osd_ec_read_cache_size")) {
+    service.ec_read_cache.set_target(cct->_conf->osd_ec_read_cache_size);
   }
   if (changed.count("clog_to_monitors") ||
       changed.count("clog_to_syslog") ||
@@ -9545,6 +9728,35 @@ void OSD::ShardedOpWQ::clear_pg_slots()
 #undef dout_prefix
 #define dout_prefix *_dout << "osd." << osd->whoami << " op_wq(" << shard_index << ") "
 
+OSD::ShardedOpWQ::ShardData *OSD::ShardedOpWQ::_steal(
+  uint32_t home, uint32_t *victim_index)
+{
+  // go for the deepest queue whose own threads are all busy
+  uint32_t best = home;
+  unsigned best_depth = steal_threshold - 1;
+  for (uint32_t i = 1; i < num_shards; i++) {
+    uint32_t s = (home + i) % num_shards;
+    ShardData *sdata = shard_list[s];
+    unsigned depth = sdata->queue_depth;
+    if (depth > best_depth && sdata->num_waiting == 0) {
+      best = s;
+      best_depth = depth;
+    }
+  }
+  if (best == home)
+    return nullptr;
+  ShardData *victim = shard_list[best];
+  victim->sdata_op_ordering_lock.Lock();
+  if (victim->queue_depth < steal_threshold) {
+    victim->sdata_op_ordering_lock.Unlock();
+    return nullptr;
+  }
+  victim->logger->inc(l_osd_opwq_stolen);
+  shard_list[home]->logger->inc(l_osd_opwq_steals);
+  *victim_index = best;
+  return victim;
+}
+
 void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
 {
   uint32_t shard_index = thread_index % num_shards;
@@ -9553,6 +9765,19 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
 
   // peek at spg_t
   sdata->sdata_op_ordering_lock.Lock();
+  if (sdata->pqueue->empty() && steal_threshold) {
+    // nothing of our own to do; help a backlogged shard instead
+    sdata->sdata_op_ordering_lock.Unlock();
+    uint32_t victim_index;
+    ShardData *victim = _steal(shard_index, &victim_index);
+    if (victim) {
+      dout(20) << __func__ << " stealing from shard " << victim_index << dendl;
+      sdata = victim;
+      shard_index = victim_index;
+    } else {
+      sdata->sdata_op_ordering_lock.Lock();
+    }
+  }
   if (sdata->pqueue->empty()) {
     dout(20) << __func__ << " empty q, waiting" << dendl;
     // optimistically sleep a moment; maybe another work item will come along.
@@ -9560,16 +9785,20 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
       osd->cct->_conf->threadpool_default_timeout, 0);
     sdata->sdata_lock.Lock();
     sdata->sdata_op_ordering_lock.Unlock();
+    ++sdata->num_waiting;
     sdata->sdata_cond.WaitInterval(sdata->sdata_lock,
       utime_t(osd->cct->_conf->threadpool_empty_queue_max_wait, 0));
+    --sdata->num_waiting;
     sdata->sdata_lock.Unlock();
     sdata->sdata_op_ordering_lock.Lock();
     if (sdata->pqueue->empty()) {
+      // if we were woken to steal, we'll do that on the next pass
       sdata->sdata_op_ordering_lock.Unlock();
       return;
     }
   }
   pair<spg_t, PGQueueable> item = sdata->pqueue->dequeue();
+  sdata->_queue_depth_changed(-1);
   if (osd->is_stopping()) {
     sdata->sdata_op_ordering_lock.Unlock();
     return;    // OSD shutdown, discard.
@@ -9761,12 +9990,27 @@ void OSD::ShardedOpWQ::_enqueue(pair<spg_t, PGQueueable> item) {
     sdata->pqueue->enqueue(
       item.second.get_owner(),
       priority, cost, item);
+  sdata->_queue_depth_changed(1);
   sdata->sdata_op_ordering_lock.Unlock();
 
   sdata->sdata_lock.Lock();
   sdata->sdata_cond.SignalOne();
   sdata->sdata_lock.Unlock();
 
+  if (steal_threshold &&
+      sdata->queue_depth >= steal_threshold &&
+      sdata->num_waiting == 0) {
+    // backlogged with every thread of ours busy; wake someone idle
+    for (uint32_t i = 1; i < num_shards; i++) {
+      ShardData *idle = shard_list[(shard_index + i) % num_shards];
+      if (idle->num_waiting) {
+	idle->sdata_lock.Lock();
+	idle->sdata_cond.SignalOne();
+	idle->sdata_lock.Unlock();
+	break;
+      }
+    }
+  }
 }
 
 void OSD::ShardedOpWQ::_enqueue_front(pair<spg_t, PGQueueable> item)
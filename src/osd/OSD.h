@@ -41,6 +41,10 @@
 #include "Session.h"
 
 #include "osd/PGQueueable.h"
+#include "osd/ECUtil.h"
+#include "osd/ExtentCache.h"
+#include "osd/RecoveryThrottle.h"
+#include "osd/ScrubIOBudget.h"
 
 #include <atomic>
 #include <map>
@@ -137,6 +141,8 @@ enum {
   l_osd_map_cache_miss,
   l_osd_map_cache_miss_low,
   l_osd_map_cache_miss_low_avg,
+  l_osd_map_cache_lockfree_hit,
+  l_osd_map_cache_locked,
   l_osd_map_bl_cache_hit,
   l_osd_map_bl_cache_miss,
 
@@ -176,9 +182,35 @@ enum {
   l_osd_pg_fastinfo,
   l_osd_pg_biginfo,
 
+  l_osd_ec_delta_write,
+  l_osd_ec_rmw_write,
+  l_osd_ec_read_cache_hit,
+  l_osd_ec_read_cache_miss,
+
+  l_osd_scrub_read_bytes,
+  l_osd_scrub_read_ops,
+  l_osd_scrub_throttled,
+  l_osd_scrub_preempted,
+
+  l_osd_recovery_adaptive_max_active,
+  l_osd_recovery_adaptive_sleep,
+  l_osd_recovery_adaptive_client_lat,
+  l_osd_recovery_adaptive_commit_lat,
+  l_osd_recovery_adaptive_backoff,
+  l_osd_recovery_adaptive_raise,
+
   l_osd_last,
 };
 
+// per-shard ShardedOpWQ perf counters
+enum {
+  l_osd_opwq_first = 21000,
+  l_osd_opwq_depth,
+  l_osd_opwq_steals,
+  l_osd_opwq_stolen,
+  l_osd_opwq_last,
+};
+
 // RecoveryState perf counters
 enum {
   rs_first = 20000,
@@ -364,6 +396,8 @@ public:
   MonClient   *&monc;
   ThreadPool::BatchWorkQueue<PG> &peering_wq;
   GenContextWQ recovery_gen_wq;
+  ECUtil::StripeCoder ec_stripe_coder;
+  ECReadCache ec_read_cache;
   ClassHandler  *&class_handler;
 
   void enqueue_back(spg_t pgid, PGQueueable qi);
@@ -856,6 +890,18 @@ public:
   Mutex scrub_sleep_lock;
   SafeTimer scrub_sleep_timer;
 
+  // -- scrub io budget --
+private:
+  Mutex scrub_io_lock;
+  ScrubIOBudget scrub_io_budget;
+public:
+  /// account for scrub reads against the per-OSD budget
+  void scrub_io_charge(uint64_t ops, uint64_t bytes);
+  /// how long scrub reads must wait to stay within budget
+  utime_t scrub_io_delay();
+  /// true if client load is high enough for scrubs to step aside
+  bool scrub_should_preempt();
+
   AsyncReserver<spg_t> snap_reserver;
   void queue_for_snap_trim(PG *pg);
 
@@ -884,6 +930,14 @@ private:
   uint64_t recovery_ops_active;
   uint64_t recovery_ops_reserved;
   bool recovery_paused;
+
+  // adaptive recovery (osd_recovery_adaptive): the controller, the
+  // sleep it asks for (read without recovery_lock), and the op_latency
+  // sample the last recalibration started from
+  RecoveryThrottle recovery_throttle;
+  std::atomic<double> recovery_adaptive_sleep{0};
+  pair<uint64_t, uint64_t> recovery_adaptive_last_lat;
+  uint64_t _get_recovery_max_active() const;
 #ifdef DEBUG_RECOVERY_OIDS
   map<spg_t, set<hobject_t> > recovery_oids;
 #endif
@@ -906,6 +960,10 @@ public:
   void start_recovery_op(PG *pg, const hobject_t& soid);
   void finish_recovery_op(PG *pg, const hobject_t& soid, bool dequeue);
   bool is_recovery_active();
+  void recovery_throttle_recalibrate();
+  double get_recovery_adaptive_sleep() const {
+    return recovery_adaptive_sleep;
+  }
   void release_reserved_pushes(uint64_t pushes) {
     Mutex::Locker l(recovery_lock);
     assert(recovery_ops_reserved >= pushes);
@@ -961,6 +1019,9 @@ public:
   // osd map cache (past osd maps)
   Mutex map_cache_lock;
   SharedLRU<epoch_t, const OSDMap> map_cache;
+  /// the newest osd_map_cache_size maps (already pinned by map_cache),
+  /// looked up by try_get_map without map_cache_lock
+  SharedWindow<const OSDMap> map_window;
   SimpleLRU<epoch_t, bufferlist> map_bl_cache;
   SimpleLRU<epoch_t, bufferlist> map_bl_inc_cache;
 
@@ -1616,6 +1677,12 @@ private:
    * instantiated; in that case they will all get requeued together by
    * wake_pg_waiters, and (2) when wake_pg_waiters just ran, waiting_for_pg
    * and already requeued the items.
+   *
+   * With osd_op_queue_steal_threshold set, a thread whose own shard is
+   * empty may run _process against another shard whose pqueue holds at
+   * least that many items.  It goes through that shard's pqueue, pg_slot
+   * and locks exactly as the shard's own threads do, so per-pg ordering
+   * is unchanged; only the thread doing the work differs.
    */
   friend class PGQueueable;
 
@@ -1651,6 +1718,19 @@ private:
       /// priority queue
       std::unique_ptr<OpQueue< pair<spg_t, PGQueueable>, uint64_t>> pqueue;
 
+      /// items in pqueue; read without the lock when looking for work
+      /// to steal
+      std::atomic<unsigned> queue_depth = {0};
+      /// threads of this shard sleeping on sdata_cond
+      std::atomic<unsigned> num_waiting = {0};
+
+      PerfCounters *logger = nullptr;
+
+      void _queue_depth_changed(int delta) {
+	queue_depth += delta;
+	logger->set(l_osd_opwq_depth, queue_depth);
+      }
+
       void _enqueue_front(pair<spg_t, PGQueueable> item, unsigned cutoff) {
 	unsigned priority = item.second.get_priority();
 	unsigned cost = item.second.get_cost();
@@ -1662,6 +1742,7 @@ private:
 	  pqueue->enqueue_front(
 	    item.second.get_owner(),
 	    priority, cost, item);
+	_queue_depth_changed(1);
       }
 
       ShardData(
@@ -1694,6 +1775,13 @@ private:
     vector<ShardData*> shard_list;
     OSD *osd;
     uint32_t num_shards;
+    /// idle threads steal from shards with at least this many queued
+    /// items; 0 disables stealing
+    const unsigned steal_threshold;
+
+    /// pick a backlogged shard for an idle thread of shard home.  on
+    /// success the victim is returned with its ordering lock held.
+    ShardData *_steal(uint32_t home, uint32_t *victim_index);
 
   public:
     ShardedOpWQ(uint32_t pnum_shards,
@@ -1703,7 +1791,9 @@ private:
 		ShardedThreadPool* tp)
       : ShardedThreadPool::ShardedWQ<pair<spg_t,PGQueueable>>(ti, si, tp),
         osd(o),
-        num_shards(pnum_shards) {
+        num_shards(pnum_shards),
+        steal_threshold(pnum_shards > 1 ?
+			o->cct->_conf->osd_op_queue_steal_threshold : 0) {
       for (uint32_t i = 0; i < num_shards; i++) {
 	char lock_name[32] = {0};
 	snprintf(lock_name, sizeof(lock_name), "%s.%d", "OSD:ShardedOpWQ:", i);
@@ -1714,11 +1804,26 @@ private:
 	  lock_name, order_lock,
 	  osd->cct->_conf->osd_op_pq_max_tokens_per_priority, 
 	  osd->cct->_conf->osd_op_pq_min_cost, osd->cct, osd->op_queue);
+
+	char logger_name[32] = {0};
+	snprintf(logger_name, sizeof(logger_name), "osd_op_wq_shard_%d", i);
+	PerfCountersBuilder plb(osd->cct, logger_name,
+				l_osd_opwq_first, l_osd_opwq_last);
+	plb.add_u64(l_osd_opwq_depth, "queue_depth", "Items queued");
+	plb.add_u64_counter(l_osd_opwq_steals, "steals",
+			    "Items this shard's threads took from other shards");
+	plb.add_u64_counter(l_osd_opwq_stolen, "stolen",
+			    "Items other shards' threads took from this shard");
+	one_shard->logger = plb.create_perf_counters();
+	osd->cct->get_perfcounters_collection()->add(one_shard->logger);
 	shard_list.push_back(one_shard);
       }
     }
     ~ShardedOpWQ() override {
       while (!shard_list.empty()) {
+	osd->cct->get_perfcounters_collection()->remove(
+	  shard_list.back()->logger);
+	delete shard_list.back()->logger;
 	delete shard_list.back();
 	shard_list.pop_back();
       }
@@ -1066,7 +1066,7 @@ void OSDMap::Incremental::generate_test_instances(list<Incremental*>& o)
 void OSDMap::set_epoch(epoch_t e)
 {
   epoch = e;
-  for (auto &pool : pools)
+  for (auto &pool : *pools)
     pool.second.last_change = e;
 }
 
@@ -1116,6 +1116,9 @@ void OSDMap::set_max_osd(int m)
   }
   osd_info.resize(m);
   osd_xinfo.resize(m);
+  cow(osd_addrs);
+  cow(osd_uuid);
+  cow(osd_primary_affinity);
   osd_addrs->client_addr.resize(m);
   osd_addrs->cluster_addr.resize(m);
   osd_addrs->hb_back_addr.resize(m);
@@ -1302,11 +1305,11 @@ uint64_t OSDMap::get_features(int entity_type, uint64_t *pmask) const
   }
   mask |= CEPH_FEATURES_CRUSH;
 
-  if (!pg_upmap.empty() || !pg_upmap_items.empty())
+  if (!pg_upmap->empty() || !pg_upmap_items->empty())
     features |= CEPH_FEATUREMASK_OSDMAP_PG_UPMAP;
   mask |= CEPH_FEATUREMASK_OSDMAP_PG_UPMAP;
 
-  for (auto &pool: pools) {
+  for (auto &pool: *pools) {
     if (pool.second.has_flag(pg_pool_t::FLAG_HASHPSPOOL)) {
       features |= CEPH_FEATURE_OSDHASHPSPOOL;
     }
@@ -1331,7 +1334,7 @@ uint64_t OSDMap::get_features(int entity_type, uint64_t *pmask) const
     }
   }
   if (entity_type == CEPH_ENTITY_TYPE_OSD) {
-    for (auto &erasure_code_profile : erasure_code_profiles) {
+    for (auto &erasure_code_profile : *erasure_code_profiles) {
       auto& profile = erasure_code_profile.second;
       const auto& plugin = profile.find("plugin");
       if (plugin != profile.end()) {
@@ -1437,10 +1440,14 @@ void OSDMap::dedup(const OSDMap *o, OSDMap *n)
 
   int diff = 0;
 
-  // do addrs match?
+  // do addrs match?  n may already share o's, or share another map's
+  // that we must not modify in place.
   if (o->max_osd != n->max_osd)
     diff++;
-  for (int i = 0; i < o->max_osd && i < n->max_osd; i++) {
+  for (int i = 0;
+       n->osd_addrs != o->osd_addrs && n->osd_addrs.use_count() == 1 &&
+	 i < o->max_osd && i < n->max_osd;
+       i++) {
     if ( n->osd_addrs->client_addr[i] &&  o->osd_addrs->client_addr[i] &&
 	*n->osd_addrs->client_addr[i] == *o->osd_addrs->client_addr[i])
       n->osd_addrs->client_addr[i] = o->osd_addrs->client_addr[i];
@@ -1462,33 +1469,51 @@ void OSDMap::dedup(const OSDMap *o, OSDMap *n)
     else
       diff++;
   }
-  if (diff == 0) {
+  if (diff == 0 && n->osd_addrs.use_count() == 1) {
     // zoinks, no differences at all!
     n->osd_addrs = o->osd_addrs;
   }
 
   // does crush match?
-  bufferlist oc, nc;
-  ::encode(*o->crush, oc, CEPH_FEATURES_SUPPORTED_DEFAULT);
-  ::encode(*n->crush, nc, CEPH_FEATURES_SUPPORTED_DEFAULT);
-  if (oc.contents_equal(nc)) {
-    n->crush = o->crush;
+  if (n->crush != o->crush) {
+    bufferlist oc, nc;
+    ::encode(*o->crush, oc, CEPH_FEATURES_SUPPORTED_DEFAULT);
+    ::encode(*n->crush, nc, CEPH_FEATURES_SUPPORTED_DEFAULT);
+    if (oc.contents_equal(nc)) {
+      n->crush = o->crush;
+    }
   }
 
   // does pg_temp match?
-  if (*o->pg_temp == *n->pg_temp)
+  if (n->pg_temp != o->pg_temp && *o->pg_temp == *n->pg_temp)
     n->pg_temp = o->pg_temp;
 
   // does primary_temp match?
-  if (o->primary_temp->size() == n->primary_temp->size()) {
+  if (n->primary_temp != o->primary_temp &&
+      o->primary_temp->size() == n->primary_temp->size()) {
     if (*o->primary_temp == *n->primary_temp)
       n->primary_temp = o->primary_temp;
   }
 
   // do uuids match?
-  if (o->osd_uuid->size() == n->osd_uuid->size() &&
+  if (n->osd_uuid != o->osd_uuid &&
+      o->osd_uuid->size() == n->osd_uuid->size() &&
       *o->osd_uuid == *n->osd_uuid)
     n->osd_uuid = o->osd_uuid;
+
+  // do upmaps, pool names and ec profiles match?
+  if (n->pg_upmap != o->pg_upmap && *o->pg_upmap == *n->pg_upmap)
+    n->pg_upmap = o->pg_upmap;
+  if (n->pg_upmap_items != o->pg_upmap_items &&
+      *o->pg_upmap_items == *n->pg_upmap_items)
+    n->pg_upmap_items = o->pg_upmap_items;
+  if (n->pool_name != o->pool_name && *o->pool_name == *n->pool_name) {
+    n->pool_name = o->pool_name;
+    n->name_pool = o->name_pool;
+  }
+  if (n->erasure_code_profiles != o->erasure_code_profiles &&
+      *o->erasure_code_profiles == *n->erasure_code_profiles)
+    n->erasure_code_profiles = o->erasure_code_profiles;
 }
 
 void OSDMap::clean_temps(CephContext *cct,
@@ -1607,26 +1632,32 @@ int OSDMap::apply_incremental(const Incremental &inc)
   if (inc.new_pool_max != -1)
     pool_max = inc.new_pool_max;
 
+  if (!inc.new_pools.empty() || !inc.old_pools.empty())
+    cow(pools);
+  if (!inc.new_pool_names.empty() || !inc.old_pools.empty()) {
+    cow(pool_name);
+    cow(name_pool);
+  }
   for (const auto &pool : inc.new_pools) {
-    pools[pool.first] = pool.second;
-    pools[pool.first].last_change = epoch;
+    (*pools)[pool.first] = pool.second;
+    (*pools)[pool.first].last_change = epoch;
   }
 
   for (const auto &pname : inc.new_pool_names) {
-    auto pool_name_entry = pool_name.find(pname.first);
-    if (pool_name_entry != pool_name.end()) {
-      name_pool.erase(pool_name_entry->second);
+    auto pool_name_entry = pool_name->find(pname.first);
+    if (pool_name_entry != pool_name->end()) {
+      name_pool->erase(pool_name_entry->second);
       pool_name_entry->second = pname.second;
     } else {
-      pool_name[pname.first] = pname.second;
+      (*pool_name)[pname.first] = pname.second;
     }
-    name_pool[pname.second] = pname.first;
+    (*name_pool)[pname.second] = pname.first;
   }
   
   for (const auto &pool : inc.old_pools) {
-    pools.erase(pool);
-    name_pool.erase(pool_name[pool]);
-    pool_name.erase(pool);
+    pools->erase(pool);
+    name_pool->erase((*pool_name)[pool]);
+    pool_name->erase(pool);
   }
 
   for (const auto &weight : inc.new_weight) {
@@ -1645,8 +1676,10 @@ int OSDMap::apply_incremental(const Incremental &inc)
   }
 
   // erasure_code_profiles
+  if (!inc.old_erasure_code_profiles.empty())
+    cow(erasure_code_profiles);
   for (const auto &profile : inc.old_erasure_code_profiles)
-    erasure_code_profiles.erase(profile);
+    erasure_code_profiles->erase(profile);
   
   for (const auto &profile : inc.new_erasure_code_profiles) {
     set_erasure_code_profile(profile.first, profile.second);
@@ -1664,6 +1697,8 @@ int OSDMap::apply_incremental(const Incremental &inc)
     if ((osd_state[osd] & CEPH_OSD_EXISTS) &&
 	(s & CEPH_OSD_EXISTS)) {
       // osd is destroyed; clear out anything interesting.
+      cow(osd_uuid);
+      cow(osd_addrs);
       (*osd_uuid)[osd] = uuid_d();
       osd_info[osd] = osd_info_t();
       osd_xinfo[osd] = osd_xinfo_t();
@@ -1678,6 +1713,8 @@ int OSDMap::apply_incremental(const Incremental &inc)
     }
   }
 
+  if (!inc.new_up_client.empty() || !inc.new_up_cluster.empty())
+    cow(osd_addrs);
   for (const auto &client : inc.new_up_client) {
     osd_state[client.first] |= CEPH_OSD_EXISTS | CEPH_OSD_UP;
     osd_addrs->client_addr[client.first].reset(new entity_addr_t(client.second));
@@ -1715,10 +1752,14 @@ int OSDMap::apply_incremental(const Incremental &inc)
     osd_xinfo[xinfo.first] = xinfo.second;
 
   // uuid
+  if (!inc.new_uuid.empty())
+    cow(osd_uuid);
   for (const auto &uuid : inc.new_uuid)
     (*osd_uuid)[uuid.first] = uuid.second;
 
   // pg rebuild
+  if (!inc.new_pg_temp.empty())
+    cow(pg_temp);
   for (const auto &pg : inc.new_pg_temp) {
     if (pg.second.empty())
       pg_temp->erase(pg.first);
@@ -1730,6 +1771,8 @@ int OSDMap::apply_incremental(const Incremental &inc)
     pg_temp->rebuild();
   }
 
+  if (!inc.new_primary_temp.empty())
+    cow(primary_temp);
   for (const auto &pg : inc.new_primary_temp) {
     if (pg.second == -1)
       primary_temp->erase(pg.first);
@@ -1737,17 +1780,21 @@ int OSDMap::apply_incremental(const Incremental &inc)
       (*primary_temp)[pg.first] = pg.second;
   }
 
+  if (!inc.new_pg_upmap.empty() || !inc.old_pg_upmap.empty())
+    cow(pg_upmap);
+  if (!inc.new_pg_upmap_items.empty() || !inc.old_pg_upmap_items.empty())
+    cow(pg_upmap_items);
   for (auto& p : inc.new_pg_upmap) {
-    pg_upmap[p.first] = p.second;
+    (*pg_upmap)[p.first] = p.second;
   }
   for (auto& pg : inc.old_pg_upmap) {
-    pg_upmap.erase(pg);
+    pg_upmap->erase(pg);
   }
   for (auto& p : inc.new_pg_upmap_items) {
-    pg_upmap_items[p.first] = p.second;
+    (*pg_upmap_items)[p.first] = p.second;
   }
   for (auto& pg : inc.old_pg_upmap_items) {
-    pg_upmap_items.erase(pg);
+    pg_upmap_items->erase(pg);
   }
 
   // blacklist
@@ -1910,8 +1957,8 @@ int OSDMap::_pick_primary(const vector<int>& osds) const
 void OSDMap::_apply_upmap(const pg_pool_t& pi, pg_t raw_pg, vector<int> *raw) const
 {
   pg_t pg = pi.raw_pg_to_pg(raw_pg);
-  auto p = pg_upmap.find(pg);
-  if (p != pg_upmap.end()) {
+  auto p = pg_upmap->find(pg);
+  if (p != pg_upmap->end()) {
     // make sure targets aren't marked out
     for (auto osd : p->second) {
       if (osd != CRUSH_ITEM_NONE && osd < max_osd && osd_weight[osd] == 0) {
@@ -1923,8 +1970,8 @@ void OSDMap::_apply_upmap(const pg_pool_t& pi, pg_t raw_pg, vector<int> *raw) co
     // continue to check and apply pg_upmap_items if any
   }
 
-  auto q = pg_upmap_items.find(pg);
-  if (q != pg_upmap_items.end()) {
+  auto q = pg_upmap_items->find(pg);
+  if (q != pg_upmap_items->end()) {
     // NOTE: this approach does not allow a bidirectional swap,
     // e.g., [[1,2],[2,1]] applied to [0,1,2] -> [0,2,1].
     for (auto& r : q->second) {
@@ -2100,7 +2147,8 @@ void OSDMap::pg_to_raw_up(pg_t pg, vector<int> *up, int *primary) const
 void OSDMap::_pg_to_up_acting_osds(
   const pg_t& pg, vector<int> *up, int *up_primary,
   vector<int> *acting, int *acting_primary,
-  bool raw_pg_to_pg) const
+  bool raw_pg_to_pg,
+  vector<int> *raw_upmap) const
 {
   const pg_pool_t *pool = get_pg_pool(pg.pool());
   if (!pool ||
@@ -2109,6 +2157,8 @@ void OSDMap::_pg_to_up_acting_osds(
       up->clear();
     if (up_primary)
       *up_primary = -1;
+    if (raw_upmap)
+      raw_upmap->clear();
     if (acting)
       acting->clear();
     if (acting_primary)
@@ -2125,6 +2175,8 @@ void OSDMap::_pg_to_up_acting_osds(
   if (_acting.empty() || up || up_primary) {
     _pg_to_raw_osds(*pool, pg, &raw, &pps);
     _apply_upmap(*pool, pg, &raw);
+    if (raw_upmap)
+      *raw_upmap = raw;
     _raw_to_up_osds(*pool, raw, &_up);
     _up_primary = _pick_primary(_up);
     _apply_primary_affinity(pps, *pool, &_up, &_up_primary);
@@ -2194,18 +2246,18 @@ void OSDMap::encode_client_old(bufferlist& bl) const
   ::encode(modified, bl);
 
   // for ::encode(pools, bl);
-  __u32 n = pools.size();
+  __u32 n = pools->size();
   ::encode(n, bl);
 
-  for (const auto &pool : pools) {
+  for (const auto &pool : *pools) {
     n = pool.first;
     ::encode(n, bl);
     ::encode(pool.second, bl, 0);
   }
   // for ::encode(pool_name, bl);
-  n = pool_name.size();
+  n = pool_name->size();
   ::encode(n, bl);
-  for (const auto &pname : pool_name) {
+  for (const auto &pname : *pool_name) {
     n = pname.first;
     ::encode(n, bl);
     ::encode(pname.second, bl);
@@ -2258,8 +2310,8 @@ void OSDMap::encode_classic(bufferlist& bl, uint64_t features) const
   ::encode(created, bl);
   ::encode(modified, bl);
 
-  ::encode(pools, bl, features);
-  ::encode(pool_name, bl);
+  ::encode(*pools, bl, features);
+  ::encode(*pool_name, bl);
   ::encode(pool_max, bl);
 
   ::encode(flags, bl);
@@ -2329,8 +2381,8 @@ void OSDMap::encode(bufferlist& bl, uint64_t features) const
     ::encode(created, bl);
     ::encode(modified, bl);
 
-    ::encode(pools, bl, features);
-    ::encode(pool_name, bl);
+    ::encode(*pools, bl, features);
+    ::encode(*pool_name, bl);
     ::encode(pool_max, bl);
 
     if (v < 4) {
@@ -2372,14 +2424,14 @@ void OSDMap::encode(bufferlist& bl, uint64_t features) const
     bufferlist cbl;
     crush->encode(cbl, features);
     ::encode(cbl, bl);
-    ::encode(erasure_code_profiles, bl);
+    ::encode(*erasure_code_profiles, bl);
 
     if (v >= 4) {
-      ::encode(pg_upmap, bl);
-      ::encode(pg_upmap_items, bl);
+      ::encode(*pg_upmap, bl);
+      ::encode(*pg_upmap_items, bl);
     } else {
-      assert(pg_upmap.empty());
-      assert(pg_upmap_items.empty());
+      assert(pg_upmap->empty());
+      assert(pg_upmap_items->empty());
     }
     if (v >= 6) {
       ::encode(crush_version, bl);
@@ -2468,33 +2520,33 @@ void OSDMap::decode_classic(bufferlist::iterator& p)
       ::decode(max_pools, p);
       pool_max = max_pools;
     }
-    pools.clear();
+    pools->clear();
     ::decode(n, p);
     while (n--) {
       ::decode(t, p);
-      ::decode(pools[t], p);
+      ::decode((*pools)[t], p);
     }
     if (v == 4) {
       ::decode(n, p);
       pool_max = n;
     } else if (v == 5) {
-      pool_name.clear();
+      pool_name->clear();
       ::decode(n, p);
       while (n--) {
 	::decode(t, p);
-	::decode(pool_name[t], p);
+	::decode((*pool_name)[t], p);
       }
       ::decode(n, p);
       pool_max = n;
     }
   } else {
-    ::decode(pools, p);
-    ::decode(pool_name, p);
+    ::decode(*pools, p);
+    ::decode(*pool_name, p);
     ::decode(pool_max, p);
   }
   // kludge around some old bug that zeroed out pool_max (#2307)
-  if (pools.size() && pool_max < pools.rbegin()->first) {
-    pool_max = pools.rbegin()->first;
+  if (pools->size() && pool_max < pools->rbegin()->first) {
+    pool_max = pools->rbegin()->first;
   }
 
   ::decode(flags, p);
@@ -2537,7 +2589,7 @@ void OSDMap::decode_classic(bufferlist::iterator& p)
   ::decode(osd_addrs->hb_back_addr, p);
   ::decode(osd_info, p);
   if (v < 5)
-    ::decode(pool_name, p);
+    ::decode(*pool_name, p);
 
   ::decode(blacklist, p);
   if (ev >= 6)
@@ -2583,6 +2635,31 @@ void OSDMap::decode(bufferlist::iterator& bl)
   size_t tail_offset = 0;
   bufferlist crc_front, crc_tail;
 
+  // a copy of another epoch shares these; decode into fresh ones
+  // rather than overwriting them under the other map's readers
+  if (crush.use_count() > 1)
+    crush.reset(new CrushWrapper);
+  if (pg_temp.use_count() > 1)
+    pg_temp.reset(new PGTempMap);
+  if (primary_temp.use_count() > 1)
+    primary_temp.reset(new mempool::osdmap::map<pg_t,int32_t>);
+  if (osd_uuid.use_count() > 1)
+    osd_uuid.reset(new mempool::osdmap::vector<uuid_d>);
+  if (osd_addrs.use_count() > 1)
+    osd_addrs.reset(new addrs_s);
+  if (pg_upmap.use_count() > 1)
+    pg_upmap.reset(new pg_upmap_t);
+  if (pg_upmap_items.use_count() > 1)
+    pg_upmap_items.reset(new pg_upmap_items_t);
+  if (pools.use_count() > 1)
+    pools.reset(new mempool::osdmap::map<int64_t,pg_pool_t>);
+  if (pool_name.use_count() > 1)
+    pool_name.reset(new mempool::osdmap::map<int64_t,string>);
+  if (erasure_code_profiles.use_count() > 1)
+    erasure_code_profiles.reset(new ec_profiles_t);
+  if (name_pool.use_count() > 1)
+    name_pool.reset(new mempool::osdmap::map<string,int64_t>);
+
   DECODE_START_LEGACY_COMPAT_LEN(8, 7, 7, bl); // wrapper
   if (struct_v < 7) {
     int struct_v_size = sizeof(struct_v);
@@ -2601,8 +2678,8 @@ void OSDMap::decode(bufferlist::iterator& bl)
     ::decode(created, bl);
     ::decode(modified, bl);
 
-    ::decode(pools, bl);
-    ::decode(pool_name, bl);
+    ::decode(*pools, bl);
+    ::decode(*pool_name, bl);
     ::decode(pool_max, bl);
 
     ::decode(flags, bl);
@@ -2638,16 +2715,16 @@ void OSDMap::decode(bufferlist::iterator& bl)
     auto cblp = cbl.begin();
     crush->decode(cblp);
     if (struct_v >= 3) {
-      ::decode(erasure_code_profiles, bl);
+      ::decode(*erasure_code_profiles, bl);
     } else {
-      erasure_code_profiles.clear();
+      erasure_code_profiles->clear();
     }
     if (struct_v >= 4) {
-      ::decode(pg_upmap, bl);
-      ::decode(pg_upmap_items, bl);
+      ::decode(*pg_upmap, bl);
+      ::decode(*pg_upmap_items, bl);
     } else {
-      pg_upmap.clear();
-      pg_upmap_items.clear();
+      pg_upmap->clear();
+      pg_upmap_items->clear();
     }
     if (struct_v >= 6) {
       ::decode(crush_version, bl);
@@ -2742,9 +2819,11 @@ void OSDMap::decode(bufferlist::iterator& bl)
 void OSDMap::post_decode()
 {
   // index pool names
-  name_pool.clear();
-  for (const auto &pname : pool_name) {
-    name_pool[pname.second] = pname.first;
+  if (name_pool.use_count() > 1)
+    name_pool.reset(new mempool::osdmap::map<string,int64_t>);
+  name_pool->clear();
+  for (const auto &pname : *pool_name) {
+    (*name_pool)[pname.second] = pname.first;
   }
 
   calc_num_osds();
@@ -2788,10 +2867,10 @@ void OSDMap::dump(Formatter *f) const
 		 ceph_release_name(require_osd_release));
 
   f->open_array_section("pools");
-  for (const auto &pool : pools) {
+  for (const auto &pool : *pools) {
     std::string name("<unknown>");
-    const auto &pni = pool_name.find(pool.first);
-    if (pni != pool_name.end())
+    const auto &pni = pool_name->find(pool.first);
+    if (pni != pool_name->end())
       name = pni->second;
     f->open_object_section("pool");
     f->dump_int("pool", pool.first);
@@ -2840,7 +2919,7 @@ void OSDMap::dump(Formatter *f) const
   f->close_section();
 
   f->open_array_section("pg_upmap");
-  for (auto& p : pg_upmap) {
+  for (auto& p : *pg_upmap) {
     f->open_object_section("mapping");
     f->dump_stream("pgid") << p.first;
     f->open_array_section("osds");
@@ -2852,7 +2931,7 @@ void OSDMap::dump(Formatter *f) const
   }
   f->close_section();
   f->open_array_section("pg_upmap_items");
-  for (auto& p : pg_upmap_items) {
+  for (auto& p : *pg_upmap_items) {
     f->open_object_section("mapping");
     f->dump_stream("pgid") << p.first;
     f->open_array_section("mappings");
@@ -2885,7 +2964,7 @@ void OSDMap::dump(Formatter *f) const
   }
   f->close_section();
 
-  dump_erasure_code_profiles(erasure_code_profiles, f);
+  dump_erasure_code_profiles(*erasure_code_profiles, f);
 }
 
 void OSDMap::generate_test_instances(list<OSDMap*>& o)
@@ -2958,10 +3037,10 @@ string OSDMap::get_flag_string() const
 
 void OSDMap::print_pools(ostream& out) const
 {
-  for (const auto &pool : pools) {
+  for (const auto &pool : *pools) {
     std::string name("<unknown>");
-    const auto &pni = pool_name.find(pool.first);
-    if (pni != pool_name.end())
+    const auto &pni = pool_name->find(pool.first);
+    if (pni != pool_name->end())
       name = pni->second;
     out << "pool " << pool.first
 	<< " '" << name
@@ -3027,10 +3106,10 @@ void OSDMap::print(ostream& out) const
   }
   out << std::endl;
 
-  for (auto& p : pg_upmap) {
+  for (auto& p : *pg_upmap) {
     out << "pg_upmap " << p.first << " " << p.second << "\n";
   }
-  for (auto& p : pg_upmap_items) {
+  for (auto& p : *pg_upmap_items) {
     out << "pg_upmap_items " << p.first << " " << p.second << "\n";
   }
 
@@ -3251,7 +3330,7 @@ void OSDMap::print_oneline_summary(ostream& out) const
 
 bool OSDMap::crush_rule_in_use(int rule_id) const
 {
-  for (const auto &pool : pools) {
+  for (const auto &pool : *pools) {
     if (pool.second.crush_rule == rule_id)
       return true;
   }
@@ -3261,7 +3340,7 @@ bool OSDMap::crush_rule_in_use(int rule_id) const
 int OSDMap::validate_crush_rules(CrushWrapper *newcrush,
 				 ostream *ss) const
 {
-  for (auto& i : pools) {
+  for (auto& i : *pools) {
     auto& pool = i.second;
     int ruleno = pool.get_crush_rule();
     if (!newcrush->rule_exists(ruleno)) {
@@ -3354,27 +3433,27 @@ int OSDMap::build_simple_optioned(CephContext *cct, epoch_t e, uuid_d &fsid,
     pool_names.push_back("rbd");
     for (auto &plname : pool_names) {
       int64_t pool = ++pool_max;
-      pools[pool].type = pg_pool_t::TYPE_REPLICATED;
-      pools[pool].flags = cct->_conf->osd_pool_default_flags;
+      (*pools)[pool].type = pg_pool_t::TYPE_REPLICATED;
+      (*pools)[pool].flags = cct->_conf->osd_pool_default_flags;
       if (cct->_conf->osd_pool_default_flag_hashpspool)
-	pools[pool].set_flag(pg_pool_t::FLAG_HASHPSPOOL);
+	(*pools)[pool].set_flag(pg_pool_t::FLAG_HASHPSPOOL);
       if (cct->_conf->osd_pool_default_flag_nodelete)
-	pools[pool].set_flag(pg_pool_t::FLAG_NODELETE);
+	(*pools)[pool].set_flag(pg_pool_t::FLAG_NODELETE);
       if (cct->_conf->osd_pool_default_flag_nopgchange)
-	pools[pool].set_flag(pg_pool_t::FLAG_NOPGCHANGE);
+	(*pools)[pool].set_flag(pg_pool_t::FLAG_NOPGCHANGE);
       if (cct->_conf->osd_pool_default_flag_nosizechange)
-	pools[pool].set_flag(pg_pool_t::FLAG_NOSIZECHANGE);
-      pools[pool].size = cct->_conf->osd_pool_default_size;
-      pools[pool].min_size = cct->_conf->get_osd_pool_default_min_size();
-      pools[pool].crush_rule = default_replicated_rule;
-      pools[pool].object_hash = CEPH_STR_HASH_RJENKINS;
-      pools[pool].set_pg_num(poolbase << pg_bits);
-      pools[pool].set_pgp_num(poolbase << pgp_bits);
-      pools[pool].last_change = epoch;
-      pools[pool].application_metadata.insert(
+	(*pools)[pool].set_flag(pg_pool_t::FLAG_NOSIZECHANGE);
+      (*pools)[pool].size = cct->_conf->osd_pool_default_size;
+      (*pools)[pool].min_size = cct->_conf->get_osd_pool_default_min_size();
+      (*pools)[pool].crush_rule = default_replicated_rule;
+      (*pools)[pool].object_hash = CEPH_STR_HASH_RJENKINS;
+      (*pools)[pool].set_pg_num(poolbase << pg_bits);
+      (*pools)[pool].set_pgp_num(poolbase << pgp_bits);
+      (*pools)[pool].last_change = epoch;
+      (*pools)[pool].application_metadata.insert(
         {pg_pool_t::APPLICATION_NAME_RBD, {}});
-      pool_name[pool] = plname;
-      name_pool[plname] = pool;
+      (*pool_name)[pool] = plname;
+      (*name_pool)[plname] = pool;
     }
   }
 
@@ -3708,7 +3787,7 @@ int OSDMap::clean_pg_upmaps(
 {
   ldout(cct, 10) << __func__ << dendl;
   int changed = 0;
-  for (auto& p : pg_upmap) {
+  for (auto& p : *pg_upmap) {
     vector<int> raw;
     int primary;
     pg_to_raw_osds(p.first, &raw, &primary);
@@ -3719,7 +3798,7 @@ int OSDMap::clean_pg_upmaps(
       ++changed;
     }
   }
-  for (auto& p : pg_upmap_items) {
+  for (auto& p : *pg_upmap_items) {
     vector<int> raw;
     int primary;
     pg_to_raw_osds(p.first, &raw, &primary);
@@ -3798,7 +3877,7 @@ int OSDMap::calc_pg_upmaps(
 {
   set<int64_t> only_pools;
   if (only_pools_orig.empty()) {
-    for (auto& i : pools) {
+    for (auto& i : *pools) {
       only_pools.insert(i.first);
     }
   } else {
@@ -3814,7 +3893,7 @@ int OSDMap::calc_pg_upmaps(
     int total_pgs = 0;
     float osd_weight_total = 0;
     map<int,float> osd_weight;
-    for (auto& i : pools) {
+    for (auto& i : *pools) {
       if (!only_pools.empty() && !only_pools.count(i.first))
 	continue;
       for (unsigned ps = 0; ps < i.second.get_pg_num(); ++ps) {
@@ -3922,13 +4001,13 @@ int OSDMap::calc_pg_upmaps(
 
       // look for remaps we can un-remap
       for (auto pg : pgs) {
-	auto p = tmp.pg_upmap_items.find(pg);
-	if (p != tmp.pg_upmap_items.end()) {
+	auto p = tmp.pg_upmap_items->find(pg);
+	if (p != tmp.pg_upmap_items->end()) {
 	  for (auto q : p->second) {
 	    if (q.second == osd) {
 	      ldout(cct, 10) << "  dropping pg_upmap_items " << pg
 			     << " " << p->second << dendl;
-	      tmp.pg_upmap_items.erase(p);
+	      tmp.pg_upmap_items->erase(p);
 	      pending_inc->old_pg_upmap_items.insert(pg);
 	      ++num_changed;
 	      restart = true;
@@ -3942,8 +4021,8 @@ int OSDMap::calc_pg_upmaps(
 	break;
 
       for (auto pg : pgs) {
-	if (tmp.pg_upmap.count(pg) ||
-	    tmp.pg_upmap_items.count(pg)) {
+	if (tmp.pg_upmap->count(pg) ||
+	    tmp.pg_upmap_items->count(pg)) {
 	  ldout(cct, 20) << "  already remapped " << pg << dendl;
 	  continue;
 	}
@@ -3957,7 +4036,7 @@ int OSDMap::calc_pg_upmaps(
 	  continue;
 	}
 	assert(orig != out);
-	auto& rmi = tmp.pg_upmap_items[pg];
+	auto& rmi = (*tmp.pg_upmap_items)[pg];
 	for (unsigned i = 0; i < out.size(); ++i) {
 	  if (orig[i] != out[i]) {
 	    rmi.push_back(make_pair(orig[i], out[i]));
@@ -4646,8 +4725,8 @@ void OSDMap::check_health(health_check_map_t *checks) const
   // CACHE_POOL_NO_HIT_SET
   if (g_conf->mon_warn_on_cache_pools_without_hit_sets) {
     list<string> detail;
-    for (map<int64_t, pg_pool_t>::const_iterator p = pools.begin();
-	 p != pools.end();
+    for (map<int64_t, pg_pool_t>::const_iterator p = pools->begin();
+	 p != pools->end();
 	 ++p) {
       const pg_pool_t& info = p->second;
       if (info.cache_mode_requires_hit_set() &&
@@ -512,13 +512,16 @@ private:
   ceph::shared_ptr< mempool::osdmap::vector<__u32> > osd_primary_affinity; ///< 16.16 fixed point, 0x10000 = baseline
 
   // remap (post-CRUSH, pre-up)
-  mempool::osdmap::map<pg_t,mempool::osdmap::vector<int32_t>> pg_upmap; ///< remap pg
-  mempool::osdmap::map<pg_t,mempool::osdmap::vector<pair<int32_t,int32_t>>> pg_upmap_items; ///< remap osds in up set
+  typedef mempool::osdmap::map<pg_t,mempool::osdmap::vector<int32_t>> pg_upmap_t;
+  typedef mempool::osdmap::map<pg_t,mempool::osdmap::vector<pair<int32_t,int32_t>>> pg_upmap_items_t;
+  typedef mempool::osdmap::map<string,map<string,string> > ec_profiles_t;
+  ceph::shared_ptr<pg_upmap_t> pg_upmap; ///< remap pg
+  ceph::shared_ptr<pg_upmap_items_t> pg_upmap_items; ///< remap osds in up set
 
-  mempool::osdmap::map<int64_t,pg_pool_t> pools;
-  mempool::osdmap::map<int64_t,string> pool_name;
-  mempool::osdmap::map<string,map<string,string> > erasure_code_profiles;
-  mempool::osdmap::map<string,int64_t> name_pool;
+  ceph::shared_ptr< mempool::osdmap::map<int64_t,pg_pool_t> > pools;
+  ceph::shared_ptr< mempool::osdmap::map<int64_t,string> > pool_name;
+  ceph::shared_ptr<ec_profiles_t> erasure_code_profiles;
+  ceph::shared_ptr< mempool::osdmap::map<string,int64_t> > name_pool;
 
   ceph::shared_ptr< mempool::osdmap::vector<uuid_d> > osd_uuid;
   mempool::osdmap::vector<osd_xinfo_t> osd_xinfo;
@@ -555,6 +558,7 @@ private:
   uint32_t crush_version = 1;
 
   friend class OSDMonitor;
+  friend class OSDMapMapping;
 
  public:
   OSDMap() : epoch(0), 
@@ -565,6 +569,12 @@ private:
 	     osd_addrs(std::make_shared<addrs_s>()),
 	     pg_temp(std::make_shared<PGTempMap>()),
 	     primary_temp(std::make_shared<mempool::osdmap::map<pg_t,int32_t>>()),
+	     pg_upmap(std::make_shared<pg_upmap_t>()),
+	     pg_upmap_items(std::make_shared<pg_upmap_items_t>()),
+	     pools(std::make_shared<mempool::osdmap::map<int64_t,pg_pool_t>>()),
+	     pool_name(std::make_shared<mempool::osdmap::map<int64_t,string>>()),
+	     erasure_code_profiles(std::make_shared<ec_profiles_t>()),
+	     name_pool(std::make_shared<mempool::osdmap::map<string,int64_t>>()),
 	     osd_uuid(std::make_shared<mempool::osdmap::vector<uuid_d>>()),
 	     cluster_snapshot_epoch(0),
 	     new_blacklist_entries(false),
@@ -585,6 +595,12 @@ public:
     primary_temp.reset(new mempool::osdmap::map<pg_t,int32_t>(*o.primary_temp));
     pg_temp.reset(new PGTempMap(*o.pg_temp));
     osd_uuid.reset(new mempool::osdmap::vector<uuid_d>(*o.osd_uuid));
+    pg_upmap.reset(new pg_upmap_t(*o.pg_upmap));
+    pg_upmap_items.reset(new pg_upmap_items_t(*o.pg_upmap_items));
+    pools.reset(new mempool::osdmap::map<int64_t,pg_pool_t>(*o.pools));
+    pool_name.reset(new mempool::osdmap::map<int64_t,string>(*o.pool_name));
+    erasure_code_profiles.reset(new ec_profiles_t(*o.erasure_code_profiles));
+    name_pool.reset(new mempool::osdmap::map<string,int64_t>(*o.name_pool));
 
     if (o.osd_primary_affinity)
       osd_primary_affinity.reset(new mempool::osdmap::vector<__u32>(*o.osd_primary_affinity));
@@ -596,6 +612,28 @@ public:
     // allocate a new CrushWrapper, though.
   }
 
+  /// copy that keeps sharing sub-structures until they are modified
+  void cow_copy_from(const OSDMap& o) {
+    *this = o;
+  }
+
+private:
+  /**
+   * A cow_copy_from() of a map shares crush, pg_temp, primary_temp,
+   * osd_primary_affinity, osd_uuid, osd_addrs, pg_upmap,
+   * pg_upmap_items, pools, pool_name, name_pool and
+   * erasure_code_profiles with the original.
+   * Anything that modifies one of them in place must cow() it first,
+   * so only the sub-structures an incremental really touches are
+   * duplicated.
+   */
+  template <class T>
+  static void cow(ceph::shared_ptr<T> &p) {
+    if (p && p.use_count() > 1)
+      p.reset(new T(*p));
+  }
+public:
+
   // map info
   const uuid_d& get_fsid() const { return fsid; }
   void set_fsid(uuid_d& f) { fsid = f; }
@@ -706,6 +744,7 @@ public:
       osd_primary_affinity.reset(
 	new mempool::osdmap::vector<__u32>(
 	  max_osd, CEPH_OSD_DEFAULT_PRIMARY_AFFINITY));
+    cow(osd_primary_affinity);
     (*osd_primary_affinity)[o] = w;
   }
   unsigned get_primary_affinity(int o) const {
@@ -719,27 +758,28 @@ public:
   }
 
   bool has_erasure_code_profile(const string &name) const {
-    auto i = erasure_code_profiles.find(name);
-    return i != erasure_code_profiles.end();
+    auto i = erasure_code_profiles->find(name);
+    return i != erasure_code_profiles->end();
   }
   int get_erasure_code_profile_default(CephContext *cct,
 				       map<string,string> &profile_map,
 				       ostream *ss);
   void set_erasure_code_profile(const string &name,
 				const map<string,string>& profile) {
-    erasure_code_profiles[name] = profile;
+    cow(erasure_code_profiles);
+    (*erasure_code_profiles)[name] = profile;
   }
   const map<string,string> &get_erasure_code_profile(
     const string &name) const {
     static map<string,string> empty;
-    auto i = erasure_code_profiles.find(name);
-    if (i == erasure_code_profiles.end())
+    auto i = erasure_code_profiles->find(name);
+    if (i == erasure_code_profiles->end())
       return empty;
     else
       return i->second;
   }
   const mempool::osdmap::map<string,map<string,string> > &get_erasure_code_profiles() const {
-    return erasure_code_profiles;
+    return *erasure_code_profiles;
   }
 
   bool exists(int osd) const {
@@ -1076,7 +1116,8 @@ private:
    */
   void _pg_to_up_acting_osds(const pg_t& pg, vector<int> *up, int *up_primary,
                              vector<int> *acting, int *acting_primary,
-			     bool raw_pg_to_pg = true) const;
+			     bool raw_pg_to_pg = true,
+			     vector<int> *raw_upmap = nullptr) const;
 
 public:
   /***
@@ -1110,13 +1151,23 @@ public:
                             vector<int> *acting, int *acting_primary) const {
     _pg_to_up_acting_osds(pg, up, up_primary, acting, acting_primary);
   }
+  /**
+   * as above, and also return the raw (crush + pg_upmap) set the up set
+   * was derived from.  Each of these pointers must be non-NULL.
+   */
+  void pg_to_raw_up_acting_osds(pg_t pg, vector<int> *raw,
+				vector<int> *up, int *up_primary,
+				vector<int> *acting, int *acting_primary) const {
+    _pg_to_up_acting_osds(pg, up, up_primary, acting, acting_primary,
+			  true, raw);
+  }
   void pg_to_up_acting_osds(pg_t pg, vector<int>& up, vector<int>& acting) const {
     int up_primary, acting_primary;
     pg_to_up_acting_osds(pg, &up, &up_primary, &acting, &acting_primary);
   }
   bool pg_is_ec(pg_t pg) const {
-    auto i = pools.find(pg.pool());
-    assert(i != pools.end());
+    auto i = pools->find(pg.pool());
+    assert(i != pools->end());
     return i->second.is_erasure();
   }
   bool get_primary_shard(const pg_t& pgid, spg_t *out) const {
@@ -1141,8 +1192,8 @@ public:
   }
 
   int64_t lookup_pg_pool_name(const string& name) const {
-    auto p = name_pool.find(name);
-    if (p == name_pool.end())
+    auto p = name_pool->find(name);
+    if (p == name_pool->end())
       return -ENOENT;
     return p->second;
   }
@@ -1151,14 +1202,15 @@ public:
     return pool_max;
   }
   const mempool::osdmap::map<int64_t,pg_pool_t>& get_pools() const {
-    return pools;
+    return *pools;
   }
   mempool::osdmap::map<int64_t,pg_pool_t>& get_pools() {
-    return pools;
+    cow(pools);
+    return *pools;
   }
   void get_pool_ids_by_rule(int rule_id, set<int64_t> *pool_ids) const {
     assert(pool_ids);
-    for (auto &p: pools) {
+    for (auto &p: *pools) {
       if (p.second.get_crush_rule() == rule_id) {
         pool_ids->insert(p.first);
       }
@@ -1168,37 +1220,37 @@ public:
                            int osd,
                            set<int64_t> *pool_ids) const;
   const string& get_pool_name(int64_t p) const {
-    auto i = pool_name.find(p);
-    assert(i != pool_name.end());
+    auto i = pool_name->find(p);
+    assert(i != pool_name->end());
     return i->second;
   }
   const mempool::osdmap::map<int64_t,string>& get_pool_names() const {
-    return pool_name;
+    return *pool_name;
   }
   bool have_pg_pool(int64_t p) const {
-    return pools.count(p);
+    return pools->count(p);
   }
   const pg_pool_t* get_pg_pool(int64_t p) const {
-    auto i = pools.find(p);
-    if (i != pools.end())
+    auto i = pools->find(p);
+    if (i != pools->end())
       return &i->second;
     return NULL;
   }
   unsigned get_pg_size(pg_t pg) const {
-    auto p = pools.find(pg.pool());
-    assert(p != pools.end());
+    auto p = pools->find(pg.pool());
+    assert(p != pools->end());
     return p->second.get_size();
   }
   int get_pg_type(pg_t pg) const {
-    auto p = pools.find(pg.pool());
-    assert(p != pools.end());
+    auto p = pools->find(pg.pool());
+    assert(p != pools->end());
     return p->second.get_type();
   }
 
 
   pg_t raw_pg_to_pg(pg_t pg) const {
-    auto p = pools.find(pg.pool());
-    assert(p != pools.end());
+    auto p = pools->find(pg.pool());
+    assert(p != pools->end());
     return p->second.raw_pg_to_pg(pg);
   }
 
@@ -1330,6 +1382,8 @@ public:
   int validate_crush_rules(CrushWrapper *crush, ostream *ss) const;
 
   void clear_temp() {
+    cow(pg_temp);
+    cow(primary_temp);
     pg_temp->clear();
     primary_temp->clear();
   }
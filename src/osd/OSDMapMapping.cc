@@ -30,15 +30,16 @@ void OSDMapMapping::_init_mappings(const OSDMap& osdmap)
 	q = pools.erase(q);
       } else {
 	// keep it
+	q->second.set_mapping_inputs(p.second);
 	++q;
 	continue;
       }
     }
-    pools.emplace(p.first, PoolMapping(p.second.get_size(),
-				       p.second.get_pg_num()));
+    pools.emplace(p.first, PoolMapping(p.second));
   }
   pools.erase(q, pools.end());
   assert(pools.size() == osdmap.get_pools().size());
+  valid = false;
 }
 
 void OSDMapMapping::update(const OSDMap& osdmap)
@@ -56,6 +57,163 @@ void OSDMapMapping::update(const OSDMap& osdmap, pg_t pgid)
   _update_range(osdmap, pgid.pool(), pgid.ps(), pgid.ps() + 1);
 }
 
+bool OSDMapMapping::update(const OSDMap& osdmap,
+			   const OSDMap::Incremental& inc)
+{
+  affected_pgs_t affected;
+  if (!_get_affected(osdmap, inc, &affected)) {
+    update(osdmap);
+    return false;
+  }
+  _start(osdmap);
+  for (auto& p : affected) {
+    for (auto ps : p.second) {
+      _update_range(osdmap, p.first, ps, ps + 1);
+    }
+  }
+  _finish(osdmap);
+  return true;
+}
+
+bool OSDMapMapping::_get_affected(
+  const OSDMap& osdmap,
+  const OSDMap::Incremental& inc,
+  affected_pgs_t *affected) const
+{
+  if (!valid ||
+      inc.epoch != osdmap.get_epoch() ||
+      epoch + 1 != osdmap.get_epoch() ||
+      inc.fullmap.length() ||
+      inc.crush.length() ||
+      (inc.new_max_osd >= 0 &&
+       (unsigned)inc.new_max_osd != osd_weight.size()) ||
+      (unsigned)osdmap.get_max_osd() != osd_weight.size()) {
+    return false;
+  }
+
+  // osds whose pgs may map differently now
+  std::vector<bool> osds(osd_weight.size());
+  bool any_osds = false;
+  auto mark = [&](int osd) {
+    if (osd < 0 || (unsigned)osd >= osds.size()) {
+      return false;
+    }
+    uint32_t w = osdmap.exists(osd) ? osdmap.get_weight(osd) : 0;
+    if (w > osd_weight[osd]) {
+      // crush may now accept this osd for pgs that rejected it before,
+      // and we don't know which those are
+      return false;
+    }
+    osds[osd] = true;
+    any_osds = true;
+    return true;
+  };
+  for (auto& p : inc.new_weight) {
+    if (!mark(p.first)) {
+      return false;
+    }
+  }
+  for (auto& p : inc.new_state) {
+    if (!mark(p.first)) {
+      return false;
+    }
+  }
+  for (auto& p : inc.new_up_client) {
+    if (!mark(p.first)) {
+      return false;
+    }
+  }
+  for (auto& p : inc.new_primary_affinity) {
+    if (!mark(p.first)) {
+      return false;
+    }
+  }
+
+  std::map<int64_t,std::set<unsigned>> pgs;
+  for (auto& p : osdmap.get_pools()) {
+    auto q = pools.find(p.first);
+    if (q == pools.end() || !q->second.same_mapping_inputs(p.second)) {
+      // new or reshaped pool: remap all of it
+      auto& v = (*affected)[p.first];
+      v.resize(p.second.get_pg_num());
+      for (unsigned ps = 0; ps < v.size(); ++ps) {
+	v[ps] = ps;
+      }
+      continue;
+    }
+    auto& s = pgs[p.first];
+    if (any_osds) {
+      for (unsigned ps = 0; ps < q->second.pg_num; ++ps) {
+	if (q->second.maps_to_any(ps, osds)) {
+	  s.insert(ps);
+	}
+      }
+    }
+  }
+  auto add = [&](pg_t pgid) {
+    auto p = pgs.find(pgid.pool());
+    if (p != pgs.end() &&
+	pgid.ps() < osdmap.get_pg_pool(pgid.pool())->get_pg_num()) {
+      p->second.insert(pgid.ps());
+    }
+  };
+  if (any_osds) {
+    // pg_temp osds that went down are filtered out of acting, so they
+    // aren't in the table when they come back up
+    for (auto p = osdmap.pg_temp->begin(); p != osdmap.pg_temp->end(); ++p) {
+      for (auto osd : p->second) {
+	if (osd >= 0 && (unsigned)osd < osds.size() && osds[osd]) {
+	  add(p->first);
+	  break;
+	}
+      }
+    }
+    for (auto& p : *osdmap.primary_temp) {
+      if (p.second >= 0 && (unsigned)p.second < osds.size() &&
+	  osds[p.second]) {
+	add(p.first);
+      }
+    }
+    // the stored raw set is post-upmap, so an item's source osd is no
+    // longer in it, but crush's choice of that osd still decides whether
+    // the item applies
+    for (auto& p : *osdmap.pg_upmap_items) {
+      for (auto& q : p.second) {
+	if (q.first >= 0 && (unsigned)q.first < osds.size() &&
+	    osds[q.first]) {
+	  add(p.first);
+	  break;
+	}
+      }
+    }
+  }
+  for (auto& p : inc.new_pg_temp) {
+    add(p.first);
+  }
+  for (auto& p : inc.new_primary_temp) {
+    add(p.first);
+  }
+  for (auto& p : inc.new_pg_upmap) {
+    add(p.first);
+  }
+  for (auto& p : inc.old_pg_upmap) {
+    add(p);
+  }
+  for (auto& p : inc.new_pg_upmap_items) {
+    add(p.first);
+  }
+  for (auto& p : inc.old_pg_upmap_items) {
+    add(p);
+  }
+
+  for (auto& p : pgs) {
+    if (!p.second.empty()) {
+      (*affected)[p.first].assign(p.second.begin(), p.second.end());
+    }
+  }
+  return true;
+}
+
 void OSDMapMapping::_build_rmap(const OSDMap& osdmap)
 {
   acting_rmap.resize(osdmap.get_max_osd());
@@ -86,7 +244,13 @@ void OSDMapMapping::_build_rmap(const OSDMap& osdmap)
 void OSDMapMapping::_finish(const OSDMap& osdmap)
 {
   _build_rmap(osdmap);
+  osd_weight.resize(osdmap.get_max_osd());
+  for (int i = 0; i < osdmap.get_max_osd(); ++i) {
+    // a nonexistent osd is never mapped, just like an out one
+    osd_weight[i] = osdmap.exists(i) ? osdmap.get_weight(i) : 0;
+  }
   epoch = osdmap.get_epoch();
+  valid = true;
 }
 
 void OSDMapMapping::_dump()
@@ -112,13 +276,12 @@ void OSDMapMapping::_update_range(
   assert(pg_begin <= pg_end);
   assert(pg_end <= i->second.pg_num);
   for (unsigned ps = pg_begin; ps < pg_end; ++ps) {
-    vector<int> up, acting;
+    vector<int> raw, up, acting;
     int up_primary, acting_primary;
-    osdmap.pg_to_up_acting_osds(
+    osdmap.pg_to_raw_up_acting_osds(
       pg_t(ps, pool),
-      &up, &up_primary, &acting, &acting_primary);
-    i->second.set(ps, std::move(up), up_primary,
-		  std::move(acting), acting_primary);
+      &raw, &up, &up_primary, &acting, &acting_primary);
+    i->second.set(ps, raw, up, up_primary, acting, acting_primary);
   }
 }
 
@@ -170,3 +333,23 @@ void ParallelPGMapper::queue(
   }
   assert(any);
 }
+
+void ParallelPGMapper::queue(
+  Job *job,
+  unsigned pgs_per_item,
+  const std::map<int64_t,unsigned>& items_per_pool)
+{
+  // hold a shard of our own so the job can't complete (or, if there is
+  // nothing to do, does complete) while we queue
+  job->start_one();
+  for (auto& p : items_per_pool) {
+    for (unsigned i = 0; i < p.second; i += pgs_per_item) {
+      unsigned i_end = MIN(i + pgs_per_item, p.second);
+      job->start_one();
+      wq.queue(new Item(job, p.first, i, i_end));
+      ldout(cct, 20) << __func__ << " " << job << " " << p.first << " [" << i
+		     << "," << i_end << ")" << dendl;
+    }
+  }
+  job->finish_one();
+}
@@ -9,10 +9,9 @@
 #include <map>
 
 #include "osd/osd_types.h"
+#include "osd/OSDMap.h"
 #include "common/WorkQueue.h"
 
-class OSDMap;
-
 /// work queue to perform work on batches of pgids on multiple CPUs
 class ParallelPGMapper {
 public:
@@ -159,6 +158,14 @@ public:
     Job *job,
     unsigned pgs_per_item);
 
+  /// queue only items_per_pool[pool] items for each pool; process() is
+  /// handed [begin, end) ranges of those item indexes rather than of ps.
+  /// the job completes even if there is nothing to queue.
+  void queue(
+    Job *job,
+    unsigned pgs_per_item,
+    const std::map<int64_t,unsigned>& items_per_pool);
+
   void drain() {
     wq.drain();
   }
@@ -176,6 +183,11 @@ private:
 
     unsigned size = 0;
     unsigned pg_num = 0;
+    /// other pool properties the mapping depends on
+    unsigned pgp_num = 0;
+    int crush_rule = -1;
+    bool hashpspool = false;
+    bool can_shift_osds = false;
     mempool::osdmap_mapping::vector<int32_t> table;
 
     size_t row_size() const {
@@ -185,13 +197,53 @@ private:
 	1 + // num acting
 	1 + // num up
 	size + // acting
-	size;  // up
+	size + // up
+	1 + // num raw
+	size;  // raw (crush + pg_upmap), for incremental updates
     }
 
-    PoolMapping(int s, int p)
-      : size(s),
-	pg_num(p),
+    PoolMapping(const pg_pool_t& pi)
+      : size(pi.get_size()),
+	pg_num(pi.get_pg_num()),
 	table(pg_num * row_size()) {
+      set_mapping_inputs(pi);
+    }
+
+    void set_mapping_inputs(const pg_pool_t& pi) {
+      pgp_num = pi.get_pgp_num();
+      crush_rule = pi.get_crush_rule();
+      hashpspool = pi.has_flag(pg_pool_t::FLAG_HASHPSPOOL);
+      can_shift_osds = pi.can_shift_osds();
+    }
+
+    /// true if pi maps its pgs exactly as the pool we were built for
+    bool same_mapping_inputs(const pg_pool_t& pi) const {
+      return
+	size == pi.get_size() &&
+	pg_num == pi.get_pg_num() &&
+	pgp_num == pi.get_pgp_num() &&
+	crush_rule == pi.get_crush_rule() &&
+	hashpspool == pi.has_flag(pg_pool_t::FLAG_HASHPSPOOL) &&
+	can_shift_osds == pi.can_shift_osds();
+    }
+
+    /// true if the raw, up or acting set of ps has any osd in osds.  The
+    /// raw set is post-upmap, so this misses pg_upmap_items sources; see
+    /// OSDMapMapping::_get_affected.
+    bool maps_to_any(size_t ps, const std::vector<bool>& osds) const {
+      const int32_t *row = &table[row_size() * ps];
+      auto has = [&](const int32_t *v, int n) {
+	for (int i = 0; i < n; ++i) {
+	  if (v[i] >= 0 && (size_t)v[i] < osds.size() && osds[v[i]]) {
+	    return true;
+	  }
+	}
+	return false;
+      };
+      return
+	has(row + 4, row[2]) ||
+	has(row + 4 + size, row[3]) ||
+	has(row + 5 + 2 * size, row[4 + 2 * size]);
     }
 
     void get(size_t ps,
@@ -221,6 +273,7 @@ private:
     }
 
     void set(size_t ps,
+	     const std::vector<int>& raw,
 	     const std::vector<int>& up,
 	     int up_primary,
 	     const std::vector<int>& acting,
@@ -236,6 +289,11 @@ private:
       for (int i = 0; i < row[3]; ++i) {
 	row[4 + size + i] = up[i];
       }
+      int32_t *r = row + 4 + 2 * size;
+      r[0] = raw.size();
+      for (int i = 0; i < r[0]; ++i) {
+	r[1 + i] = raw[i];
+      }
     }
   };
 
@@ -245,6 +303,19 @@ private:
   //unused: mempool::osdmap_mapping::vector<std::vector<pg_t>> up_rmap;  // osd -> pg
   epoch_t epoch = 0;
   uint64_t num_pgs = 0;
+  /// false while an update is in progress (or was aborted)
+  bool valid = false;
+  /// osd weights as of epoch (0 for nonexistent osds)
+  mempool::osdmap_mapping::vector<uint32_t> osd_weight;
+
+  /// pool -> ps to remap, for an incremental update
+  typedef std::map<int64_t,std::vector<unsigned>> affected_pgs_t;
+
+  /// find the pgs whose mapping inc may have changed; false if we need
+  /// to remap everything
+  bool _get_affected(const OSDMap& osdmap,
+		     const OSDMap::Incremental& inc,
+		     affected_pgs_t *affected) const;
 
   void _init_mappings(const OSDMap& osdmap);
   void _update_range(
@@ -277,6 +348,19 @@ private:
     }
   };
 
+  struct IncrementalMappingJob : public MappingJob {
+    const affected_pgs_t affected;
+    IncrementalMappingJob(const OSDMap *osdmap, OSDMapMapping *m,
+			  affected_pgs_t&& a)
+      : MappingJob(osdmap, m), affected(std::move(a)) {}
+    void process(int64_t pool, unsigned begin, unsigned end) override {
+      const auto& v = affected.at(pool);
+      for (unsigned i = begin; i < end; ++i) {
+	mapping->_update_range(*osdmap, pool, v[i], v[i] + 1);
+      }
+    }
+  };
+
 public:
   void get(pg_t pgid,
 	   std::vector<int> *up,
@@ -303,6 +387,17 @@ public:
   void update(const OSDMap& map);
   void update(const OSDMap& map, pg_t pgid);
 
+  /**
+   * update a mapping of the previous epoch to map, which inc was just
+   * applied to, remapping only the pgs inc can have affected.  falls
+   * back to a full update if we aren't at the previous epoch or inc
+   * changes something that can move any pg (crush, max_osd, an osd
+   * weight going up or a weighted osd being created).
+   *
+   * @return true if the update was incremental
+   */
+  bool update(const OSDMap& map, const OSDMap::Incremental& inc);
+
   std::unique_ptr<MappingJob> start_update(
     const OSDMap& map,
     ParallelPGMapper& mapper,
@@ -312,6 +407,26 @@ public:
     return job;
   }
 
+  /// parallel version of update(map, inc)
+  std::unique_ptr<MappingJob> start_update(
+    const OSDMap& map,
+    const OSDMap::Incremental& inc,
+    ParallelPGMapper& mapper,
+    unsigned pgs_per_item) {
+    affected_pgs_t affected;
+    if (!_get_affected(map, inc, &affected)) {
+      return start_update(map, mapper, pgs_per_item);
+    }
+    std::map<int64_t,unsigned> items;
+    for (auto& p : affected) {
+      items[p.first] = p.second.size();
+    }
+    std::unique_ptr<MappingJob> job(
+      new IncrementalMappingJob(&map, this, std::move(affected)));
+    mapper.queue(job.get(), pgs_per_item, items);
+    return job;
+  }
+
   epoch_t get_epoch() const {
     return epoch;
   }
@@ -4041,41 +4041,146 @@ void PG::_repair_oinfo_oid(ScrubMap &smap)
 /*
  * build a scrub map over a chunk without releasing the lock
  * only used by chunky scrub
+ *
+ * returns -EINPROGRESS when the scrub should step aside for client ops
+ * or to stay within the scrub read budget; pos.delay then says how long
+ * to wait before calling again to carry on where it left off.
  */
 int PG::build_scrub_map_chunk(
   ScrubMap &map,
+  Scrubber::MapBuilder &pos,
   hobject_t start, hobject_t end, bool deep, uint32_t seed,
   ThreadPool::TPHandle &handle)
 {
   dout(10) << __func__ << " [" << start << "," << end << ") "
-	   << " seed " << seed << dendl;
-
-  map.valid_through = info.last_update;
-
-  // objects
-  vector<hobject_t> ls;
-  vector<ghobject_t> rollback_obs;
-  int ret = get_pgbackend()->objects_list_range(
-    start,
-    end,
-    0,
-    &ls,
-    &rollback_obs);
-  if (ret < 0) {
-    dout(5) << "objects_list_range error: " << ret << dendl;
-    return ret;
-  }
-
+	   << " seed " << seed
+	   << (pos.in_progress() ? " resuming at " : " pos ") << pos.pos
+	   << dendl;
 
-  get_pgbackend()->be_scan_list(map, ls, deep, seed, handle);
-  _scan_rollback_obs(rollback_obs, handle);
+  if (!pos.in_progress()) {
+    map.valid_through = info.last_update;
+
+    // objects
+    int ret = get_pgbackend()->objects_list_range(
+      start,
+      end,
+      0,
+      &pos.ls,
+      &pos.rollback_obs);
+    if (ret < 0) {
+      dout(5) << "objects_list_range error: " << ret << dendl;
+      pos.reset();
+      return ret;
+    }
+    pos.listed = true;
+  }
+
+  // objects are scanned in listing order, which is the order the store
+  // keeps them in, one at a time so that we can yield between them
+  utime_t slice_start = ceph_clock_now();
+  size_t slice_first = pos.pos;
+  while (pos.pos < pos.ls.size()) {
+    utime_t delay = osd->scrub_io_delay();
+    if (delay > utime_t()) {
+      dout(20) << __func__ << " over scrub read budget, waiting " << delay
+	       << dendl;
+      osd->logger->inc(l_osd_scrub_throttled);
+      pos.delay = delay;
+      return -EINPROGRESS;
+    }
+    if (pos.preemptions < cct->_conf->osd_scrub_max_preemptions &&
+	osd->scrub_should_preempt()) {
+      ++pos.preemptions;
+      dout(20) << __func__ << " preempted by client ops ("
+	       << pos.preemptions << ")" << dendl;
+      osd->logger->inc(l_osd_scrub_preempted);
+      pos.delay = utime_t();
+      pos.delay.set_from_double(cct->_conf->osd_scrub_preempt_sleep);
+      return -EINPROGRESS;
+    }
+    if (cct->_conf->osd_scrub_time_slice > 0 &&
+	pos.pos > slice_first &&
+	(double)(ceph_clock_now() - slice_start) >
+	  cct->_conf->osd_scrub_time_slice) {
+      dout(20) << __func__ << " time slice used up after "
+	       << pos.pos - slice_first << " objects" << dendl;
+      pos.delay = utime_t();
+      return -EINPROGRESS;
+    }
+
+    const hobject_t &poid = pos.ls[pos.pos];
+    get_pgbackend()->be_scan_object(map, poid, deep, seed, handle);
+    ++pos.pos;
+
+    uint64_t bytes = 0;
+    auto p = map.objects.find(poid);
+    if (deep && p != map.objects.end())
+      bytes = p->second.size;
+    osd->scrub_io_charge(
+      ScrubIOBudget::object_ops(deep, bytes,
+				cct->_conf->osd_deep_scrub_stride),
+      bytes);
+  }
+
+  _scan_rollback_obs(pos.rollback_obs, handle);
   _scan_snaps(map);
   _repair_oinfo_oid(map);
+  pos.reset();
 
   dout(20) << __func__ << " done" << dendl;
   return 0;
 }
 
+/*
+ * requeue a scrub that yielded in build_scrub_map_chunk, right away or
+ * after @delay.  @rep_scrub_op is the MOSDRepScrub to resume on a
+ * replica, null on the primary.
+ */
+void PG::scrub_resume_after(utime_t delay, OpRequestRef rep_scrub_op)
+{
+  if (rep_scrub_op)
+    scrubber.yielded_rep_scrub = rep_scrub_op;
+  if (delay == utime_t()) {
+    scrub_resume(rep_scrub_op);
+    return;
+  }
+
+  OSDService *osds = osd;
+  spg_t pgid = get_pgid();
+  auto callback = new FunctionContext([osds, pgid, rep_scrub_op](int r) {
+      PG *pg = osds->osd->lookup_lock_pg(pgid);
+      if (pg == nullptr) {
+	lgeneric_dout(osds->osd->cct, 20)
+	  << "scrub_resume_after: Could not find "
+	  << "PG " << pgid << " can't resume scrub" << dendl;
+	return;
+      }
+      pg->scrub_resume(rep_scrub_op);
+      pg->unlock();
+    });
+  Mutex::Locker l(osd->scrub_sleep_lock);
+  osd->scrub_sleep_timer.add_event_after(delay, callback);
+}
+
+void PG::scrub_resume(OpRequestRef rep_scrub_op)
+{
+  if (rep_scrub_op) {
+    if (scrubber.yielded_rep_scrub != rep_scrub_op) {
+      dout(20) << __func__ << " replica scrub was reset" << dendl;
+      return;
+    }
+    osd->enqueue_back(
+      info.pgid,
+      PGQueueable(rep_scrub_op, get_osdmap()->get_epoch()));
+  } else {
+    if (scrubber.state != PG::Scrubber::BUILD_MAP) {
+      dout(20) << __func__ << " scrub was reset" << dendl;
+      return;
+    }
+    requeue_scrub();
+  }
+}
+
 void PG::Scrubber::cleanup_store(ObjectStore::Transaction *t) {
   if (!store)
     return;
@@ -4181,9 +4286,22 @@ void PG::replica_scrub(
   if (!end.is_max())
     end.pool = info.pgid.pool();
 
-  build_scrub_map_chunk(
-    map, start, end, msg->deep, msg->seed,
+  if (scrubber.yielded_rep_scrub != op) {
+    // a new chunk rather than the resumption of a yielded one
+    scrubber.replica_scrubmap = ScrubMap();
+    scrubber.replica_scrubmap_pos.reset();
+  }
+  scrubber.yielded_rep_scrub = OpRequestRef();
+
+  int r = build_scrub_map_chunk(
+    scrubber.replica_scrubmap, scrubber.replica_scrubmap_pos,
+    start, end, msg->deep, msg->seed,
     handle);
+  if (r == -EINPROGRESS) {
+    scrub_resume_after(scrubber.replica_scrubmap_pos.delay, op);
+    return;
+  }
+  map.swap(scrubber.replica_scrubmap);
 
   MOSDRepScrubMap *reply = new MOSDRepScrubMap(
     spg_t(info.pgid.pgid, get_primary().shard),
@@ -4537,9 +4655,17 @@ void PG::chunky_scrub(ThreadPool::TPHandle &handle)
 
         // build my own scrub map
         ret = build_scrub_map_chunk(scrubber.primary_scrubmap,
+				    scrubber.primary_scrubmap_pos,
                                     scrubber.start, scrubber.end,
                                     scrubber.deep, scrubber.seed,
 				    handle);
+        if (ret == -EINPROGRESS) {
+          // picks up where it left off once requeued
+          scrub_resume_after(scrubber.primary_scrubmap_pos.delay,
+                             OpRequestRef());
+          done = true;
+          break;
+        }
         if (ret < 0) {
           dout(5) << "error building scrub map: " << ret << ", aborting" << dendl;
           scrub_clear_state();
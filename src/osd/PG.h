@@ -1469,6 +1469,23 @@ public:
     ScrubMap primary_scrubmap;
     map<pg_shard_t, ScrubMap> received_maps;
     OpRequestRef active_rep_scrub;
+
+    // where a time sliced build_scrub_map_chunk left off
+    struct MapBuilder {
+      bool listed = false;
+      vector<hobject_t> ls;
+      vector<ghobject_t> rollback_obs;
+      size_t pos = 0;
+      unsigned preemptions = 0;
+      utime_t delay;  // how long to wait before resuming
+
+      bool in_progress() const { return listed; }
+      void reset() { *this = MapBuilder(); }
+    };
+    MapBuilder primary_scrubmap_pos;
+    ScrubMap replica_scrubmap;
+    MapBuilder replica_scrubmap_pos;
+    OpRequestRef yielded_rep_scrub;  // replica scrub op waiting to resume
     utime_t scrub_reg_stamp;  // stamp we registered for
 
     // For async sleep
@@ -1568,6 +1585,10 @@ public:
         active_rep_scrub = OpRequestRef();
       }
       received_maps.clear();
+      primary_scrubmap_pos.reset();
+      replica_scrubmap = ScrubMap();
+      replica_scrubmap_pos.reset();
+      yielded_rep_scrub = OpRequestRef();
 
       must_scrub = false;
       must_deep_scrub = false;
@@ -1626,8 +1647,11 @@ protected:
 			  uint32_t seed);
   int build_scrub_map_chunk(
     ScrubMap &map,
+    Scrubber::MapBuilder &pos,
     hobject_t start, hobject_t end, bool deep, uint32_t seed,
     ThreadPool::TPHandle &handle);
+  void scrub_resume_after(utime_t delay, OpRequestRef rep_scrub_op);
+  void scrub_resume(OpRequestRef rep_scrub_op);
   /**
    * returns true if [begin, end) is good to scrub at this time
    * a false return value obliges the implementer to requeue scrub when the
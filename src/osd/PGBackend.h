@@ -35,6 +35,10 @@ struct inconsistent_obj_wrapper;
 //forward declaration
 class OSDMap;
 class PGLog;
+namespace ECUtil {
+  class StripeCoder;
+}
+class ECReadCache;
 typedef ceph::shared_ptr<const OSDMap> OSDMapRef;
 
  /**
@@ -274,6 +278,10 @@ typedef ceph::shared_ptr<const OSDMap> OSDMapRef;
      virtual entity_name_t get_cluster_msgr_name() = 0;
 
      virtual PerfCounters *get_logger() = 0;
+     /// shared pool coding the stripes of large EC ops in parallel
+     virtual ECUtil::StripeCoder *get_ec_stripe_coder() = 0;
+     /// OSD-wide cache of reconstructed EC client reads
+     virtual ECReadCache *get_ec_read_cache() = 0;
 
      virtual ceph_tid_t get_tid() = 0;
 
@@ -556,6 +564,9 @@ typedef ceph::shared_ptr<const OSDMap> OSDMapRef;
    void be_scan_list(
      ScrubMap &map, const vector<hobject_t> &ls, bool deep, uint32_t seed,
      ThreadPool::TPHandle &handle);
+   void be_scan_object(
+     ScrubMap &map, const hobject_t &poid, bool deep, uint32_t seed,
+     ThreadPool::TPHandle &handle);
    bool be_compare_scrub_objects(
      pg_shard_t auth_shard,
      const ScrubMap::object &auth,
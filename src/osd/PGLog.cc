@@ -354,6 +354,7 @@ void PGLog::merge_log(pg_info_t &oinfo, pg_log_t &olog, pg_shard_t fromosd,
 	 ++to) {
       if (to->version > log.tail)
 	break;
+      log.pack_entry_buffers(*to);
       log.index(*to);
       dout(15) << *to << dendl;
       last = to->version;
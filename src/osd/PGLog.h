@@ -63,6 +63,80 @@ struct PGLog : DoutPrefixProvider {
     virtual ~LogEntryHandler() {}
   };
 
+  /**
+   * EntryIndex - hash index of log entries by one of their own fields
+   *
+   * Only the key's hash is stored next to each entry pointer; lookups
+   * compare against the entry itself.  Indexing an entry therefore
+   * doesn't copy its hobject_t (and object name) or reqid, which is what
+   * a map keyed by value would do for every indexed entry.  Nodes are
+   * accounted in the osd_pglog mempool.
+   */
+  template <typename K, K pg_log_entry_t::*field>
+  class EntryIndex {
+    typedef std::unordered_multimap<
+      size_t, pg_log_entry_t*, std::hash<size_t>, std::equal_to<size_t>,
+      mempool::osd_pglog::pool_allocator<
+	std::pair<const size_t, pg_log_entry_t*>>> index_t;
+    index_t index;
+
+    static size_t hash(const K &k) {
+      return std::hash<K>()(k);
+    }
+  public:
+    typedef typename index_t::iterator iterator;
+    typedef typename index_t::const_iterator const_iterator;
+
+    iterator begin() { return index.begin(); }
+    iterator end() { return index.end(); }
+    const_iterator begin() const { return index.begin(); }
+    const_iterator end() const { return index.end(); }
+    size_t size() const { return index.size(); }
+    bool empty() const { return index.empty(); }
+
+    iterator find(const K &k) {
+      auto r = index.equal_range(hash(k));
+      for (auto p = r.first; p != r.second; ++p) {
+	if (p->second->*field == k)
+	  return p;
+      }
+      return index.end();
+    }
+    const_iterator find(const K &k) const {
+      auto r = index.equal_range(hash(k));
+      for (auto p = r.first; p != r.second; ++p) {
+	if (p->second->*field == k)
+	  return p;
+      }
+      return index.end();
+    }
+    size_t count(const K &k) const {
+      return find(k) != end() ? 1 : 0;
+    }
+
+    /// index e, replacing whatever entry had the same key
+    void set(pg_log_entry_t *e) {
+      auto p = find(e->*field);
+      if (p != index.end())
+	p->second = e;
+      else
+	index.emplace(hash(e->*field), e);
+    }
+    void erase(iterator p) {
+      index.erase(p);
+    }
+    size_t erase(const K &k) {
+      auto p = find(k);
+      if (p == index.end())
+	return 0;
+      index.erase(p);
+      return 1;
+    }
+    void clear() {
+      index.clear();
+    }
+  };
+
   /* Exceptions */
   class read_log_and_missing_error : public buffer::error {
   public:
@@ -82,8 +156,8 @@ public:
    * plus some methods to manipulate it all.
    */
   struct IndexedLog : public pg_log_t {
-    mutable ceph::unordered_map<hobject_t,pg_log_entry_t*> objects;  // ptrs into log.  be careful!
-    mutable ceph::unordered_map<osd_reqid_t,pg_log_entry_t*> caller_ops;
+    mutable EntryIndex<hobject_t, &pg_log_entry_t::soid> objects;  // ptrs into log.  be careful!
+    mutable EntryIndex<osd_reqid_t, &pg_log_entry_t::reqid> caller_ops;
     mutable ceph::unordered_multimap<osd_reqid_t,pg_log_entry_t*> extra_caller_ops;
     mutable ceph::unordered_map<osd_reqid_t,pg_log_dup_t*> dup_index;
 
@@ -129,6 +203,43 @@ public:
 	++rollback_info_trimmed_to_riter;
     }
 
+    /**
+     * Entries keep their small buffers (rollback info, clone snaps) in
+     * shared arena chunks rather than in a buffer each, or in the much
+     * bigger buffer they were decoded from.  The log is trimmed from the
+     * tail, so chunks are released in the order they were filled.
+     */
+    static const unsigned ENTRY_ARENA_CHUNK = 4096;
+    static const unsigned ENTRY_ARENA_MAX = 512;  // bigger gets its own
+    bufferptr entry_arena;
+
+    void pack(bufferlist &bl) {
+      unsigned len = bl.length();
+      if (len == 0)
+	return;
+      if (len > ENTRY_ARENA_MAX) {
+	bl.rebuild();
+	bl.reassign_to_mempool(mempool::mempool_osd_pglog);
+	return;
+      }
+      if (!entry_arena.have_raw() ||
+	  entry_arena.unused_tail_length() < len) {
+	entry_arena = buffer::create(ENTRY_ARENA_CHUNK);
+	entry_arena.reassign_to_mempool(mempool::mempool_osd_pglog);
+	entry_arena.set_length(0);
+      }
+      unsigned off = entry_arena.length();
+      for (auto &p : bl.buffers())
+	entry_arena.append(p.c_str(), p.length());
+      bl.clear();
+      bl.append(entry_arena, off, len);
+    }
+
+    void pack_entries() {
+      for (auto &e : log)
+	pack_entry_buffers(e);
+    }
+
     // indexes objects, caller ops and extra caller ops
   public:
     IndexedLog() :
@@ -147,6 +258,7 @@ public:
       rollback_info_trimmed_to_riter(log.rbegin())
     {
       reset_rollback_info_trimmed_to_riter();
+      pack_entries();
       index();
     }
 
@@ -167,6 +279,12 @@ public:
       return *this;
     }
 
+    /// move the buffers of an entry added to the log into the arena
+    void pack_entry_buffers(pg_log_entry_t &e) {
+      pack(e.mod_desc.bl);
+      pack(e.snaps);
+    }
+
     void trim_rollback_info_to(eversion_t to, LogEntryHandler *h) {
       advance_can_rollback_to(
 	to,
@@ -273,15 +391,14 @@ public:
       assert(version);
       assert(user_version);
       assert(return_code);
-      ceph::unordered_map<osd_reqid_t,pg_log_entry_t*>::const_iterator p;
       if (!(indexed_data & PGLOG_INDEXED_CALLER_OPS)) {
         index_caller_ops();
       }
-      p = caller_ops.find(r);
-      if (p != caller_ops.end()) {
-	*version = p->second->version;
-	*user_version = p->second->user_version;
-	*return_code = p->second->return_code;
+      auto op = caller_ops.find(r);
+      if (op != caller_ops.end()) {
+	*version = op->second->version;
+	*user_version = op->second->user_version;
+	*return_code = op->second->return_code;
 	return true;
       }
 
@@ -290,7 +407,7 @@ public:
       if (!(indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS)) {
         index_extra_caller_ops();
       }
-      p = extra_caller_ops.find(r);
+      auto p = extra_caller_ops.find(r);
       if (p != extra_caller_ops.end()) {
 	for (auto i = p->second->extra_reqids.begin();
 	     i != p->second->extra_reqids.end();
@@ -376,13 +493,13 @@ public:
 	     ++i) {
 	  if (to_index & PGLOG_INDEXED_OBJECTS) {
 	    if (i->object_is_indexed()) {
-	      objects[i->soid] = const_cast<pg_log_entry_t*>(&(*i));
+	      objects.set(const_cast<pg_log_entry_t*>(&(*i)));
 	    }
 	  }
 
 	  if (to_index & PGLOG_INDEXED_CALLER_OPS) {
 	    if (i->reqid_is_indexed()) {
-	      caller_ops[i->reqid] = const_cast<pg_log_entry_t*>(&(*i));
+	      caller_ops.set(const_cast<pg_log_entry_t*>(&(*i)));
 	    }
 	  }
 
@@ -418,14 +535,14 @@ public:
 
     void index(pg_log_entry_t& e) {
       if ((indexed_data & PGLOG_INDEXED_OBJECTS) && e.object_is_indexed()) {
-        if (objects.count(e.soid) == 0 ||
-            objects[e.soid]->version < e.version)
-          objects[e.soid] = &e;
+        auto p = objects.find(e.soid);
+        if (p == objects.end() || p->second->version < e.version)
+          objects.set(&e);
       }
       if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
 	// divergent merge_log indexes new before unindexing old
         if (e.reqid_is_indexed()) {
-	  caller_ops[e.reqid] = &e;
+	  caller_ops.set(&e);
         }
       }
       if (indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS) {
@@ -448,14 +565,16 @@ public:
     void unindex(const pg_log_entry_t& e) {
       // NOTE: this only works if we remove from the _tail_ of the log!
       if (indexed_data & PGLOG_INDEXED_OBJECTS) {
-        if (objects.count(e.soid) && objects[e.soid]->version == e.version)
-          objects.erase(e.soid);
+        auto p = objects.find(e.soid);
+        if (p != objects.end() && p->second->version == e.version)
+          objects.erase(p);
       }
       if (e.reqid_is_indexed()) {
         if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
 	  // divergent merge_log indexes new before unindexing old
-          if (caller_ops.count(e.reqid) && caller_ops[e.reqid] == &e)
-            caller_ops.erase(e.reqid);
+          auto p = caller_ops.find(e.reqid);
+          if (p != caller_ops.end() && p->second == &e)
+            caller_ops.erase(p);
         }
       }
       if (indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS) {
@@ -496,12 +615,12 @@ public:
 	assert(get_can_rollback_to() == head);
       }
 
-      // make sure our buffers don't pin bigger buffers
-      e.mod_desc.trim_bl();
-
       // add to log
       log.push_back(e);
 
+      // make sure our buffers don't pin bigger buffers
+      pack_entry_buffers(log.back());
+
       // riter previously pointed to the previous entry
       if (rollback_info_trimmed_to_riter == log.rbegin())
 	++rollback_info_trimmed_to_riter;
@@ -512,11 +631,11 @@ public:
 
       // to our index
       if ((indexed_data & PGLOG_INDEXED_OBJECTS) && e.object_is_indexed()) {
-        objects[e.soid] = &(log.back());
+        objects.set(&(log.back()));
       }
       if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
         if (e.reqid_is_indexed()) {
-	  caller_ops[e.reqid] = &(log.back());
+	  caller_ops.set(&(log.back()));
         }
       }
 
@@ -912,8 +1031,7 @@ protected:
 		       << " last_divergent_update: " << last_divergent_update
 		       << dendl;
 
-    ceph::unordered_map<hobject_t, pg_log_entry_t*>::const_iterator objiter =
-      log.objects.find(hoid);
+    auto objiter = log.objects.find(hoid);
     if (objiter != log.objects.end() &&
 	objiter->second->version >= first_divergent_update) {
       /// Case 1)
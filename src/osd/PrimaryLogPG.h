@@ -464,6 +464,12 @@ public:
   }
 
   PerfCounters *get_logger() override;
+  ECUtil::StripeCoder *get_ec_stripe_coder() override {
+    return &osd->ec_stripe_coder;
+  }
+  ECReadCache *get_ec_read_cache() override {
+    return &osd->ec_read_cache;
+  }
 
   ceph_tid_t get_tid() override { return osd->get_tid(); }
 
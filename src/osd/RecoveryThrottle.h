@@ -0,0 +1,115 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_OSD_RECOVERYTHROTTLE_H
+#define CEPH_OSD_RECOVERYTHROTTLE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+/*
+ * The control law behind osd_recovery_adaptive.  Once per tick it is
+ * given the latencies seen since the last tick and moves the limit on
+ * active recovery ops and the extra sleep between them: down
+ * multiplicatively while either latency is over target, back up
+ * additively while both are under and recovery is being held back.
+ *
+ * Not locked; OSDService serializes access.
+ */
+class RecoveryThrottle {
+public:
+  enum step_t {
+    STEP_NONE,
+    STEP_BACKOFF,
+    STEP_RAISE,
+  };
+
+  struct targets_t {
+    double client_lat = 0;  ///< seconds; 0 ignores client latency
+    double commit_lat = 0;  ///< seconds; 0 ignores commit latency
+    double max_sleep = 0;   ///< seconds; upper bound on the sleep
+  };
+
+private:
+  uint64_t max_active = 0;  ///< 0 until the first update
+  double sleep = 0;
+
+public:
+  uint64_t get_max_active() const {
+    return max_active;
+  }
+  double get_sleep() const {
+    return sleep;
+  }
+  void reset() {
+    max_active = 0;
+    sleep = 0;
+  }
+
+  /// average latency in seconds between two (count, total ms) samples
+  static double interval_latency(std::pair<uint64_t, uint64_t> prev,
+				 std::pair<uint64_t, uint64_t> cur) {
+    if (cur.first <= prev.first || cur.second < prev.second)
+      return 0;
+    return (double)(cur.second - prev.second) /
+      (double)(cur.first - prev.first) / 1000.0;
+  }
+
+  /**
+   * one recalibration step
+   *
+   * @param client_lat client op latency over the last interval
+   * @param commit_lat current store commit latency
+   * @param in_use recovery ops active or reserved
+   * @param waiting true if PGs are waiting for a recovery slot
+   * @param conf_max osd_recovery_max_active, the ceiling
+   */
+  step_t update(double client_lat, double commit_lat,
+		uint64_t in_use, bool waiting, uint64_t conf_max,
+		const targets_t& t) {
+    if (!max_active || max_active > conf_max)
+      max_active = conf_max;
+
+    bool over = (t.client_lat > 0 && client_lat > t.client_lat) ||
+      (t.commit_lat > 0 && commit_lat > t.commit_lat);
+    // only probe upwards while recovery is actually held back by us
+    bool limited = waiting || in_use >= max_active;
+
+    if (over) {
+      // back off multiplicatively: first concurrency, then pacing
+      if (max_active > 1) {
+	max_active /= 2;
+	return STEP_BACKOFF;
+      }
+      double s = std::min(std::max(sleep * 2, 0.01), t.max_sleep);
+      if (s == sleep)
+	return STEP_NONE;
+      sleep = s;
+      return STEP_BACKOFF;
+    }
+    if (limited) {
+      // and recover additively, undoing the pacing first
+      if (sleep > 0) {
+	sleep = sleep < 0.01 ? 0 : sleep / 2;
+	return STEP_RAISE;
+      }
+      if (max_active < conf_max) {
+	++max_active;
+	return STEP_RAISE;
+      }
+    }
+    return STEP_NONE;
+  }
+};
+
+#endif
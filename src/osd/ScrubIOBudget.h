@@ -0,0 +1,77 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_OSD_SCRUBIOBUDGET_H
+#define CEPH_OSD_SCRUBIOBUDGET_H
+
+#include <algorithm>
+
+#include "include/utime.h"
+
+/*
+ * The per-OSD scrub read budget.  Every scrubbing PG charges its reads
+ * here; each charge pushes back the time the budget is next available
+ * by as long as the reads take at the configured rate.  There is no
+ * burst allowance, so an idle budget does not bank time.
+ *
+ * Not locked; OSDService serializes access.
+ */
+class ScrubIOBudget {
+  utime_t next;  ///< when the budget is available again
+
+public:
+  /// reads issued to scan one object of @size bytes
+  static uint64_t object_ops(bool deep, uint64_t size, uint64_t stride) {
+    // stat and attrs, then on a deep scrub the data one stride at a time
+    uint64_t ops = 1;
+    if (deep) {
+      if (stride == 0)
+	stride = 1;
+      ops += (size + stride - 1) / stride;
+    }
+    return ops;
+  }
+
+  /// charge @ops reads of @bytes in total; a zero rate is unlimited
+  void charge(uint64_t ops, uint64_t bytes,
+	      uint64_t max_ops_per_sec, uint64_t max_bytes_per_sec,
+	      utime_t now) {
+    double cost = 0;
+    if (max_bytes_per_sec)
+      cost = std::max(cost, (double)bytes / max_bytes_per_sec);
+    if (max_ops_per_sec)
+      cost = std::max(cost, (double)ops / max_ops_per_sec);
+    if (cost == 0)
+      return;
+    if (next < now)
+      next = now;
+    // add a utime_t rather than the double, whose += does not carry a
+    // whole second of nsec
+    utime_t t;
+    t.set_from_double(cost);
+    next += t;
+  }
+
+  /// how long scrub reads must wait at @now to stay within budget
+  utime_t delay(utime_t now) const {
+    if (next <= now)
+      return utime_t();
+    return next - now;
+  }
+
+  /// true if @in_flight client ops should preempt scrub; 0 @depth is off
+  static bool should_preempt(uint64_t in_flight, uint64_t depth) {
+    return depth && in_flight >= depth;
+  }
+};
+
+#endif
@@ -62,8 +62,14 @@ namespace ceph {
   mClockClientQueue::op_class_client_info_f(
     const mClockClientQueue::InnerClient& client)
   {
-    switch(client.second) {
+    switch(client.op_type) {
     case osd_op_type_t::client_op:
+      if (client.pool >= 0) {
+	std::lock_guard<std::mutex> l(pool_tags_lock);
+	auto p = pool_tags.find(client.pool);
+	if (p != pool_tags.end())
+	  return p->second;
+      }
       return mclock_op_tags->client_op;
     case osd_op_type_t::osd_subop:
       return mclock_op_tags->osd_subop;
@@ -90,6 +96,64 @@ namespace ceph {
   mClockClientQueue::pg_queueable_visitor_t
   mClockClientQueue::pg_queueable_visitor;
 
+  std::mutex mClockClientQueue::pool_tags_lock;
+  std::map<int64_t,dmc::ClientInfo> mClockClientQueue::pool_tags;
+  std::atomic<uint64_t> mClockClientQueue::pool_tags_version(0);
+
+  void mClockClientQueue::update_pool_tags(
+    const mempool::osdmap::map<int64_t,pg_pool_t>& pools)
+  {
+    if (!mclock_op_tags)
+      return;
+    const dmc::ClientInfo& def = mclock_op_tags->client_op;
+    std::map<int64_t,dmc::ClientInfo> tags;
+    for (auto& p : pools) {
+      const pool_opts_t& opts = p.second.opts;
+      if (!opts.is_set(pool_opts_t::QOS_RES) &&
+	  !opts.is_set(pool_opts_t::QOS_WGT) &&
+	  !opts.is_set(pool_opts_t::QOS_LIM))
+	continue;
+      double res = def.reservation;
+      double wgt = def.weight;
+      double lim = def.limit;
+      opts.get(pool_opts_t::QOS_RES, &res);
+      opts.get(pool_opts_t::QOS_WGT, &wgt);
+      opts.get(pool_opts_t::QOS_LIM, &lim);
+      tags.emplace(p.first, dmc::ClientInfo(res, wgt, lim));
+    }
+
+    std::lock_guard<std::mutex> l(pool_tags_lock);
+    bool changed = tags.size() != pool_tags.size();
+    for (auto i = tags.begin(), j = pool_tags.begin();
+	 !changed && i != tags.end();
+	 ++i, ++j) {
+      changed = i->first != j->first ||
+	i->second.reservation != j->second.reservation ||
+	i->second.weight != j->second.weight ||
+	i->second.limit != j->second.limit;
+    }
+    if (changed) {
+      pool_tags.swap(tags);
+      ++pool_tags_version;
+    }
+  }
+
+  // called with the queue's (shard's) lock held, before anything that
+  // may create or tag a client record
+  void mClockClientQueue::maybe_update_client_infos() {
+    uint64_t v = pool_tags_version;
+    if (v != pool_tags_seen) {
+      {
+	std::lock_guard<std::mutex> l(pool_tags_lock);
+	pool_tags_seen = pool_tags_version;
+	tagged_pools.clear();
+	for (auto& p : pool_tags)
+	  tagged_pools.insert(tagged_pools.end(), p.first);
+      }
+      queue.update_client_infos();
+    }
+  }
+
   mClockClientQueue::mClockClientQueue(CephContext *cct) :
     queue(&mClockClientQueue::op_class_client_info_f)
   {
@@ -120,10 +184,20 @@ namespace ceph {
     }
   }
 
+  mClockClientQueue::InnerClient
+  mClockClientQueue::get_inner_client(const Client& cl,
+				      osd_op_type_t type,
+				      int64_t pool) const {
+    if (type == osd_op_type_t::client_op && tagged_pools.count(pool))
+      return InnerClient(0, type, pool);
+    return InnerClient(cl, type);
+  }
+
   mClockClientQueue::InnerClient
   inline mClockClientQueue::get_inner_client(const Client& cl,
 				      const Request& request) {
-    return InnerClient(cl, get_osd_op_type(request));
+    return get_inner_client(cl, get_osd_op_type(request),
+			    request.first.pool());
   }
 
   // Formatted output of the queue
@@ -134,6 +208,7 @@ namespace ceph {
   inline void mClockClientQueue::enqueue_strict(Client cl,
 						unsigned priority,
 						Request item) {
+    maybe_update_client_infos();
     queue.enqueue_strict(get_inner_client(cl, item), priority, item);
   }
 
@@ -141,6 +216,7 @@ namespace ceph {
   inline void mClockClientQueue::enqueue_strict_front(Client cl,
 						      unsigned priority,
 						      Request item) {
+    maybe_update_client_infos();
     queue.enqueue_strict_front(get_inner_client(cl, item), priority, item);
   }
 
@@ -149,6 +225,7 @@ namespace ceph {
 					 unsigned priority,
 					 unsigned cost,
 					 Request item) {
+    maybe_update_client_infos();
     queue.enqueue(get_inner_client(cl, item), priority, cost, item);
   }
 
@@ -157,6 +234,7 @@ namespace ceph {
 					       unsigned priority,
 					       unsigned cost,
 					       Request item) {
+    maybe_update_client_infos();
     queue.enqueue_front(get_inner_client(cl, item), priority, cost, item);
   }
 
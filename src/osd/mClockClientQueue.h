@@ -15,7 +15,11 @@
 
 #pragma once
 
+#include <atomic>
+#include <map>
+#include <mutex>
 #include <ostream>
+#include <set>
 
 #include "boost/variant.hpp"
 
@@ -38,10 +42,36 @@ namespace ceph {
   // appropriately.
   class mClockClientQueue : public OpQueue<Request, Client> {
 
+  public:
+
     enum class osd_op_type_t {
       client_op, osd_subop, bg_snaptrim, bg_recovery, bg_scrub };
 
-    using InnerClient = std::pair<uint64_t,osd_op_type_t>;
+    // client ops of a pool with qos_* options set are keyed by the pool
+    // alone (client 0), so that all of the pool's clients share one set
+    // of tags on each OSD; other ops are keyed by client (pool -1)
+    struct InnerClient {
+      uint64_t client;
+      osd_op_type_t op_type;
+      int64_t pool;
+
+      InnerClient() : InnerClient(0, osd_op_type_t::client_op) {}
+      InnerClient(uint64_t c, osd_op_type_t t, int64_t p = -1)
+	: client(c), op_type(t), pool(p) {}
+
+      bool operator<(const InnerClient& o) const {
+	if (client != o.client)
+	  return client < o.client;
+	if (op_type != o.op_type)
+	  return op_type < o.op_type;
+	return pool < o.pool;
+      }
+      bool operator==(const InnerClient& o) const {
+	return client == o.client && op_type == o.op_type && pool == o.pool;
+      }
+    };
+
+  private:
 
     using queue_t = mClockQueue<Request, InnerClient>;
 
@@ -59,6 +89,16 @@ namespace ceph {
 
     static std::unique_ptr<mclock_op_tags_t> mclock_op_tags;
 
+    // per-pool client_op tags, shared by the queues of all shards
+    static std::mutex pool_tags_lock;
+    static std::map<int64_t,crimson::dmclock::ClientInfo> pool_tags;
+    static std::atomic<uint64_t> pool_tags_version;
+
+    // pool_tags_version this queue's client infos were last fetched at
+    uint64_t pool_tags_seen = 0;
+    // pools that had tags as of pool_tags_seen
+    std::set<int64_t> tagged_pools;
+
   public:
 
     mClockClientQueue(CephContext *cct);
@@ -66,6 +106,12 @@ namespace ceph {
     static crimson::dmclock::ClientInfo
     op_class_client_info_f(const InnerClient& client);
 
+    // pick up the qos_res, qos_wgt and qos_lim pool options; unset
+    // ones fall back to the osd_op_queue_mclock_client_op_* values.
+    // They apply to the pool as a whole, separately on every OSD.
+    static void update_pool_tags(
+      const mempool::osdmap::map<int64_t,pg_pool_t>& pools);
+
     inline unsigned length() const override final {
       return queue.length();
     }
@@ -139,7 +185,11 @@ namespace ceph {
 
     static pg_queueable_visitor_t pg_queueable_visitor;
 
+    void maybe_update_client_infos();
+
     osd_op_type_t get_osd_op_type(const Request& request);
+    InnerClient get_inner_client(const Client& cl, osd_op_type_t type,
+				 int64_t pool) const;
     InnerClient get_inner_client(const Client& cl, const Request& request);
   }; // class mClockClientAdapter
 
@@ -996,7 +996,13 @@ static opt_mapping_t opt_mapping = boost::assign::map_list_of
            ("csum_max_block", pool_opts_t::opt_desc_t(
 	     pool_opts_t::CSUM_MAX_BLOCK, pool_opts_t::INT))
            ("csum_min_block", pool_opts_t::opt_desc_t(
-	     pool_opts_t::CSUM_MIN_BLOCK, pool_opts_t::INT));
+	     pool_opts_t::CSUM_MIN_BLOCK, pool_opts_t::INT))
+           ("qos_res", pool_opts_t::opt_desc_t(
+	     pool_opts_t::QOS_RES, pool_opts_t::DOUBLE))
+           ("qos_wgt", pool_opts_t::opt_desc_t(
+	     pool_opts_t::QOS_WGT, pool_opts_t::DOUBLE))
+           ("qos_lim", pool_opts_t::opt_desc_t(
+	     pool_opts_t::QOS_LIM, pool_opts_t::DOUBLE));
 
 bool pool_opts_t::is_opt_name(const std::string& name) {
     return opt_mapping.count(name);
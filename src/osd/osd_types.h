@@ -1056,6 +1056,9 @@ public:
     CSUM_TYPE,
     CSUM_MAX_BLOCK,
     CSUM_MIN_BLOCK,
+    QOS_RES,
+    QOS_WGT,
+    QOS_LIM,
   };
 
   enum type_t {
@@ -0,0 +1,346 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+
+/*
+ * Model of OSD::ShardedOpWQ driven with a skewed per-PG load.
+ *
+ * Items are hashed by pg to a shard; each shard has a FIFO queue and a
+ * pg_slot per pg whose to_process deque orders items while the worker
+ * drops the shard lock to take the pg lock, the same way the OSD does.
+ * With --steal-threshold set, idle threads run items from the most
+ * backlogged shard through that shard's slots, as in the OSD.
+ *
+ * --hot-pgs pgs that all hash to shard 0 receive --hot-ratio of the
+ * load, so without stealing shard 0 saturates while the rest idle.
+ * Reports throughput and end-to-end latency percentiles, and checks
+ * that every pg saw its items in submission order.
+ */
+
+#include <boost/program_options/option.hpp>
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/program_options/cmdline.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+
+#include "common/ceph_time.h"
+#include "common/WorkQueue.h"
+#include "global/global_init.h"
+
+namespace po = boost::program_options;
+using namespace std;
+
+struct Item {
+  unsigned pg;
+  uint64_t seq;
+  ceph::mono_clock::time_point queued;
+};
+
+struct PGState {
+  std::mutex lock;
+  uint64_t next_seq = 0;     ///< next seq to submit
+  uint64_t last_done = 0;    ///< seq + 1 of the last item run
+  uint64_t out_of_order = 0;
+};
+
+struct LatencyHistogram {
+  // bucket i counts items that took [2^i, 2^(i+1)) ns
+  static const int NUM_BUCKETS = 40;
+  uint64_t buckets[NUM_BUCKETS] = {0};
+  uint64_t count = 0;
+
+  void add(uint64_t ns) {
+    int b = ns ? 63 - __builtin_clzll(ns) : 0;
+    if (b >= NUM_BUCKETS)
+      b = NUM_BUCKETS - 1;
+    buckets[b]++;
+    count++;
+  }
+  uint64_t percentile(double p) const {
+    uint64_t want = count * p;
+    uint64_t seen = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+      seen += buckets[i];
+      if (seen > want)
+	return 1ull << (i + 1);
+    }
+    return 1ull << NUM_BUCKETS;
+  }
+};
+
+class ModelShardedWQ : public ShardedThreadPool::ShardedWQ<Item> {
+  struct Shard {
+    std::mutex ordering_lock;
+    std::condition_variable cond;
+    deque<Item> pqueue;
+    map<unsigned, deque<Item>> pg_slots;   ///< to_process per pg
+    std::atomic<unsigned> queue_depth = {0};
+    std::atomic<unsigned> num_waiting = {0};
+    std::atomic<uint64_t> steals = {0};
+  };
+
+  vector<Shard> shards;
+  vector<PGState> &pgs;
+  unsigned steal_threshold;
+  ceph::timespan op_time;
+
+  std::mutex hist_lock;
+  LatencyHistogram hist;
+  std::atomic<uint64_t> completed = {0};
+
+  std::function<void()> on_complete;
+
+  Shard *_steal(uint32_t home, std::unique_lock<std::mutex> *l) {
+    uint32_t best = home;
+    unsigned best_depth = steal_threshold - 1;
+    for (uint32_t i = 1; i < shards.size(); i++) {
+      uint32_t s = (home + i) % shards.size();
+      unsigned depth = shards[s].queue_depth;
+      if (depth > best_depth && shards[s].num_waiting == 0) {
+	best = s;
+	best_depth = depth;
+      }
+    }
+    if (best == home)
+      return nullptr;
+    Shard *victim = &shards[best];
+    *l = std::unique_lock<std::mutex>(victim->ordering_lock);
+    if (victim->queue_depth < steal_threshold) {
+      l->unlock();
+      return nullptr;
+    }
+    shards[home].steals++;
+    return victim;
+  }
+
+  void _enqueue(Item item) override {
+    Shard& s = shards[item.pg % shards.size()];
+    {
+      std::lock_guard<std::mutex> l(s.ordering_lock);
+      s.pqueue.push_back(item);
+      s.queue_depth++;
+    }
+    s.cond.notify_one();
+    if (steal_threshold && s.queue_depth >= steal_threshold &&
+	s.num_waiting == 0) {
+      for (uint32_t i = 1; i < shards.size(); i++) {
+	Shard& idle = shards[(item.pg + i) % shards.size()];
+	if (idle.num_waiting) {
+	  std::lock_guard<std::mutex> l(idle.ordering_lock);
+	  idle.cond.notify_one();
+	  break;
+	}
+      }
+    }
+  }
+  void _enqueue_front(Item item) override {
+    ceph_abort();
+  }
+
+public:
+  ModelShardedWQ(ShardedThreadPool *tp, unsigned num_shards,
+		 vector<PGState> &pgs, unsigned steal_threshold,
+		 ceph::timespan op_time, std::function<void()> on_complete)
+    : ShardedThreadPool::ShardedWQ<Item>(100, 100, tp),
+      shards(num_shards), pgs(pgs), steal_threshold(steal_threshold),
+      op_time(op_time), on_complete(on_complete) {}
+
+  void _process(uint32_t thread_index, heartbeat_handle_d *hb) override {
+    uint32_t shard_index = thread_index % shards.size();
+    Shard *s = &shards[shard_index];
+    std::unique_lock<std::mutex> l(s->ordering_lock);
+    if (s->pqueue.empty() && steal_threshold) {
+      l.unlock();
+      Shard *victim = _steal(shard_index, &l);
+      if (victim)
+	s = victim;
+      else
+	l = std::unique_lock<std::mutex>(s->ordering_lock);
+    }
+    if (s->pqueue.empty()) {
+      s->num_waiting++;
+      s->cond.wait_for(l, std::chrono::milliseconds(100));
+      s->num_waiting--;
+      if (s->pqueue.empty())
+	return;
+    }
+    Item item = s->pqueue.front();
+    s->pqueue.pop_front();
+    s->queue_depth--;
+    s->pg_slots[item.pg].push_back(item);
+    l.unlock();
+
+    // pg lock, then take the oldest item for the pg
+    PGState& pg = pgs[item.pg];
+    std::lock_guard<std::mutex> pl(pg.lock);
+    l.lock();
+    auto& to_process = s->pg_slots[item.pg];
+    Item mine = to_process.front();
+    to_process.pop_front();
+    l.unlock();
+
+    if (mine.seq != pg.last_done)
+      pg.out_of_order++;
+    pg.last_done = mine.seq + 1;
+    auto until = ceph::mono_clock::now() + op_time;
+    while (ceph::mono_clock::now() < until)
+      ;
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      ceph::mono_clock::now() - mine.queued).count();
+    {
+      std::lock_guard<std::mutex> hl(hist_lock);
+      hist.add(ns);
+    }
+    completed++;
+    on_complete();
+  }
+
+  void return_waiting_threads() override {
+    for (auto& s : shards) {
+      std::lock_guard<std::mutex> l(s.ordering_lock);
+      s.cond.notify_all();
+    }
+  }
+
+  bool is_shard_empty(uint32_t thread_index) override {
+    Shard& s = shards[thread_index % shards.size()];
+    std::lock_guard<std::mutex> l(s.ordering_lock);
+    return s.pqueue.empty();
+  }
+
+  uint64_t get_completed() const { return completed; }
+  const LatencyHistogram& get_hist() const { return hist; }
+  uint64_t get_steals() const {
+    uint64_t n = 0;
+    for (auto& s : shards)
+      n += s.steals;
+    return n;
+  }
+};
+
+int main(int argc, char **argv)
+{
+  po::options_description desc("Allowed options");
+  desc.add_options()
+    ("help", "produce help message")
+    ("num-shards", po::value<unsigned>()->default_value(8),
+     "op queue shards")
+    ("threads-per-shard", po::value<unsigned>()->default_value(2),
+     "threads per shard")
+    ("num-pgs", po::value<unsigned>()->default_value(256),
+     "pgs")
+    ("hot-pgs", po::value<unsigned>()->default_value(8),
+     "pgs, all on shard 0, that get --hot-ratio of the items")
+    ("hot-ratio", po::value<double>()->default_value(0.6),
+     "fraction of items going to the hot pgs")
+    ("op-us", po::value<unsigned>()->default_value(20),
+     "cpu time per item (usec)")
+    ("queue-size", po::value<unsigned>()->default_value(64),
+     "items in flight")
+    ("num-items", po::value<unsigned>()->default_value(200000),
+     "num items")
+    ("steal-threshold", po::value<unsigned>()->default_value(4),
+     "steal from shards with this many items queued (0 = no stealing)")
+    ;
+
+  vector<string> ceph_option_strings;
+  po::variables_map vm;
+  try {
+    po::parsed_options parsed =
+      po::command_line_parser(argc, argv).options(desc).allow_unregistered().run();
+    po::store(parsed, vm);
+    po::notify(vm);
+    ceph_option_strings = po::collect_unrecognized(parsed.options,
+						   po::include_positional);
+  } catch(po::error &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  vector<const char *> ceph_options, def_args;
+  ceph_options.reserve(ceph_option_strings.size());
+  for (auto& i : ceph_option_strings)
+    ceph_options.push_back(i.c_str());
+
+  auto cct = global_init(
+    &def_args, ceph_options, CEPH_ENTITY_TYPE_CLIENT,
+    CODE_ENVIRONMENT_UTILITY,
+    CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+
+  if (vm.count("help")) {
+    cout << desc << std::endl;
+    return 1;
+  }
+
+  unsigned num_shards = vm["num-shards"].as<unsigned>();
+  unsigned num_pgs = vm["num-pgs"].as<unsigned>();
+  unsigned hot_pgs = vm["hot-pgs"].as<unsigned>();
+  double hot_ratio = vm["hot-ratio"].as<double>();
+  unsigned queue_size = vm["queue-size"].as<unsigned>();
+  unsigned num_items = vm["num-items"].as<unsigned>();
+  if (num_shards == 0 || hot_pgs == 0 || hot_pgs * num_shards > num_pgs ||
+      queue_size == 0) {
+    cout << desc << std::endl;
+    return 1;
+  }
+
+  vector<PGState> pgs(num_pgs);
+  std::mutex lock;
+  std::condition_variable cond;
+  unsigned in_flight = 0;
+  auto on_complete = [&] {
+    std::lock_guard<std::mutex> l(lock);
+    --in_flight;
+    cond.notify_one();
+  };
+
+  ShardedThreadPool tp(g_ceph_context, "sharded_tp_bench", "tp_bench",
+		       num_shards * vm["threads-per-shard"].as<unsigned>());
+  ModelShardedWQ wq(&tp, num_shards, pgs,
+		    num_shards > 1 ? vm["steal-threshold"].as<unsigned>() : 0,
+		    std::chrono::microseconds(vm["op-us"].as<unsigned>()),
+		    on_complete);
+  tp.start();
+
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> coin(0, 1);
+  std::uniform_int_distribution<unsigned> pick_hot(0, hot_pgs - 1);
+  std::uniform_int_distribution<unsigned> pick_any(0, num_pgs - 1);
+  auto start = ceph::mono_clock::now();
+  for (unsigned i = 0; i < num_items; ++i) {
+    {
+      std::unique_lock<std::mutex> l(lock);
+      cond.wait(l, [&] { return in_flight < queue_size; });
+      ++in_flight;
+    }
+    unsigned pg = coin(rng) < hot_ratio ?
+      pick_hot(rng) * num_shards : pick_any(rng);
+    wq.queue(Item{pg, pgs[pg].next_seq++, ceph::mono_clock::now()});
+  }
+  {
+    std::unique_lock<std::mutex> l(lock);
+    cond.wait(l, [&] { return in_flight == 0; });
+  }
+  auto end = ceph::mono_clock::now();
+  tp.stop();
+
+  uint64_t out_of_order = 0;
+  for (auto& pg : pgs)
+    out_of_order += pg.out_of_order;
+  const LatencyHistogram& h = wq.get_hist();
+  double secs = std::chrono::duration<double>(end - start).count();
+  cout << "items " << wq.get_completed()
+       << " " << (wq.get_completed() / secs / 1000.0) << " Kops/s"
+       << " steals " << wq.get_steals()
+       << " p50 <" << h.percentile(0.5) / 1000 << " us"
+       << " p99 <" << h.percentile(0.99) / 1000 << " us"
+       << " p99.9 <" << h.percentile(0.999) / 1000 << " us"
+       << " out_of_order " << out_of_order
+       << std::endl;
+  return out_of_order ? 1 : 0;
+}
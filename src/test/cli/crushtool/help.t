@@ -98,6 +98,7 @@
      --show-mappings       show mappings
      --show-bad-mappings   show bad mappings
      --show-choose-tries   show choose tries histogram
+     --show-throughput     show mappings per second for each rule
      --output-name name
                            prepend the data file(s) generated during the
                            testing routine with name
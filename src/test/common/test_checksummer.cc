@@ -0,0 +1,115 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <iostream>
+
+#include "include/buffer.h"
+#include "include/types.h"
+#include "common/ceph_time.h"
+#include "common/Checksummer.h"
+
+#include "gtest/gtest.h"
+
+template<class Alg>
+class ChecksummerTest : public ::testing::Test {
+public:
+  typedef typename Alg::value_t value_t;
+
+  // checksums computed one block at a time through Alg::calc()
+  static bufferptr reference(size_t block_size, const bufferlist& bl) {
+    size_t blocks = bl.length() / block_size;
+    bufferptr csum(blocks * sizeof(value_t));
+    value_t *pv = reinterpret_cast<value_t*>(csum.c_str());
+    typename Alg::state_t state;
+    Alg::init(&state);
+    bufferlist::const_iterator p = bl.begin();
+    for (size_t i = 0; i < blocks; ++i) {
+      pv[i] = Alg::calc(state, -1, block_size, p);
+    }
+    Alg::fini(&state);
+    return csum;
+  }
+};
+
+typedef ::testing::Types<
+  Checksummer::crc32c,
+  Checksummer::crc32c_16,
+  Checksummer::crc32c_8,
+  Checksummer::xxhash32,
+  Checksummer::xxhash64
+  > ChecksummerAlgs;
+TYPED_TEST_CASE(ChecksummerTest, ChecksummerAlgs);
+
+static bufferlist make_data(const std::vector<size_t>& segments)
+{
+  bufferlist bl;
+  unsigned v = 0;
+  for (auto len : segments) {
+    bufferptr bp(len);
+    for (size_t i = 0; i < len; ++i)
+      bp.c_str()[i] = (v++ * 131) >> 3;
+    bl.append(bp);
+  }
+  return bl;
+}
+
+TYPED_TEST(ChecksummerTest, calculate_matches_per_block)
+{
+  typedef typename TestFixture::value_t value_t;
+  const size_t block_size = 4096;
+  // contiguous, split on block boundaries, and split mid-block
+  std::vector<std::vector<size_t>> layouts = {
+    {block_size * 37},
+    {block_size * 3, block_size * 20, block_size},
+    {100, block_size * 5 - 100, block_size * 2 + 7, block_size * 9 - 7},
+  };
+  for (auto& layout : layouts) {
+    bufferlist bl = make_data(layout);
+    size_t blocks = bl.length() / block_size;
+    bufferptr expected = TestFixture::reference(block_size, bl);
+    bufferptr csum(blocks * sizeof(value_t));
+    ASSERT_EQ(0, Checksummer::calculate<TypeParam>(
+		block_size, 0, bl.length(), bl, &csum));
+    ASSERT_EQ(0, memcmp(expected.c_str(), csum.c_str(), csum.length()));
+    ASSERT_EQ(-1, Checksummer::verify<TypeParam>(
+		block_size, 0, bl.length(), bl, csum));
+
+    // corrupt one block; verify must report that block and no later one
+    for (size_t bad : {(size_t)0, blocks / 2, blocks - 1}) {
+      bufferlist corrupt;
+      corrupt.append(bl.c_str(), bl.length());
+      corrupt.c_str()[bad * block_size + 5] ^= 1;
+      uint64_t bad_csum = 0;
+      ASSERT_EQ((int)(bad * block_size),
+		Checksummer::verify<TypeParam>(
+		  block_size, 0, corrupt.length(), corrupt, csum, &bad_csum));
+      bufferptr got = TestFixture::reference(block_size, corrupt);
+      ASSERT_EQ((uint64_t)reinterpret_cast<value_t*>(got.c_str())[bad],
+		bad_csum);
+    }
+  }
+}
+
+TYPED_TEST(ChecksummerTest, calculate_performance)
+{
+  typedef typename TestFixture::value_t value_t;
+  const size_t block_size = 4096;
+  const int count = 64;
+  bufferlist bl = make_data({16 << 20});
+  size_t blocks = bl.length() / block_size;
+  bufferptr csum(blocks * sizeof(value_t));
+
+  auto start = ceph::mono_clock::now();
+  for (int i = 0; i < count; ++i)
+    TestFixture::reference(block_size, bl);
+  auto mid = ceph::mono_clock::now();
+  for (int i = 0; i < count; ++i)
+    Checksummer::calculate<TypeParam>(block_size, 0, bl.length(), bl, &csum);
+  auto end = ceph::mono_clock::now();
+
+  double bytes = (double)count * bl.length() / 1000000.0;
+  std::cout << "per block " << bytes / std::chrono::duration<double>(mid - start).count()
+	    << " MB/sec, batched "
+	    << bytes / std::chrono::duration<double>(end - mid).count()
+	    << " MB/sec" << std::endl;
+}
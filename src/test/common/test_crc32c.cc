@@ -41,6 +41,56 @@ TEST(Crc32c, Big) {
   ASSERT_EQ(1400919119u, ceph_crc32c(1234, (unsigned char *)a, len));
 }
 
+TEST(Crc32c, Multi) {
+  unsigned len = 4096 * 8 + 7;
+  unsigned char *a = (unsigned char *)malloc(len);
+  for (unsigned i = 0; i < len; i++)
+    a[i] = (i * 131) & 0xff;
+  // odd chunk sizes, chunk counts that don't divide by the interleave
+  // factor and a misaligned start
+  for (unsigned chunk_len : {1u, 7u, 8u, 9u, 64u, 511u, 4096u}) {
+    for (unsigned chunks = 1; chunks <= 8 && chunks * chunk_len < len; ++chunks) {
+      uint32_t out[8];
+      ceph_crc32c_multi(1234, a + 1, chunk_len, chunks, out);
+      for (unsigned i = 0; i < chunks; ++i) {
+	ASSERT_EQ(ceph_crc32c(1234, a + 1 + i * chunk_len, chunk_len), out[i])
+	  << "chunk_len " << chunk_len << " chunks " << chunks << " i " << i;
+      }
+    }
+  }
+  free(a);
+}
+
+TEST(Crc32c, multi_performance) {
+  unsigned chunk_len = 4096;
+  unsigned chunks = 1024;
+  unsigned len = chunk_len * chunks;
+  int count = 256;
+  unsigned char *a = (unsigned char *)malloc(len);
+  for (unsigned i = 0; i < len; i++)
+    a[i] = i & 0xff;
+  uint32_t *out = new uint32_t[chunks];
+  {
+    utime_t start = ceph_clock_now();
+    for (int n = 0; n < count; n++)
+      for (unsigned i = 0; i < chunks; i++)
+	out[i] = ceph_crc32c(-1, a + i * chunk_len, chunk_len);
+    utime_t end = ceph_clock_now();
+    float rate = (float)len * count / (float)(1024*1024) / (float)(end - start);
+    std::cout << "one 4k chunk at a time = " << rate << " MB/sec" << std::endl;
+  }
+  {
+    utime_t start = ceph_clock_now();
+    for (int n = 0; n < count; n++)
+      ceph_crc32c_multi(-1, a, chunk_len, chunks, out);
+    utime_t end = ceph_clock_now();
+    float rate = (float)len * count / (float)(1024*1024) / (float)(end - start);
+    std::cout << "multi = " << rate << " MB/sec" << std::endl;
+  }
+  delete[] out;
+  free(a);
+}
+
 TEST(Crc32c, Performance) {
   int len = 1000 * 1024 * 1024;
   char *a = (char *)malloc(len);
@@ -391,6 +391,67 @@ TEST(SharedCache_all, lru) {
   ASSERT_TRUE(cache.lookup(0).get());
 }
 
+TEST(SharedWindow, lookup) {
+  SharedWindow<int> window(4);
+  ASSERT_FALSE(window.lookup(1));
+  for (int i = 1; i <= 6; ++i)
+    window.add(i, std::make_shared<int>(i * 10));
+  // 1 and 2 were pushed out by 5 and 6
+  ASSERT_FALSE(window.lookup(1));
+  ASSERT_FALSE(window.lookup(2));
+  for (int i = 3; i <= 6; ++i)
+    ASSERT_EQ(i * 10, *window.lookup(i));
+  // an older key never replaces a newer one
+  window.add(2, std::make_shared<int>(20));
+  ASSERT_FALSE(window.lookup(2));
+  ASSERT_EQ(60, *window.lookup(6));
+
+  ceph::shared_ptr<int> pinned = window.lookup(6);
+  window.clear();
+  ASSERT_FALSE(window.lookup(6));
+  ASSERT_EQ(60, *pinned);
+}
+
+TEST(SharedWindow, set_size) {
+  SharedWindow<int> window(4);
+  window.add(1, std::make_shared<int>(10));
+  ASSERT_EQ(10, *window.lookup(1));
+  // resizing starts over with an empty window
+  window.set_size(8);
+  ASSERT_EQ(8u, window.get_size());
+  ASSERT_FALSE(window.lookup(1));
+  for (int i = 1; i <= 8; ++i)
+    window.add(i, std::make_shared<int>(i * 10));
+  for (int i = 1; i <= 8; ++i)
+    ASSERT_EQ(i * 10, *window.lookup(i));
+  // a zero sized window holds nothing
+  window.set_size(0);
+  window.add(9, std::make_shared<int>(90));
+  ASSERT_FALSE(window.lookup(9));
+}
+
+TEST(SharedWindow, concurrent) {
+  SharedWindow<int> window(4);
+  std::atomic<bool> done(false);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 4; ++t) {
+    readers.emplace_back([&] {
+	while (!done) {
+	  for (int i = 0; i < 4000; ++i) {
+	    ceph::shared_ptr<int> v = window.lookup(i);
+	    if (v)
+	      ASSERT_EQ(i, *v);
+	  }
+	}
+      });
+  }
+  for (int i = 0; i < 4000; ++i)
+    window.add(i, std::make_shared<int>(i));
+  done = true;
+  for (auto &t : readers)
+    t.join();
+}
+
 // Local Variables:
 // compile-command: "cd ../.. ; make unittest_shared_cache && ./unittest_shared_cache # --gtest_filter=*.* --log-to-stderr=true"
 // End:
@@ -14,6 +14,7 @@
 
 #include "include/stringify.h"
 
+#include "arch/intel.h"
 #include "crush/CrushWrapper.h"
 #include "osd/osd_types.h"
 
@@ -509,6 +510,70 @@ TEST(CRUSH, straw2_stddev)
   }
 }
 
+TEST(CRUSH, straw2_simd) {
+  // the vectorized straw2 hash must pick exactly what the scalar one does
+#if defined(__x86_64__)
+  if (!ceph_arch_intel_avx2) {
+    cout << "no avx2, skipping" << std::endl;
+    return;
+  }
+
+  std::unique_ptr<CrushWrapper> c(new CrushWrapper);
+  c->create();
+  c->set_type_name(2, "root");
+  c->set_type_name(1, "host");
+  c->set_type_name(0, "osd");
+
+  // hosts of 1..20 osds cover full and partial groups of 8 items; a few
+  // zero weights make sure skipped items are still skipped
+  const int num_host = 20;
+  int hosts[num_host], host_weights[num_host];
+  int osd = 0;
+  for (int h = 0; h < num_host; ++h) {
+    int n = h + 1;
+    int items[n], weights[n];
+    for (int i = 0; i < n; ++i, ++osd) {
+      items[i] = osd;
+      weights[i] = (osd % 7 == 3) ? 0 : 0x10000 * (1 + osd % 3);
+    }
+    crush_bucket *b = crush_make_bucket(c->get_crush_map(),
+					CRUSH_BUCKET_STRAW2,
+					CRUSH_HASH_RJENKINS1, 1, n, items,
+					weights);
+    ASSERT_EQ(0, crush_add_bucket(c->get_crush_map(), 0, b, &hosts[h]));
+    ASSERT_EQ(0, c->set_item_name(hosts[h], "host" + stringify(h)));
+    host_weights[h] = b->weight;
+  }
+  int root;
+  crush_bucket *b = crush_make_bucket(c->get_crush_map(),
+				      CRUSH_BUCKET_STRAW2,
+				      CRUSH_HASH_RJENKINS1, 2, num_host,
+				      hosts, host_weights);
+  ASSERT_EQ(0, crush_add_bucket(c->get_crush_map(), 0, b, &root));
+  ASSERT_EQ(0, c->set_item_name(root, "default"));
+  c->set_max_devices(osd);
+  int rule = c->add_simple_rule("rule", "default", "host", "",
+				"firstn", pg_pool_t::TYPE_REPLICATED);
+  ASSERT_EQ(0, rule);
+  c->finalize();
+
+  vector<__u32> reweight(osd, 0x10000);
+  for (int i = 0; i < osd; i += 5)
+    reweight[i] = 0x8000;
+
+  int saved = ceph_arch_intel_avx2;
+  for (int x = 0; x < 100000; ++x) {
+    vector<int> simd, scalar;
+    ceph_arch_intel_avx2 = saved;
+    c->do_rule(rule, x, simd, 3, reweight, 0);
+    ceph_arch_intel_avx2 = 0;
+    c->do_rule(rule, x, scalar, 3, reweight, 0);
+    ceph_arch_intel_avx2 = saved;
+    ASSERT_EQ(scalar, simd) << "x " << x;
+  }
+#endif
+}
+
 TEST(CRUSH, straw2_reweight) {
   // when we adjust the weight of an item in a straw2 bucket,
   // we should *only* see movement from or to that item, never
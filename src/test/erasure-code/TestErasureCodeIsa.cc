@@ -366,6 +366,69 @@ TEST_F(IsaErasureCodeTest, encode)
   }
 }
 
+TEST_F(IsaErasureCodeTest, encode_delta)
+{
+  const char *configs[][3] = {
+    { "reed_sol_van", "4", "2" },
+    { "cauchy", "4", "2" },
+    { "reed_sol_van", "4", "1" },  // region_xor
+  };
+  for (auto &&config : configs) {
+    int matrix = strcmp(config[0], "cauchy") ?
+      ErasureCodeIsaDefault::kVandermonde : ErasureCodeIsaDefault::kCauchy;
+    ErasureCodeIsaDefault Isa(tcache, matrix);
+    ErasureCodeProfile profile;
+    profile["technique"] = config[0];
+    profile["k"] = config[1];
+    profile["m"] = config[2];
+    Isa.init(profile, &cerr);
+    EXPECT_TRUE(Isa.supports_parity_delta());
+
+    unsigned k = Isa.get_data_chunk_count();
+    unsigned n = Isa.get_chunk_count();
+    unsigned stripe_width = Isa.get_alignment() * k;
+    set<int> want_to_encode;
+    for (unsigned i = 0; i < n; i++)
+      want_to_encode.insert(i);
+
+    string before(stripe_width, 0), after(stripe_width, 0);
+    for (unsigned i = 0; i < stripe_width; i++) {
+      before[i] = i * 7;
+      after[i] = i % 5 ? before[i] : i * 13;
+    }
+    bufferlist in_before, in_after;
+    in_before.append(before);
+    in_after.append(after);
+    map<int, bufferlist> encoded_before, encoded_after;
+    EXPECT_EQ(0, Isa.encode(want_to_encode, in_before, &encoded_before));
+    EXPECT_EQ(0, Isa.encode(want_to_encode, in_after, &encoded_after));
+    unsigned length = encoded_before[0].length();
+
+    map<int, string> parity;
+    for (unsigned i = k; i < n; i++)
+      parity[i] = string(encoded_before[i].c_str(), length);
+    for (unsigned j = 0; j < k; j++) {
+      string diff(length, 0);
+      for (unsigned b = 0; b < length; b++)
+        diff[b] = encoded_before[j][b] ^ encoded_after[j][b];
+      bufferlist delta;
+      delta.append(diff);
+      map<int, bufferlist> parity_delta;
+      EXPECT_EQ(0, Isa.encode_delta(j, delta, &parity_delta));
+      EXPECT_EQ(n - k, parity_delta.size());
+      for (auto &&p : parity_delta) {
+        EXPECT_EQ(length, p.second.length());
+        for (unsigned b = 0; b < length; b++)
+          parity[p.first][b] ^= p.second[b];
+      }
+    }
+    for (unsigned i = k; i < n; i++) {
+      EXPECT_EQ(0, memcmp(parity[i].c_str(), encoded_after[i].c_str(),
+                          length));
+    }
+  }
+}
+
 TEST_F(IsaErasureCodeTest, sanity_check_k)
 {
   ErasureCodeIsaDefault Isa(tcache);
@@ -129,6 +129,61 @@ TYPED_TEST(ErasureCodeTest, encode_decode)
   }
 }
 
+TYPED_TEST(ErasureCodeTest, encode_delta)
+{
+  TypeParam jerasure;
+  ErasureCodeProfile profile;
+  profile["k"] = "2";
+  profile["m"] = "2";
+  profile["packetsize"] = "8";
+  jerasure.init(profile, &cerr);
+  EXPECT_TRUE(jerasure.supports_parity_delta());
+
+  unsigned k = jerasure.get_data_chunk_count();
+  unsigned n = jerasure.get_chunk_count();
+  unsigned stripe_width = jerasure.get_chunk_size(1) * k;
+  set<int> want_to_encode;
+  for (unsigned i = 0; i < n; i++)
+    want_to_encode.insert(i);
+
+  // both data chunks change
+  string before(stripe_width, 0), after(stripe_width, 0);
+  for (unsigned i = 0; i < stripe_width; i++) {
+    before[i] = i * 7;
+    after[i] = i % 5 ? before[i] : i * 13;
+  }
+  bufferlist in_before, in_after;
+  in_before.append(before);
+  in_after.append(after);
+  map<int, bufferlist> encoded_before, encoded_after;
+  EXPECT_EQ(0, jerasure.encode(want_to_encode, in_before, &encoded_before));
+  EXPECT_EQ(0, jerasure.encode(want_to_encode, in_after, &encoded_after));
+  unsigned length = encoded_before[0].length();
+
+  // old parity patched with the delta of each data chunk
+  map<int, string> parity;
+  for (unsigned i = k; i < n; i++)
+    parity[i] = string(encoded_before[i].c_str(), length);
+  for (unsigned j = 0; j < k; j++) {
+    string diff(length, 0);
+    for (unsigned b = 0; b < length; b++)
+      diff[b] = encoded_before[j][b] ^ encoded_after[j][b];
+    bufferlist delta;
+    delta.append(diff);
+    map<int, bufferlist> parity_delta;
+    EXPECT_EQ(0, jerasure.encode_delta(j, delta, &parity_delta));
+    EXPECT_EQ(n - k, parity_delta.size());
+    for (auto &&p : parity_delta) {
+      EXPECT_EQ(length, p.second.length());
+      for (unsigned b = 0; b < length; b++)
+	parity[p.first][b] ^= p.second[b];
+    }
+  }
+  for (unsigned i = k; i < n; i++) {
+    EXPECT_EQ(0, memcmp(parity[i].c_str(), encoded_after[i].c_str(), length));
+  }
+}
+
 TYPED_TEST(ErasureCodeTest, minimum_to_decode)
 {
   TypeParam jerasure;
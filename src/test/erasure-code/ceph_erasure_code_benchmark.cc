@@ -49,7 +49,9 @@ int ErasureCodeBench::setup(int argc, char** argv) {
     ("plugin,p", po::value<string>()->default_value("jerasure"),
      "erasure code plugin name")
     ("workload,w", po::value<string>()->default_value("encode"),
-     "run either encode or decode")
+     "run either encode, decode or delta (update the coding chunks after "
+     "overwriting one --size chunk, with parity deltas and by re-encoding "
+     "the stripe)")
     ("erasures,e", po::value<int>()->default_value(1),
      "number of erasures when decoding")
     ("erased", po::value<vector<int> >(),
@@ -143,6 +145,8 @@ int ErasureCodeBench::run() {
 
   if (workload == "encode")
     return encode();
+  else if (workload == "delta")
+    return encode_delta();
   else
     return decode();
 }
@@ -188,6 +192,81 @@ int ErasureCodeBench::encode()
   return 0;
 }
 
+static void xor_into(char *dst, const char *src, unsigned len)
+{
+  for (unsigned i = 0; i < len; i++)
+    dst[i] ^= src[i];
+}
+
+int ErasureCodeBench::encode_delta()
+{
+  ErasureCodePluginRegistry &instance = ErasureCodePluginRegistry::instance();
+  ErasureCodeInterfaceRef erasure_code;
+  stringstream messages;
+  int code = instance.factory(plugin,
+			      g_conf->get_val<std::string>("erasure_code_dir"),
+			      profile, &erasure_code, &messages);
+  if (code) {
+    cerr << messages.str() << endl;
+    return code;
+  }
+  if (!erasure_code->supports_parity_delta()) {
+    cerr << "plugin " << plugin << " does not support parity deltas" << endl;
+    return -EOPNOTSUPP;
+  }
+
+  // a stripe made of --size chunks, one of which is overwritten
+  unsigned chunk_size = erasure_code->get_chunk_size(in_size * k);
+  bufferlist stripe;
+  stripe.append(string(chunk_size * k, 'X'));
+  stripe.rebuild_aligned(ErasureCode::SIMD_ALIGN);
+  bufferlist old_chunk, new_chunk;
+  old_chunk.append(string(chunk_size, 'X'));
+  old_chunk.rebuild_aligned(ErasureCode::SIMD_ALIGN);
+  new_chunk.append(string(chunk_size, 'Y'));
+  new_chunk.rebuild_aligned(ErasureCode::SIMD_ALIGN);
+  set<int> want_to_encode;
+  for (int i = 0; i < k + m; i++) {
+    want_to_encode.insert(i);
+  }
+  map<int,bufferlist> parity;
+  code = erasure_code->encode(want_to_encode, stripe, &parity);
+  if (code)
+    return code;
+
+  // old ^ new, its parity delta, and patching the m coding chunks
+  utime_t begin_time = ceph_clock_now();
+  for (int i = 0; i < max_iterations; i++) {
+    bufferptr diff(buffer::create_aligned(chunk_size, ErasureCode::SIMD_ALIGN));
+    memcpy(diff.c_str(), old_chunk.c_str(), chunk_size);
+    xor_into(diff.c_str(), new_chunk.c_str(), chunk_size);
+    bufferlist delta;
+    delta.push_back(std::move(diff));
+    map<int,bufferlist> parity_delta;
+    code = erasure_code->encode_delta(i % k, delta, &parity_delta);
+    if (code)
+      return code;
+    for (auto &&p : parity_delta)
+      xor_into(parity[p.first].c_str(), p.second.c_str(), chunk_size);
+  }
+  utime_t end_time = ceph_clock_now();
+  cout << "delta\t" << (end_time - begin_time) << "\t"
+       << (max_iterations * (chunk_size / 1024)) << endl;
+
+  // what a read-modify-write does instead: encode the whole stripe
+  begin_time = ceph_clock_now();
+  for (int i = 0; i < max_iterations; i++) {
+    map<int,bufferlist> encoded;
+    code = erasure_code->encode(want_to_encode, stripe, &encoded);
+    if (code)
+      return code;
+  }
+  end_time = ceph_clock_now();
+  cout << "stripe\t" << (end_time - begin_time) << "\t"
+       << (max_iterations * (chunk_size / 1024)) << endl;
+  return 0;
+}
+
 static void display_chunks(const map<int,bufferlist> &chunks,
 			   unsigned int chunk_count) {
   cout << "chunks ";
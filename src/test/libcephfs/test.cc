@@ -30,6 +30,7 @@
 #include <limits.h>
 #endif
 
+#include <algorithm>
 #include <map>
 #include <vector>
 #include <thread>
@@ -444,8 +445,126 @@ TEST(LibCephFS, DirLs) {
   }
   ASSERT_EQ(found, entries);
 
+  // test readdirplus_bulk
+  ceph_rewinddir(cmount, ls_dir);
+
+  std::vector<std::pair<std::string, struct ceph_statx> > bulk;
+  ASSERT_EQ(0, ceph_readdirplus_bulk(cmount, ls_dir,
+    [](void *arg, struct dirent *de, struct ceph_statx *stx) {
+      static_cast<std::vector<std::pair<std::string, struct ceph_statx> >*>(arg)
+	->push_back(std::make_pair(std::string(de->d_name), *stx));
+      return 0;
+    }, &bulk, CEPH_STATX_SIZE, AT_NO_ATTR_SYNC));
+  ASSERT_EQ(ceph_readdir(cmount, ls_dir), (struct dirent *)NULL);
+  found.clear();
+  for (auto& p : bulk) {
+    found.push_back(p.first);
+    int size;
+    sscanf(p.first.c_str(), "dirf%d", &size);
+    ASSERT_TRUE(p.second.stx_mask & CEPH_STATX_SIZE);
+    ASSERT_EQ(p.second.stx_size, (size_t)size);
+  }
+  std::sort(found.begin(), found.end());
+  std::vector<std::string> sorted_entries(entries);
+  std::sort(sorted_entries.begin(), sorted_entries.end());
+  ASSERT_EQ(found, sorted_entries);
+
+  ASSERT_EQ(ceph_closedir(cmount, ls_dir), 0);
+
+  ceph_shutdown(cmount);
+}
+
+static int mds_injectargs(struct ceph_mount_info *cmount, const char *args)
+{
+  std::string cmd = std::string("{\"prefix\": \"injectargs\", "
+				"\"injected_args\": [\"") + args + "\"]}";
+  const char *cmdv[] = {cmd.c_str()};
+  char *outbuf = NULL, *outs = NULL;
+  size_t outbuflen = 0, outslen = 0;
+  int r = ceph_mds_command(cmount, "*", cmdv, 1, "", 0,
+			   &outbuf, &outbuflen, &outs, &outslen);
+  if (outbuf)
+    ceph_buffer_free(outbuf);
+  if (outs)
+    ceph_buffer_free(outs);
+  return r;
+}
+
+static int bulk_ls(struct ceph_mount_info *cmount, struct ceph_dir_result *dirp,
+		   std::vector<std::pair<std::string, uint64_t> > *out)
+{
+  return ceph_readdirplus_bulk(cmount, dirp,
+    [](void *arg, struct dirent *de, struct ceph_statx *stx) {
+      if (strcmp(de->d_name, ".") && strcmp(de->d_name, ".."))
+	static_cast<std::vector<std::pair<std::string, uint64_t> >*>(arg)
+	  ->push_back(std::make_pair(std::string(de->d_name), stx->stx_size));
+      return 0;
+    }, out, CEPH_STATX_SIZE, AT_NO_ATTR_SYNC);
+}
+
+TEST(LibCephFS, DirLsBulkFragmented) {
+  pid_t mypid = getpid();
+
+  struct ceph_mount_info *cmount;
+  ASSERT_EQ(ceph_create(&cmount, NULL), 0);
+  ASSERT_EQ(ceph_conf_read_file(cmount, NULL), 0);
+  ASSERT_EQ(0, ceph_conf_parse_env(cmount, NULL));
+  ASSERT_EQ(ceph_mount(cmount, "/"), 0);
+
+  // make the MDS split the directory while we fill it
+  ASSERT_EQ(0, mds_injectargs(cmount, "--mds_bal_split_size 100 "
+			      "--mds_bal_merge_size 1 "
+			      "--mds_bal_split_bits 2 "
+			      "--mds_bal_fragment_interval 1"));
+
+  char dir[256];
+  sprintf(dir, "dir_ls_frag%d", mypid);
+  ASSERT_EQ(ceph_mkdir(cmount, dir, 0777), 0);
+
+  // an open handle that has seen the unfragmented directory, so its
+  // frag tree is stale by the time it reads in bulk
+  struct ceph_dir_result *stale_dir = NULL;
+  ASSERT_EQ(ceph_opendir(cmount, dir, &stale_dir), 0);
+  ASSERT_NE(ceph_readdir(cmount, stale_dir), (struct dirent *)NULL);
+
+  const int nfiles = 1000;
+  std::vector<std::pair<std::string, uint64_t> > expected;
+  char name[256], path[512];
+  for (int i = 0; i < nfiles; ++i) {
+    sprintf(name, "f%d", i);
+    sprintf(path, "%s/%s", dir, name);
+    int fd = ceph_open(cmount, path, O_CREAT|O_RDWR, 0666);
+    ASSERT_GT(fd, 0);
+    ASSERT_EQ(i % 7, ceph_write(cmount, fd, "0123456", i % 7, 0));
+    ASSERT_EQ(ceph_close(cmount, fd), 0);
+    expected.push_back(std::make_pair(std::string(name), (uint64_t)(i % 7)));
+  }
+  std::sort(expected.begin(), expected.end());
+
+  // give the balancer time to act on the queued splits
+  sleep(5);
+
+  std::vector<std::pair<std::string, uint64_t> > found;
+  ceph_rewinddir(cmount, stale_dir);
+  ASSERT_EQ(0, bulk_ls(cmount, stale_dir, &found));
+  std::sort(found.begin(), found.end());
+  ASSERT_EQ(expected, found);
+  ASSERT_EQ(ceph_closedir(cmount, stale_dir), 0);
+
+  // a fresh handle walks every frag concurrently
+  struct ceph_dir_result *ls_dir = NULL;
+  ASSERT_EQ(ceph_opendir(cmount, dir, &ls_dir), 0);
+  found.clear();
+  ASSERT_EQ(0, bulk_ls(cmount, ls_dir, &found));
+  ASSERT_EQ(ceph_readdir(cmount, ls_dir), (struct dirent *)NULL);
+  std::sort(found.begin(), found.end());
+  ASSERT_EQ(expected, found);
   ASSERT_EQ(ceph_closedir(cmount, ls_dir), 0);
 
+  ASSERT_EQ(0, mds_injectargs(cmount, "--mds_bal_split_size 10000 "
+			      "--mds_bal_merge_size 50 "
+			      "--mds_bal_split_bits 3 "
+			      "--mds_bal_fragment_interval 5"));
   ceph_shutdown(cmount);
 }
 
@@ -0,0 +1,203 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+/*
+ * Many threads sharing one libcephfs mount, the way NFS-Ganesha and
+ * Samba use it.  Each phase is run with every thread working on its
+ * own file, so anything that keeps the threads from scaling is
+ * contention inside the client rather than on the same inode.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "include/cephfs/libcephfs.h"
+
+static void usage()
+{
+  std::cerr << "usage: ceph_libcephfs_bench [flags] [ceph options]\n"
+	    << "	 --threads <n>\n"
+	    << "	       number of threads sharing the mount (default 8)\n"
+	    << "	 --ops <n>\n"
+	    << "	       operations per thread in each phase (default 10000)\n"
+	    << "	 --size <bytes>\n"
+	    << "	       size of each thread's file (default 65536)\n"
+	    << "	 --dir <path>\n"
+	    << "	       directory to work in (default /libcephfs_bench.<pid>)\n"
+	    << std::endl;
+}
+
+struct Config {
+  int threads = 8;
+  int ops = 10000;
+  int size = 65536;
+  std::string dir;
+};
+
+typedef std::function<int(int thread, int op)> op_fn_t;
+
+static int run_phase(const char *name, const Config& cfg, op_fn_t fn)
+{
+  std::vector<std::thread> workers;
+  std::vector<int> errors(cfg.threads, 0);
+  auto start = std::chrono::steady_clock::now();
+  for (int t = 0; t < cfg.threads; ++t) {
+    workers.emplace_back([&, t] {
+	for (int i = 0; i < cfg.ops; ++i) {
+	  int r = fn(t, i);
+	  if (r < 0) {
+	    errors[t] = r;
+	    return;
+	  }
+	}
+      });
+  }
+  for (auto& w : workers)
+    w.join();
+  std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+
+  for (int t = 0; t < cfg.threads; ++t) {
+    if (errors[t] < 0) {
+      std::cerr << name << ": thread " << t << " failed: "
+		<< strerror(-errors[t]) << std::endl;
+      return errors[t];
+    }
+  }
+  double total = (double)cfg.threads * cfg.ops;
+  printf("%-10s %3d threads %10.0f ops %8.3f s %12.1f ops/s\n",
+	 name, cfg.threads, total, elapsed.count(), total / elapsed.count());
+  return 0;
+}
+
+int main(int argc, const char **argv)
+{
+  Config cfg;
+  std::vector<const char*> args;
+  args.push_back(argv[0]);
+  for (int i = 1; i < argc; ++i) {
+    std::string a = argv[i];
+    if ((a == "--threads" || a == "--ops" || a == "--size" || a == "--dir") &&
+	i + 1 < argc) {
+      const char *v = argv[++i];
+      if (a == "--threads")
+	cfg.threads = atoi(v);
+      else if (a == "--ops")
+	cfg.ops = atoi(v);
+      else if (a == "--size")
+	cfg.size = atoi(v);
+      else
+	cfg.dir = v;
+    } else if (a == "-h" || a == "--help") {
+      usage();
+      return 0;
+    } else {
+      args.push_back(argv[i]);
+    }
+  }
+  if (cfg.threads <= 0 || cfg.ops <= 0 || cfg.size <= 0) {
+    usage();
+    return 1;
+  }
+  if (cfg.dir.empty())
+    cfg.dir = "/libcephfs_bench." + std::to_string(getpid());
+
+  struct ceph_mount_info *cmount;
+  int r = ceph_create(&cmount, NULL);
+  if (r == 0)
+    r = ceph_conf_read_file(cmount, NULL);
+  if (r == 0)
+    r = ceph_conf_parse_env(cmount, NULL);
+  if (r == 0)
+    r = ceph_conf_parse_argv(cmount, args.size(), args.data());
+  if (r == 0)
+    r = ceph_mount(cmount, "/");
+  if (r < 0) {
+    std::cerr << "mount failed: " << strerror(-r) << std::endl;
+    return 1;
+  }
+
+  r = ceph_mkdir(cmount, cfg.dir.c_str(), 0755);
+  if (r < 0 && r != -EEXIST) {
+    std::cerr << "mkdir " << cfg.dir << " failed: " << strerror(-r) << std::endl;
+    ceph_shutdown(cmount);
+    return 1;
+  }
+
+  // one file per thread, written out so reads can hit the cache
+  std::vector<std::string> paths;
+  std::vector<int> fds;
+  std::vector<char> buf(cfg.size, 'x');
+  for (int t = 0; t < cfg.threads; ++t) {
+    paths.push_back(cfg.dir + "/f" + std::to_string(t));
+    int fd = ceph_open(cmount, paths.back().c_str(), O_CREAT|O_RDWR, 0644);
+    if (fd < 0) {
+      std::cerr << "open " << paths.back() << " failed: " << strerror(-fd)
+		<< std::endl;
+      ceph_shutdown(cmount);
+      return 1;
+    }
+    r = ceph_write(cmount, fd, buf.data(), buf.size(), 0);
+    if (r < 0) {
+      std::cerr << "write " << paths.back() << " failed: " << strerror(-r)
+		<< std::endl;
+      ceph_shutdown(cmount);
+      return 1;
+    }
+    fds.push_back(fd);
+  }
+
+  const int block = 4096;
+  r = run_phase("statx", cfg, [&](int t, int i) {
+      struct ceph_statx stx;
+      return ceph_statx(cmount, paths[t].c_str(), &stx,
+			CEPH_STATX_BASIC_STATS, AT_NO_ATTR_SYNC);
+    });
+  if (r == 0)
+    r = run_phase("fstatx", cfg, [&](int t, int i) {
+	struct ceph_statx stx;
+	return ceph_fstatx(cmount, fds[t], &stx, CEPH_STATX_BASIC_STATS,
+			   AT_NO_ATTR_SYNC);
+      });
+  if (r == 0)
+    r = run_phase("read", cfg, [&](int t, int i) {
+	char b[block];
+	int64_t off = ((int64_t)i * block) % cfg.size;
+	return ceph_read(cmount, fds[t], b, block, off);
+      });
+  if (r == 0)
+    r = run_phase("write", cfg, [&](int t, int i) {
+	char b[block];
+	memset(b, 'y', block);
+	int64_t off = ((int64_t)i * block) % cfg.size;
+	return ceph_write(cmount, fds[t], b, block, off);
+      });
+
+  for (int t = 0; t < cfg.threads; ++t) {
+    ceph_close(cmount, fds[t]);
+    ceph_unlink(cmount, paths[t].c_str());
+  }
+  ceph_rmdir(cmount, cfg.dir.c_str());
+  ceph_shutdown(cmount);
+  return r < 0 ? 1 : 0;
+}
@@ -0,0 +1,365 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+/*
+ * Stress the BlueStore allocators from many threads.  Each thread runs
+ * reserve+allocate / release against a shared allocator, either replaying
+ * its share of a trace file or generating a synthetic workload that
+ * keeps the device around --fill full with a mix of small and large
+ * extents.  Reports throughput, allocate latency and the allocator's own
+ * fragmentation score at the end of the run.
+ *
+ * Trace format, one op per line:
+ *   alloc <id> <bytes>
+ *   free <id>
+ * Ops on the same id are replayed in order by the same thread.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/ceph_argparse.h"
+#include "common/ceph_time.h"
+#include "global/global_init.h"
+#include "include/str_list.h"
+#include "os/bluestore/Allocator.h"
+
+using namespace std;
+
+static void usage()
+{
+  cout << "usage: ceph_perf_allocator [flags]\n"
+       << "  --types a,b        allocators to compare (default stupid,bitmap,fastbitmap)\n"
+       << "  --threads N        allocating threads (default 8)\n"
+       << "  --size BYTES       device size (default 64G)\n"
+       << "  --alloc-unit BYTES allocation unit (default 4096)\n"
+       << "  --ops N            synthetic ops per thread (default 200000)\n"
+       << "  --fill RATIO       synthetic target utilization (default 0.7)\n"
+       << "  --trace FILE       replay FILE instead of the synthetic workload\n"
+       << std::endl;
+}
+
+struct LatencyHistogram {
+  // bucket i counts ops that took [2^i, 2^(i+1)) ns
+  static const int NUM_BUCKETS = 40;
+  uint64_t buckets[NUM_BUCKETS] = {0};
+  uint64_t count = 0;
+  uint64_t total_ns = 0;
+
+  void add(uint64_t ns) {
+    int b = ns ? 63 - __builtin_clzll(ns) : 0;
+    if (b >= NUM_BUCKETS)
+      b = NUM_BUCKETS - 1;
+    buckets[b]++;
+    count++;
+    total_ns += ns;
+  }
+  void merge(const LatencyHistogram& o) {
+    for (int i = 0; i < NUM_BUCKETS; i++)
+      buckets[i] += o.buckets[i];
+    count += o.count;
+    total_ns += o.total_ns;
+  }
+  uint64_t percentile(double p) const {
+    uint64_t want = count * p;
+    uint64_t seen = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+      seen += buckets[i];
+      if (seen > want)
+	return 1ull << (i + 1);
+    }
+    return 1ull << NUM_BUCKETS;
+  }
+};
+
+struct TraceOp {
+  bool alloc;
+  uint64_t id;
+  uint64_t bytes;
+};
+
+struct ThreadResult {
+  LatencyHistogram alloc_lat;
+  uint64_t frees = 0;
+  uint64_t enospc = 0;
+};
+
+static bool load_trace(const string& fn, int threads,
+		       vector<vector<TraceOp>> *ops)
+{
+  ifstream in(fn);
+  if (!in) {
+    cerr << "unable to open " << fn << std::endl;
+    return false;
+  }
+  ops->resize(threads);
+  string line;
+  int lineno = 0;
+  while (getline(in, line)) {
+    ++lineno;
+    if (line.empty() || line[0] == '#')
+      continue;
+    istringstream ss(line);
+    string op;
+    TraceOp t = {false, 0, 0};
+    ss >> op >> t.id;
+    if (op == "alloc") {
+      t.alloc = true;
+      ss >> t.bytes;
+    } else if (op != "free") {
+      cerr << fn << ":" << lineno << ": bad op '" << op << "'" << std::endl;
+      return false;
+    }
+    if (ss.fail()) {
+      cerr << fn << ":" << lineno << ": parse error" << std::endl;
+      return false;
+    }
+    (*ops)[t.id % threads].push_back(t);
+  }
+  return true;
+}
+
+/// mostly small writes, with the occasional big sequential one
+static uint64_t synthetic_size(std::mt19937_64& rng, uint64_t alloc_unit)
+{
+  unsigned r = rng() % 100;
+  if (r < 70)
+    return alloc_unit * (1 + rng() % 4);
+  if (r < 95)
+    return alloc_unit * (1 + rng() % 32);
+  return alloc_unit * (256 + rng() % 768);
+}
+
+static void release(Allocator *alloc, AllocExtentVector& extents)
+{
+  interval_set<uint64_t> r;
+  for (auto& e : extents)
+    r.insert(e.offset, e.length);
+  alloc->release(r);
+}
+
+static void run_thread(Allocator *alloc, uint64_t alloc_unit,
+		       const vector<TraceOp> *trace,
+		       uint64_t ops, uint64_t target_bytes, int seed,
+		       std::function<void()> barrier, ThreadResult *res)
+{
+  map<uint64_t, AllocExtentVector> live;
+  uint64_t live_bytes = 0;
+  std::mt19937_64 rng(seed);
+  uint64_t next_id = 0;
+
+  auto do_alloc = [&](uint64_t id, uint64_t want) {
+    want = ROUND_UP_TO(want, alloc_unit);
+    auto t0 = ceph::mono_clock::now();
+    if (alloc->reserve(want) < 0) {
+      res->enospc++;
+      return;
+    }
+    AllocExtentVector extents;
+    int64_t got = alloc->allocate(want, alloc_unit, 0, &extents);
+    auto t1 = ceph::mono_clock::now();
+    res->alloc_lat.add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			 t1 - t0).count());
+    if (got < 0) {
+      alloc->unreserve(want);
+      res->enospc++;
+      return;
+    }
+    if ((uint64_t)got < want)
+      alloc->unreserve(want - got);
+    live_bytes += got;
+    auto& v = live[id];
+    v.insert(v.end(), extents.begin(), extents.end());
+  };
+  auto do_free = [&](map<uint64_t, AllocExtentVector>::iterator p) {
+    for (auto& e : p->second)
+      live_bytes -= e.length;
+    release(alloc, p->second);
+    live.erase(p);
+    res->frees++;
+  };
+
+  if (trace) {
+    for (auto& op : *trace) {
+      if (op.alloc) {
+	do_alloc(op.id, op.bytes);
+      } else {
+	auto p = live.find(op.id);
+	if (p != live.end())
+	  do_free(p);
+      }
+    }
+  } else {
+    for (uint64_t i = 0; i < ops; ++i) {
+      if (live.empty() || live_bytes < target_bytes) {
+	do_alloc(next_id++, synthetic_size(rng, alloc_unit));
+      } else {
+	// free something old-ish so long-lived extents pin the layout
+	auto p = live.lower_bound(next_id - 1 - rng() % next_id);
+	if (p == live.end())
+	  p = live.begin();
+	do_free(p);
+      }
+    }
+  }
+  barrier();
+  for (auto p = live.begin(); p != live.end(); )
+    do_free(p++);
+}
+
+static void run(CephContext *cct, const string& type, int threads,
+		uint64_t size, uint64_t alloc_unit, uint64_t ops, double fill,
+		const vector<vector<TraceOp>>& trace)
+{
+  Allocator *alloc = Allocator::create(cct, type, size, alloc_unit);
+  if (!alloc) {
+    cerr << "unknown allocator " << type << std::endl;
+    return;
+  }
+  alloc->init_add_free(0, size);
+
+  vector<ThreadResult> results(threads);
+  vector<std::thread> workers;
+  uint64_t target_bytes = size * fill / threads;
+
+  // threads park here once their workload is done, so fragmentation is
+  // measured while they still hold their extents
+  std::mutex lock;
+  std::condition_variable cond;
+  int waiting = 0;
+  bool teardown = false;
+  auto barrier = [&] {
+    std::unique_lock<std::mutex> l(lock);
+    if (++waiting == threads)
+      cond.notify_all();
+    cond.wait(l, [&] { return teardown; });
+  };
+
+  auto start = ceph::mono_clock::now();
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+	run_thread(alloc, alloc_unit, trace.empty() ? nullptr : &trace[t],
+		   ops, target_bytes, t, barrier, &results[t]);
+      });
+  }
+  {
+    std::unique_lock<std::mutex> l(lock);
+    cond.wait(l, [&] { return waiting == threads; });
+  }
+  auto end = ceph::mono_clock::now();
+  double frag = alloc->get_fragmentation(alloc_unit);
+  {
+    std::lock_guard<std::mutex> l(lock);
+    teardown = true;
+  }
+  cond.notify_all();
+  for (auto& w : workers)
+    w.join();
+
+  ThreadResult total;
+  for (auto& r : results) {
+    total.alloc_lat.merge(r.alloc_lat);
+    total.frees += r.frees;
+    total.enospc += r.enospc;
+  }
+  double secs = std::chrono::duration<double>(end - start).count();
+  const LatencyHistogram& h = total.alloc_lat;
+  cout << type
+       << " threads " << threads
+       << " allocs " << h.count
+       << " frees " << total.frees
+       << " enospc " << total.enospc
+       << " " << ((h.count + total.frees) / secs / 1000.0) << " Kops/s"
+       << " alloc avg " << (h.count ? h.total_ns / h.count : 0) << " ns"
+       << " p50 <" << h.percentile(0.5) << " ns"
+       << " p99 <" << h.percentile(0.99) << " ns"
+       << " fragmentation " << frag
+       << std::endl;
+  if (alloc->get_free() != size)
+    cerr << type << " leaked 0x" << std::hex << (size - alloc->get_free())
+	 << std::dec << " bytes" << std::endl;
+
+  alloc->shutdown();
+  delete alloc;
+}
+
+int main(int argc, const char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  env_to_vec(args);
+
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY, 0);
+
+  int threads = 8;
+  uint64_t size = 64ull << 30;
+  uint64_t alloc_unit = 4096;
+  uint64_t ops = 200000;
+  double fill = 0.7;
+  string types = "stupid,bitmap,fastbitmap";
+  string trace_fn;
+
+  string val;
+  for (auto i = args.begin(); i != args.end();) {
+    if (ceph_argparse_double_dash(args, i)) {
+      break;
+    } else if (ceph_argparse_witharg(args, i, &val, "--threads", (char*)NULL)) {
+      threads = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--size", (char*)NULL)) {
+      size = strtoull(val.c_str(), NULL, 10);
+    } else if (ceph_argparse_witharg(args, i, &val, "--alloc-unit", (char*)NULL)) {
+      alloc_unit = strtoull(val.c_str(), NULL, 10);
+    } else if (ceph_argparse_witharg(args, i, &val, "--ops", (char*)NULL)) {
+      ops = strtoull(val.c_str(), NULL, 10);
+    } else if (ceph_argparse_witharg(args, i, &val, "--fill", (char*)NULL)) {
+      fill = atof(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--trace", (char*)NULL)) {
+      trace_fn = val;
+    } else if (ceph_argparse_witharg(args, i, &val, "--types", (char*)NULL)) {
+      types = val;
+    } else {
+      cerr << "unknown option " << *i << std::endl;
+      usage();
+      return 1;
+    }
+  }
+  if (threads <= 0 || size == 0 || alloc_unit == 0 || !ISP2(alloc_unit) ||
+      fill <= 0 || fill >= 1) {
+    usage();
+    return 1;
+  }
+  size = P2ALIGN(size, alloc_unit);
+
+  common_init_finish(cct.get());
+
+  vector<vector<TraceOp>> trace;
+  if (!trace_fn.empty() && !load_trace(trace_fn, threads, &trace))
+    return 1;
+
+  list<string> type_list;
+  get_str_list(types, ",", type_list);
+  for (auto& type : type_list)
+    run(cct.get(), type, threads, size, alloc_unit, ops, fill, trace);
+  return 0;
+}
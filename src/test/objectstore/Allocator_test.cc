@@ -294,7 +294,7 @@ TEST_P(AllocTest, test_alloc_non_aligned_len)
 INSTANTIATE_TEST_CASE_P(
   Allocator,
   AllocTest,
-  ::testing::Values("stupid", "bitmap"));
+  ::testing::Values("stupid", "bitmap", "fastbitmap"));
 
 #else
 
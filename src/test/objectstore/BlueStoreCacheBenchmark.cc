@@ -0,0 +1,212 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+/*
+ * Measure the onode cache hit path (OnodeSpace::lookup) of the
+ * BlueStore cache implementations under many concurrent threads.  A
+ * single cache shard is populated and every thread then looks up random
+ * onodes that are all resident, while a background thread calls trim()
+ * the way the mempool thread does, so the numbers include contention on
+ * the shard lock but no evictions.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/ceph_argparse.h"
+#include "common/ceph_time.h"
+#include "common/perf_counters.h"
+#include "global/global_init.h"
+#include "include/stringify.h"
+#include "include/str_list.h"
+#include "os/bluestore/BlueStore.h"
+
+using namespace std;
+
+static void usage()
+{
+  cout << "usage: ceph_perf_bluestore_cache [flags]\n"
+       << "  --threads N      lookup threads (default 32)\n"
+       << "  --onodes N       resident onodes (default 100000)\n"
+       << "  --lookups N      lookups per thread (default 1000000)\n"
+       << "  --types a,b      cache types to compare (default lru,2q,clock)\n"
+       << std::endl;
+}
+
+struct LatencyHistogram {
+  // bucket i counts lookups that took [2^i, 2^(i+1)) ns
+  static const int NUM_BUCKETS = 40;
+  uint64_t buckets[NUM_BUCKETS] = {0};
+  uint64_t count = 0;
+  uint64_t total_ns = 0;
+
+  void add(uint64_t ns) {
+    int b = ns ? 63 - __builtin_clzll(ns) : 0;
+    if (b >= NUM_BUCKETS)
+      b = NUM_BUCKETS - 1;
+    buckets[b]++;
+    count++;
+    total_ns += ns;
+  }
+  void merge(const LatencyHistogram& o) {
+    for (int i = 0; i < NUM_BUCKETS; i++)
+      buckets[i] += o.buckets[i];
+    count += o.count;
+    total_ns += o.total_ns;
+  }
+  /// upper bound (ns) of the bucket holding the given percentile
+  uint64_t percentile(double p) const {
+    uint64_t want = count * p;
+    uint64_t seen = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+      seen += buckets[i];
+      if (seen > want)
+	return 1ull << (i + 1);
+    }
+    return 1ull << NUM_BUCKETS;
+  }
+};
+
+static PerfCounters *create_logger(CephContext *cct)
+{
+  // OnodeSpace::lookup only touches the onode hit/miss counters
+  PerfCountersBuilder b(cct, "bluestore_cache_bench",
+			l_bluestore_onode_hits - 1,
+			l_bluestore_onode_misses + 1);
+  b.add_u64_counter(l_bluestore_onode_hits, "onode_hits",
+		    "Sum for onode-lookups hit in the cache");
+  b.add_u64_counter(l_bluestore_onode_misses, "onode_misses",
+		    "Sum for onode-lookups missed in the cache");
+  return b.create_perf_counters();
+}
+
+static void run(CephContext *cct, const string& type, int threads,
+		int num_onodes, int lookups)
+{
+  PerfCounters *logger = create_logger(cct);
+  BlueStore::Cache *cache = BlueStore::Cache::create(cct, type, logger);
+  BlueStore::OnodeSpace space(cache);
+
+  vector<ghobject_t> oids;
+  oids.reserve(num_onodes);
+  for (int i = 0; i < num_onodes; i++) {
+    oids.emplace_back(hobject_t(sobject_t("obj" + stringify(i), CEPH_NOSNAP)));
+    BlueStore::OnodeRef o(new BlueStore::Onode(nullptr, oids.back(),
+					       stringify(i).c_str()));
+    space.add(oids.back(), o);
+  }
+
+  std::atomic<bool> stop = {false};
+  std::thread trimmer([&] {
+      while (!stop) {
+	// a target comfortably above what we hold: takes the lock, frees
+	// nothing
+	cache->trim((uint64_t)num_onodes * 8192, 0.5, 0.5, 4096);
+	std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    });
+
+  vector<LatencyHistogram> hists(threads);
+  vector<std::thread> workers;
+  auto start = ceph::mono_clock::now();
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+	std::mt19937 rng(t);
+	std::uniform_int_distribution<int> pick(0, num_onodes - 1);
+	LatencyHistogram& h = hists[t];
+	for (int i = 0; i < lookups; i++) {
+	  const ghobject_t& oid = oids[pick(rng)];
+	  auto t0 = ceph::mono_clock::now();
+	  BlueStore::OnodeRef o = space.lookup(oid);
+	  auto t1 = ceph::mono_clock::now();
+	  assert(o);
+	  h.add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		  t1 - t0).count());
+	}
+      });
+  }
+  for (auto& w : workers)
+    w.join();
+  auto end = ceph::mono_clock::now();
+  stop = true;
+  trimmer.join();
+
+  LatencyHistogram total;
+  for (auto& h : hists)
+    total.merge(h);
+  double secs = std::chrono::duration<double>(end - start).count();
+  cout << type
+       << " threads " << threads
+       << " lookups " << total.count
+       << " " << (total.count / secs / 1000000.0) << " Mops/s"
+       << " avg " << (total.total_ns / total.count) << " ns"
+       << " p50 <" << total.percentile(0.5) << " ns"
+       << " p99 <" << total.percentile(0.99) << " ns"
+       << " p99.9 <" << total.percentile(0.999) << " ns"
+       << std::endl;
+
+  space.clear();
+  delete cache;
+  delete logger;
+}
+
+int main(int argc, const char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  env_to_vec(args);
+
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY, 0);
+
+  int threads = 32;
+  int num_onodes = 100000;
+  int lookups = 1000000;
+  string types = "lru,2q,clock";
+
+  string val;
+  for (auto i = args.begin(); i != args.end();) {
+    if (ceph_argparse_double_dash(args, i)) {
+      break;
+    } else if (ceph_argparse_witharg(args, i, &val, "--threads", (char*)NULL)) {
+      threads = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--onodes", (char*)NULL)) {
+      num_onodes = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--lookups", (char*)NULL)) {
+      lookups = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--types", (char*)NULL)) {
+      types = val;
+    } else {
+      cerr << "unknown option " << *i << std::endl;
+      usage();
+      return 1;
+    }
+  }
+  if (threads <= 0 || num_onodes <= 0 || lookups <= 0) {
+    usage();
+    return 1;
+  }
+
+  common_init_finish(g_ceph_context);
+
+  list<string> type_list;
+  get_str_list(types, ",", type_list);
+  for (auto& type : type_list)
+    run(g_ceph_context, type, threads, num_onodes, lookups);
+  return 0;
+}
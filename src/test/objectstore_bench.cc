@@ -30,7 +30,11 @@ static void usage()
       "	 --threads\n"
       "	       number of threads to carry out this workload\n"
       "	 --multi-object\n"
-      "	       have each thread write to a separate object\n" << dendl;
+      "	       have each thread write to a separate object\n"
+      "	 --compare-io-backends\n"
+      "	       run the workload against bluestore once with libaio and\n"
+      "	       once with io_uring (bdev_ioring) and compare the results;\n"
+      "	       each run gets its own subdirectory of osd_data\n" << dendl;
   generic_server_usage();
 }
 
@@ -74,10 +78,18 @@ struct Config {
   int repeats;
   int threads;
   bool multi_object;
+  bool compare_io_backends;
   Config()
     : size(1048576), block_size(4096),
       repeats(1), threads(1),
-      multi_object(false) {}
+      multi_object(false), compare_io_backends(false) {}
+};
+
+struct Result {
+  std::chrono::microseconds duration;
+  byte_units rate = 0;
+  size_t iops = 0;
+  std::string io_backend;  ///< what the block device actually used
 };
 
 class C_NotifyCond : public Context {
@@ -147,54 +159,15 @@ void osbench_worker(ObjectStore *os, const Config &cfg,
   sequencer.flush();
 }
 
-int main(int argc, const char *argv[])
+static int run_bench(const Config &cfg,
+                     const std::string &data_path,
+                     const std::string &journal_path,
+                     Result *result)
 {
-  Config cfg;
-
-  // command-line arguments
-  vector<const char*> args;
-  argv_to_vec(argc, argv, args);
-  env_to_vec(args);
-
-  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_OSD,
-			 CODE_ENVIRONMENT_UTILITY, 0);
-
-  std::string val;
-  vector<const char*>::iterator i = args.begin();
-  while (i != args.end()) {
-    if (ceph_argparse_double_dash(args, i))
-      break;
-
-    if (ceph_argparse_witharg(args, i, &val, "--size", (char*)nullptr)) {
-      std::string err;
-      if (!cfg.size.parse(val, &err)) {
-        derr << "error parsing size: " << err << dendl;
-        usage();
-      }
-    } else if (ceph_argparse_witharg(args, i, &val, "--block-size", (char*)nullptr)) {
-      std::string err;
-      if (!cfg.block_size.parse(val, &err)) {
-        derr << "error parsing block-size: " << err << dendl;
-        usage();
-      }
-    } else if (ceph_argparse_witharg(args, i, &val, "--repeats", (char*)nullptr)) {
-      cfg.repeats = atoi(val.c_str());
-    } else if (ceph_argparse_witharg(args, i, &val, "--threads", (char*)nullptr)) {
-      cfg.threads = atoi(val.c_str());
-    } else if (ceph_argparse_flag(args, i, "--multi-object", (char*)nullptr)) {
-      cfg.multi_object = true;
-    } else {
-      derr << "Error: can't understand argument: " << *i << "\n" << dendl;
-      usage();
-    }
-  }
-
-  common_init_finish(g_ceph_context);
-
   // create object store
   dout(0) << "objectstore " << g_conf->osd_objectstore << dendl;
-  dout(0) << "data " << g_conf->osd_data << dendl;
-  dout(0) << "journal " << g_conf->osd_journal << dendl;
+  dout(0) << "data " << data_path << dendl;
+  dout(0) << "journal " << journal_path << dendl;
   dout(0) << "size " << cfg.size << dendl;
   dout(0) << "block-size " << cfg.block_size << dendl;
   dout(0) << "repeats " << cfg.repeats << dendl;
@@ -203,31 +176,32 @@ int main(int argc, const char *argv[])
   auto os = std::unique_ptr<ObjectStore>(
       ObjectStore::create(g_ceph_context,
                           g_conf->osd_objectstore,
-                          g_conf->osd_data,
-                          g_conf->osd_journal));
+                          data_path,
+                          journal_path));
 
   //Checking data folder: create if needed or error if it's not empty
-  DIR *dir = ::opendir(g_conf->osd_data.c_str());
+  DIR *dir = ::opendir(data_path.c_str());
   if (!dir) {
     std::string cmd("mkdir -p ");
-    cmd+=g_conf->osd_data;
+    cmd+=data_path;
     int r = ::system( cmd.c_str() );
     if( r<0 ){
       derr << "Failed to create data directory, ret = " << r << dendl;
-      return 1;
+      return -1;
     }
   }
   else {
      bool non_empty = readdir(dir) != NULL && readdir(dir) != NULL && readdir(dir) != NULL;
      if( non_empty ){
-       derr << "Data directory '"<<g_conf->osd_data<<"' isn't empty, please clean it first."<< dendl;
-       return 1;
+       derr << "Data directory '"<<data_path<<"' isn't empty, please clean it first."<< dendl;
+       return -1;
      }
   }
-  ::closedir(dir);
+  if (dir)
+    ::closedir(dir);
 
   //Create folders for journal if needed
-  string journal_base = g_conf->osd_journal.substr(0, g_conf->osd_journal.rfind('/'));
+  string journal_base = journal_path.substr(0, journal_path.rfind('/'));
   struct stat sb;
   if (stat(journal_base.c_str(), &sb) != 0 ){
     std::string cmd("mkdir -p ");
@@ -235,25 +209,31 @@ int main(int argc, const char *argv[])
     int r = ::system( cmd.c_str() );
     if( r<0 ){
       derr << "Failed to create journal directory, ret = " << r << dendl;
-      return 1;
+      return -1;
     }
   }
 
   if (!os) {
     derr << "bad objectstore type " << g_conf->osd_objectstore << dendl;
-    return 1;
+    return -EINVAL;
   }
   if (os->mkfs() < 0) {
     derr << "mkfs failed" << dendl;
-    return 1;
+    return -1;
   }
   if (os->mount() < 0) {
     derr << "mount failed" << dendl;
-    return 1;
+    return -1;
   }
 
   dout(10) << "created objectstore " << os.get() << dendl;
 
+  {
+    map<string,string> pm;
+    os->collect_metadata(&pm);
+    result->io_backend = pm["bluestore_bdev_io_backend"];
+  }
+
   // create a collection
   spg_t pg;
   const coll_t cid(pg);
@@ -312,6 +292,9 @@ int main(int argc, const char *argv[])
   dout(0) << "Wrote " << total << " in "
       << duration.count() << "us, at a rate of " << rate << "/s and "
       << iops << " iops" << dendl;
+  result->duration = duration;
+  result->rate = rate;
+  result->iops = iops;
 
   // remove the objects
   ObjectStore::Sequencer osr(__func__);
@@ -323,3 +306,95 @@ int main(int argc, const char *argv[])
   os->umount();
   return 0;
 }
+
+int main(int argc, const char *argv[])
+{
+  Config cfg;
+
+  // command-line arguments
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  env_to_vec(args);
+
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_OSD,
+			 CODE_ENVIRONMENT_UTILITY, 0);
+
+  std::string val;
+  vector<const char*>::iterator i = args.begin();
+  while (i != args.end()) {
+    if (ceph_argparse_double_dash(args, i))
+      break;
+
+    if (ceph_argparse_witharg(args, i, &val, "--size", (char*)nullptr)) {
+      std::string err;
+      if (!cfg.size.parse(val, &err)) {
+        derr << "error parsing size: " << err << dendl;
+        usage();
+      }
+    } else if (ceph_argparse_witharg(args, i, &val, "--block-size", (char*)nullptr)) {
+      std::string err;
+      if (!cfg.block_size.parse(val, &err)) {
+        derr << "error parsing block-size: " << err << dendl;
+        usage();
+      }
+    } else if (ceph_argparse_witharg(args, i, &val, "--repeats", (char*)nullptr)) {
+      cfg.repeats = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--threads", (char*)nullptr)) {
+      cfg.threads = atoi(val.c_str());
+    } else if (ceph_argparse_flag(args, i, "--multi-object", (char*)nullptr)) {
+      cfg.multi_object = true;
+    } else if (ceph_argparse_flag(args, i, "--compare-io-backends", (char*)nullptr)) {
+      cfg.compare_io_backends = true;
+    } else {
+      derr << "Error: can't understand argument: " << *i << "\n" << dendl;
+      usage();
+    }
+  }
+
+  common_init_finish(g_ceph_context);
+
+  if (!cfg.compare_io_backends) {
+    Result result;
+    int r = run_bench(cfg, g_conf->osd_data, g_conf->osd_journal, &result);
+    return r < 0 ? 1 : 0;
+  }
+
+  if (g_conf->osd_objectstore != "bluestore") {
+    derr << "--compare-io-backends requires osd_objectstore = bluestore"
+         << dendl;
+    return 1;
+  }
+
+  const char *backends[] = { "libaio", "io_uring" };
+  Result results[2];
+  for (int b = 0; b < 2; b++) {
+    g_conf->set_val("bdev_ioring", b ? "true" : "false");
+    g_conf->apply_changes(nullptr);
+
+    std::string data_path = g_conf->osd_data + "/" + backends[b];
+    dout(0) << "io backend " << backends[b] << dendl;
+    int r = run_bench(cfg, data_path, data_path + "/journal", &results[b]);
+    if (r < 0)
+      return 1;
+    // KernelDevice quietly falls back to libaio if io_uring is missing
+    if (results[b].io_backend != backends[b]) {
+      std::cerr << "io backend " << backends[b] << " not available (device used "
+                << (results[b].io_backend.empty() ? "unknown" :
+                    results[b].io_backend)
+                << "); skipping the comparison" << std::endl;
+      return 2;
+    }
+  }
+
+  for (int b = 0; b < 2; b++) {
+    std::cout << backends[b] << ": "
+              << results[b].duration.count() << "us, "
+              << results[b].rate << "/s, "
+              << results[b].iops << " iops" << std::endl;
+  }
+  if (results[0].iops) {
+    std::cout << "io_uring/libaio iops ratio: "
+              << (double)results[1].iops / results[0].iops << std::endl;
+  }
+  return 0;
+}
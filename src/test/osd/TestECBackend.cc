@@ -17,6 +17,10 @@
 #include <errno.h>
 #include <signal.h>
 #include "osd/ECBackend.h"
+#include "erasure-code/ErasureCodePlugin.h"
+#include "global/global_context.h"
+#include "common/config.h"
+#include "include/stringify.h"
 #include "gtest/gtest.h"
 
 TEST(ECUtil, stripe_info_t)
@@ -58,3 +62,105 @@ TEST(ECUtil, stripe_info_t)
             make_pair((uint64_t)0, 2*swidth));
 }
 
+TEST(ECUtil, StripeCoder)
+{
+  {
+    ECUtil::StripeCoder coder(g_ceph_context, 0, 4);
+    coder.start();
+    ASSERT_EQ(1u, coder.get_batches(1000));
+    coder.stop();
+  }
+
+  ECUtil::StripeCoder coder(g_ceph_context, 3, 4);
+  coder.start();
+  ASSERT_EQ(1u, coder.get_batches(0));
+  ASSERT_EQ(1u, coder.get_batches(7));
+  ASSERT_EQ(2u, coder.get_batches(8));
+  ASSERT_EQ(4u, coder.get_batches(1000));
+
+  for (unsigned batches = 1; batches <= 4; ++batches) {
+    vector<unsigned> ran(batches, 0);
+    coder.run(batches, [&](unsigned b) { ran[b]++; });
+    ASSERT_EQ(vector<unsigned>(batches, 1), ran);
+  }
+  coder.stop();
+}
+
+TEST(ECUtil, StripeCoder_matches_serial)
+{
+  // enough stripes to fan out over every thread, and not a multiple of
+  // the batch count so the batches are uneven
+  const unsigned threads = 3;
+  const uint64_t min_stripes = 4;
+  const uint64_t stripes = min_stripes * (threads + 1) * 2 + 3;
+  ECUtil::StripeCoder coder(g_ceph_context, threads, min_stripes);
+  coder.start();
+  ASSERT_EQ(threads + 1, coder.get_batches(stripes));
+
+  const pair<int, int> km[] = { {2, 1}, {4, 2}, {8, 3} };
+  for (auto& p : km) {
+    int k = p.first, m = p.second;
+    ErasureCodeProfile profile;
+    profile["technique"] = "reed_sol_van";
+    profile["k"] = stringify(k);
+    profile["m"] = stringify(m);
+    ErasureCodeInterfaceRef ec_impl;
+    ASSERT_EQ(0, ErasureCodePluginRegistry::instance().factory(
+		"jerasure",
+		g_conf->get_val<std::string>("erasure_code_dir"),
+		profile, &ec_impl, &cerr));
+    const uint64_t swidth = k * 4096;
+    ASSERT_EQ(4096u, ec_impl->get_chunk_size(swidth));
+    ECUtil::stripe_info_t sinfo(k, swidth);
+
+    bufferlist in;
+    bufferptr bp(stripes * swidth);
+    srand(k * 100 + m);
+    for (unsigned i = 0; i < bp.length(); ++i)
+      bp[i] = rand();
+    in.append(bp);
+
+    set<int> want;
+    for (int i = 0; i < k + m; ++i)
+      want.insert(i);
+    map<int, bufferlist> serial, parallel;
+    ASSERT_EQ(0, ECUtil::encode(sinfo, ec_impl, in, want, &serial));
+    ASSERT_EQ(0, ECUtil::encode(sinfo, ec_impl, in, want, &parallel,
+				&coder));
+    ASSERT_EQ(serial.size(), parallel.size());
+    for (auto& i : serial) {
+      ASSERT_EQ(stripes * sinfo.get_chunk_size(), i.second.length());
+      ASSERT_TRUE(i.second.contents_equal(parallel[i.first]))
+	<< "k=" << k << " m=" << m << " shard " << i.first;
+    }
+
+    // lose the first m shards, which include data shards
+    map<int, bufferlist> to_decode(serial);
+    for (int i = 0; i < m; ++i)
+      to_decode.erase(i);
+
+    bufferlist serial_out, parallel_out;
+    ASSERT_EQ(0, ECUtil::decode(sinfo, ec_impl, to_decode, &serial_out));
+    ASSERT_EQ(0, ECUtil::decode(sinfo, ec_impl, to_decode, &parallel_out,
+				&coder));
+    ASSERT_TRUE(serial_out.contents_equal(in));
+    ASSERT_TRUE(parallel_out.contents_equal(serial_out))
+      << "k=" << k << " m=" << m;
+
+    map<int, bufferlist> serial_shards, parallel_shards;
+    map<int, bufferlist*> serial_ptrs, parallel_ptrs;
+    for (int i = 0; i < m; ++i) {
+      serial_ptrs[i] = &serial_shards[i];
+      parallel_ptrs[i] = &parallel_shards[i];
+    }
+    ASSERT_EQ(0, ECUtil::decode(sinfo, ec_impl, to_decode, serial_ptrs));
+    ASSERT_EQ(0, ECUtil::decode(sinfo, ec_impl, to_decode, parallel_ptrs,
+				&coder));
+    for (int i = 0; i < m; ++i) {
+      ASSERT_TRUE(serial_shards[i].contents_equal(serial[i]));
+      ASSERT_TRUE(parallel_shards[i].contents_equal(serial_shards[i]))
+	<< "k=" << k << " m=" << m << " shard " << i;
+    }
+  }
+  coder.stop();
+}
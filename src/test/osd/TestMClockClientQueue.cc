@@ -185,3 +185,76 @@ TEST_F(MClockClientQueueTest, TestRemoveByClass) {
   r = q.dequeue();
   ASSERT_EQ(104u, r.second.get_map_epoch());
 }
+
+
+TEST_F(MClockClientQueueTest, TestPoolTags) {
+  using InnerClient = mClockClientQueue::InnerClient;
+  using op_type = mClockClientQueue::osd_op_type_t;
+
+  mempool::osdmap::map<int64_t,pg_pool_t> pools;
+  pools[1];
+  pools[2].opts.set(pool_opts_t::QOS_RES, 100.0);
+  pools[2].opts.set(pool_opts_t::QOS_LIM, 500.0);
+  mClockClientQueue::update_pool_tags(pools);
+
+  auto dflt = mClockClientQueue::op_class_client_info_f(
+    InnerClient(client1, op_type::client_op, 1));
+  ASSERT_EQ(g_conf->osd_op_queue_mclock_client_op_res, dflt.reservation);
+
+  auto tagged = mClockClientQueue::op_class_client_info_f(
+    InnerClient(client1, op_type::client_op, 2));
+  ASSERT_EQ(100.0, tagged.reservation);
+  ASSERT_EQ(g_conf->osd_op_queue_mclock_client_op_wgt, tagged.weight);
+  ASSERT_EQ(500.0, tagged.limit);
+
+  // only client ops pick up the pool's tags
+  auto trim = mClockClientQueue::op_class_client_info_f(
+    InnerClient(client1, op_type::bg_snaptrim, 2));
+  ASSERT_EQ(g_conf->osd_op_queue_mclock_snap_res, trim.reservation);
+
+  pools[2].opts.unset(pool_opts_t::QOS_RES);
+  pools[2].opts.unset(pool_opts_t::QOS_LIM);
+  mClockClientQueue::update_pool_tags(pools);
+  tagged = mClockClientQueue::op_class_client_info_f(
+    InnerClient(client1, op_type::client_op, 2));
+  ASSERT_EQ(g_conf->osd_op_queue_mclock_client_op_res, tagged.reservation);
+}
+
+
+struct PoolKeyedQueue : public mClockClientQueue {
+  PoolKeyedQueue() : mClockClientQueue(g_ceph_context) {}
+  using mClockClientQueue::maybe_update_client_infos;
+  using mClockClientQueue::get_inner_client;
+};
+
+TEST_F(MClockClientQueueTest, TestPoolTagsKeyedByPool) {
+  using InnerClient = mClockClientQueue::InnerClient;
+  using op_type = mClockClientQueue::osd_op_type_t;
+
+  mempool::osdmap::map<int64_t,pg_pool_t> pools;
+  pools[1];
+  pools[2].opts.set(pool_opts_t::QOS_RES, 100.0);
+  mClockClientQueue::update_pool_tags(pools);
+
+  PoolKeyedQueue pq;
+  pq.maybe_update_client_infos();
+
+  // every client of a tagged pool shares the pool's one dmclock client,
+  // so the reservation is the pool's, not each client's
+  ASSERT_EQ(InnerClient(0, op_type::client_op, 2),
+	    pq.get_inner_client(client1, op_type::client_op, 2));
+  ASSERT_EQ(InnerClient(0, op_type::client_op, 2),
+	    pq.get_inner_client(client2, op_type::client_op, 2));
+
+  // untagged pools and background ops stay per client
+  ASSERT_EQ(InnerClient(client1, op_type::client_op),
+	    pq.get_inner_client(client1, op_type::client_op, 1));
+  ASSERT_EQ(InnerClient(client1, op_type::bg_snaptrim),
+	    pq.get_inner_client(client1, op_type::bg_snaptrim, 2));
+
+  pools[2].opts.unset(pool_opts_t::QOS_RES);
+  mClockClientQueue::update_pool_tags(pools);
+  pq.maybe_update_client_infos();
+  ASSERT_EQ(InnerClient(client2, op_type::client_op),
+	    pq.get_inner_client(client2, op_type::client_op, 2));
+}
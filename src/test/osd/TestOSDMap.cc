@@ -446,6 +446,218 @@ TEST_F(OSDMapTest, PrimaryAffinity) {
   }
 }
 
+TEST_F(OSDMapTest, IncrementalMapping) {
+  set_up_map();
+  mapping.update(osdmap);
+
+  auto check = [&]() {
+    for (auto pool : {my_ec_pool, my_rep_pool}) {
+      for (unsigned ps = 0; ps < 64; ++ps) {
+	pg_t pgid(ps, pool);
+	vector<int> up, acting, up2, acting2;
+	int up_primary, acting_primary, up_primary2, acting_primary2;
+	osdmap.pg_to_up_acting_osds(pgid, &up, &up_primary,
+				    &acting, &acting_primary);
+	mapping.get(pgid, &up2, &up_primary2, &acting2, &acting_primary2);
+	ASSERT_EQ(up, up2) << pgid;
+	ASSERT_EQ(up_primary, up_primary2) << pgid;
+	ASSERT_EQ(acting, acting2) << pgid;
+	ASSERT_EQ(acting_primary, acting_primary2) << pgid;
+      }
+    }
+    ASSERT_EQ(osdmap.get_epoch(), mapping.get_epoch());
+  };
+
+  pg_t rep_pg(0, my_rep_pool);
+  vector<int> rep_up;
+  osdmap.pg_to_raw_up(rep_pg, &rep_up, nullptr);
+  int down_osd = rep_up[0];
+
+  {
+    // osd goes down while in a pg_temp
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_state[down_osd] = CEPH_OSD_UP;
+    inc.new_pg_temp[pg_t(1, my_rep_pool)] =
+      mempool::osdmap::vector<int>({down_osd, (down_osd + 1) % 6});
+    osdmap.apply_incremental(inc);
+    ASSERT_TRUE(mapping.update(osdmap, inc));
+    check();
+  }
+  {
+    // another osd is marked out; upmap a pg
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    int out_osd = (down_osd + 2) % 6;
+    inc.new_weight[out_osd] = CEPH_OSD_OUT;
+    vector<int> raw;
+    osdmap.pg_to_raw_up(rep_pg, &raw, nullptr);
+    for (int o = 0; o < 6; ++o) {
+      if (o != out_osd && std::find(raw.begin(), raw.end(), o) == raw.end()) {
+	inc.new_pg_upmap_items[rep_pg] =
+	  mempool::osdmap::vector<pair<int32_t,int32_t>>({{raw[0], o}});
+	break;
+      }
+    }
+    osdmap.apply_incremental(inc);
+    ASSERT_TRUE(mapping.update(osdmap, inc));
+    check();
+  }
+  {
+    // the down osd comes back up, and is in the pg_temp again
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    entity_addr_t addr;
+    addr.nonce = 100;
+    inc.new_up_client[down_osd] = addr;
+    inc.new_up_cluster[down_osd] = addr;
+    inc.new_hb_back_up[down_osd] = addr;
+    inc.new_hb_front_up[down_osd] = addr;
+    osdmap.apply_incremental(inc);
+    ASSERT_TRUE(mapping.update(osdmap, inc));
+    check();
+  }
+  {
+    // marking an osd in can move anything
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_weight[(down_osd + 2) % 6] = CEPH_OSD_IN;
+    osdmap.apply_incremental(inc);
+    ASSERT_FALSE(mapping.update(osdmap, inc));
+    check();
+  }
+  {
+    // so can skipping an epoch
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.old_pg_upmap_items.insert(rep_pg);
+    osdmap.apply_incremental(inc);
+    OSDMap::Incremental inc2(osdmap.get_epoch() + 1);
+    inc2.new_primary_affinity[down_osd] = 0;
+    osdmap.apply_incremental(inc2);
+    ASSERT_FALSE(mapping.update(osdmap, inc2));
+    check();
+  }
+  {
+    // upmap src_osd away from every pg that crush maps to it...
+    int src_osd = (down_osd + 1) % 6;
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    for (unsigned ps = 0; ps < 64; ++ps) {
+      pg_t pgid(ps, my_rep_pool);
+      vector<int> raw;
+      osdmap.pg_to_raw_osds(pgid, &raw, nullptr);
+      if (std::find(raw.begin(), raw.end(), src_osd) == raw.end()) {
+	continue;
+      }
+      for (int o = (src_osd + ps) % 6, n = 0; n < 6; o = (o + 1) % 6, ++n) {
+	if (std::find(raw.begin(), raw.end(), o) == raw.end()) {
+	  inc.new_pg_upmap_items[pgid] =
+	    mempool::osdmap::vector<pair<int32_t,int32_t>>({{src_osd, o}});
+	  break;
+	}
+      }
+    }
+    ASSERT_FALSE(inc.new_pg_upmap_items.empty());
+    osdmap.apply_incremental(inc);
+    ASSERT_TRUE(mapping.update(osdmap, inc));
+    check();
+  }
+  {
+    // ...then mark it out.  it is in none of those pgs' stored sets, but
+    // crush now rejects it and the upmap items stop applying.
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_weight[(down_osd + 1) % 6] = CEPH_OSD_OUT;
+    osdmap.apply_incremental(inc);
+    ASSERT_TRUE(mapping.update(osdmap, inc));
+    check();
+
+    OSDMapMapping full;
+    full.update(osdmap);
+    for (unsigned ps = 0; ps < 64; ++ps) {
+      pg_t pgid(ps, my_rep_pool);
+      vector<int> up, acting, up2, acting2;
+      int up_primary, acting_primary, up_primary2, acting_primary2;
+      mapping.get(pgid, &up, &up_primary, &acting, &acting_primary);
+      full.get(pgid, &up2, &up_primary2, &acting2, &acting_primary2);
+      ASSERT_EQ(up, up2) << pgid;
+      ASSERT_EQ(up_primary, up_primary2) << pgid;
+      ASSERT_EQ(acting, acting2) << pgid;
+      ASSERT_EQ(acting_primary, acting_primary2) << pgid;
+    }
+  }
+}
+
+TEST_F(OSDMapTest, CopySharesUntouched) {
+  set_up_map();
+
+  pg_t pgid = osdmap.raw_pg_to_pg(pg_t(0, my_rep_pool));
+  vector<int> up_osds, acting_osds;
+  int up_primary, acting_primary;
+  osdmap.pg_to_up_acting_osds(pgid, &up_osds, &up_primary,
+			      &acting_osds, &acting_primary);
+
+  OSDMap next;
+  next.cow_copy_from(osdmap);
+  {
+    // a weight change leaves crush and the addrs alone
+    OSDMap::Incremental inc(next.get_epoch() + 1);
+    inc.new_weight[0] = CEPH_OSD_OUT;
+    next.apply_incremental(inc);
+  }
+  ASSERT_EQ(osdmap.crush, next.crush);
+  const OSDMap& co = osdmap;
+  const OSDMap& cn = next;
+  ASSERT_EQ(&co.get_pools(), &cn.get_pools());
+  ASSERT_EQ(&co.get_pool_names(), &cn.get_pool_names());
+  ASSERT_EQ(&co.get_erasure_code_profiles(), &cn.get_erasure_code_profiles());
+
+  {
+    // a pg_temp and an address change must not leak into the original
+    OSDMap::Incremental inc(next.get_epoch() + 1);
+    vector<int> temp(acting_osds.rbegin(), acting_osds.rend());
+    inc.new_pg_temp[pgid] = mempool::osdmap::vector<int>(
+      temp.begin(), temp.end());
+    entity_addr_t addr;
+    addr.nonce = 100;
+    inc.new_up_client[1] = addr;
+    inc.new_up_cluster[1] = addr;
+    inc.new_uuid[1].generate_random();
+    next.apply_incremental(inc);
+
+    vector<int> next_up, next_acting;
+    next.pg_to_up_acting_osds(pgid, next_up, next_acting);
+    ASSERT_EQ(temp, next_acting);
+    ASSERT_EQ(100u, next.get_addr(1).get_nonce());
+  }
+
+  vector<int> still_up, still_acting;
+  osdmap.pg_to_up_acting_osds(pgid, still_up, still_acting);
+  ASSERT_EQ(acting_osds, still_acting);
+  ASSERT_EQ(1u, osdmap.get_addr(1).get_nonce());
+  ASSERT_NE(osdmap.get_uuid(1), next.get_uuid(1));
+
+  {
+    // so must a pool change and an upmap
+    OSDMap::Incremental inc(next.get_epoch() + 1);
+    pg_pool_t *pi = inc.get_new_pool(my_rep_pool,
+				     next.get_pg_pool(my_rep_pool));
+    pi->min_size = 1;
+    vector<int> upmap(up_osds.rbegin(), up_osds.rend());
+    inc.new_pg_upmap[pgid] = mempool::osdmap::vector<int32_t>(
+      upmap.begin(), upmap.end());
+    inc.new_weight[0] = CEPH_OSD_IN;
+    inc.new_erasure_code_profiles["cow"] = {{"k", "2"}, {"m", "1"}};
+    next.apply_incremental(inc);
+
+    vector<int> next_up, next_acting;
+    next.pg_to_raw_up(pgid, &next_up, &up_primary);
+    ASSERT_EQ(upmap, next_up);
+    ASSERT_EQ(1u, next.get_pg_pool(my_rep_pool)->get_min_size());
+  }
+  ASSERT_NE(&co.get_pools(), &cn.get_pools());
+  ASSERT_NE(&co.get_erasure_code_profiles(), &cn.get_erasure_code_profiles());
+  ASSERT_EQ(&co.get_pool_names(), &cn.get_pool_names());
+  ASSERT_EQ(2u, osdmap.get_pg_pool(my_rep_pool)->get_min_size());
+  ASSERT_EQ(0u, osdmap.get_erasure_code_profiles().count("cow"));
+  osdmap.pg_to_raw_up(pgid, &still_up, &up_primary);
+  ASSERT_EQ(up_osds, still_up);
+}
+
 TEST_F(OSDMapTest, parse_osd_id_list) {
   set_up_map();
   set<int> out;
@@ -142,6 +142,63 @@ TEST(TestOSDScrub, scrub_time_permit) {
 
 }
 
+TEST(TestOSDScrub, io_budget_object_ops) {
+  // a shallow scan only stats the object
+  ASSERT_EQ(1u, ScrubIOBudget::object_ops(false, 0, 524288));
+  ASSERT_EQ(1u, ScrubIOBudget::object_ops(false, 4 << 20, 524288));
+  // a deep scan adds one read per stride, rounded up
+  ASSERT_EQ(1u, ScrubIOBudget::object_ops(true, 0, 524288));
+  ASSERT_EQ(2u, ScrubIOBudget::object_ops(true, 1, 524288));
+  ASSERT_EQ(2u, ScrubIOBudget::object_ops(true, 524288, 524288));
+  ASSERT_EQ(3u, ScrubIOBudget::object_ops(true, 524289, 524288));
+  ASSERT_EQ(9u, ScrubIOBudget::object_ops(true, 4 << 20, 524288));
+  // a zero stride does not divide by zero
+  ASSERT_EQ(11u, ScrubIOBudget::object_ops(true, 10, 0));
+}
+
+TEST(TestOSDScrub, io_budget_charge) {
+  ScrubIOBudget budget;
+  utime_t now(1000, 0);
+
+  // unlimited: charges never delay
+  budget.charge(100, 100 << 20, 0, 0, now);
+  ASSERT_EQ(utime_t(), budget.delay(now));
+
+  // 10 ops/s: 5 ops cost half a second
+  budget.charge(5, 0, 10, 0, now);
+  ASSERT_EQ(utime_t(0, 500000000), budget.delay(now));
+  ASSERT_EQ(utime_t(0, 250000000), budget.delay(now + utime_t(0, 250000000)));
+  ASSERT_EQ(utime_t(), budget.delay(now + utime_t(1, 0)));
+
+  // charges made while waiting stack up
+  budget.charge(5, 0, 10, 0, now);
+  ASSERT_EQ(utime_t(1, 0), budget.delay(now));
+
+  // the slower of the two rates wins
+  now += utime_t(10, 0);
+  budget.charge(1, 4 << 20, 10, 1 << 20, now);
+  ASSERT_EQ(utime_t(4, 0), budget.delay(now));
+  now += utime_t(10, 0);
+  budget.charge(20, 1024, 10, 1 << 20, now);
+  ASSERT_EQ(utime_t(2, 0), budget.delay(now));
+
+  // idle time is not banked
+  now += utime_t(100, 0);
+  budget.charge(10, 0, 10, 0, now);
+  ASSERT_EQ(utime_t(1, 0), budget.delay(now));
+}
+
+TEST(TestOSDScrub, io_budget_preempt) {
+  // off
+  ASSERT_FALSE(ScrubIOBudget::should_preempt(0, 0));
+  ASSERT_FALSE(ScrubIOBudget::should_preempt(1000, 0));
+  // on at or above the configured depth
+  ASSERT_FALSE(ScrubIOBudget::should_preempt(0, 8));
+  ASSERT_FALSE(ScrubIOBudget::should_preempt(7, 8));
+  ASSERT_TRUE(ScrubIOBudget::should_preempt(8, 8));
+  ASSERT_TRUE(ScrubIOBudget::should_preempt(100, 8));
+}
+
 // Local Variables:
 // compile-command: "cd ../.. ; make unittest_osdscrub ; ./unittest_osdscrub --log-to-stderr=true  --debug-osd=20 # --gtest_filter=*.* "
 // End:
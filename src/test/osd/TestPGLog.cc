@@ -2253,7 +2253,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
   log.add(modify);
 
   EXPECT_TRUE(log.logged_object(oid));
-  pg_log_entry_t *entry = log.objects[oid];
+  pg_log_entry_t *entry = log.objects.find(oid)->second;
   EXPECT_EQ(modify.op, entry->op);
   EXPECT_EQ(modify.version, entry->version);
   EXPECT_EQ(modify.prior_version, entry->prior_version);
@@ -2267,7 +2267,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
   log.add(del);
 
   EXPECT_TRUE(log.logged_object(oid));
-  entry = log.objects[oid];
+  entry = log.objects.find(oid)->second;
   EXPECT_EQ(del.op, entry->op);
   EXPECT_EQ(del.version, entry->version);
   EXPECT_EQ(del.prior_version, entry->prior_version);
@@ -2280,7 +2280,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
 		   utime_t(20,1), -ENOENT));
 
   EXPECT_TRUE(log.logged_object(oid));
-  entry = log.objects[oid];
+  entry = log.objects.find(oid)->second;
   EXPECT_EQ(del.op, entry->op);
   EXPECT_EQ(del.version, entry->version);
   EXPECT_EQ(del.prior_version, entry->prior_version);
@@ -3005,6 +3005,158 @@ TEST(pg_log_dup_t, get_key_name) {
   EXPECT_EQ("dup_0000001234.00000000000000005678", a_key_name);
 }
 
+TEST(PGLog_IndexedLog, packed_entry_buffers) {
+  // the baseline is what IndexedLog::add() used to leave behind:
+  // trim_bl() gives each entry's rollback info an exactly sized buffer
+  // of its own.  Those are put in osd_pglog too so that both sides are
+  // accounted alike.
+  const unsigned num = 1000;
+  mempool::osd_pglog::list<pg_log_entry_t> entries;
+  for (unsigned i = 1; i <= num; ++i) {
+    pg_log_entry_t e(pg_log_entry_t::MODIFY, PGLogTestBase::mk_obj(i),
+		     eversion_t(1, i), eversion_t(), i,
+		     osd_reqid_t(), utime_t(), 0);
+    e.mod_desc.append(i);
+    e.mod_desc.trim_bl();
+    e.mod_desc.bl.reassign_to_mempool(mempool::mempool_osd_pglog);
+    entries.push_back(e);
+  }
+  // count the buffers and their bytes directly: the osd_pglog total
+  // would also take in the log's own indexes, built by the constructor
+  auto count_raws = [](const mempool::osd_pglog::list<pg_log_entry_t> &l,
+		       size_t *bytes) {
+    std::map<const buffer::raw*, size_t> raws;
+    for (auto &e : l)
+      for (auto &p : e.mod_desc.bl.buffers())
+	raws[p.get_raw()] = p.raw_length();
+    *bytes = 0;
+    for (auto &r : raws)
+      *bytes += r.second;
+    return raws.size();
+  };
+  size_t unpacked;
+  size_t unpacked_raws = count_raws(entries, &unpacked);
+
+  PGLog::IndexedLog log(
+    eversion_t(1, num), eversion_t(), eversion_t(), eversion_t(),
+    std::move(entries), mempool::osd_pglog::list<pg_log_dup_t>());
+  size_t packed;
+  size_t packed_raws = count_raws(log.log, &packed);
+  std::cout << "pg log entry buffers: " << unpacked_raws << " unpacked ("
+	    << unpacked << " bytes), " << packed_raws << " packed ("
+	    << packed << " bytes)" << std::endl;
+
+  // the bytes themselves take as much room as before, give or take the
+  // unused tail of the last 4KB chunk; what packing saves is a
+  // buffer::raw and its allocation per entry
+  ASSERT_EQ(num, unpacked_raws);
+  ASSERT_LT(packed_raws * 100, unpacked_raws);
+  ASSERT_LE(packed, unpacked + 4096);
+
+  // packing must not change what the entries say
+  unsigned i = 1;
+  for (auto &e : log.log) {
+    ASSERT_EQ(eversion_t(1, i), e.version);
+    ObjectModDesc expected;
+    expected.append(i);
+    ASSERT_TRUE(e.mod_desc.bl.contents_equal(expected.bl));
+    ++i;
+  }
+
+  // entries added later share the arena too
+  pg_log_entry_t e(pg_log_entry_t::MODIFY, PGLogTestBase::mk_obj(num + 1),
+		   eversion_t(1, num + 1), eversion_t(), num + 1,
+		   osd_reqid_t(), utime_t(), 0);
+  e.mod_desc.append(num + 1);
+  log.add(e);
+  ASSERT_EQ(1u, log.log.back().mod_desc.bl.buffers().size());
+  ASSERT_EQ(log.log.back().mod_desc.bl.buffers().front().get_raw(),
+	    (++log.log.rbegin())->mod_desc.bl.buffers().front().get_raw());
+}
+
+TEST(PGLog_IndexedLog, index_bytes_per_entry) {
+  // rbd-like workload: a few writes to each object, one reqid per write,
+  // object names too long for the short string optimization
+  const unsigned num = 3000;
+  const unsigned writes_per_object = 4;
+  size_t base = mempool::osd_pglog::allocated_bytes();
+  mempool::osd_pglog::list<pg_log_entry_t> entries;
+  for (unsigned i = 1; i <= num; ++i) {
+    unsigned id = i / writes_per_object;
+    hobject_t hoid;
+    char name[64];
+    snprintf(name, sizeof(name), "rbd_data.1234567890ab.%016x", id);
+    hoid.oid = name;
+    hoid.set_hash(id);
+    hoid.pool = 1;
+    entries.push_back(
+      pg_log_entry_t(pg_log_entry_t::MODIFY, hoid,
+		     eversion_t(1, i), eversion_t(), i,
+		     osd_reqid_t(entity_name_t::CLIENT(4100), 0, i),
+		     utime_t(), 0));
+  }
+  PGLog::IndexedLog log(
+    eversion_t(1, num), eversion_t(), eversion_t(), eversion_t(),
+    std::move(entries), mempool::osd_pglog::list<pg_log_dup_t>());
+  size_t with_log = mempool::osd_pglog::allocated_bytes() - base;
+
+  // what the log's own objects and caller_ops indexes take
+  size_t idx_base = mempool::osd_pglog::allocated_bytes();
+  size_t entry_idx;
+  {
+    PGLog::EntryIndex<hobject_t, &pg_log_entry_t::soid> objects;
+    PGLog::EntryIndex<osd_reqid_t, &pg_log_entry_t::reqid> caller_ops;
+    for (auto &e : log.log) {
+      objects.set(&e);
+      caller_ops.set(&e);
+    }
+    ASSERT_EQ(log.objects.size(), objects.size());
+    ASSERT_EQ(log.caller_ops.size(), caller_ops.size());
+    entry_idx = mempool::osd_pglog::allocated_bytes() - idx_base;
+  }
+  ASSERT_EQ(idx_base, mempool::osd_pglog::allocated_bytes());
+
+  // the same indexes keyed by value, as IndexedLog used to keep them.
+  // The key names' heap copies come from std::allocator and are not seen
+  // by the mempool, so they are counted by hand.
+  size_t value_idx;
+  {
+    size_t names = 0;
+    mempool::osd_pglog::unordered_map<hobject_t,pg_log_entry_t*> objects;
+    mempool::osd_pglog::unordered_map<osd_reqid_t,pg_log_entry_t*> caller_ops;
+    for (auto &e : log.log) {
+      auto r = objects.insert(make_pair(e.soid, &e));
+      if (r.second && r.first->first.oid.name.size() > 15)
+	names += r.first->first.oid.name.capacity() + 1;
+      caller_ops[e.reqid] = &e;
+    }
+    value_idx = mempool::osd_pglog::allocated_bytes() - idx_base + names;
+  }
+
+  size_t before = with_log - entry_idx + value_idx;
+  std::cout << "pg log index bytes per entry: " << value_idx / num
+	    << " keyed by value, " << entry_idx / num << " keyed by entry"
+	    << std::endl;
+  std::cout << "pg log bytes per entry (osd_pglog): " << before / num
+	    << " before, " << with_log / num << " after" << std::endl;
+  ASSERT_LT(entry_idx * 2, value_idx);
+  ASSERT_LT(with_log, before);
+
+  // lookups still find the newest entry for an object, and each reqid
+  hobject_t first = log.log.front().soid;
+  auto p = log.objects.find(first);
+  ASSERT_NE(log.objects.end(), p);
+  ASSERT_EQ(first, p->second->soid);
+  ASSERT_EQ(eversion_t(1, writes_per_object - 1), p->second->version);
+  for (auto &e : log.log) {
+    eversion_t v;
+    version_t uv;
+    int rc;
+    ASSERT_TRUE(log.get_request(e.reqid, &v, &uv, &rc));
+    ASSERT_EQ(e.version, v);
+  }
+}
+
 // Local Variables:
 // compile-command: "cd ../.. ; make unittest_pglog ; ./unittest_pglog --log-to-stderr=true  --debug-osd=20 # --gtest_filter=*.* "
 // End:
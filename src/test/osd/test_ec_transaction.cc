@@ -122,3 +122,89 @@ TEST(ectransaction, many_writes)
   ASSERT_EQ(0u, plan.to_read.size());
   ASSERT_EQ(1u, plan.will_write.size());
 }
+
+TEST(ectransaction, delta_writes)
+{
+  // k=4 with 4k chunks, the object is 8 stripes long
+  ECUtil::stripe_info_t sinfo(4, 4 * 4096);
+  auto get_hinfo = [&](const hobject_t &i) {
+    ECUtil::HashInfoRef ref(new ECUtil::HashInfo(6));
+    ref->set_projected_total_logical_size(sinfo, 8 * sinfo.get_stripe_width());
+    return ref;
+  };
+  hobject_t h;
+
+  // a single chunk
+  {
+    PGTransactionUPtr t(new PGTransaction);
+    bufferlist a;
+    a.append_zero(4096);
+    t->write(h, 16384 + 8192, a.length(), a, 0);
+    auto plan = ECTransaction::get_write_plan(
+      sinfo, std::move(t), get_hinfo, &dpp, 2);
+    ASSERT_EQ(1u, plan.delta_writes.size());
+    auto &delta = plan.delta_writes[h];
+    extent_set stripes, chunks;
+    stripes.insert(16384, 16384);
+    chunks.insert(16384 + 8192, 4096);
+    ASSERT_EQ(stripes, delta.stripes);
+    ASSERT_EQ(chunks, delta.chunks);
+    ASSERT_EQ(set<int>({2}), delta.data_shards);
+    // the full stripe plan is kept in case the backend declines
+    ASSERT_EQ(stripes, plan.to_read[h]);
+    ASSERT_EQ(stripes, plan.will_write[h]);
+  }
+
+  // unaligned, across a stripe boundary
+  {
+    PGTransactionUPtr t(new PGTransaction);
+    bufferlist a;
+    a.append_zero(8192);
+    t->write(h, 16384 + 10000, a.length(), a, 0);
+    auto plan = ECTransaction::get_write_plan(
+      sinfo, std::move(t), get_hinfo, &dpp, 2);
+    ASSERT_EQ(1u, plan.delta_writes.size());
+    auto &delta = plan.delta_writes[h];
+    extent_set stripes, chunks;
+    stripes.insert(16384, 2 * 16384);
+    chunks.insert(16384 + 8192, 3 * 4096);
+    ASSERT_EQ(stripes, delta.stripes);
+    ASSERT_EQ(chunks, delta.chunks);
+    ASSERT_EQ(set<int>({0, 2, 3}), delta.data_shards);
+  }
+
+  // too many chunks of one stripe
+  {
+    PGTransactionUPtr t(new PGTransaction);
+    bufferlist a;
+    a.append_zero(3 * 4096);
+    t->write(h, 16384, a.length(), a, 0);
+    auto plan = ECTransaction::get_write_plan(
+      sinfo, std::move(t), get_hinfo, &dpp, 2);
+    ASSERT_EQ(1u, plan.to_read.size());
+    ASSERT_EQ(0u, plan.delta_writes.size());
+  }
+
+  // growing the object
+  {
+    PGTransactionUPtr t(new PGTransaction);
+    bufferlist a;
+    a.append_zero(8192);
+    t->write(h, 8 * 16384 - 4096, a.length(), a, 0);
+    auto plan = ECTransaction::get_write_plan(
+      sinfo, std::move(t), get_hinfo, &dpp, 2);
+    ASSERT_EQ(0u, plan.delta_writes.size());
+  }
+
+  // disabled
+  {
+    PGTransactionUPtr t(new PGTransaction);
+    bufferlist a;
+    a.append_zero(4096);
+    t->write(h, 16384, a.length(), a, 0);
+    auto plan = ECTransaction::get_write_plan(
+      sinfo, std::move(t), get_hinfo, &dpp);
+    ASSERT_EQ(1u, plan.to_read.size());
+    ASSERT_EQ(0u, plan.delta_writes.size());
+  }
+}
@@ -15,6 +15,8 @@
 
 #include <gtest/gtest.h>
 #include "osd/ExtentCache.h"
+#include "include/mempool.h"
+#include "include/stringify.h"
 #include <iostream>
 
 extent_map imap_from_vector(vector<pair<uint64_t, uint64_t> > &&in)
@@ -278,3 +280,124 @@ TEST(extentcache, write_write_overlap2)
 
   c.release_write_pin(pin3);
 }
+
+TEST(ECReadCache, simple)
+{
+  hobject_t oid(sobject_t("foo", CEPH_NOSNAP));
+  hobject_t oid2(sobject_t("bar", CEPH_NOSNAP));
+  spg_t pgid(pg_t(0, 1), shard_id_t(0));
+  ECReadCache c(1 << 20);
+  extent_map out;
+
+  extent_set want = iset_from_vector({{0, 8192}});
+  ASSERT_FALSE(c.lookup(oid, want, &out));
+
+  extent_map got;
+  bufferlist bl;
+  bl.append(string(8192, 'a'));
+  got.insert(0, bl.length(), bl);
+  c.start_read(pgid, oid);
+  c.finish_read(oid, &got);
+  ASSERT_EQ(1u, c.get_num_objects());
+  ASSERT_EQ(8192u, c.get_bytes());
+  ASSERT_LE(8192u, mempool::osd_ec_read_cache::allocated_bytes());
+
+  ASSERT_TRUE(c.lookup(oid, iset_from_vector({{4096, 4096}}), &out));
+  ASSERT_EQ(iset_from_vector({{4096, 4096}}), out.get_interval_set());
+  bufferlist expected;
+  expected.append(string(4096, 'a'));
+  ASSERT_TRUE(out.begin().get_val().contents_equal(expected));
+  ASSERT_FALSE(c.lookup(oid, iset_from_vector({{4096, 8192}}), &out));
+
+  // a write racing with a read keeps its result out of the cache
+  c.start_read(pgid, oid2);
+  c.invalidate(oid2);
+  c.finish_read(oid2, &got);
+  ASSERT_EQ(1u, c.get_num_objects());
+
+  c.invalidate(oid);
+  ASSERT_EQ(0u, c.get_num_objects());
+  ASSERT_EQ(0u, c.get_bytes());
+
+  // going over the target drops the least recently read object
+  c.set_target(16384);
+  c.start_read(pgid, oid);
+  c.finish_read(oid, &got);
+  c.start_read(pgid, oid2);
+  c.finish_read(oid2, &got);
+  ASSERT_EQ(2u, c.get_num_objects());
+  ASSERT_TRUE(c.lookup(oid, want, &out));
+  hobject_t oid3(sobject_t("baz", CEPH_NOSNAP));
+  c.start_read(pgid, oid3);
+  c.finish_read(oid3, &got);
+  ASSERT_EQ(2u, c.get_num_objects());
+  ASSERT_EQ(16384u, c.get_bytes());
+  ASSERT_TRUE(c.lookup(oid, want, &out));
+  ASSERT_FALSE(c.lookup(oid2, want, &out));
+
+  c.clear(pgid);
+  ASSERT_EQ(0u, c.get_num_objects());
+  ASSERT_EQ(0u, c.get_bytes());
+}
+
+TEST(ECReadCache, shared)
+{
+  spg_t pg1(pg_t(0, 1), shard_id_t(0));
+  spg_t pg2(pg_t(1, 1), shard_id_t(0));
+  ECReadCache c(64 * 8192);
+  size_t base = mempool::osd_ec_read_cache::allocated_bytes();
+
+  extent_map got;
+  bufferlist bl;
+  bl.append(string(8192, 'a'));
+  got.insert(0, bl.length(), bl);
+  auto oid = [](spg_t pgid, int i) {
+    return hobject_t(object_t("obj" + stringify(i)), "", CEPH_NOSNAP,
+		     i, pgid.pool(), "");
+  };
+
+  // one PG's inserts evict the coldest objects of another
+  for (int i = 0; i < 64; ++i) {
+    c.start_read(pg1, oid(pg1, i));
+    c.finish_read(oid(pg1, i), &got);
+  }
+  ASSERT_EQ(64u, c.get_num_objects());
+  for (int i = 0; i < 16; ++i) {
+    c.start_read(pg2, oid(pg2, i));
+    c.finish_read(oid(pg2, i), &got);
+  }
+  ASSERT_EQ(64u, c.get_num_objects());
+  ASSERT_EQ(64u * 8192, c.get_bytes());
+  extent_map out;
+  extent_set want = iset_from_vector({{0, 8192}});
+  for (int i = 0; i < 16; ++i)
+    ASSERT_FALSE(c.lookup(oid(pg1, i), want, &out));
+  for (int i = 16; i < 64; ++i)
+    ASSERT_TRUE(c.lookup(oid(pg1, i), want, &out));
+  for (int i = 0; i < 16; ++i)
+    ASSERT_TRUE(c.lookup(oid(pg2, i), want, &out));
+
+  // lowering the target frees memory without waiting for a read
+  out.clear();
+  c.set_target(8 * 8192);
+  ASSERT_EQ(8u, c.get_num_objects());
+  ASSERT_EQ(8u * 8192, c.get_bytes());
+  ASSERT_GE(base + 8 * 8192 + 4096,
+	    mempool::osd_ec_read_cache::allocated_bytes());
+  // the most recently read survive: the last of pg2's
+  for (int i = 8; i < 16; ++i)
+    ASSERT_TRUE(c.lookup(oid(pg2, i), want, &out));
+
+  // an interval change of one PG leaves the other's entries alone
+  c.start_read(pg1, oid(pg1, 0));
+  c.finish_read(oid(pg1, 0), &got);
+  c.start_read(pg1, oid(pg1, 1));
+  c.clear(pg1);
+  c.finish_read(oid(pg1, 1), &got);
+  ASSERT_EQ(7u, c.get_num_objects());
+  ASSERT_FALSE(c.lookup(oid(pg1, 0), want, &out));
+  ASSERT_FALSE(c.lookup(oid(pg1, 1), want, &out));
+
+  c.set_target(0);
+  ASSERT_EQ(0u, c.get_num_objects());
+}
@@ -0,0 +1,142 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <gtest/gtest.h>
+#include "osd/RecoveryThrottle.h"
+
+static RecoveryThrottle::targets_t targets()
+{
+  RecoveryThrottle::targets_t t;
+  t.client_lat = 0.010;
+  t.commit_lat = 0.050;
+  t.max_sleep = 0.05;
+  return t;
+}
+
+TEST(RecoveryThrottle, interval_latency)
+{
+  typedef std::pair<uint64_t, uint64_t> sample_t;
+  // no ops in the interval
+  ASSERT_EQ(0, RecoveryThrottle::interval_latency(sample_t(10, 100),
+						  sample_t(10, 100)));
+  // counters went backwards (perf counters were reset)
+  ASSERT_EQ(0, RecoveryThrottle::interval_latency(sample_t(10, 100),
+						  sample_t(5, 50)));
+  // 10 ops taking 50ms in total
+  ASSERT_DOUBLE_EQ(0.005, RecoveryThrottle::interval_latency(
+		     sample_t(10, 100), sample_t(20, 150)));
+}
+
+TEST(RecoveryThrottle, clamp)
+{
+  RecoveryThrottle rt;
+  ASSERT_EQ(0u, rt.get_max_active());
+
+  // starts at the configured ceiling
+  ASSERT_EQ(RecoveryThrottle::STEP_NONE,
+	    rt.update(0.001, 0.001, 0, false, 3, targets()));
+  ASSERT_EQ(3u, rt.get_max_active());
+  ASSERT_EQ(0, rt.get_sleep());
+
+  // never raised above it, even when held back
+  ASSERT_EQ(RecoveryThrottle::STEP_NONE,
+	    rt.update(0.001, 0.001, 3, true, 3, targets()));
+  ASSERT_EQ(3u, rt.get_max_active());
+
+  // follows osd_recovery_max_active down
+  rt.update(0.001, 0.001, 0, false, 2, targets());
+  ASSERT_EQ(2u, rt.get_max_active());
+
+  rt.reset();
+  ASSERT_EQ(0u, rt.get_max_active());
+  ASSERT_EQ(0, rt.get_sleep());
+}
+
+TEST(RecoveryThrottle, step_down)
+{
+  RecoveryThrottle rt;
+  rt.update(0.001, 0.001, 0, false, 8, targets());
+  ASSERT_EQ(8u, rt.get_max_active());
+
+  // client latency over target halves concurrency...
+  for (uint64_t expect : {4, 2, 1}) {
+    ASSERT_EQ(RecoveryThrottle::STEP_BACKOFF,
+	      rt.update(0.020, 0.001, 0, false, 8, targets()));
+    ASSERT_EQ(expect, rt.get_max_active());
+    ASSERT_EQ(0, rt.get_sleep());
+  }
+
+  // ...then doubles the sleep, up to osd_recovery_adaptive_max_sleep
+  for (double expect : {0.01, 0.02, 0.04, 0.05}) {
+    ASSERT_EQ(RecoveryThrottle::STEP_BACKOFF,
+	      rt.update(0.020, 0.001, 0, false, 8, targets()));
+    ASSERT_EQ(1u, rt.get_max_active());
+    ASSERT_DOUBLE_EQ(expect, rt.get_sleep());
+  }
+  ASSERT_EQ(RecoveryThrottle::STEP_NONE,
+	    rt.update(0.020, 0.001, 0, false, 8, targets()));
+  ASSERT_DOUBLE_EQ(0.05, rt.get_sleep());
+}
+
+TEST(RecoveryThrottle, commit_latency)
+{
+  RecoveryThrottle rt;
+  rt.update(0.001, 0.001, 0, false, 4, targets());
+
+  // store commit latency alone is enough to back off
+  ASSERT_EQ(RecoveryThrottle::STEP_BACKOFF,
+	    rt.update(0.001, 0.100, 0, false, 4, targets()));
+  ASSERT_EQ(2u, rt.get_max_active());
+
+  // a zero target ignores that latency
+  RecoveryThrottle::targets_t t = targets();
+  t.client_lat = 0;
+  t.commit_lat = 0;
+  ASSERT_EQ(RecoveryThrottle::STEP_RAISE,
+	    rt.update(10.0, 10.0, 2, false, 4, t));
+  ASSERT_EQ(3u, rt.get_max_active());
+}
+
+TEST(RecoveryThrottle, recover)
+{
+  RecoveryThrottle rt;
+  rt.update(0.001, 0.001, 0, false, 4, targets());
+  for (int i = 0; i < 6; ++i)
+    rt.update(0.020, 0.001, 0, false, 4, targets());
+  ASSERT_EQ(1u, rt.get_max_active());
+  ASSERT_DOUBLE_EQ(0.05, rt.get_sleep());
+
+  // under target but not held back: stay put
+  ASSERT_EQ(RecoveryThrottle::STEP_NONE,
+	    rt.update(0.001, 0.001, 0, false, 4, targets()));
+  ASSERT_EQ(1u, rt.get_max_active());
+  ASSERT_DOUBLE_EQ(0.05, rt.get_sleep());
+
+  // held back: undo the sleep first...
+  for (double expect : {0.025, 0.0125, 0.00625, 0.0}) {
+    ASSERT_EQ(RecoveryThrottle::STEP_RAISE,
+	      rt.update(0.001, 0.001, 0, true, 4, targets()));
+    ASSERT_EQ(1u, rt.get_max_active());
+    ASSERT_DOUBLE_EQ(expect, rt.get_sleep());
+  }
+
+  // ...then add one active op at a time, while they are all in use
+  for (uint64_t expect : {2, 3, 4}) {
+    ASSERT_EQ(RecoveryThrottle::STEP_RAISE,
+	      rt.update(0.001, 0.001, rt.get_max_active(), false, 4,
+			targets()));
+    ASSERT_EQ(expect, rt.get_max_active());
+  }
+  ASSERT_EQ(RecoveryThrottle::STEP_NONE,
+	    rt.update(0.001, 0.001, 4, true, 4, targets()));
+  ASSERT_EQ(4u, rt.get_max_active());
+}
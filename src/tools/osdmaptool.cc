@@ -18,10 +18,12 @@
 #include "common/ceph_argparse.h"
 #include "common/errno.h"
 #include "common/safe_io.h"
+#include "include/stringify.h"
 #include "mon/health_check.h"
 
 #include "global/global_init.h"
 #include "osd/OSDMap.h"
+#include "osd/OSDMapMapping.h"
 
 using namespace std;
 
@@ -33,6 +35,8 @@ void usage()
   cout << "   --test-map-pgs [--pool <poolid>] [--pg_num <pg_num>] map all pgs" << std::endl;
   cout << "   --test-map-pgs-dump [--pool <poolid>] map all pgs" << std::endl;
   cout << "   --test-map-pgs-dump-all [--pool <poolid>] map all pgs to osds" << std::endl;
+  cout << "   --test-mapping-epochs <n> apply <n> synthetic osd up/down/out epochs" << std::endl;
+  cout << "                           and time incremental vs full pg mapping updates" << std::endl;
   cout << "   --health                dump health checks" << std::endl;
   cout << "   --mark-up-in            mark osds up and in (but do not persist)" << std::endl;
   cout << "   --mark-out <osdid>      mark an osd as out (but do not persist)" << std::endl;
@@ -132,6 +136,7 @@ int main(int argc, const char **argv)
   std::set<std::string> upmap_pools;
   int64_t pg_num = -1;
   bool test_map_pgs_dump_all = false;
+  int test_mapping_epochs = 0;
 
   std::string val;
   std::ostringstream err;
@@ -187,6 +192,11 @@ int main(int argc, const char **argv)
       test_map_pgs_dump = true;
     } else if (ceph_argparse_flag(args, i, "--test-map-pgs-dump-all", (char*)NULL)) {
       test_map_pgs_dump_all = true;
+    } else if (ceph_argparse_witharg(args, i, &test_mapping_epochs, err, "--test-mapping-epochs", (char*)NULL)) {
+      if (!err.str().empty()) {
+	cerr << err.str() << std::endl;
+	exit(EXIT_FAILURE);
+      }
     } else if (ceph_argparse_flag(args, i, "--test-random", (char*)NULL)) {
       test_random = true;
     } else if (ceph_argparse_flag(args, i, "--clobber", (char*)NULL)) {
@@ -595,6 +605,66 @@ int main(int argc, const char **argv)
       cout << "size " << i << "\t" << size[i] << std::endl;
     }
   }
+  if (test_mapping_epochs > 0) {
+    // flap random osds down/up (and occasionally out/in) and compare the
+    // cost of OSDMapMapping::update(map, inc) with a full recompute
+    OSDMapMapping inc_mapping, full_mapping;
+    auto t0 = ceph::mono_clock::now();
+    inc_mapping.update(osdmap);
+    auto t1 = ceph::mono_clock::now();
+    cout << "epoch " << osdmap.get_epoch() << " initial full mapping "
+	 << std::chrono::duration<double>(t1 - t0).count() << "s" << std::endl;
+
+    std::set<int> down, out;
+    double inc_total = 0, full_total = 0;
+    int num_incremental = 0;
+    for (int e = 0; e < test_mapping_epochs; ++e) {
+      OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+      inc.fsid = osdmap.get_fsid();
+      string what;
+      int osd = rand() % osdmap.get_max_osd();
+      if (!osdmap.exists(osd)) {
+	what = "noop";
+      } else if (down.count(osd)) {
+	inc.new_up_client[osd] = entity_addr_t();
+	down.erase(osd);
+	what = "osd." + stringify(osd) + " up";
+      } else if (out.count(osd)) {
+	inc.new_weight[osd] = CEPH_OSD_IN;
+	out.erase(osd);
+	what = "osd." + stringify(osd) + " in";
+      } else if (osdmap.is_up(osd) && rand() % 8 == 0) {
+	inc.new_weight[osd] = CEPH_OSD_OUT;
+	out.insert(osd);
+	what = "osd." + stringify(osd) + " out";
+      } else if (osdmap.is_up(osd)) {
+	inc.new_state[osd] = CEPH_OSD_UP;
+	down.insert(osd);
+	what = "osd." + stringify(osd) + " down";
+      } else {
+	what = "noop";
+      }
+      osdmap.apply_incremental(inc);
+
+      t0 = ceph::mono_clock::now();
+      bool incremental = inc_mapping.update(osdmap, inc);
+      t1 = ceph::mono_clock::now();
+      full_mapping.update(osdmap);
+      auto t2 = ceph::mono_clock::now();
+      double inc_secs = std::chrono::duration<double>(t1 - t0).count();
+      double full_secs = std::chrono::duration<double>(t2 - t1).count();
+      inc_total += inc_secs;
+      full_total += full_secs;
+      if (incremental)
+	++num_incremental;
+      cout << "epoch " << osdmap.get_epoch() << " " << what
+	   << (incremental ? " incremental " : " full ") << inc_secs
+	   << "s vs full " << full_secs << "s" << std::endl;
+    }
+    cout << "total " << test_mapping_epochs << " epochs ("
+	 << num_incremental << " incremental) "
+	 << inc_total << "s vs full " << full_total << "s" << std::endl;
+  }
   if (test_crush) {
     int pass = 0;
     while (1) {
@@ -630,6 +700,7 @@ int main(int argc, const char **argv)
       export_crush.empty() && import_crush.empty() && 
       test_map_pg.empty() && test_map_object.empty() &&
       !test_map_pgs && !test_map_pgs_dump && !test_map_pgs_dump_all &&
+      !test_mapping_epochs &&
       !upmap && !upmap_cleanup) {
     cerr << me << ": no action specified?" << std::endl;
     usage();